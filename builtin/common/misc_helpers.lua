@@ -789,3 +789,17 @@ function core.parse_coordinates(x, y, z, relative_to)
 	local rz = core.parse_relative_number(z, relative_to.z)
 	return rx and ry and rz and { x = rx, y = ry, z = rz }
 end
+
+-- Lua 5.1 ignores __pairs, which shared tables need to be iterable
+do
+	local rawpairs = pairs
+	function pairs(t)
+		if type(t) == "userdata" then
+			local mt = getmetatable(t)
+			if type(mt) == "table" and mt.__pairs then
+				return mt.__pairs(t)
+			end
+		end
+		return rawpairs(t)
+	end
+end
@@ -1,11 +1,17 @@
 
 core.async_jobs = {}
 
-function core.async_event_handler(jobid, retval)
-	local callback = core.async_jobs[jobid]
-	assert(type(callback) == "function")
-	callback(unpack(retval, 1, retval.n))
-	core.async_jobs[jobid] = nil
+-- Called by C++ with the results of a batch of jobs of the same mod
+function core.async_event_handler(jobids, retvals)
+	local jobs = core.async_jobs
+	for i = 1, #jobids do
+		local jobid = jobids[i]
+		local callback = jobs[jobid]
+		assert(type(callback) == "function")
+		jobs[jobid] = nil
+		local retval = retvals[i]
+		callback(unpack(retval, 1, retval.n))
+	end
 end
 
 function core.handle_async(func, callback, ...)
@@ -20,3 +26,28 @@ function core.handle_async(func, callback, ...)
 	return true
 end
 
+function core.handle_async_batch(func, callback, args_list)
+	assert(type(func) == "function" and type(callback) == "function" and
+		type(args_list) == "table", "Invalid core.handle_async_batch invocation")
+	local count = #args_list
+	local results = {}
+	if count == 0 then
+		core.after(0, callback, results)
+		return true
+	end
+	local mod_origin = core.get_last_run_mod()
+
+	local first = core.do_async_callback_batch(func, args_list, mod_origin)
+	local remaining = count
+	for i = 1, count do
+		core.async_jobs[first + i - 1] = function(retval)
+			results[i] = retval
+			remaining = remaining - 1
+			if remaining == 0 then
+				callback(results)
+			end
+		end
+	end
+
+	return true
+end
@@ -1173,6 +1173,67 @@ core.register_chatcommand("shutdown", {
 	end,
 })
 
+core.register_chatcommand("trace", {
+	params = "start | stop",
+	description = S("Record a timeline of all server threads and save it "
+		.. "in the world directory (Chrome trace format)"),
+	privs = {server=true},
+	func = function(name, param)
+		if param == "start" then
+			if not core.start_trace() then
+				return false, S("A trace is already being recorded.")
+			end
+			core.log("action", name .. " started a trace")
+			return true, S("Started recording a trace.")
+		elseif param == "stop" then
+			local path = core.stop_trace()
+			if not path then
+				return false, S("No trace is being recorded.")
+			end
+			return true, S("Writing trace to @1.", path)
+		end
+		return false, S("Invalid parameters (see /help trace).")
+	end,
+})
+
+core.register_chatcommand("lua_usage", {
+	params = S("[<mod> | reset]"),
+	description = S("Show the Lua callbacks that took the most time "
+		.. "(needs the setting lua_accounting)"),
+	privs = {server=true},
+	func = function(name, param)
+		local usage = core.get_lua_usage()
+		if not usage then
+			return false, S("Lua accounting is disabled.")
+		end
+		if param == "reset" then
+			core.reset_lua_usage()
+			return true, S("Reset the Lua usage.")
+		end
+
+		local lines = {}
+		for _, entry in ipairs(usage) do
+			if param == "" or entry.mod == param then
+				local label = entry.type
+				if entry.name ~= "" then
+					label = label .. " " .. entry.name
+				end
+				lines[#lines + 1] = string.format(
+					"%s: %s: %d calls, %.1f ms total, %.3f ms max, %d KiB",
+					entry.mod, label, entry.calls, entry.time / 1000,
+					entry.max_time / 1000, entry.memory / 1024)
+				if #lines == 15 then
+					break
+				end
+			end
+		end
+		if #lines == 0 then
+			return true, S("No Lua usage recorded.")
+		end
+		return true, table.concat(lines, "\n")
+	end,
+})
+
 core.register_chatcommand("ban", {
 	params = S("[<name>]"),
 	description = S("Ban the IP of a player or show the ban list"),
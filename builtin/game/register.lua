@@ -636,6 +636,25 @@ core.register_on_mods_loaded(function()
 	end)
 end)
 
+-- on_generated callbacks of the server environment run with the environment
+-- locked, which stalls the server step. Point out the mods still using them.
+core.register_on_mods_loaded(function()
+	local mods = {}
+	for _, func in ipairs(core.registered_on_generateds) do
+		local origin = core.callback_origins[func]
+		local mod = origin and origin.mod or "??"
+		if not mods[mod] then
+			mods[mod] = true
+			mods[#mods + 1] = mod
+		end
+	end
+	if #mods > 0 then
+		core.log("info", "Mods with on_generated callbacks in the server " ..
+			"environment: " .. table.concat(mods, ", ") .. ". These block " ..
+			"the server step, consider moving them to core.register_mapgen_script.")
+	end
+end)
+
 --
 -- Compatibility for on_mapgen_init()
 --
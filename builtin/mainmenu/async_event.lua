@@ -1,14 +1,17 @@
 
 core.async_jobs = {}
 
-local function handle_job(jobid, serialized_retval)
-	local retval = core.deserialize(serialized_retval)
-	assert(type(core.async_jobs[jobid]) == "function")
-	core.async_jobs[jobid](retval)
-	core.async_jobs[jobid] = nil
+local function handle_jobs(jobids, serialized_retvals)
+	for i = 1, #jobids do
+		local jobid = jobids[i]
+		local retval = core.deserialize(serialized_retvals[i])
+		assert(type(core.async_jobs[jobid]) == "function")
+		core.async_jobs[jobid](retval)
+		core.async_jobs[jobid] = nil
+	end
 end
 
-core.async_event_handler = handle_job
+core.async_event_handler = handle_jobs
 
 function core.handle_async(func, parameter, callback)
 	-- Serialize parameters
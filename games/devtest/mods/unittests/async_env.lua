@@ -142,6 +142,20 @@ local function test_handle_async(cb)
 end
 unittests.register("test_handle_async", test_handle_async, {async=true})
 
+local function test_shared_table_passing(cb)
+	local st = core.share({values = {1, 2, 3}})
+	core.handle_async(function(t)
+		assert(type(t) == "userdata")
+		return t.values, t.values[3]
+	end, function(values, third)
+		if values ~= st.values or third ~= 3 then
+			return cb("shared table was copied or changed")
+		end
+		cb()
+	end, st)
+end
+unittests.register("test_shared_table_passing", test_shared_table_passing, {async=true})
+
 local function test_userdata_passing2(cb, _, pos)
 	-- VManip: check transfer into other env
 	local vm = core.get_voxel_manip(pos, pos)
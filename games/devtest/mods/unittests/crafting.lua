@@ -110,3 +110,41 @@ local function test_get_craft_result()
 	assert(output.item:is_empty())
 end
 unittests.register("test_get_craft_result", test_get_craft_result)
+
+-- Test core.get_craft_results function
+local function test_get_craft_results()
+	local torch = {
+		method = "normal",
+		width = 2,
+		items = {"", "unittests:coal_lump 2", "", "unittests:stick"}
+	}
+	local fuel = {
+		method = "fuel",
+		width = 1,
+		items = {"unittests:coal_lump"}
+	}
+	local nothing = {
+		method = "normal",
+		width = 1,
+		items = {"unittests:stick"}
+	}
+	local outputs, decremented_inputs = core.get_craft_results({torch, fuel, torch, nothing})
+	assert(#outputs == 4 and #decremented_inputs == 4)
+	for _, i in ipairs({1, 3}) do
+		local expected_output, expected_decremented = core.get_craft_result(torch)
+		assert(outputs[i].item:equals(expected_output.item))
+		assert(decremented_inputs[i].items[2]:get_count() == 1)
+		assert(decremented_inputs[i].items[4]:is_empty())
+		assert(expected_decremented.width == decremented_inputs[i].width)
+	end
+	assert(outputs[2].time > 0)
+	assert(outputs[4].item:is_empty())
+	assert(decremented_inputs[4].items[1]:get_name() == "unittests:stick")
+
+	-- Extra arguments are ignored
+	local inputs = {fuel}
+	outputs, decremented_inputs = core.get_craft_results(inputs, nil)
+	assert(#outputs == 1 and #decremented_inputs == 1)
+	assert(outputs[1].time > 0 and inputs[1] == fuel)
+end
+unittests.register("test_get_craft_results", test_get_craft_results)
@@ -201,6 +201,7 @@ dofile(modpath .. "/inventory.lua")
 dofile(modpath .. "/load_time.lua")
 dofile(modpath .. "/on_shutdown.lua")
 dofile(modpath .. "/color.lua")
+dofile(modpath .. "/voxelmanip.lua")
 
 --------------
 
@@ -353,3 +353,38 @@ local function test_ipc_poll(cb)
 	print("delta: " .. (core.get_us_time() - t0) .. "us")
 end
 unittests.register("test_ipc_poll", test_ipc_poll)
+
+local function test_shared_table()
+	local inner = {"a", "b"}
+	local st = core.share({x = 1, [true] = "yes", [0.5] = false,
+		list = inner, again = inner, 10, 20, 30})
+	assert(type(st) == "userdata")
+	assert(st.x == 1 and st[true] == "yes" and st[0.5] == false)
+	assert(#st == 3 and st[2] == 20 and st[4] == nil)
+	assert(st.list[2] == "b" and #st.list == 2)
+	assert(st.list == st.again)
+	assert(core.share(st) == st)
+	assert(not pcall(function() st.x = 2 end))
+
+	local n = 0
+	for k, v in pairs(st) do
+		n = n + 1
+		assert(k ~= nil and v ~= nil)
+	end
+	assert(n == 8)
+
+	local copy = core.unshare(st)
+	assert(type(copy) == "table" and type(copy.list) == "table")
+	assert(copy.x == 1 and copy[3] == 30 and copy.list[1] == "a")
+
+	local cyclic = {}
+	cyclic.self = cyclic
+	assert(not pcall(core.share, cyclic))
+	assert(not pcall(core.share, {f = print}))
+
+	-- IPC hands out the same table
+	core.ipc_set("unittests:shared", st)
+	assert(core.ipc_get("unittests:shared") == st)
+	assert(core.ipc_cas("unittests:shared", st, nil))
+end
+unittests.register("test_shared_table", test_shared_table)
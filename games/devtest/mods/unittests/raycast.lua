@@ -101,3 +101,28 @@ local function test_raycast_noskip(_, pos)
 end
 
 unittests.register("test_raycast_noskip", test_raycast_noskip, {map = true, random = true})
+
+local function test_raycast_batch(_, pos)
+	local rays = {}
+	for i = 1, 20 do
+		local from = pos:offset(math.random(-20, 20), math.random(5, 20), math.random(-20, 20))
+		local to = pos:offset(math.random(-20, 20), math.random(-20, 0), math.random(-20, 20))
+		rays[i] = {from, to}
+	end
+	-- A ray that does not hit anything
+	rays[#rays + 1] = {pos:offset(0, 30, 0), pos:offset(0, 30, 0)}
+
+	local results = core.raycast_batch(rays, false, false)
+	assert(#results == #rays)
+	for i, ray in ipairs(rays) do
+		local expected = core.raycast(ray[1], ray[2], false, false):next()
+		if expected then
+			assert(vector.equals(results[i].under, expected.under))
+			assert(vector.equals(results[i].intersection_point, expected.intersection_point))
+		else
+			assert(results[i] == false)
+		end
+	end
+end
+
+unittests.register("test_raycast_batch", test_raycast_batch, {map = true, random = true})
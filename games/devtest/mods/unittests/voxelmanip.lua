@@ -0,0 +1,38 @@
+local function test_voxelmanip_buffer(_, pos)
+	local vm = VoxelManip(pos, pos)
+	local emin, emax = vm:get_emerged_area()
+	local volume = VoxelArea(emin, emax):getVolume()
+
+	local data = vm:get_data()
+	local buf = vm:get_buffer()
+	assert(buf:get_field() == "content")
+	assert(#buf == volume)
+	assert(buf[0] == nil and buf[volume + 1] == nil)
+	for i = 1, volume, 997 do
+		assert(buf[i] == data[i])
+	end
+
+	local c_stone = core.get_content_id("basenodes:stone")
+	local c_dirt = core.get_content_id("basenodes:dirt")
+	buf:fill(c_stone)
+	buf[1] = c_dirt
+	data = vm:get_data()
+	assert(data[1] == c_dirt and data[2] == c_stone and data[volume] == c_stone)
+
+	assert(buf:replace({[c_stone] = c_dirt}, 2, 10) == 9)
+	data = vm:get_data()
+	assert(data[10] == c_dirt and data[11] == c_stone)
+
+	-- Copying between fields and from tables
+	local param2 = vm:get_buffer("param2")
+	param2:copy_from({1, 2, 3})
+	assert(param2[1] == 1 and param2[3] == 3)
+	local param1 = vm:get_buffer("param1")
+	param1:copy_from(param2, 2)
+	assert(param1[2] == 1 and param1[4] == 3)
+	assert(vm:get_light_data()[4] == 3)
+
+	assert(not pcall(function() buf[volume + 1] = 0 end))
+	assert(not pcall(vm.get_buffer, vm, "foo"))
+end
+unittests.register("test_voxelmanip_buffer", test_voxelmanip_buffer, {map=true})
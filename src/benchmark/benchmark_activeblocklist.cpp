@@ -0,0 +1,128 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "mapblock.h"
+#include "serverenvironment.h"
+#include "util/numeric.h"
+
+namespace {
+
+// Defaults of active_block_range and active_object_send_range_blocks
+constexpr s16 BLOCK_RANGE = 4;
+constexpr s16 OBJECT_RANGE = 8;
+
+std::vector<ActiveBlockViewer> make_viewers(size_t n)
+{
+	std::vector<ActiveBlockViewer> viewers(n);
+	for (size_t i = 0; i < n; i++) {
+		ActiveBlockViewer &viewer = viewers[i];
+		viewer.id = i + 1;
+		viewer.blockpos = v3s16(myrand_range(-100, 100), myrand_range(-2, 2),
+			myrand_range(-100, 100));
+		viewer.object_range = OBJECT_RANGE;
+		viewer.eye_pos = v3f::from(viewer.blockpos * MAP_BLOCKSIZE) * BS;
+		viewer.camera_dir = v3f(0, 0, 1);
+		viewer.camera_dir.rotateXZBy(myrand_range(0, 359));
+		viewer.fov = 1.5f;
+	}
+	return viewers;
+}
+
+/*
+	Every player walks and looks around between two updates, which are
+	active_block_mgmt_interval = 2 seconds apart: they walk 8 nodes in the
+	direction they look at, so they enter another block every other update,
+	and turn by 1 to 30 degrees.
+*/
+void walk(std::vector<ActiveBlockViewer> &viewers, u32 step)
+{
+	for (size_t i = 0; i < viewers.size(); i++) {
+		ActiveBlockViewer &viewer = viewers[i];
+		viewer.camera_dir.rotateXZBy((i + step) % 30 + 1);
+		viewer.eye_pos += viewer.camera_dir * (8 * BS);
+		viewer.blockpos = getNodeBlockPos(floatToInt(viewer.eye_pos, BS));
+	}
+}
+
+// Builds the lists from scratch every time, for comparison
+void rebuild(const std::vector<ActiveBlockViewer> &viewers,
+	std::set<v3s16> &list, std::set<v3s16> &abm_list)
+{
+	abm_list.clear();
+	std::set<v3s16> extra;
+	for (const ActiveBlockViewer &viewer : viewers) {
+		v3s16 p;
+		const v3s16 &p0 = viewer.blockpos;
+		s16 r = BLOCK_RANGE;
+		for (p.X = p0.X - r; p.X <= p0.X + r; p.X++)
+		for (p.Y = p0.Y - r; p.Y <= p0.Y + r; p.Y++)
+		for (p.Z = p0.Z - r; p.Z <= p0.Z + r; p.Z++) {
+			if (p.getDistanceFrom(p0) <= r)
+				abm_list.insert(p);
+		}
+		r = OBJECT_RANGE;
+		for (p.X = p0.X - r; p.X <= p0.X + r; p.X++)
+		for (p.Y = p0.Y - r; p.Y <= p0.Y + r; p.Y++)
+		for (p.Z = p0.Z - r; p.Z <= p0.Z + r; p.Z++) {
+			if (isBlockInSight(p, viewer.eye_pos, viewer.camera_dir, viewer.fov,
+					r * BS * MAP_BLOCKSIZE))
+				extra.insert(p);
+		}
+	}
+	std::set<v3s16> newlist = abm_list;
+	newlist.insert(extra.begin(), extra.end());
+	std::set<v3s16> removed;
+	std::set_difference(list.begin(), list.end(), newlist.begin(), newlist.end(),
+		std::inserter(removed, removed.end()));
+	list = std::move(newlist);
+}
+
+}
+
+template <size_t N>
+void benchUpdate(Catch::Benchmark::Chronometer &meter, bool walking)
+{
+	ActiveBlockList list;
+	std::vector<ActiveBlockViewer> viewers = make_viewers(N);
+	std::vector<v3s16> removed, added, extra_added;
+	list.update(viewers, BLOCK_RANGE, OBJECT_RANGE, removed, added, extra_added);
+
+	u32 step = 0;
+	meter.measure([&] {
+		if (walking)
+			walk(viewers, step++);
+		removed.clear();
+		added.clear();
+		extra_added.clear();
+		list.update(viewers, BLOCK_RANGE, OBJECT_RANGE, removed, added, extra_added);
+		return list.size();
+	});
+}
+
+template <size_t N>
+void benchRebuild(Catch::Benchmark::Chronometer &meter)
+{
+	std::set<v3s16> list, abm_list;
+	std::vector<ActiveBlockViewer> viewers = make_viewers(N);
+
+	u32 step = 0;
+	meter.measure([&] {
+		walk(viewers, step++);
+		rebuild(viewers, list, abm_list);
+		return list.size();
+	});
+}
+
+#define BENCH_UPDATE(_count) \
+	BENCHMARK_ADVANCED("update_idle_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchUpdate<_count>(meter, false); }; \
+	BENCHMARK_ADVANCED("update_walking_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchUpdate<_count>(meter, true); }; \
+	BENCHMARK_ADVANCED("rebuild_walking_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchRebuild<_count>(meter); };
+
+TEST_CASE("ActiveBlockList") {
+	BENCH_UPDATE(10)
+	BENCH_UPDATE(100)
+}
@@ -0,0 +1,86 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "craftdef.h"
+#include "dummygamedef.h"
+
+// Number of items (and recipes of each kind), similar to a large game
+constexpr u32 NUM_ITEMS = 1000;
+
+static std::string itemName(u32 i)
+{
+	return "bench:item_" + std::to_string(i);
+}
+
+TEST_CASE("benchmark_craft")
+{
+	DummyGameDef gamedef;
+	auto *idef = static_cast<IWritableItemDefManager *>(gamedef.getItemDefManager());
+	auto *cdef = static_cast<IWritableCraftDefManager *>(gamedef.getCraftDefManager());
+
+	for (u32 i = 0; i < NUM_ITEMS; i++) {
+		ItemDefinition def;
+		def.type = ITEM_CRAFT;
+		def.name = itemName(i);
+		if (i % 10 == 0)
+			def.groups["wood"] = 1;
+		idef->registerItem(def);
+	}
+
+	// Shaped 3x3 recipes from items i and i+1, shapeless ones from i, i+2 and
+	// a group
+	for (u32 i = 0; i + 2 < NUM_ITEMS; i++) {
+		const std::string a = itemName(i), b = itemName(i + 1);
+		cdef->registerCraft(new CraftDefinitionShaped(itemName(i + 2) + " 4", 3,
+				{a, a, a, "", b, "", "", b, ""}, CraftReplacements()), &gamedef);
+		cdef->registerCraft(new CraftDefinitionShapeless(itemName(i) + " 2",
+				{a, itemName(i + 2), "group:wood"}, CraftReplacements()), &gamedef);
+	}
+	cdef->initHashes(&gamedef);
+
+	auto grid = [&] (const std::vector<std::string> &names) {
+		std::vector<ItemStack> items;
+		for (const auto &name : names)
+			items.emplace_back(name, 1, 0, idef);
+		return CraftInput(CRAFT_METHOD_NORMAL, 3, items);
+	};
+	const std::string a = itemName(500), b = itemName(501);
+	const CraftInput shaped = grid({a, a, a, "", b, "", "", b, ""});
+	const CraftInput shapeless = grid({itemName(502), "", a, itemName(20), "", "", "", "", ""});
+	const CraftInput nothing = grid({a, b, a, b, a, b, a, b, a});
+
+	auto craft = [&] (CraftInput input) {
+		CraftOutput output;
+		std::vector<ItemStack> output_replacements;
+		cdef->getCraftResult(input, output, output_replacements, true, &gamedef);
+		return output.item;
+	};
+
+	REQUIRE(craft(shaped) == itemName(502) + " 4");
+	REQUIRE(craft(shapeless) == itemName(500) + " 2");
+	REQUIRE(craft(nothing).empty());
+
+	BENCHMARK("craft_shaped") {
+		return craft(shaped);
+	};
+
+	BENCHMARK("craft_shapeless_group") {
+		return craft(shapeless);
+	};
+
+	BENCHMARK("craft_no_match") {
+		return craft(nothing);
+	};
+
+	// An autocrafter farm working on many different grids
+	std::vector<CraftInput> grids;
+	for (u32 i = 0; i + 2 < NUM_ITEMS; i += 2)
+		grids.push_back(grid({itemName(i), itemName(i + 2), itemName(20)}));
+	BENCHMARK("craft_many_grids") {
+		size_t found = 0;
+		for (const CraftInput &input : grids)
+			found += !craft(input).empty();
+		return found;
+	};
+}
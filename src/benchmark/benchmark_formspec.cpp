@@ -0,0 +1,109 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "util/formspec_diff.h"
+#include "util/string.h"
+#include <sstream>
+
+namespace {
+
+// A machine form with a status line per slot, like a furnace array
+std::string make_form(int slots, int tick)
+{
+	std::string form = "formspec_version[8]size[12," + std::to_string(slots + 6) + "]";
+	for (int i = 0; i < slots; i++) {
+		const std::string y = std::to_string(i + 1);
+		form += "list[context;src" + std::to_string(i) + ";0.5," + y + ";1,1;]";
+		form += "image[2," + y + ";1,1;default_furnace_fire_bg.png^[lowpart:" +
+			std::to_string((tick + i) % 100) + ":default_furnace_fire_fg.png]";
+		form += "label[3.5," + y + ".5;Slot " + y + "\\; cooking]";
+		form += "tooltip[src" + std::to_string(i) + ";Input " + y + "]";
+	}
+	form += "list[current_player;main;1," + std::to_string(slots + 1) + ";8,4;]";
+	form += "listring[]";
+	return form;
+}
+
+// The tokenizing GUIFormSpecMenu::regenerateGui does before creating widgets
+size_t parse_form(const std::string &form)
+{
+	size_t parts = 0;
+	for (const std::string &element : split(form, ']')) {
+		std::vector<std::string> name_params = split(element, '[');
+		if (name_params.size() < 2)
+			continue;
+		for (const std::string &param : split(name_params[1], ';'))
+			parts += split(param, ',').size();
+	}
+	return parts;
+}
+
+}
+
+template <int N>
+void benchParse(Catch::Benchmark::Chronometer &meter)
+{
+	const std::string form = make_form(N, 0);
+	meter.measure([&] {
+		return parse_form(form);
+	});
+}
+
+template <int N>
+void benchSplit(Catch::Benchmark::Chronometer &meter)
+{
+	const std::string form = make_form(N, 0);
+	meter.measure([&] {
+		return formspec_split_elements(form).size();
+	});
+}
+
+template <int N>
+void benchDiff(Catch::Benchmark::Chronometer &meter)
+{
+	const std::string from = make_form(N, 0);
+	// The progress of every slot changes
+	const std::string to = make_form(N, 1);
+	// What the server does per refresh
+	meter.measure([&] {
+		std::ostringstream os(std::ios_base::binary);
+		FormspecDiff::make(from, to).serialize(os);
+		return os.str().size();
+	});
+}
+
+template <int N>
+void benchApply(Catch::Benchmark::Chronometer &meter)
+{
+	const std::string from = make_form(N, 0);
+	const std::string to = make_form(N, 1);
+	std::ostringstream os(std::ios_base::binary);
+	FormspecDiff::make(from, to).serialize(os);
+	const std::string data = os.str();
+
+	// What the client does per refresh
+	meter.measure([&] {
+		std::istringstream is(data, std::ios_base::binary);
+		FormspecDiff diff;
+		diff.deSerialize(is);
+		std::string result;
+		diff.apply(from, &result);
+		return result.size();
+	});
+}
+
+#define BENCH_FORMSPEC(_slots) \
+	BENCHMARK_ADVANCED("parse_" #_slots)(Catch::Benchmark::Chronometer meter) \
+	{ benchParse<_slots>(meter); }; \
+	BENCHMARK_ADVANCED("split_" #_slots)(Catch::Benchmark::Chronometer meter) \
+	{ benchSplit<_slots>(meter); }; \
+	BENCHMARK_ADVANCED("diff_" #_slots)(Catch::Benchmark::Chronometer meter) \
+	{ benchDiff<_slots>(meter); }; \
+	BENCHMARK_ADVANCED("apply_" #_slots)(Catch::Benchmark::Chronometer meter) \
+	{ benchApply<_slots>(meter); };
+
+TEST_CASE("benchmark_formspec") {
+	BENCH_FORMSPEC(4)
+	BENCH_FORMSPEC(64)
+}
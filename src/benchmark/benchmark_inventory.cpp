@@ -0,0 +1,81 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "inventory.h"
+#include "itemdef.h"
+#include <memory>
+#include <sstream>
+
+// Server steps per second with the default dedicated_server_step
+constexpr u32 STEPS_PER_SECOND = 11;
+
+// A player inventory and three chests, in which an automation mod changes
+// one slot every step
+static void fill(Inventory &inv, IItemDefManager *idef)
+{
+	const char *names[] = {"main", "chest_a", "chest_b", "chest_c"};
+	for (const char *name : names) {
+		InventoryList *list = inv.addList(name, 32);
+		list->setWidth(8);
+		for (u32 i = 0; i < list->getSize(); i += 2)
+			list->changeItem(i, ItemStack("default:cobble", 1 + i, 0, idef));
+	}
+	inv.setModified(false);
+}
+
+static void step(Inventory &inv, u32 n)
+{
+	for (InventoryList *list : inv.getLists()) {
+		ItemStack stack = list->getItem(n % list->getSize());
+		stack.count = stack.count % 99 + 1;
+		list->changeItem(n % list->getSize(), stack);
+	}
+}
+
+static size_t sendUpdate(Inventory &inv, bool incremental)
+{
+	std::ostringstream os(std::ios::binary);
+	inv.serialize(os, incremental);
+	inv.setModified(false);
+	return os.str().size();
+}
+
+TEST_CASE("benchmark_inventory")
+{
+	std::unique_ptr<IWritableItemDefManager> idef(createItemDefManager());
+	Inventory inv(idef.get());
+	fill(inv, idef.get());
+
+	for (bool incremental : {false, true}) {
+		size_t bytes = 0;
+		for (u32 i = 0; i < STEPS_PER_SECOND; i++) {
+			step(inv, i);
+			bytes += sendUpdate(inv, incremental);
+		}
+		WARN("inventory sync, " << (incremental ? "per slot" : "whole lists")
+				<< ": " << bytes << " bytes/s");
+	}
+
+	u32 n = 0;
+	BENCHMARK("serialize_whole_lists") {
+		step(inv, n++);
+		return sendUpdate(inv, false);
+	};
+
+	BENCHMARK("serialize_changed_slots") {
+		step(inv, n++);
+		return sendUpdate(inv, true);
+	};
+
+	// Shift-clicking stacks between the player inventory and a chest
+	InventoryList *main = inv.getList("main");
+	InventoryList *chest = inv.getList("chest_a");
+	BENCHMARK("move_items") {
+		for (u32 i = 0; i < main->getSize(); i++)
+			main->moveItemSomewhere(i, chest, main->getItem(i).count);
+		for (u32 i = 0; i < chest->getSize(); i++)
+			chest->moveItemSomewhere(i, main, chest->getItem(i).count);
+		return main->getUsedSlots();
+	};
+}
@@ -3,7 +3,12 @@
 // Copyright (C) 2023 Minetest Authors
 
 #include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
 #include "mapblock.h"
+#include "mapsector.h"
+#include "noise.h"
+#include "settings.h"
 #include <vector>
 
 typedef std::vector<MapBlock*> MBContainer;
@@ -170,3 +175,131 @@ TEST_CASE("benchmark_mapblock") {
 	BENCH1(2200)
 	BENCH1(7500) // <- default client_mapblock_limit
 }
+
+// Random block lookups, mostly missing the per-thread cache
+static u32 lookupRandom(Map &map, const std::vector<v3s16> &positions)
+{
+	u32 found = 0;
+	for (v3s16 p : positions)
+		found += !!map.getBlockNoCreateNoEx(p);
+	return found;
+}
+
+// The same lookups through the sectors, like before the block index
+static u32 lookupRandomSectors(Map &map, const std::vector<v3s16> &positions)
+{
+	u32 found = 0;
+	for (v3s16 p : positions) {
+		MapSector *sector = map.getSectorNoGenerate(v2s16(p.X, p.Z));
+		found += sector && sector->getBlockNoCreateNoEx(p.Y);
+	}
+	return found;
+}
+
+// usage patterns inspired by collision and raycasts, many getNode() calls
+// in a small area that crosses block borders
+static u32 getNodeArea(Map &map, v3s16 center)
+{
+	u32 foo = 0;
+	v3s16 p;
+	for (p.Z = center.Z - 12; p.Z <= center.Z + 12; p.Z++)
+	for (p.Y = center.Y - 12; p.Y <= center.Y + 12; p.Y++)
+	for (p.X = center.X - 12; p.X <= center.X + 12; p.X++)
+		foo += map.getNode(p).getContent();
+	return foo;
+}
+
+TEST_CASE("benchmark_mapblock_lookup") {
+	DummyGameDef gamedef;
+	// About as many blocks as a server has loaded for a few players
+	const v3s16 bpmin(-20, -4, -20), bpmax(19, 3, 19);
+	DummyMap map(&gamedef, bpmin, bpmax);
+
+	PcgRandom pr(42);
+	std::vector<v3s16> positions(10000);
+	for (v3s16 &p : positions) {
+		// Some lookups miss
+		p = v3s16(pr.range(bpmin.X - 2, bpmax.X + 2), pr.range(bpmin.Y - 2, bpmax.Y + 2),
+			pr.range(bpmin.Z - 2, bpmax.Z + 2));
+	}
+
+	BENCHMARK("lookup_random_10000") {
+		return lookupRandom(map, positions);
+	};
+
+	BENCHMARK("lookup_random_sectors_10000") {
+		return lookupRandomSectors(map, positions);
+	};
+
+	BENCHMARK("getNode_area_25x25x25") {
+		return getNodeArea(map, v3s16(3, -5, 8));
+	};
+}
+
+// Any content works, node definitions are not used
+static constexpr content_t CONTENT_BENCH_STONE = 1;
+
+// Blocks like in a generated world: 3/4 are only air or only stone
+static void allocateTerrain(MBContainer &vec, u32 n)
+{
+	allocateSome(vec, n);
+	for (u32 i = 0; i < n; i++) {
+		MapBlock *block = vec[i];
+		if (i % 4 == 3) {
+			MapNode *data = block->getDataMutable();
+			for (u32 j = 0; j < MapBlock::nodecount; j++)
+				data[j] = MapNode(j < MapBlock::nodecount / 2 ? CONTENT_BENCH_STONE : CONTENT_AIR);
+			block->compactData();
+		} else {
+			block->fillData(MapNode(i % 2 ? CONTENT_BENCH_STONE : CONTENT_AIR));
+		}
+	}
+}
+
+static size_t nodeDataSize(const MBContainer &vec)
+{
+	size_t size = 0;
+	for (MapBlock *block : vec) {
+		if (!block->isUniform())
+			size += MapBlock::nodecount * sizeof(MapNode);
+	}
+	return size;
+}
+
+static MBContainer allocateTerrain(u32 count, bool compact)
+{
+	const bool was_compact = g_settings->getBool("compact_uniform_mapblocks");
+	g_settings->setBool("compact_uniform_mapblocks", compact);
+	MBContainer vec;
+	allocateTerrain(vec, count);
+	g_settings->setBool("compact_uniform_mapblocks", was_compact);
+	return vec;
+}
+
+TEST_CASE("benchmark_mapblock_uniform") {
+	MBContainer dense = allocateTerrain(2200, false);
+	MBContainer compact = allocateTerrain(2200, true);
+	WARN("2200 blocks, node data: " << nodeDataSize(dense) / 1024 << " KiB dense, "
+		<< nodeDataSize(compact) / 1024 << " KiB compact");
+
+	BENCHMARK("terrain_getNode_dense_2200") {
+		return workOnNodes(dense);
+	};
+	BENCHMARK("terrain_getNode_compact_2200") {
+		return workOnNodes(compact);
+	};
+	freeAll(dense);
+	freeAll(compact);
+
+	BENCHMARK_ADVANCED("fill_7500")(Catch::Benchmark::Chronometer meter) {
+		MBContainer vec;
+		allocateSome(vec, 7500);
+		u32 i = 0;
+		meter.measure([&] {
+			// Alternating, so that blocks change
+			MapBlock *block = vec[i % vec.size()];
+			block->fillData(MapNode(i++ % 3 ? CONTENT_BENCH_STONE : CONTENT_AIR));
+		});
+		freeAll(vec);
+	};
+}
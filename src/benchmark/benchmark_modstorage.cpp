@@ -0,0 +1,74 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "database/database-files.h"
+#include "database/database-journal.h"
+#include "database/database-sqlite3.h"
+#include "filesys.h"
+#include <memory>
+
+namespace {
+
+// An economy mod with one entry per account
+void fill(ModStorageDatabase *db, int count)
+{
+	db->beginSave();
+	for (int i = 0; i < count; i++) {
+		db->setModEntry("economy", "account_" + std::to_string(i),
+			"return {balance=" + std::to_string(i * 10) + ",history={1,2,3,4,5,6,7,8}}");
+	}
+	db->endSave();
+}
+
+}
+
+// A save after a few entries changed, as in a server step
+template <class Database, int N>
+void benchSave(Catch::Benchmark::Chronometer &meter)
+{
+	const std::string dir = fs::CreateTempDir();
+	{
+		auto db = std::make_unique<Database>(dir);
+		fill(db.get(), N);
+		int i = 0;
+		meter.measure([&] {
+			db->beginSave();
+			for (int j = 0; j < 10; j++, i++) {
+				db->setModEntry("economy", "account_" + std::to_string(i % N),
+					"return {balance=" + std::to_string(i) + "}");
+			}
+			db->endSave();
+		});
+	}
+	fs::RecursiveDelete(dir);
+}
+
+template <class Database, int N>
+void benchLoad(Catch::Benchmark::Chronometer &meter)
+{
+	const std::string dir = fs::CreateTempDir();
+	{
+		Database db(dir);
+		fill(&db, N);
+	}
+	meter.measure([&] {
+		Database db(dir);
+		std::string value;
+		db.getModEntry("economy", "account_0", &value);
+		return value;
+	});
+	fs::RecursiveDelete(dir);
+}
+
+#define BENCH_MODSTORAGE(_name, _class, _count) \
+	BENCHMARK_ADVANCED("save_" _name "_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchSave<_class, _count>(meter); }; \
+	BENCHMARK_ADVANCED("load_" _name "_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchLoad<_class, _count>(meter); };
+
+TEST_CASE("benchmark_modstorage") {
+	BENCH_MODSTORAGE("files", ModStorageDatabaseFiles, 20000)
+	BENCH_MODSTORAGE("sqlite3", ModStorageDatabaseSQLite3, 20000)
+	BENCH_MODSTORAGE("journal", ModStorageDatabaseJournal, 20000)
+}
@@ -0,0 +1,81 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "nodedef.h"
+#include "client/occlusioncache.h"
+#include <vector>
+
+// Synthetic hilly terrain, as seen by the raytraced occlusion culling of
+// ClientMap::updateDrawList()
+static void makeTerrain(DummyMap &map, v3s16 bpmin, v3s16 bpmax, content_t c_stone)
+{
+	for (s16 bz = bpmin.Z; bz <= bpmax.Z; bz++)
+	for (s16 by = bpmin.Y; by <= bpmax.Y; by++)
+	for (s16 bx = bpmin.X; bx <= bpmax.X; bx++) {
+		MapBlock *block = map.getBlockNoCreateNoEx({bx, by, bz});
+		v3s16 base = block->getPosRelative();
+		for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+		for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+			s16 height = (((base.X + x) * 7 + (base.Z + z) * 13) & 31) / 4 - 4;
+			for (s16 y = 0; y < MAP_BLOCKSIZE; y++) {
+				content_t c = base.Y + y < height ? c_stone : CONTENT_AIR;
+				block->setNodeNoCheck(x, y, z, MapNode(c));
+			}
+		}
+		block->expireIsAirCache();
+	}
+}
+
+TEST_CASE("benchmark_occlusion")
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	content_t c_stone;
+	{
+		ContentFeatures f;
+		f.name = "stone";
+		c_stone = ndef->set(f.name, f);
+	}
+
+	const v3s16 bpmin(-6, -3, -6), bpmax(5, 2, 5);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	makeTerrain(map, bpmin, bpmax, c_stone);
+
+	std::vector<MapBlock*> meshes;
+	for (s16 z = bpmin.Z; z <= bpmax.Z; z++)
+	for (s16 y = bpmin.Y; y <= bpmax.Y; y++)
+	for (s16 x = bpmin.X; x <= bpmax.X; x++)
+		meshes.push_back(map.getBlockNoCreateNoEx({x, y, z}));
+
+	// The checks ClientMap::updateDrawList() does in one frame
+	const v3s16 cam_pos_nodes(0, 6, 0);
+	OcclusionCache cache(&map);
+	cache.setCamera(cam_pos_nodes, MeshGrid{1});
+
+	// Also what every change of the map used to cost
+	BENCHMARK("check_all_meshes") {
+		cache.clear();
+		cache.checkMeshes(meshes);
+		return cache.size();
+	};
+
+	BENCHMARK("cached_lookups") {
+		u32 occluded = 0;
+		for (MapBlock *block : meshes)
+			occluded += cache.isMeshOccluded(block) ? 1 : 0;
+		return occluded;
+	};
+
+	// A node was dug somewhere in view, then the next frame is drawn
+	const std::vector<v3s16> changed = {v3s16(4, 0, -5)};
+
+	BENCHMARK("invalidate_changed_block") {
+		cache.invalidate(changed);
+		cache.checkMeshes(meshes);
+		return cache.size();
+	};
+}
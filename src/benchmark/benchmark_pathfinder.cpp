@@ -0,0 +1,87 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "nodedef.h"
+#include "pathfinder.h"
+#include "noise.h"
+#include "log.h"
+
+// Number of mobs that look for a path at the same time
+static constexpr size_t NUM_QUERIES = 200;
+
+TEST_CASE("benchmark_pathfinder")
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	content_t content_stone;
+	{
+		ContentFeatures f;
+		f.name = "stone";
+		content_stone = ndef->set(f.name, f);
+	}
+
+	// Hilly floor with some pillars in the way
+	v3s16 bpmin(-4, -1, -4), bpmax(3, 1, 3);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	map.fill(bpmin, bpmax, MapNode(CONTENT_AIR));
+	PcgRandom pr(42);
+	auto ground = [] (s16 x, s16 z) -> s16 { return ((x / 8 + z / 8) & 1) + 1; };
+	for (s16 z = -64; z < 64; z++)
+	for (s16 x = -64; x < 64; x++) {
+		s16 height = ground(x, z) + (pr.range(0, 9) == 0 ? 3 : 0);
+		for (s16 y = -16; y < height; y++)
+			map.setNode(v3s16(x, y, z), MapNode(content_stone));
+	}
+
+	std::vector<PathQuery> queries;
+	for (size_t i = 0; i < NUM_QUERIES; i++) {
+		PathQuery query;
+		query.source.X = pr.range(-50, 50);
+		query.source.Z = pr.range(-50, 50);
+		query.source.Y = ground(query.source.X, query.source.Z);
+		query.destination.X = query.source.X + pr.range(-12, 12);
+		query.destination.Z = query.source.Z + pr.range(-12, 12);
+		query.destination.Y = ground(query.destination.X, query.destination.Z);
+		query.searchdistance = 8;
+		query.max_jump = 1;
+		query.max_drop = 2;
+		queries.push_back(query);
+	}
+
+	size_t num_found = 0;
+	for (const PathQuery &q : queries)
+		num_found += !get_path(&map, ndef, q.source, q.destination,
+				q.searchdistance, q.max_jump, q.max_drop, q.algo).empty();
+	WARN(num_found << " of " << NUM_QUERIES << " queries find a path");
+
+	BENCHMARK("get_path") {
+		size_t found = 0;
+		for (const PathQuery &q : queries)
+			found += !get_path(&map, ndef, q.source, q.destination,
+					q.searchdistance, q.max_jump, q.max_drop, q.algo).empty();
+		return found;
+	};
+
+	PathfinderService service(&map, ndef);
+
+	BENCHMARK("findPath_cached") {
+		size_t found = 0;
+		for (const PathQuery &q : queries)
+			found += !service.findPath(q).empty();
+		return found;
+	};
+
+	BENCHMARK("queuePath_batch") {
+		size_t found = 0;
+		for (const PathQuery &q : queries)
+			service.queuePath(q, [&found] (std::vector<v3s16> &&path) {
+				found += !path.empty();
+			});
+		service.finish();
+		return found;
+	};
+}
@@ -0,0 +1,96 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "environment.h"
+#include "nodedef.h"
+#include "raycast.h"
+#include "noise.h"
+
+namespace {
+
+class BenchEnvironment : public Environment
+{
+public:
+	BenchEnvironment(IGameDef *gamedef, Map *map) :
+		Environment(gamedef), m_map(map)
+	{}
+
+	void step(f32 dtime) override {}
+
+	Map &getMap() override { return *m_map; }
+
+	void getSelectedActiveObjects(const core::line3d<f32> &shootline_on_map,
+			std::vector<PointedThing> &objects,
+			const std::optional<Pointabilities> &pointabilities) override
+	{}
+
+private:
+	Map *m_map;
+};
+
+}
+
+// Number of rays cast by e.g. a combat mod in one step
+static constexpr size_t NUM_RAYS = 100;
+
+TEST_CASE("benchmark_raycast")
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	content_t content_stone;
+	{
+		ContentFeatures f;
+		f.name = "stone";
+		content_stone = ndef->set(f.name, f);
+	}
+
+	// Ground below y = 0, open air above it
+	v3s16 bpmin(-4, -1, -4), bpmax(3, 2, 3);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	map.fill(bpmin, bpmax, MapNode(CONTENT_AIR));
+	map.fill(bpmin, v3s16(bpmax.X, -1, bpmax.Z), MapNode(content_stone));
+	BenchEnvironment env(&gamedef, &map);
+
+	PcgRandom pr(42);
+	auto random_pos = [&] (s32 min_y, s32 max_y) {
+		return v3f(pr.range(-60, 60), pr.range(min_y, max_y), pr.range(-60, 60)) * BS;
+	};
+	// Rays that stay in the air, e.g. between players
+	std::vector<core::line3d<f32>> air_rays;
+	for (size_t i = 0; i < NUM_RAYS; i++)
+		air_rays.emplace_back(random_pos(2, 40), random_pos(2, 40));
+	// Rays that end in the ground
+	std::vector<core::line3d<f32>> ground_rays;
+	for (size_t i = 0; i < NUM_RAYS; i++)
+		ground_rays.emplace_back(random_pos(2, 40), random_pos(-10, -2));
+
+	auto cast = [&] (const std::vector<core::line3d<f32>> &rays) {
+		size_t hits = 0;
+		for (const auto &ray : rays) {
+			RaycastState state(ray, false, false, std::nullopt);
+			PointedThing pointed;
+			env.continueRaycast(&state, &pointed);
+			hits += pointed.type == POINTEDTHING_NODE;
+		}
+		return hits;
+	};
+
+	BENCHMARK("raycast_air") {
+		return cast(air_rays);
+	};
+
+	BENCHMARK("raycast_ground") {
+		return cast(ground_rays);
+	};
+
+	BENCHMARK("line_of_sight_air") {
+		size_t visible = 0;
+		for (const auto &ray : air_rays)
+			visible += env.line_of_sight(ray.start, ray.end);
+		return visible;
+	};
+}
@@ -0,0 +1,207 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+/*
+	Server load test: starts a server with the devtest game on a new world
+	and lets scripted bots (see bot_client.h) play on it over loopback.
+
+	Run with: --run-benchmarks --test-module benchmark_server_load
+	The environment variables LOADGEN_BOTS and LOADGEN_SECONDS override
+	the number of bots and the duration of the measurement. If
+	LOADGEN_RECORD is set to a directory, the session is recorded there
+	and can be replayed with --replay.
+*/
+
+#include "catch.h"
+#include "benchmark/bot_client.h"
+#include "content/subgames.h"
+#include "filesys.h"
+#include "log.h"
+#include "porting.h"
+#include "server.h"
+#include "server/session_recorder.h"
+#include "settings.h"
+#include "util/metricsbackend.h"
+#include "util/numeric.h"
+#include "util/string.h"
+#include <cstdlib>
+#include <iomanip>
+
+static u32 get_env_u32(const char *name, u32 fallback)
+{
+	const char *value = std::getenv(name);
+	return value ? mystoi(value) : fallback;
+}
+
+namespace {
+	// Changes settings for the lifetime of the object
+	class SettingsOverride {
+	public:
+		void set(const std::string &name, const std::string &value)
+		{
+			std::string old;
+			m_old.emplace_back(name, g_settings->getNoEx(name, old), old);
+			g_settings->set(name, value);
+		}
+
+		~SettingsOverride()
+		{
+			for (auto it = m_old.rbegin(); it != m_old.rend(); ++it) {
+				if (std::get<1>(*it))
+					g_settings->set(std::get<0>(*it), std::get<2>(*it));
+				else
+					g_settings->remove(std::get<0>(*it));
+			}
+		}
+
+	private:
+		std::vector<std::tuple<std::string, bool, std::string>> m_old;
+	};
+}
+
+TEST_CASE("benchmark_server_load", "[.]")
+{
+	const u32 num_bots = get_env_u32("LOADGEN_BOTS", 20);
+	const u32 duration_s = get_env_u32("LOADGEN_SECONDS", 30);
+
+	SubgameSpec gamespec = findSubgame("devtest");
+	if (!gamespec.isValid()) {
+		WARN("devtest game not found, skipping");
+		return;
+	}
+
+	std::string world_path = fs::CreateTempDir();
+	REQUIRE(!world_path.empty());
+
+	SettingsOverride settings;
+	// Flat ground with its surface at y = 8, the bots walk on it
+	settings.set("mg_name", "flat");
+	settings.set("mgflat_ground_level", "8");
+	settings.set("static_spawnpoint", "0,9,0");
+	settings.set("max_users", itos(num_bots + 1));
+	settings.set("disallow_empty_password", "false");
+	// The bots don't simulate physics
+	settings.set("disable_anticheat", "true");
+	settings.set("enable_damage", "false");
+
+	const Address address(127, 0, 0, 1, myrand_range(40000, 49999));
+
+	{
+		Server server(world_path, gamespec, false, address, true);
+		if (const char *record_dir = std::getenv("LOADGEN_RECORD"))
+			server.setSessionRecorder(std::make_unique<SessionRecorder>(record_dir, world_path,
+				gamespec.id));
+		server.start();
+		MetricsBackend *metrics = server.getMetricsBackend();
+		MetricHistogramPtr step_time = metrics->getHistogram("minetest_core_server_step_time");
+		MetricGaugePtr emerge_queue = metrics->getGauge("minetest_emerge_queue_size");
+		MetricCounterPtr envlock = metrics->getCounter("minetest_core_envlock_acquisitions");
+		MetricCounterPtr envlock_contended = metrics->getCounter("minetest_core_envlock_contended");
+		MetricCounterPtr envlock_wait = metrics->getCounter("minetest_core_envlock_wait_time");
+		REQUIRE(step_time);
+		REQUIRE(emerge_queue);
+		REQUIRE((envlock && envlock_contended && envlock_wait));
+
+		std::vector<std::unique_ptr<BotClient>> bots;
+		for (u32 i = 0; i < num_bots; i++)
+			bots.push_back(std::make_unique<BotClient>("bot" + itos(i), address, i));
+
+		auto step_bots = [&] (float dtime) {
+			for (auto &bot : bots)
+				bot->step(dtime);
+		};
+		auto count_state = [&] (BotClient::State state) {
+			u32 count = 0;
+			for (auto &bot : bots)
+				count += bot->getState() == state;
+			return count;
+		};
+
+		// Log in
+		u64 t_start = porting::getTimeMs();
+		u64 t_last = t_start;
+		while (count_state(BotClient::STATE_PLAYING) +
+				count_state(BotClient::STATE_FAILED) < num_bots &&
+				t_last - t_start < 60000) {
+			sleep_ms(10);
+			u64 t_now = porting::getTimeMs();
+			step_bots((t_now - t_last) / 1000.0f);
+			t_last = t_now;
+		}
+		const float login_time = (t_last - t_start) / 1000.0f;
+		const u32 num_playing = count_state(BotClient::STATE_PLAYING);
+		for (auto &bot : bots) {
+			if (bot->getState() == BotClient::STATE_FAILED)
+				WARN(bot->getName() << " failed: " << bot->getError());
+		}
+
+		// Play
+		BotClient::Stats start_stats;
+		for (auto &bot : bots) {
+			start_stats.bytes_received += bot->getStats().bytes_received;
+			start_stats.bytes_sent += bot->getStats().bytes_sent;
+		}
+		const u64 steps_before = step_time->getCount();
+		const double envlock_before = envlock->get();
+		const double envlock_contended_before = envlock_contended->get();
+		const double envlock_wait_before = envlock_wait->get();
+		double emerge_queue_max = 0, emerge_queue_sum = 0;
+		u32 samples = 0;
+
+		t_start = t_last = porting::getTimeMs();
+		while (t_last - t_start < duration_s * 1000) {
+			sleep_ms(10);
+			u64 t_now = porting::getTimeMs();
+			step_bots((t_now - t_last) / 1000.0f);
+			t_last = t_now;
+
+			double queued = emerge_queue->get();
+			emerge_queue_max = std::max(emerge_queue_max, queued);
+			emerge_queue_sum += queued;
+			samples++;
+		}
+		const float play_time = (t_last - t_start) / 1000.0f;
+
+		BotClient::Stats total;
+		for (auto &bot : bots) {
+			const BotClient::Stats &stats = bot->getStats();
+			total.bytes_received += stats.bytes_received;
+			total.bytes_sent += stats.bytes_sent;
+			total.packets_received += stats.packets_received;
+			total.packets_sent += stats.packets_sent;
+			total.blocks_received += stats.blocks_received;
+			total.actions += stats.actions;
+		}
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(1);
+		os << "Server load with " << num_playing << "/" << num_bots
+			<< " bots playing (login took " << login_time << " s)\n";
+		os << "  server steps: " << (step_time->getCount() - steps_before)
+			<< " in " << play_time << " s; step time percentiles since start (ms):"
+			<< " p50=" << step_time->getQuantile(0.5) / 1000
+			<< " p90=" << step_time->getQuantile(0.9) / 1000
+			<< " p99=" << step_time->getQuantile(0.99) / 1000
+			<< " max=" << step_time->getQuantile(1.0) / 1000 << "\n";
+		os << "  bandwidth (KiB/s): down="
+			<< (total.bytes_received - start_stats.bytes_received) / 1024.0 / play_time
+			<< " up=" << (total.bytes_sent - start_stats.bytes_sent) / 1024.0 / play_time << "\n";
+		os << "  env lock: " << (envlock_contended->get() - envlock_contended_before)
+			<< " of " << (envlock->get() - envlock_before) << " acquisitions contended, waited "
+			<< (envlock_wait->get() - envlock_wait_before) / 1000 << " ms\n";
+		os << "  emerge queue: avg=" << (samples ? emerge_queue_sum / samples : 0.0)
+			<< " max=" << emerge_queue_max << "\n";
+		os << "  totals: " << total.packets_received << " packets received, "
+			<< total.packets_sent << " sent, " << total.blocks_received
+			<< " map blocks, " << total.actions << " actions";
+		WARN(os.str());
+
+		for (auto &bot : bots)
+			bot->disconnect();
+		bots.clear();
+
+		CHECK(num_playing == num_bots);
+	}
+
+	fs::RecursiveDelete(world_path);
+}
@@ -0,0 +1,160 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "script/common/c_packer.h"
+#include "script/lua_api/l_shared.h"
+#include <memory>
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+namespace {
+
+// A lookup table like mods keep of items or recipes
+void push_lookup_table(lua_State *L, int count)
+{
+	lua_createtable(L, 0, count);
+	for (int i = 0; i < count; i++) {
+		const std::string name = "mod:item_" + std::to_string(i);
+		lua_createtable(L, 0, 3);
+		lua_pushstring(L, name.c_str());
+		lua_setfield(L, -2, "name");
+
+		lua_createtable(L, 0, 2);
+		lua_pushinteger(L, i % 3);
+		lua_setfield(L, -2, "cracky");
+		lua_pushinteger(L, i % 5);
+		lua_setfield(L, -2, "level");
+		lua_setfield(L, -2, "groups");
+
+		lua_createtable(L, 4, 0);
+		for (int j = 1; j <= 4; j++) {
+			lua_pushinteger(L, i * j);
+			lua_rawseti(L, -2, j);
+		}
+		lua_setfield(L, -2, "drops");
+
+		lua_setfield(L, -2, name.c_str());
+	}
+}
+
+// Reads a few fields of the table on top of the stack, like a mod would
+lua_Number read_fields(lua_State *L, int count)
+{
+	lua_Number sum = 0;
+	for (int i = 0; i < count; i += count / 8) {
+		const std::string name = "mod:item_" + std::to_string(i);
+		lua_getfield(L, -1, name.c_str());
+		lua_getfield(L, -1, "groups");
+		lua_getfield(L, -1, "level");
+		sum += lua_tonumber(L, -1);
+		lua_pop(L, 3);
+	}
+	return sum;
+}
+
+struct LuaState {
+	lua_State *L;
+	LuaState() : L(luaL_newstate()) { LuaSharedTable::Register(L); }
+	~LuaState() { lua_close(L); }
+};
+
+}
+
+template <int N>
+void benchGetPacked(Catch::Benchmark::Chronometer &meter)
+{
+	LuaState state;
+	lua_State *L = state.L;
+	push_lookup_table(L, N);
+	std::unique_ptr<PackedValue> pv(script_pack(L, -1));
+	lua_pop(L, 1);
+
+	// What core.ipc_get() does with a table
+	meter.measure([&] {
+		script_unpack(L, pv.get());
+		lua_Number sum = read_fields(L, N);
+		lua_pop(L, 1);
+		return sum;
+	});
+}
+
+template <int N>
+void benchGetShared(Catch::Benchmark::Chronometer &meter)
+{
+	LuaState state;
+	lua_State *L = state.L;
+	push_lookup_table(L, N);
+	SharedTablePtr table = LuaSharedTable::share(L, -1);
+	lua_pop(L, 1);
+
+	// What core.ipc_get() does with a shared table
+	meter.measure([&] {
+		LuaSharedTable::create(L, table);
+		lua_Number sum = read_fields(L, N);
+		lua_pop(L, 1);
+		return sum;
+	});
+}
+
+template <int N>
+void benchPassPacked(Catch::Benchmark::Chronometer &meter)
+{
+	LuaState state;
+	lua_State *L = state.L;
+	push_lookup_table(L, N);
+
+	// An async job parameter is packed and unpacked in the worker
+	meter.measure([&] {
+		std::unique_ptr<PackedValue> pv(script_pack(L, -1));
+		script_unpack(L, pv.get());
+		lua_pop(L, 1);
+	});
+}
+
+template <int N>
+void benchPassShared(Catch::Benchmark::Chronometer &meter)
+{
+	LuaState state;
+	lua_State *L = state.L;
+	push_lookup_table(L, N);
+	LuaSharedTable::create(L, LuaSharedTable::share(L, -1));
+
+	meter.measure([&] {
+		std::unique_ptr<PackedValue> pv(script_pack(L, -1));
+		script_unpack(L, pv.get());
+		lua_pop(L, 1);
+	});
+}
+
+template <int N>
+void benchShare(Catch::Benchmark::Chronometer &meter)
+{
+	LuaState state;
+	lua_State *L = state.L;
+	push_lookup_table(L, N);
+
+	// One-time cost of core.share()
+	meter.measure([&] {
+		return LuaSharedTable::share(L, -1);
+	});
+}
+
+#define BENCH_SHARED(_count) \
+	BENCHMARK_ADVANCED("get_packed_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchGetPacked<_count>(meter); }; \
+	BENCHMARK_ADVANCED("get_shared_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchGetShared<_count>(meter); }; \
+	BENCHMARK_ADVANCED("pass_packed_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchPassPacked<_count>(meter); }; \
+	BENCHMARK_ADVANCED("pass_shared_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchPassShared<_count>(meter); }; \
+	BENCHMARK_ADVANCED("share_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchShare<_count>(meter); };
+
+TEST_CASE("benchmark_sharedtable") {
+	BENCH_SHARED(100)
+	BENCH_SHARED(5000)
+}
@@ -0,0 +1,336 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "benchmark/bot_client.h"
+
+#include "constants.h"
+#include "inventorymanager.h"
+#include "log.h"
+#include "network/connection.h"
+#include "network/networkexceptions.h"
+#include "network/networkpacket.h"
+#include "network/networkprotocol.h"
+#include "serialization.h"
+#include "util/auth.h"
+#include "util/numeric.h"
+#include "util/pointedthing.h"
+#include "util/string.h"
+#include "version.h"
+#include <cmath>
+#include <sstream>
+
+// Radius of the circle the bots walk on
+constexpr float BOT_WALK_RADIUS = 8.0f * BS;
+// Nodes per second
+constexpr float BOT_WALK_SPEED = 4.0f * BS;
+// Seconds between position updates, like Client
+constexpr float BOT_SEND_INTERVAL = 0.1f;
+// Seconds between actions (dig, place, inventory, chat)
+constexpr float BOT_ACTION_INTERVAL = 1.0f;
+// View range in map blocks that the bots request blocks for
+constexpr u8 BOT_WANTED_RANGE = 6;
+
+/*
+	Channel and reliability of the packets the bots send.
+	Must match serverCommandFactoryTable, which is only part of the client.
+*/
+static void get_send_params(u16 command, u8 *channel, bool *reliable)
+{
+	*channel = 0;
+	*reliable = true;
+	switch (command) {
+	case TOSERVER_INIT:
+		*channel = 1;
+		*reliable = false;
+		break;
+	case TOSERVER_INIT2:
+	case TOSERVER_FIRST_SRP:
+	case TOSERVER_CLIENT_READY:
+		*channel = 1;
+		break;
+	case TOSERVER_GOTBLOCKS:
+		*channel = 2;
+		break;
+	case TOSERVER_PLAYERPOS:
+		*reliable = false;
+		break;
+	default:
+		break;
+	}
+}
+
+BotClient::BotClient(const std::string &name, const Address &address, u32 seed) :
+	m_name(name),
+	m_rand(seed),
+	m_con(con::createMTP(CONNECTION_TIMEOUT, address.isIPv6(), this))
+{
+	m_con->Connect(address);
+}
+
+BotClient::~BotClient()
+{
+	disconnect();
+}
+
+void BotClient::disconnect()
+{
+	if (m_con)
+		m_con->Disconnect();
+}
+
+void BotClient::deletingPeer(con::IPeer *peer, bool timeout)
+{
+	fail(timeout ? "connection timed out" : "connection closed");
+}
+
+void BotClient::fail(const std::string &error)
+{
+	if (m_state == STATE_FAILED)
+		return;
+	infostream << "BotClient(" << m_name << "): " << error << std::endl;
+	m_error = error;
+	m_state = STATE_FAILED;
+}
+
+void BotClient::send(NetworkPacket *pkt)
+{
+	u8 channel;
+	bool reliable;
+	get_send_params(pkt->getCommand(), &channel, &reliable);
+	m_stats.packets_sent++;
+	m_stats.bytes_sent += 2 + pkt->getSize();
+	m_con->Send(PEER_ID_SERVER, channel, pkt, reliable);
+}
+
+void BotClient::step(float dtime)
+{
+	NetworkPacket pkt;
+	while (m_state != STATE_FAILED) {
+		pkt.clear();
+		try {
+			if (!m_con->TryReceive(&pkt))
+				break;
+			m_stats.packets_received++;
+			m_stats.bytes_received += 2 + pkt.getSize();
+			handlePacket(&pkt);
+		} catch (PacketError &e) {
+			fail(std::string("invalid packet: ") + e.what());
+		} catch (con::InvalidIncomingDataException &e) {
+			fail(std::string("invalid data: ") + e.what());
+		}
+	}
+
+	// Acknowledge map blocks, otherwise the server stops sending them
+	while (!m_blocks_to_ack.empty()) {
+		size_t count = std::min<size_t>(m_blocks_to_ack.size(), U8_MAX);
+		NetworkPacket ack(TOSERVER_GOTBLOCKS, 1 + 6 * count);
+		ack << (u8)count;
+		for (size_t i = 0; i < count; i++)
+			ack << m_blocks_to_ack[i];
+		send(&ack);
+		m_blocks_to_ack.erase(m_blocks_to_ack.begin(), m_blocks_to_ack.begin() + count);
+	}
+
+	switch (m_state) {
+	case STATE_CONNECTING:
+		// TOSERVER_INIT is unreliable, repeat it until the server answers
+		m_init_timer -= dtime;
+		if (m_init_timer <= 0.0f) {
+			m_init_timer = 1.0f;
+			NetworkPacket init(TOSERVER_INIT, 1 + 2 + 2 + (1 + m_name.size()));
+			init << SER_FMT_VER_HIGHEST_READ << (u16) 0 /* unused */;
+			init << CLIENT_PROTOCOL_VERSION_MIN << LATEST_PROTOCOL_VERSION;
+			init << m_name;
+			send(&init);
+		}
+		break;
+	case STATE_PLAYING:
+		walk(dtime);
+		m_action_timer += dtime;
+		if (m_action_timer >= BOT_ACTION_INTERVAL) {
+			m_action_timer -= BOT_ACTION_INTERVAL;
+			act();
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void BotClient::handlePacket(NetworkPacket *pkt)
+{
+	switch (pkt->getCommand()) {
+	case TOCLIENT_HELLO: {
+		if (m_state != STATE_CONNECTING)
+			break;
+		u8 ser_ver;
+		u16 unused_compression_mode, proto_ver;
+		u32 auth_mechs;
+		*pkt >> ser_ver >> unused_compression_mode >> proto_ver >> auth_mechs;
+		// Bots are always new players with an empty password
+		if (!(auth_mechs & AUTH_MECHANISM_FIRST_SRP)) {
+			fail("player already exists");
+			break;
+		}
+		std::string verifier, salt;
+		generate_srp_verifier_and_salt(m_name, "", &verifier, &salt);
+		NetworkPacket resp(TOSERVER_FIRST_SRP, 0);
+		resp << salt << verifier << (u8)1;
+		send(&resp);
+		m_state = STATE_AUTHENTICATING;
+		break;
+	}
+	case TOCLIENT_AUTH_ACCEPT: {
+		NetworkPacket resp(TOSERVER_INIT2, sizeof(u16));
+		resp << std::string();
+		send(&resp);
+		m_state = STATE_LOADING;
+		break;
+	}
+	case TOCLIENT_ACCESS_DENIED: {
+		u8 reason;
+		*pkt >> reason;
+		fail("access denied (reason " + itos(reason) + ")");
+		break;
+	}
+	case TOCLIENT_NODEDEF: {
+		// The definitions come last; the bots need no media
+		if (m_state != STATE_LOADING)
+			break;
+		NetworkPacket ready(TOSERVER_CLIENT_READY, 0);
+		ready << (u8) VERSION_MAJOR << (u8) VERSION_MINOR << (u8) VERSION_PATCH
+			<< (u8) 0 << (u16) strlen(g_version_hash);
+		ready.putRawString(g_version_hash, (u16) strlen(g_version_hash));
+		ready << (u16)FORMSPEC_API_VERSION;
+		send(&ready);
+		m_state = STATE_JOINING;
+		break;
+	}
+	case TOCLIENT_MOVE_PLAYER: {
+		*pkt >> m_pos;
+		if (m_state == STATE_JOINING) {
+			// Spread the bots out around the spawn point
+			m_center = m_pos + v3f(m_rand.range(-16, 16), 0, m_rand.range(-16, 16)) * BS;
+			m_state = STATE_PLAYING;
+		}
+		break;
+	}
+	case TOCLIENT_BLOCKDATA: {
+		v3s16 p;
+		*pkt >> p;
+		m_blocks_to_ack.push_back(p);
+		m_stats.blocks_received++;
+		break;
+	}
+	case TOCLIENT_CHAT_MESSAGE:
+		m_stats.chat_messages_received++;
+		break;
+	case TOCLIENT_DEATHSCREEN_LEGACY: {
+		NetworkPacket respawn(TOSERVER_RESPAWN_LEGACY, 0);
+		send(&respawn);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// Same format as writePlayerPos() in the client
+void BotClient::writePosition(NetworkPacket *pkt) const
+{
+	v3s32 position = v3s32::from(m_pos * 100);
+	v3s32 speed = v3s32::from(m_speed * 100);
+	s32 pitch = 0;
+	s32 yaw = m_yaw * 100;
+	u32 keys_pressed = 1; // forward
+	u8 fov = 72 * core::DEGTORAD * 80;
+	*pkt << position << speed << pitch << yaw << keys_pressed;
+	*pkt << fov << BOT_WANTED_RANGE;
+	*pkt << false;
+	*pkt << 1.0f << 0.0f;
+}
+
+void BotClient::walk(float dtime)
+{
+	m_angle += dtime * BOT_WALK_SPEED / BOT_WALK_RADIUS;
+	v3f old_pos = m_pos;
+	m_pos = m_center + v3f(std::cos(m_angle), 0, std::sin(m_angle)) * BOT_WALK_RADIUS;
+	m_speed = (m_pos - old_pos) / std::max(dtime, 0.001f);
+	m_yaw = m_angle * core::RADTODEG + 180.0f;
+
+	m_send_timer -= dtime;
+	if (m_send_timer <= 0.0f) {
+		m_send_timer = BOT_SEND_INTERVAL;
+		NetworkPacket pkt(TOSERVER_PLAYERPOS, 12 + 12 + 4 + 4 + 4 + 1 + 1 + 1 + 4 + 4);
+		writePosition(&pkt);
+		send(&pkt);
+	}
+}
+
+void BotClient::interact(u8 action, const PointedThing &pointed)
+{
+	NetworkPacket pkt(TOSERVER_INTERACT, 1 + 2 + 0);
+	pkt << action;
+	pkt << (u16)0; // wield index
+	std::ostringstream os(std::ios::binary);
+	pointed.serialize(os);
+	pkt.putLongString(os.str());
+	writePosition(&pkt);
+	send(&pkt);
+}
+
+void BotClient::act()
+{
+	m_stats.actions++;
+	v3s16 feet = floatToInt(m_pos, BS);
+	v3s16 below = feet - v3s16(0, 1, 0);
+
+	switch (m_action_counter++ % 4) {
+	case 0: {
+		// Dig the node below
+		PointedThing pointed(below, feet, below, intToFloat(below, BS),
+			v3f(0, 1, 0), 0, 0.0f, PointabilityType::POINTABLE);
+		interact(INTERACT_START_DIGGING, pointed);
+		interact(INTERACT_DIGGING_COMPLETED, pointed);
+		break;
+	}
+	case 1: {
+		// Place the dug node back
+		v3s16 under = below - v3s16(0, 1, 0);
+		PointedThing pointed(under, below, under, intToFloat(under, BS),
+			v3f(0, 1, 0), 0, 0.0f, PointabilityType::POINTABLE);
+		interact(INTERACT_PLACE, pointed);
+		break;
+	}
+	case 2: {
+		// Open the inventory, move an item and close it again
+		IMoveAction a;
+		a.count = 1;
+		a.from_inv.setCurrentPlayer();
+		a.from_list = "main";
+		a.from_i = 0;
+		a.to_inv.setCurrentPlayer();
+		a.to_list = "main";
+		a.to_i = m_rand.range(1, 7);
+		std::ostringstream os(std::ios::binary);
+		a.serialize(os);
+		std::string s = os.str();
+		NetworkPacket pkt(TOSERVER_INVENTORY_ACTION, s.size());
+		pkt.putRawString(s.c_str(), s.size());
+		send(&pkt);
+
+		NetworkPacket fields(TOSERVER_INVENTORY_FIELDS, 0);
+		fields << std::string() << (u16)1 << std::string("quit");
+		fields.putLongString("true");
+		send(&fields);
+		break;
+	}
+	case 3: {
+		std::wstring message = utf8_to_wide("Hello from " + m_name);
+		NetworkPacket pkt(TOSERVER_CHAT_MESSAGE, 2 + message.size() * sizeof(u16));
+		pkt << message;
+		send(&pkt);
+		break;
+	}
+	}
+}
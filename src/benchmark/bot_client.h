@@ -0,0 +1,99 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "irr_v3d.h"
+#include "network/address.h"
+#include "network/peerhandler.h"
+#include "noise.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class NetworkPacket;
+struct PointedThing;
+
+namespace con {
+	class IConnection;
+}
+
+/*
+	Headless client for load tests.
+
+	Logs into a server as a new player and then plays a fixed script:
+	walks in circles, digs and places the node below it, moves items in
+	its inventory and chats. It speaks the client side of the protocol
+	directly on the network layer and keeps no map, media or object
+	state, so it runs without Irrlicht and hundreds of bots fit into one
+	process.
+*/
+class BotClient : public con::PeerHandler
+{
+public:
+	enum State {
+		STATE_CONNECTING,
+		STATE_AUTHENTICATING,
+		STATE_LOADING,
+		STATE_JOINING,
+		STATE_PLAYING,
+		STATE_FAILED,
+	};
+
+	struct Stats {
+		u64 packets_received = 0;
+		u64 bytes_received = 0;
+		u64 packets_sent = 0;
+		u64 bytes_sent = 0;
+		u64 blocks_received = 0;
+		u64 chat_messages_received = 0;
+		u64 actions = 0;
+	};
+
+	BotClient(const std::string &name, const Address &address, u32 seed);
+	~BotClient();
+
+	// Handles incoming packets and runs the script
+	void step(float dtime);
+	void disconnect();
+
+	State getState() const { return m_state; }
+	const std::string &getName() const { return m_name; }
+	const std::string &getError() const { return m_error; }
+	const Stats &getStats() const { return m_stats; }
+
+	// con::PeerHandler
+	void peerAdded(con::IPeer *peer) override {}
+	void deletingPeer(con::IPeer *peer, bool timeout) override;
+
+private:
+	void send(NetworkPacket *pkt);
+	void handlePacket(NetworkPacket *pkt);
+	void fail(const std::string &error);
+
+	void writePosition(NetworkPacket *pkt) const;
+	void interact(u8 action, const PointedThing &pointed);
+	void walk(float dtime);
+	void act();
+
+	const std::string m_name;
+	PcgRandom m_rand;
+	std::unique_ptr<con::IConnection> m_con;
+	State m_state = STATE_CONNECTING;
+	std::string m_error;
+	Stats m_stats;
+
+	float m_init_timer = 0.0f;
+	float m_send_timer = 0.0f;
+	float m_action_timer = 0.0f;
+	u32 m_action_counter = 0;
+	std::vector<v3s16> m_blocks_to_ack;
+
+	// The bot walks around the point it spawned at
+	v3f m_pos;
+	v3f m_center;
+	v3f m_speed;
+	float m_angle = 0.0f;
+	float m_yaw = 0.0f;
+};
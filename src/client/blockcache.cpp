@@ -0,0 +1,80 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "blockcache.h"
+
+#include "database/database-sqlite3.h"
+#include "filesys.h"
+#include "irrlicht_changes/printing.h"
+#include "log.h"
+#include "network/networkprotocol.h"
+#include "util/numeric.h"
+#include "util/timetaker.h"
+
+BlockCache::BlockCache(const std::string &dir)
+{
+	fs::CreateAllDirs(dir);
+	m_db = std::make_unique<BlockCacheDatabaseSQLite3>(dir);
+
+	// Blocks are only read when they are used, load() checks their hash
+	TimeTaker tt("BlockCache: indexing", nullptr, PRECISION_MILLI);
+	m_db->listHashes(m_hashes);
+
+	infostream << "BlockCache: " << m_hashes.size() << " blocks cached at '"
+		<< dir << "', indexed in " << tt.stop(true) << "ms" << std::endl;
+
+	m_db->beginSave();
+}
+
+BlockCache::~BlockCache()
+{
+	m_db->endSave();
+}
+
+u64 BlockCache::hashData(std::string_view data)
+{
+	return murmur_hash_64_ua(data.data(), data.size(), BLOCK_CACHE_HASH_SEED);
+}
+
+void BlockCache::update(v3s16 pos, std::string_view data)
+{
+	u64 hash = hashData(data);
+	auto it = m_hashes.find(pos);
+	if (it != m_hashes.end() && it->second == hash)
+		return;
+
+	if (!m_db->saveBlock(pos, hash, data)) {
+		m_hashes.erase(pos);
+		return;
+	}
+	m_hashes[pos] = hash;
+}
+
+bool BlockCache::load(v3s16 pos, std::string *data)
+{
+	auto it = m_hashes.find(pos);
+	if (it == m_hashes.end())
+		return false;
+
+	data->clear();
+	m_db->loadBlock(pos, data);
+	if (data->empty() || hashData(*data) != it->second) {
+		warningstream << "BlockCache: cached block " << pos
+			<< " is missing or corrupt" << std::endl;
+		remove(pos);
+		return false;
+	}
+	return true;
+}
+
+void BlockCache::remove(v3s16 pos)
+{
+	if (m_hashes.erase(pos) > 0)
+		m_db->deleteBlock(pos);
+}
+
+void BlockCache::save()
+{
+	m_db->endSave();
+	m_db->beginSave();
+}
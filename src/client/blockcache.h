@@ -0,0 +1,48 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "irr_v3d.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class BlockCacheDatabaseSQLite3;
+
+/*
+	Persistent client-side store of map blocks received from one server.
+
+	Blocks are stored exactly as they were received in TOCLIENT_BLOCKDATA so
+	that their content hash matches what the server computes when deciding
+	whether it may skip sending a block (see TOSERVER_BLOCK_CACHE).
+*/
+class BlockCache
+{
+public:
+	/*
+		'dir' is the directory holding the database for a single server.
+	*/
+	BlockCache(const std::string &dir);
+	~BlockCache();
+
+	static u64 hashData(std::string_view data);
+
+	// Store the data of a block, replacing what was cached before
+	void update(v3s16 pos, std::string_view data);
+	// Returns false if the block is not (or no longer) cached
+	bool load(v3s16 pos, std::string *data);
+	void remove(v3s16 pos);
+
+	// Commit pending changes to disk
+	void save();
+
+	const std::unordered_map<v3s16, u64> &getHashes() const { return m_hashes; }
+
+private:
+	std::unique_ptr<BlockCacheDatabaseSQLite3> m_db;
+	// content hash of every cached block, as stored with the block
+	std::unordered_map<v3s16, u64> m_hashes;
+};
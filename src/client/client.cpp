@@ -22,6 +22,7 @@
 #include "client/mesh_generator_thread.h"
 #include "client/particles.h"
 #include "client/localplayer.h"
+#include "client/blockcache.h"
 #include "util/auth.h"
 #include "util/directiontables.h"
 #include "util/pointedthing.h"
@@ -390,6 +391,7 @@ void Client::connect(const Address &address, const std::string &address_name,
 	m_con->Connect(address);
 
 	initLocalMapSaving(address, m_address_name, is_local_server);
+	initBlockCache(address, m_address_name, is_local_server);
 }
 
 void Client::step(float dtime)
@@ -480,6 +482,9 @@ void Client::step(float dtime)
 			std::max(g_settings->getFloat("client_unload_unused_data_timeout"), 0.0f),
 			mapblock_limit, &deleted_blocks);
 
+		if (!deleted_blocks.empty())
+			m_env.getClientMap().invalidateOcclusionCache(deleted_blocks);
+
 		// Send info to server
 
 		auto i = deleted_blocks.begin();
@@ -578,11 +583,13 @@ void Client::step(float dtime)
 	{
 		int num_processed_meshes = 0;
 		std::vector<v3s16> blocks_to_ack;
+		std::vector<v3s16> meshed_blocks;
 		bool force_update_shadows = false;
 		MeshUpdateResult r;
 		while (m_mesh_update_manager->getNextResult(r))
 		{
 			num_processed_meshes++;
+			meshed_blocks.push_back(r.p);
 
 			std::vector<MinimapMapblock*> minimap_mapblocks;
 			bool do_mapper_update = true;
@@ -660,8 +667,10 @@ void Client::step(float dtime)
 				sendGotBlocks(blocks_to_ack);
 		}
 
-		if (num_processed_meshes > 0)
+		if (num_processed_meshes > 0) {
 			g_profiler->graphAdd("num_processed_meshes", num_processed_meshes);
+			m_env.getClientMap().invalidateOcclusionCache(meshed_blocks);
+		}
 
 		if (force_update_shadows && !g_settings->getFlag("performance_tradeoffs")) {
 			auto shadow = RenderingEngine::get_shadow_renderer();
@@ -783,6 +792,12 @@ void Client::step(float dtime)
 		m_localdb->endSave();
 		m_localdb->beginSave();
 	}
+
+	// Write block cache
+	if (m_block_cache && m_block_cache_save_interval.step(dtime,
+			m_cache_save_interval)) {
+		m_block_cache->save();
+	}
 }
 
 bool Client::loadMedia(const std::string &data, const std::string &filename,
@@ -950,6 +965,28 @@ void Client::initLocalMapSaving(const Address &address,
 	actionstream << "Local map saving started, map will be saved at '" << world_path << "'" << std::endl;
 }
 
+void Client::initBlockCache(const Address &address,
+		const std::string &hostname,
+		bool is_local_server)
+{
+	if (!g_settings->getBool("enable_client_block_cache") || is_local_server)
+		return;
+	if (m_block_cache)
+		return;
+
+	std::string hostname_escaped = hostname;
+	str_replace(hostname_escaped, ':', '_');
+	std::string cache_path = porting::path_cache + DIR_DELIM + "blocks"
+		+ DIR_DELIM + "server_" + hostname_escaped + "_"
+		+ std::to_string(address.getPort());
+
+	try {
+		m_block_cache = std::make_unique<BlockCache>(cache_path);
+	} catch (BaseException &e) {
+		errorstream << "Could not open block cache: " << e.what() << std::endl;
+	}
+}
+
 void Client::ReceiveAll()
 {
 	NetworkPacket pkt;
@@ -1230,6 +1267,33 @@ void Client::sendGotBlocks(const std::vector<v3s16> &blocks)
 	Send(&pkt);
 }
 
+void Client::sendBlockCache()
+{
+	// Limit packet size to a sane value
+	constexpr size_t MAX_ENTRIES = 4096;
+
+	const auto &hashes = m_block_cache->getHashes();
+	auto it = hashes.begin();
+	while (it != hashes.end()) {
+		u16 count = std::min(MAX_ENTRIES, (size_t)std::distance(it, hashes.end()));
+		NetworkPacket pkt(TOSERVER_BLOCK_CACHE, 2 + (6 + 8) * count);
+		pkt << count;
+		for (u16 i = 0; i < count; i++, ++it)
+			pkt << it->first << it->second;
+		Send(&pkt);
+	}
+
+	infostream << "Client: Announced " << hashes.size()
+		<< " cached blocks to server" << std::endl;
+}
+
+void Client::sendBlockCacheMiss(v3s16 p)
+{
+	NetworkPacket pkt(TOSERVER_BLOCK_CACHE, 2 + 6 + 8);
+	pkt << (u16) 1 << p << (u64) 0;
+	Send(&pkt);
+}
+
 void Client::sendRemovedSounds(const std::vector<s32> &soundList)
 {
 	size_t server_ids = soundList.size();
@@ -1877,6 +1941,9 @@ void Client::afterContentReceived()
 	m_mesh_update_manager->start();
 
 	m_state = LC_Ready;
+	if (m_block_cache && m_proto_ver >= 48)
+		sendBlockCache();
+
 	sendReady();
 
 	if (m_mods_loaded)
@@ -29,6 +29,7 @@
 
 #define CLIENT_CHAT_MESSAGE_LIMIT_PER_10S 10.0f
 
+class BlockCache;
 class Camera;
 class ClientMediaDownloader;
 class ISoundManager;
@@ -168,6 +169,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void handleCommand_AddNode(NetworkPacket* pkt);
 	void handleCommand_NodemetaChanged(NetworkPacket *pkt);
 	void handleCommand_BlockData(NetworkPacket* pkt);
+	void handleCommand_BlockDataCached(NetworkPacket* pkt);
 	void handleCommand_Inventory(NetworkPacket* pkt);
 	void handleCommand_TimeOfDay(NetworkPacket* pkt);
 	void handleCommand_ChatMessage(NetworkPacket *pkt);
@@ -191,6 +193,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void handleCommand_InventoryFormSpec(NetworkPacket* pkt);
 	void handleCommand_DetachedInventory(NetworkPacket* pkt);
 	void handleCommand_ShowFormSpec(NetworkPacket* pkt);
+	void handleCommand_FormspecDiff(NetworkPacket* pkt);
 	void handleCommand_SpawnParticle(NetworkPacket* pkt);
 	void handleCommand_AddParticleSpawner(NetworkPacket* pkt);
 	void handleCommand_DeleteParticleSpawner(NetworkPacket* pkt);
@@ -441,6 +444,12 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void initLocalMapSaving(const Address &address,
 			const std::string &hostname,
 			bool is_local_server);
+	void initBlockCache(const Address &address,
+			const std::string &hostname,
+			bool is_local_server);
+
+	// Deserializes block data received from the server or the block cache
+	void updateBlockData(v3s16 p, const std::string &data);
 
 	void ReceiveAll();
 
@@ -454,6 +463,8 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void startAuth(AuthMechanism chosen_auth_mechanism);
 	void sendDeletedBlocks(std::vector<v3s16> &blocks);
 	void sendGotBlocks(const std::vector<v3s16> &blocks);
+	void sendBlockCache();
+	void sendBlockCacheMiss(v3s16 p);
 	void sendRemovedSounds(const std::vector<s32> &soundList);
 
 	bool canSendChatMessage() const;
@@ -564,6 +575,14 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	IntervalLimiter m_localdb_save_interval;
 	u16 m_cache_save_interval;
 
+	// Blocks received from this server in earlier sessions
+	std::unique_ptr<BlockCache> m_block_cache;
+	IntervalLimiter m_block_cache_save_interval;
+
+	// Last formspec received in TOCLIENT_SHOW_FORMSPEC or TOCLIENT_FORMSPEC_DIFF,
+	// the base of the next TOCLIENT_FORMSPEC_DIFF
+	std::string m_last_formspec;
+
 	// Client modding
 	ClientScripting *m_script = nullptr;
 	ModStorageDatabase *m_mod_storage_database = nullptr;
@@ -160,7 +160,8 @@ ClientMap::ClientMap(
 	m_client(client),
 	m_rendering_engine(rendering_engine),
 	m_control(control),
-	m_drawlist(MapBlockComparer(v3s16(0,0,0)))
+	m_drawlist(MapBlockComparer(v3s16(0,0,0))),
+	m_occlusion_cache(this)
 {
 
 	/*
@@ -242,7 +243,7 @@ MapSector * ClientMap::emergeSector(v2s16 p2d)
 	// Create it if it does not exist yet
 	if (!sector) {
 		sector = new MapSector(this, p2d, m_gamedef);
-		m_sectors[p2d] = sector;
+		addSector(sector);
 	}
 
 	return sector;
@@ -386,6 +387,10 @@ void ClientMap::updateDrawList()
 			occlusion_culling_enabled = false;
 	}
 
+	// Occlusion does not depend on the view direction, keep the results
+	// as long as the camera stays in the same node
+	m_occlusion_cache.setCamera(cam_pos_nodes, mesh_grid);
+
 	const v3s16 camera_block = getContainerPos(cam_pos_nodes, MAP_BLOCKSIZE);
 	m_drawlist = decltype(m_drawlist)(MapBlockComparer(camera_block));
 
@@ -466,7 +471,7 @@ void ClientMap::updateDrawList()
 				// Raytraced occlusion culling - send rays from the camera to the block's corners
 				if (!m_control.range_all && occlusion_culling_enabled && m_enable_raytraced_culling &&
 						mesh &&
-						isMeshOccluded(block, mesh_grid.cell_size, cam_pos_nodes)) {
+						m_occlusion_cache.isMeshOccluded(block)) {
 					blocks_occlusion_culled++;
 					continue;
 				}
@@ -508,188 +513,240 @@ void ClientMap::updateDrawList()
 		blocks_to_consider.push(camera_mesh);
 		meshes_seen.getChunk(camera_cell).getBits(camera_cell) = 0x07; // mark all sides as visible
 
+		// Calculate the coordinates for range and frustum culling
+		auto get_bounding_sphere = [&] (v3s16 block_pos_nodes, MapBlockMesh *mesh,
+				v3f &mesh_sphere_center, f32 &mesh_sphere_radius) {
+			if (mesh) {
+				mesh_sphere_center = intToFloat(block_pos_nodes, BS)
+						+ mesh->getBoundingSphereCenter();
+				mesh_sphere_radius = mesh->getBoundingRadius();
+			} else {
+				mesh_sphere_center = intToFloat(block_pos_nodes, BS) + v3f((mesh_grid.cell_size * MAP_BLOCKSIZE * 0.5f - 0.5f) * BS);
+				mesh_sphere_radius = 0.87f * mesh_grid.cell_size * MAP_BLOCKSIZE * BS;
+			}
+		};
+
+		// Simple distance check
+		auto is_out_of_range = [&] (v3f mesh_sphere_center, f32 mesh_sphere_radius) {
+			return !m_control.range_all &&
+				mesh_sphere_center.getDistanceFrom(intToFloat(cam_pos_nodes, BS)) >
+					m_control.wanted_range * BS + mesh_sphere_radius;
+		};
+
+		// Only do coarse frustum culling here, to account for fast camera movement.
+		// This is needed because this function is not called every frame.
+		const float frustum_cull_extra_radius = 300.0f;
+
+		const bool raytraced_culling = occlusion_culling_enabled && m_enable_raytraced_culling;
+
+		// Blocks of the current step of the search
+		std::vector<v3s16> blocks_step;
+		std::vector<MapBlock*> occlusion_candidates;
+
 		// Recursively walk the space and pick mapblocks for drawing
 		while (!blocks_to_consider.empty()) {
 
-			v3s16 block_coord = blocks_to_consider.front();
-			blocks_to_consider.pop();
+			// Take all queued blocks at once, so that their occlusion checks
+			// can be evaluated together in advance. They are still processed
+			// in the original order.
+			blocks_step.clear();
+			while (!blocks_to_consider.empty()) {
+				blocks_step.push_back(blocks_to_consider.front());
+				blocks_to_consider.pop();
+			}
 
-			v3s16 cell_coord = mesh_grid.getCellPos(block_coord);
-			auto &flags = meshes_seen.getChunk(cell_coord).getBits(cell_coord);
+			if (raytraced_culling) {
+				occlusion_candidates.clear();
+				for (v3s16 block_coord : blocks_step) {
+					v3s16 cell_coord = mesh_grid.getCellPos(block_coord);
+					if (meshes_seen.getChunk(cell_coord).getBits(cell_coord) & 0x80)
+						continue;
+
+					MapBlock *block = getBlockNoCreateNoEx(block_coord);
+					MapBlockMesh *mesh = block ? block->mesh : nullptr;
+					if (!mesh)
+						continue;
+
+					v3f mesh_sphere_center;
+					f32 mesh_sphere_radius;
+					get_bounding_sphere(block_coord * MAP_BLOCKSIZE, mesh,
+							mesh_sphere_center, mesh_sphere_radius);
+					if (is_out_of_range(mesh_sphere_center, mesh_sphere_radius) ||
+							is_frustum_culled(mesh_sphere_center,
+								mesh_sphere_radius + frustum_cull_extra_radius))
+						continue;
+
+					occlusion_candidates.push_back(block);
+				}
+				m_occlusion_cache.checkMeshes(occlusion_candidates);
+			}
 
-			// Only visit each block once (it may have been queued up to three times)
-			if ((flags & 0x80) == 0x80)
-				continue;
-			flags |= 0x80;
+			for (v3s16 block_coord : blocks_step) {
 
-			blocks_visited++;
+				v3s16 cell_coord = mesh_grid.getCellPos(block_coord);
+				auto &flags = meshes_seen.getChunk(cell_coord).getBits(cell_coord);
 
-			// Get the sector, block and mesh
-			MapSector *sector = this->getSectorNoGenerate(v2s16(block_coord.X, block_coord.Z));
+				// Only visit each block once (it may have been queued up to three times)
+				if ((flags & 0x80) == 0x80)
+					continue;
+				flags |= 0x80;
 
-			MapBlock *block = sector ? sector->getBlockNoCreateNoEx(block_coord.Y) : nullptr;
+				blocks_visited++;
 
-			MapBlockMesh *mesh = block ? block->mesh : nullptr;
+				// Get the sector, block and mesh
+				MapSector *sector = this->getSectorNoGenerate(v2s16(block_coord.X, block_coord.Z));
 
-			// Calculate the coordinates for range and frustum culling
-			v3f mesh_sphere_center;
-			f32 mesh_sphere_radius;
+				MapBlock *block = sector ? sector->getBlockNoCreateNoEx(block_coord.Y) : nullptr;
 
-			v3s16 block_pos_nodes = block_coord * MAP_BLOCKSIZE;
+				MapBlockMesh *mesh = block ? block->mesh : nullptr;
 
-			if (mesh) {
-				mesh_sphere_center = intToFloat(block_pos_nodes, BS)
-						+ mesh->getBoundingSphereCenter();
-				mesh_sphere_radius = mesh->getBoundingRadius();
-			} else {
-				mesh_sphere_center = intToFloat(block_pos_nodes, BS) + v3f((mesh_grid.cell_size * MAP_BLOCKSIZE * 0.5f - 0.5f) * BS);
-				mesh_sphere_radius = 0.87f * mesh_grid.cell_size * MAP_BLOCKSIZE * BS;
-			}
+				// Calculate the coordinates for range and frustum culling
+				v3f mesh_sphere_center;
+				f32 mesh_sphere_radius;
 
-			// First, perform a simple distance check.
-			if (!m_control.range_all &&
-				mesh_sphere_center.getDistanceFrom(intToFloat(cam_pos_nodes, BS)) >
-					m_control.wanted_range * BS + mesh_sphere_radius)
-				continue; // Out of range, skip.
+				v3s16 block_pos_nodes = block_coord * MAP_BLOCKSIZE;
 
-			// Frustum culling
-			// Only do coarse culling here, to account for fast camera movement.
-			// This is needed because this function is not called every frame.
-			float frustum_cull_extra_radius = 300.0f;
-			if (is_frustum_culled(mesh_sphere_center,
-					mesh_sphere_radius + frustum_cull_extra_radius)) {
-				blocks_frustum_culled++;
-				continue;
-			}
+				get_bounding_sphere(block_pos_nodes, mesh, mesh_sphere_center, mesh_sphere_radius);
 
-			// Calculate the vector from the camera block to the current block
-			// We use it to determine through which sides of the current block we can continue the search
-			v3s16 look = block_coord - camera_mesh;
+				// First, perform a simple distance check.
+				if (is_out_of_range(mesh_sphere_center, mesh_sphere_radius))
+					continue; // Out of range, skip.
 
-			// Occluded near sides will further occlude the far sides
-			u8 visible_outer_sides = flags & 0x07;
+				// Frustum culling
+				if (is_frustum_culled(mesh_sphere_center,
+						mesh_sphere_radius + frustum_cull_extra_radius)) {
+					blocks_frustum_culled++;
+					continue;
+				}
 
-			// Raytraced occlusion culling - send rays from the camera to the block's corners
-			if (occlusion_culling_enabled && m_enable_raytraced_culling &&
-					block && mesh &&
-					visible_outer_sides != 0x07 && isMeshOccluded(block, mesh_grid.cell_size, cam_pos_nodes)) {
-				blocks_occlusion_culled++;
-				continue;
-			}
+				// Calculate the vector from the camera block to the current block
+				// We use it to determine through which sides of the current block we can continue the search
+				v3s16 look = block_coord - camera_mesh;
 
-			if (mesh_grid.cell_size > 1) {
-				// Block meshes are stored in the corner block of a chunk
-				// (where all coordinate are divisible by the chunk size)
-				// Add them to the de-dup set.
-				shortlist.emplace(block_coord.X, block_coord.Y, block_coord.Z);
-				// All other blocks we can grab and add to the keeplist right away.
-				if (block) {
-					m_keeplist.push_back(block);
+				// Occluded near sides will further occlude the far sides
+				u8 visible_outer_sides = flags & 0x07;
+
+				// Raytraced occlusion culling - send rays from the camera to the block's corners
+				if (raytraced_culling && block && mesh &&
+						visible_outer_sides != 0x07 && m_occlusion_cache.isMeshOccluded(block)) {
+					blocks_occlusion_culled++;
+					continue;
+				}
+
+				if (mesh_grid.cell_size > 1) {
+					// Block meshes are stored in the corner block of a chunk
+					// (where all coordinate are divisible by the chunk size)
+					// Add them to the de-dup set.
+					shortlist.emplace(block_coord.X, block_coord.Y, block_coord.Z);
+					// All other blocks we can grab and add to the keeplist right away.
+					if (block) {
+						m_keeplist.push_back(block);
+						block->refGrab();
+					}
+				} else if (mesh) {
+					// without mesh chunking we can add the block to the drawlist
 					block->refGrab();
+					m_drawlist.emplace(block_coord, block);
 				}
-			} else if (mesh) {
-				// without mesh chunking we can add the block to the drawlist
-				block->refGrab();
-				m_drawlist.emplace(block_coord, block);
-			}
 
-			// Decide which sides to traverse next or to block away
+				// Decide which sides to traverse next or to block away
 
-			// First, find the near sides that would occlude the far sides
-			// * A near side can itself be occluded by a nearby block (the test above ^^)
-			// * A near side can be visible but fully opaque by itself (e.g. ground at the 0 level)
+				// First, find the near sides that would occlude the far sides
+				// * A near side can itself be occluded by a nearby block (the test above ^^)
+				// * A near side can be visible but fully opaque by itself (e.g. ground at the 0 level)
 
-			// mesh solid sides are +Z-Z+Y-Y+X-X
-			// if we are inside the block's coordinates on an axis,
-			// treat these sides as opaque, as they should not allow to reach the far sides
-			u8 block_inner_sides = (look.X == 0 ? 3 : 0) |
-				(look.Y == 0 ? 12 : 0) |
-				(look.Z == 0 ? 48 : 0);
+				// mesh solid sides are +Z-Z+Y-Y+X-X
+				// if we are inside the block's coordinates on an axis,
+				// treat these sides as opaque, as they should not allow to reach the far sides
+				u8 block_inner_sides = (look.X == 0 ? 3 : 0) |
+					(look.Y == 0 ? 12 : 0) |
+					(look.Z == 0 ? 48 : 0);
 
-			// get the mask for the sides that are relevant based on the direction
-			u8 near_inner_sides = (look.X > 0 ? 1 : 2) |
-					(look.Y > 0 ? 4 : 8) |
-					(look.Z > 0 ? 16 : 32);
+				// get the mask for the sides that are relevant based on the direction
+				u8 near_inner_sides = (look.X > 0 ? 1 : 2) |
+						(look.Y > 0 ? 4 : 8) |
+						(look.Z > 0 ? 16 : 32);
 
-			// This bitset is +Z-Z+Y-Y+X-X (See MapBlockMesh), and axis is XYZ.
-			// Get he block's transparent sides
-			u8 transparent_sides = (occlusion_culling_enabled && block) ? ~block->solid_sides : 0x3F;
+				// This bitset is +Z-Z+Y-Y+X-X (See MapBlockMesh), and axis is XYZ.
+				// Get he block's transparent sides
+				u8 transparent_sides = (occlusion_culling_enabled && block) ? ~block->solid_sides : 0x3F;
 
-			// compress block transparent sides to ZYX mask of see-through axes
-			u8 near_transparency =  (block_inner_sides == 0x3F) ? near_inner_sides : (transparent_sides & near_inner_sides);
+				// compress block transparent sides to ZYX mask of see-through axes
+				u8 near_transparency =  (block_inner_sides == 0x3F) ? near_inner_sides : (transparent_sides & near_inner_sides);
 
-			// when we are inside the camera block, do not block any sides
-			if (block_inner_sides == 0x3F)
-				block_inner_sides = 0;
+				// when we are inside the camera block, do not block any sides
+				if (block_inner_sides == 0x3F)
+					block_inner_sides = 0;
 
-			near_transparency &= ~block_inner_sides & 0x3F;
+				near_transparency &= ~block_inner_sides & 0x3F;
 
-			near_transparency |= (near_transparency >> 1);
-			near_transparency = (near_transparency & 1) |
-					((near_transparency >> 1) & 2) |
-					((near_transparency >> 2) & 4);
+				near_transparency |= (near_transparency >> 1);
+				near_transparency = (near_transparency & 1) |
+						((near_transparency >> 1) & 2) |
+						((near_transparency >> 2) & 4);
 
-			// combine with known visible sides that matter
-			near_transparency &= visible_outer_sides;
+				// combine with known visible sides that matter
+				near_transparency &= visible_outer_sides;
 
-			// The rule for any far side to be visible:
-			// * Any of the adjacent near sides is transparent (different axes)
-			// * The opposite near side (same axis) is transparent, if it is the dominant axis of the look vector
+				// The rule for any far side to be visible:
+				// * Any of the adjacent near sides is transparent (different axes)
+				// * The opposite near side (same axis) is transparent, if it is the dominant axis of the look vector
 
-			// Calculate vector from camera to mapblock center. Because we only need relation between
-			// coordinates we scale by 2 to avoid precision loss.
-			v3s16 precise_look = 2 * (block_pos_nodes - cam_pos_nodes) + mesh_grid.cell_size * MAP_BLOCKSIZE - 1;
+				// Calculate vector from camera to mapblock center. Because we only need relation between
+				// coordinates we scale by 2 to avoid precision loss.
+				v3s16 precise_look = 2 * (block_pos_nodes - cam_pos_nodes) + mesh_grid.cell_size * MAP_BLOCKSIZE - 1;
 
-			// dominant axis flag
-			u8 dominant_axis = (abs(precise_look.X) > abs(precise_look.Y) && abs(precise_look.X) > abs(precise_look.Z)) |
-						((abs(precise_look.Y) > abs(precise_look.Z) && abs(precise_look.Y) > abs(precise_look.X)) << 1) |
-						((abs(precise_look.Z) > abs(precise_look.X) && abs(precise_look.Z) > abs(precise_look.Y)) << 2);
+				// dominant axis flag
+				u8 dominant_axis = (abs(precise_look.X) > abs(precise_look.Y) && abs(precise_look.X) > abs(precise_look.Z)) |
+							((abs(precise_look.Y) > abs(precise_look.Z) && abs(precise_look.Y) > abs(precise_look.X)) << 1) |
+							((abs(precise_look.Z) > abs(precise_look.X) && abs(precise_look.Z) > abs(precise_look.Y)) << 2);
 
-			// Queue next blocks for processing:
-			// - Examine "far" sides of the current blocks, i.e. never move towards the camera
-			// - Only traverse the sides that are not occluded
-			// - Only traverse the sides that are not opaque
-			// When queueing, mark the relevant side on the next block as 'visible'
-			for (s16 axis = 0; axis < 3; axis++) {
+				// Queue next blocks for processing:
+				// - Examine "far" sides of the current blocks, i.e. never move towards the camera
+				// - Only traverse the sides that are not occluded
+				// - Only traverse the sides that are not opaque
+				// When queueing, mark the relevant side on the next block as 'visible'
+				for (s16 axis = 0; axis < 3; axis++) {
 
-				// Select a bit from transparent_sides for the side
-				u8 far_side_mask = 1 << (2 * axis);
+					// Select a bit from transparent_sides for the side
+					u8 far_side_mask = 1 << (2 * axis);
 
-				// axis flag
-				u8 my_side = 1 << axis;
-				u8 adjacent_sides = my_side ^ 0x07;
+					// axis flag
+					u8 my_side = 1 << axis;
+					u8 adjacent_sides = my_side ^ 0x07;
 
-				auto traverse_far_side = [&](s8 next_pos_offset) {
-					// far side is visible if adjacent near sides are transparent, or if opposite side on dominant axis is transparent
-					bool side_visible = ((near_transparency & adjacent_sides) | (near_transparency & my_side & dominant_axis)) != 0;
-					side_visible = side_visible && ((far_side_mask & transparent_sides) != 0);
+					auto traverse_far_side = [&](s8 next_pos_offset) {
+						// far side is visible if adjacent near sides are transparent, or if opposite side on dominant axis is transparent
+						bool side_visible = ((near_transparency & adjacent_sides) | (near_transparency & my_side & dominant_axis)) != 0;
+						side_visible = side_visible && ((far_side_mask & transparent_sides) != 0);
 
-					v3s16 next_pos = block_coord;
-					next_pos[axis] += next_pos_offset;
+						v3s16 next_pos = block_coord;
+						next_pos[axis] += next_pos_offset;
 
-					v3s16 next_cell = mesh_grid.getCellPos(next_pos);
+						v3s16 next_cell = mesh_grid.getCellPos(next_pos);
 
-					// If a side is a see-through, mark the next block's side as visible, and queue
-					if (side_visible) {
-						auto &next_flags = meshes_seen.getChunk(next_cell).getBits(next_cell);
-						next_flags |= my_side;
-						blocks_to_consider.push(next_pos);
-					}
-					else {
-						sides_skipped++;
-					}
-				};
+						// If a side is a see-through, mark the next block's side as visible, and queue
+						if (side_visible) {
+							auto &next_flags = meshes_seen.getChunk(next_cell).getBits(next_cell);
+							next_flags |= my_side;
+							blocks_to_consider.push(next_pos);
+						}
+						else {
+							sides_skipped++;
+						}
+					};
 
 
-				// Test the '-' direction of the axis
-				if (look[axis] <= 0 && block_coord[axis] > p_blocks_min[axis])
-					traverse_far_side(-mesh_grid.cell_size);
+					// Test the '-' direction of the axis
+					if (look[axis] <= 0 && block_coord[axis] > p_blocks_min[axis])
+						traverse_far_side(-mesh_grid.cell_size);
 
-				// Test the '+' direction of the axis
-				far_side_mask <<= 1;
+					// Test the '+' direction of the axis
+					far_side_mask <<= 1;
 
-				if (look[axis] >= 0 && block_coord[axis] < p_blocks_max[axis])
-					traverse_far_side(+mesh_grid.cell_size);
+					if (look[axis] >= 0 && block_coord[axis] < p_blocks_max[axis])
+						traverse_far_side(+mesh_grid.cell_size);
+				}
 			}
 		}
 		g_profiler->avg("MapBlocks sides skipped [#]", sides_skipped);
@@ -1609,54 +1666,3 @@ u32 DrawDescriptor::draw(video::IVideoDriver* driver)
 		return m_buffer->getVertexCount();
 	}
 }
-
-bool ClientMap::isMeshOccluded(MapBlock *mesh_block, u16 mesh_size, v3s16 cam_pos_nodes)
-{
-	if (mesh_size == 1)
-		return isBlockOccluded(mesh_block, cam_pos_nodes);
-
-	v3s16 min_edge = mesh_block->getPosRelative();
-	v3s16 max_edge = min_edge + mesh_size * MAP_BLOCKSIZE -1;
-	bool check_axis[3] = { false, false, false };
-	u16 closest_side[3] = { 0, 0, 0 };
-
-	for (int axis = 0; axis < 3; axis++) {
-		if (cam_pos_nodes[axis] < min_edge[axis])
-			check_axis[axis] = true;
-		else if (cam_pos_nodes[axis] > max_edge[axis]) {
-			check_axis[axis] = true;
-			closest_side[axis] = mesh_size - 1;
-		}
-	}
-
-	std::vector<bool> processed_blocks(mesh_size * mesh_size * mesh_size);
-
-	// scan the side
-	for (u16 i = 0; i < mesh_size; i++)
-	for (u16 j = 0; j < mesh_size; j++) {
-		v3s16 offsets[3] = {
-			v3s16(closest_side[0], i, j),
-			v3s16(i, closest_side[1], j),
-			v3s16(i, j, closest_side[2])
-		};
-		for (int axis = 0; axis < 3; axis++) {
-			v3s16 offset = offsets[axis];
-			int block_index = offset.X + offset.Y * mesh_size + offset.Z * mesh_size * mesh_size;
-			if (check_axis[axis] && !processed_blocks[block_index]) {
-				processed_blocks[block_index] = true;
-				v3s16 block_pos = mesh_block->getPos() + offset;
-				MapBlock *block;
-
-				if (mesh_block->getPos() == block_pos)
-					block = mesh_block;
-				else
-					block = getBlockNoCreateNoEx(block_pos);
-
-				if (block && !isBlockOccluded(block, cam_pos_nodes))
-					return false;
-			}
-		}
-	}
-
-	return true;
-}
@@ -6,6 +6,7 @@
 
 #include "irrlichttypes_bloated.h"
 #include "map.h"
+#include "occlusioncache.h"
 #include "camera.h"
 #include <set>
 #include <map>
@@ -107,6 +108,13 @@ class ClientMap : public Map, public scene::ISceneNode
 
 	void invalidateMapBlockMesh(MapBlockMesh *mesh);
 
+	// Call when the nodes of the blocks changed, forgets the occlusion check
+	// results that may depend on them
+	void invalidateOcclusionCache(const std::vector<v3s16> &blocks)
+	{
+		m_occlusion_cache.invalidate(blocks);
+	}
+
 	// For debug printing
 	void PrintInfo(std::ostream &out) override;
 
@@ -122,8 +130,6 @@ class ClientMap : public Map, public scene::ISceneNode
 
 	void reportMetrics(u64 save_time_us, u32 saved_blocks, u32 all_blocks) override;
 private:
-	bool isMeshOccluded(MapBlock *mesh_block, u16 mesh_size, v3s16 cam_pos_nodes);
-
 	// update the vertex order in transparent mesh buffers
 	void updateTransparentMeshBuffers();
 
@@ -173,4 +179,6 @@ class ClientMap : public Map, public scene::ISceneNode
 
 	bool m_loops_occlusion_culler;
 	bool m_enable_raytraced_culling;
+
+	OcclusionCache m_occlusion_cache;
 };
@@ -25,6 +25,7 @@
 #include "content_cao.h"
 #include "content/subgames.h"
 #include "client/event_manager.h"
+#include "filesys.h"
 #include "fontengine.h"
 #include "gui/touchcontrols.h"
 #include "itemdef.h"
@@ -885,6 +886,9 @@ bool Game::startup(bool *kill,
 	this->chat_backend        = chat_backend;
 	simple_singleplayer_mode  = start_data.isSinglePlayer();
 
+	if (g_settings->getBool("trace_client"))
+		g_tracer->start();
+
 	input->keycache.populate();
 
 	driver = device->getVideoDriver();
@@ -1101,6 +1105,11 @@ void Game::shutdown()
 
 	stop_thread->rethrow();
 
+	if (g_settings->getBool("trace_client")) {
+		if (auto trace = g_tracer->stop())
+			trace->writeFile(porting::path_user + DIR_DELIM + TraceData::getDefaultFileName());
+	}
+
 	// to be continued in Game::~Game
 }
 
@@ -0,0 +1,149 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "occlusioncache.h"
+#include "map.h"
+#include "mapblock.h"
+#include "profiler.h"
+#include "threading/task_pool.h"
+#include <functional>
+
+void OcclusionCache::setCamera(v3s16 cam_pos_nodes, MeshGrid mesh_grid)
+{
+	if (cam_pos_nodes == m_camera && mesh_grid.cell_size == m_mesh_grid.cell_size)
+		return;
+	m_results.clear();
+	m_camera = cam_pos_nodes;
+	m_mesh_grid = mesh_grid;
+}
+
+bool OcclusionCache::isMeshOccluded(MapBlock *mesh_block)
+{
+	auto it = m_results.find(mesh_block->getPos());
+	if (it != m_results.end())
+		return it->second;
+
+	bool occluded = checkMesh(mesh_block);
+	m_results[mesh_block->getPos()] = occluded;
+	return occluded;
+}
+
+void OcclusionCache::checkMeshes(const std::vector<MapBlock*> &mesh_blocks)
+{
+	// Not worth waking up the helper threads for a few checks
+	constexpr size_t min_parallel_checks = 8;
+
+	// Insert the entries first, so the map is not modified during the checks
+	std::vector<std::pair<MapBlock*, bool*>> pending;
+	for (MapBlock *block : mesh_blocks) {
+		auto inserted = m_results.emplace(block->getPos(), false);
+		if (inserted.second)
+			pending.emplace_back(block, &inserted.first->second);
+	}
+
+	std::function<void(size_t)> check = [&] (size_t i) {
+		*pending[i].second = checkMesh(pending[i].first);
+	};
+
+	if (TaskPool::get().getThreadCount() > 1 && pending.size() >= min_parallel_checks) {
+		TaskPool::get().parallelFor(0, pending.size(), check);
+	} else {
+		for (size_t i = 0; i < pending.size(); i++)
+			check(i);
+	}
+	g_profiler->avg("CM::updateDrawList(): occlusion checks [#]", pending.size());
+}
+
+void OcclusionCache::invalidate(const std::vector<v3s16> &blocks)
+{
+	if (m_results.empty() || blocks.empty())
+		return;
+
+	const s16 cell_size = m_mesh_grid.cell_size;
+	const v3s16 camera_block = getNodeBlockPos(m_camera);
+
+	// The changed nodes are anywhere in the meshes of the blocks
+	std::vector<std::pair<v3s16, v3s16>> changed;
+	changed.reserve(blocks.size());
+	for (v3s16 p : blocks) {
+		v3s16 minp = m_mesh_grid.getMeshPos(p);
+		changed.emplace_back(minp, minp + (cell_size - 1));
+	}
+
+	for (auto it = m_results.begin(); it != m_results.end(); ) {
+		/*
+			The rays of a check go from the camera to points of the mesh,
+			some of which are one node outside of it. They do not leave the
+			box around the camera and the mesh, grown by one block.
+		*/
+		const v3s16 mesh_max = it->first + (cell_size - 1);
+		const v3s16 minp = componentwise_min(camera_block, it->first) - 1;
+		const v3s16 maxp = componentwise_max(camera_block, mesh_max) + 1;
+
+		bool affected = false;
+		for (const auto &area : changed) {
+			if (area.first.X <= maxp.X && area.second.X >= minp.X &&
+					area.first.Y <= maxp.Y && area.second.Y >= minp.Y &&
+					area.first.Z <= maxp.Z && area.second.Z >= minp.Z) {
+				affected = true;
+				break;
+			}
+		}
+		if (affected)
+			it = m_results.erase(it);
+		else
+			++it;
+	}
+}
+
+bool OcclusionCache::checkMesh(MapBlock *mesh_block) const
+{
+	const u16 mesh_size = m_mesh_grid.cell_size;
+	if (mesh_size == 1)
+		return m_map->isBlockOccluded(mesh_block, m_camera);
+
+	v3s16 min_edge = mesh_block->getPosRelative();
+	v3s16 max_edge = min_edge + mesh_size * MAP_BLOCKSIZE -1;
+	bool check_axis[3] = { false, false, false };
+	u16 closest_side[3] = { 0, 0, 0 };
+
+	for (int axis = 0; axis < 3; axis++) {
+		if (m_camera[axis] < min_edge[axis])
+			check_axis[axis] = true;
+		else if (m_camera[axis] > max_edge[axis]) {
+			check_axis[axis] = true;
+			closest_side[axis] = mesh_size - 1;
+		}
+	}
+
+	std::vector<bool> processed_blocks(mesh_size * mesh_size * mesh_size);
+
+	// scan the side
+	for (u16 i = 0; i < mesh_size; i++)
+	for (u16 j = 0; j < mesh_size; j++) {
+		v3s16 offsets[3] = {
+			v3s16(closest_side[0], i, j),
+			v3s16(i, closest_side[1], j),
+			v3s16(i, j, closest_side[2])
+		};
+		for (int axis = 0; axis < 3; axis++) {
+			v3s16 offset = offsets[axis];
+			int block_index = offset.X + offset.Y * mesh_size + offset.Z * mesh_size * mesh_size;
+			if (check_axis[axis] && !processed_blocks[block_index]) {
+				processed_blocks[block_index] = true;
+				v3s16 block_pos = mesh_block->getPos() + offset;
+				MapBlock *block;
+
+				if (mesh_block->getPos() == block_pos)
+					block = mesh_block;
+				else
+					block = m_map->findBlock(block_pos);
+
+				if (block && !m_map->isBlockOccluded(block, m_camera))
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,52 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irr_v3d.h"
+#include "util/numeric.h"
+#include <unordered_map>
+#include <vector>
+
+class Map;
+class MapBlock;
+
+/*
+	Results of the raytraced occlusion checks of ClientMap::updateDrawList,
+	by mesh position.
+
+	Occlusion does not depend on the camera direction, so the results stay
+	valid until the camera moves to another node or the nodes between the
+	camera and a mesh change.
+*/
+class OcclusionCache
+{
+public:
+	OcclusionCache(Map *map) : m_map(map) {}
+
+	// Forgets all results if the camera moved to another node or the
+	// mesh grid changed
+	void setCamera(v3s16 cam_pos_nodes, MeshGrid mesh_grid);
+
+	// 'mesh_block' is the block that holds the mesh
+	bool isMeshOccluded(MapBlock *mesh_block);
+
+	// Checks the meshes that have no result yet, in parallel if there are
+	// enough of them
+	void checkMeshes(const std::vector<MapBlock*> &mesh_blocks);
+
+	// Forgets the results that may depend on the nodes of the given blocks
+	void invalidate(const std::vector<v3s16> &blocks);
+
+	void clear() { m_results.clear(); }
+	size_t size() const { return m_results.size(); }
+
+private:
+	// May be called from several threads at once
+	bool checkMesh(MapBlock *mesh_block) const;
+
+	Map *m_map;
+	v3s16 m_camera;
+	MeshGrid m_mesh_grid = {1};
+	std::unordered_map<v3s16, bool> m_results;
+};
@@ -10,6 +10,7 @@
 #include <unordered_set>
 #include <algorithm>
 #include <queue>
+#include <set>
 #include "gamedef.h"
 #include "inventory.h"
 #include "util/serialize.h"
@@ -17,6 +18,7 @@
 #include "util/numeric.h"
 #include "util/strfnd.h"
 #include "exceptions.h"
+#include "threading/mutex_auto_lock.h"
 
 inline bool isGroupRecipeStr(const std::string &rec_name)
 {
@@ -32,28 +34,45 @@ static bool hasGroupItem(const std::vector<std::string> &recipe)
 	return false;
 }
 
-inline u64 getHashForString(const std::string &recipe_str)
+static bool hasGroupItem(const std::vector<ItemName> &recipe_names)
 {
-	/*errorstream << "Hashing craft string  \"" << recipe_str << '"';*/
-	return murmur_hash_64_ua(recipe_str.data(), recipe_str.length(), 0xdeadbeef);
+	for (ItemName name : recipe_names) {
+		if (isGroupRecipeStr(name))
+			return true;
+	}
+	return false;
+}
+
+// Item names are sorted by their interned id wherever the order does not
+// matter, which is much cheaper than comparing the strings. Names that are
+// not interned all have the same id and are ordered by their string.
+inline bool compareItemNames(const ItemName &a, const ItemName &b)
+{
+	if (a.getId() != b.getId())
+		return a.getId() < b.getId();
+	return !a.isInterned() && a.str() < b.str();
+}
+
+inline u64 getHashForIds(const u32 *ids, size_t count)
+{
+	return murmur_hash_64_ua(ids, count * sizeof(u32), 0xdeadbeef);
 }
 
-static u64 getHashForGrid(CraftHashType type, const std::vector<std::string> &grid_names)
+// Hashes of the same names only match within one process
+static u64 getHashForGrid(CraftHashType type, const std::vector<ItemName> &grid_names)
 {
 	switch (type) {
 		case CRAFT_HASH_TYPE_ITEM_NAMES: {
-			std::ostringstream os;
-			bool is_first = true;
-			for (const std::string &grid_name : grid_names) {
-				if (!grid_name.empty()) {
-					os << (is_first ? "" : "\n") << grid_name;
-					is_first = false;
-				}
+			std::vector<u32> ids;
+			ids.reserve(grid_names.size());
+			for (ItemName grid_name : grid_names) {
+				if (!grid_name.empty())
+					ids.push_back(grid_name.getId());
 			}
-			return getHashForString(os.str());
+			return getHashForIds(ids.data(), ids.size());
 		} case CRAFT_HASH_TYPE_COUNT: {
 			u64 cnt = 0;
-			for (const std::string &grid_name : grid_names)
+			for (ItemName grid_name : grid_names)
 				if (!grid_name.empty())
 					cnt++;
 			return cnt;
@@ -67,17 +86,24 @@ static u64 getHashForGrid(CraftHashType type, const std::vector<std::string> &gr
 
 // Check if input matches recipe
 // Takes recipe groups into account
-static bool inputItemMatchesRecipe(const std::string &inp_name,
-		const std::string &rec_name, IItemDefManager *idef)
+static bool inputItemMatchesRecipe(const ItemName &inp_name,
+		const ItemName &rec_name, IItemDefManager *idef,
+		const CraftGroupTable *group_table)
 {
 	// Exact name
 	if (inp_name == rec_name)
 		return true;
 
+	// Group, precomputed
+	if (group_table) {
+		if (std::optional<bool> matches = group_table->matches(inp_name, rec_name))
+			return *matches;
+	}
+
 	// Group
 	if (isGroupRecipeStr(rec_name) && idef->isKnown(inp_name)) {
 		const struct ItemDefinition &def = idef->get(inp_name);
-		Strfnd f(rec_name.substr(6));
+		Strfnd f(rec_name.str().substr(6));
 		bool all_groups_match = true;
 		do {
 			std::string check_group = f.next(",");
@@ -94,19 +120,23 @@ static bool inputItemMatchesRecipe(const std::string &inp_name,
 	return false;
 }
 
-// Deserialize an itemstring then return the name of the item
-static std::string craftGetItemName(const std::string &itemstring, IGameDef *gamedef)
+// Deserialize an itemstring then return the name of the item.
+// Names in recipes are interned even if no such item is registered, group
+// names in particular.
+static ItemName craftGetItemName(const std::string &itemstring, IGameDef *gamedef)
 {
 	ItemStack item;
 	item.deSerialize(itemstring, gamedef->idef());
-	return item.name;
+	if (item.name.isInterned())
+		return item.name;
+	return ItemName::intern(item.name.str());
 }
 
 // (mapcar craftGetItemName itemstrings)
-static std::vector<std::string> craftGetItemNames(
+static std::vector<ItemName> craftGetItemNames(
 		const std::vector<std::string> &itemstrings, IGameDef *gamedef)
 {
-	std::vector<std::string> result;
+	std::vector<ItemName> result;
 	result.reserve(itemstrings.size());
 	for (const auto &itemstring : itemstrings) {
 		result.push_back(craftGetItemName(itemstring, gamedef));
@@ -115,10 +145,10 @@ static std::vector<std::string> craftGetItemNames(
 }
 
 // Get name of each item, and return them as a new list.
-static std::vector<std::string> craftGetItemNames(
+static std::vector<ItemName> craftGetItemNames(
 		const std::vector<ItemStack> &items, IGameDef *gamedef)
 {
-	std::vector<std::string> result;
+	std::vector<ItemName> result;
 	result.reserve(items.size());
 	for (const auto &item : items) {
 		result.push_back(item.name);
@@ -141,14 +171,14 @@ static std::vector<ItemStack> craftGetItems(
 
 // Compute bounding rectangle given a matrix of items
 // Returns false if every item is ""
-static bool craftGetBounds(const std::vector<std::string> &items, unsigned int width,
+static bool craftGetBounds(const std::vector<ItemName> &items, unsigned int width,
 		unsigned int &min_x, unsigned int &max_x,
 		unsigned int &min_y, unsigned int &max_y)
 {
 	bool success = false;
 	unsigned int x = 0;
 	unsigned int y = 0;
-	for (const std::string &item : items) {
+	for (ItemName item : items) {
 		// Is this an actual item?
 		if (!item.empty()) {
 			if (!success) {
@@ -189,7 +219,7 @@ static void craftDecrementInput(CraftInput &input, IGameDef *gamedef)
 static void craftDecrementOrReplaceInput(CraftInput &input,
 		std::vector<ItemStack> &output_replacements,
 		const CraftReplacements &replacements,
-		IGameDef *gamedef)
+		IGameDef *gamedef, const CraftGroupTable *group_table)
 {
 	if (replacements.pairs.empty()) {
 		craftDecrementInput(input, gamedef);
@@ -203,7 +233,9 @@ static void craftDecrementOrReplaceInput(CraftInput &input,
 		// Find an appropriate replacement
 		bool found_replacement = false;
 		for (auto j = pairs.begin(); j != pairs.end(); ++j) {
-			if (inputItemMatchesRecipe(item.name, j->first, gamedef->idef())) {
+			if (inputItemMatchesRecipe(item.name,
+					gamedef->idef()->getItemName(j->first), gamedef->idef(),
+					group_table)) {
 				if (item.count == 1) {
 					item.deSerialize(j->second, gamedef->idef());
 					found_replacement = true;
@@ -321,6 +353,79 @@ std::string CraftReplacements::dump() const
 	return os.str();
 }
 
+/*
+	CraftGroupTable
+*/
+
+void CraftGroupTable::build(const std::vector<ItemName> &group_names,
+		IItemDefManager *idef)
+{
+	clear();
+
+	// Items of every group, so that each group recipe item only has to
+	// look at the items of one of its groups
+	std::set<std::string> all_names;
+	idef->getAll(all_names);
+	std::unordered_map<std::string, std::vector<ItemName>> items_by_group;
+	for (const std::string &name : all_names) {
+		for (const auto &group : idef->get(name).groups) {
+			if (group.second != 0)
+				items_by_group[group.first].emplace_back(name);
+		}
+	}
+
+	for (ItemName group_name : group_names) {
+		if (!isGroupRecipeStr(group_name) || m_items_by_group.count(group_name))
+			continue;
+		std::unordered_set<ItemName> &items = m_items_by_group[group_name];
+
+		std::vector<std::string> groups;
+		Strfnd f(group_name.str().substr(6));
+		do {
+			groups.push_back(f.next(","));
+		} while (!f.at_end());
+
+		auto it = items_by_group.find(groups[0]);
+		if (it == items_by_group.end())
+			continue;
+		for (ItemName item : it->second) {
+			const ItemDefinition &def = idef->get(item);
+			bool all_groups_match = true;
+			for (size_t i = 1; i < groups.size(); i++) {
+				if (itemgroup_get(def.groups, groups[i]) == 0) {
+					all_groups_match = false;
+					break;
+				}
+			}
+			if (all_groups_match) {
+				items.insert(item);
+				m_groups_by_item[item].push_back(group_name);
+			}
+		}
+	}
+}
+
+void CraftGroupTable::clear()
+{
+	m_items_by_group.clear();
+	m_groups_by_item.clear();
+}
+
+std::optional<bool> CraftGroupTable::matches(const ItemName &item, const ItemName &group_name) const
+{
+	auto it = m_items_by_group.find(group_name);
+	if (it == m_items_by_group.end())
+		return std::nullopt;
+	return it->second.count(item) != 0;
+}
+
+const std::vector<ItemName> &CraftGroupTable::getGroupsOf(const ItemName &item) const
+{
+	static const std::vector<ItemName> none;
+	auto it = m_groups_by_item.find(item);
+	return it == m_groups_by_item.end() ? none : it->second;
+}
+
 /*
 	CraftDefinitionShaped
 */
@@ -349,12 +454,12 @@ bool CraftDefinitionShaped::check(const CraftInput &input, IGameDef *gamedef) co
 		return false;
 
 	// Get input item matrix
-	std::vector<std::string> inp_names = craftGetItemNames(input.items, gamedef);
+	std::vector<ItemName> inp_names = craftGetItemNames(input.items, gamedef);
 	unsigned int inp_width = input.width;
 	if (inp_width == 0)
 		return false;
 	while (inp_names.size() % inp_width != 0)
-		inp_names.emplace_back("");
+		inp_names.emplace_back();
 
 	// Get input bounds
 	unsigned int inp_min_x = 0, inp_max_x = 0, inp_min_y = 0, inp_max_y = 0;
@@ -362,7 +467,7 @@ bool CraftDefinitionShaped::check(const CraftInput &input, IGameDef *gamedef) co
 			inp_min_y, inp_max_y))
 		return false;  // it was empty
 
-	std::vector<std::string> rec_names;
+	std::vector<ItemName> rec_names;
 	if (hash_inited)
 		rec_names = recipe_names;
 	else
@@ -373,7 +478,7 @@ bool CraftDefinitionShaped::check(const CraftInput &input, IGameDef *gamedef) co
 	if (rec_width == 0)
 		return false;
 	while (rec_names.size() % rec_width != 0)
-		rec_names.emplace_back("");
+		rec_names.emplace_back();
 
 	// Get recipe bounds
 	unsigned int rec_min_x=0, rec_max_x=0, rec_min_y=0, rec_max_y=0;
@@ -400,7 +505,7 @@ bool CraftDefinitionShaped::check(const CraftInput &input, IGameDef *gamedef) co
 
 			if (!inputItemMatchesRecipe(
 					inp_names[inp_y + inp_x],
-					rec_names[rec_y + rec_x], gamedef->idef())) {
+					rec_names[rec_y + rec_x], gamedef->idef(), group_table)) {
 				return false;
 			}
 		}
@@ -422,7 +527,8 @@ CraftInput CraftDefinitionShaped::getInput(const CraftOutput &output, IGameDef *
 void CraftDefinitionShaped::decrementInput(CraftInput &input, std::vector<ItemStack> &output_replacements,
 	 IGameDef *gamedef) const
 {
-	craftDecrementOrReplaceInput(input, output_replacements, replacements, gamedef);
+	craftDecrementOrReplaceInput(input, output_replacements, replacements, gamedef,
+			group_table);
 }
 
 u64 CraftDefinitionShaped::getHash(CraftHashType type) const
@@ -431,8 +537,8 @@ u64 CraftDefinitionShaped::getHash(CraftHashType type) const
 	assert((type == CRAFT_HASH_TYPE_ITEM_NAMES)
 		|| (type == CRAFT_HASH_TYPE_COUNT)); // Pre-condition
 
-	std::vector<std::string> rec_names = recipe_names;
-	std::sort(rec_names.begin(), rec_names.end());
+	std::vector<ItemName> rec_names = recipe_names;
+	std::sort(rec_names.begin(), rec_names.end(), compareItemNames);
 	return getHashForGrid(type, rec_names);
 }
 
@@ -449,6 +555,17 @@ void CraftDefinitionShaped::initHash(IGameDef *gamedef)
 		hash_type = CRAFT_HASH_TYPE_ITEM_NAMES;
 }
 
+std::vector<ItemName> CraftDefinitionShaped::getRecipeNames() const
+{
+	assert(hash_inited); // Pre-condition
+	std::vector<ItemName> names;
+	for (ItemName name : recipe_names) {
+		if (!name.empty())
+			names.push_back(name);
+	}
+	return names;
+}
+
 std::string CraftDefinitionShaped::dump() const
 {
 	std::ostringstream os(std::ios::binary);
@@ -592,7 +709,7 @@ bool CraftDefinitionShapeless::check(const CraftInput &input, IGameDef *gamedef)
 		return false;
 
 	// Filter empty items out of input
-	std::vector<std::string> input_filtered;
+	std::vector<ItemName> input_filtered;
 	for (const auto &item : input.items) {
 		if (!item.name.empty())
 			input_filtered.push_back(item.name);
@@ -607,31 +724,31 @@ bool CraftDefinitionShapeless::check(const CraftInput &input, IGameDef *gamedef)
 	}
 
 	// Sort input and recipe
-	std::sort(input_filtered.begin(), input_filtered.end());
+	std::sort(input_filtered.begin(), input_filtered.end(), compareItemNames);
 
-	std::vector<std::string> recipe_copy;
+	std::vector<ItemName> recipe_copy;
 	if (hash_inited) {
 		recipe_copy = recipe_names;
 	} else {
 		recipe_copy = craftGetItemNames(recipe, gamedef);
-		std::sort(recipe_copy.begin(), recipe_copy.end());
+		std::sort(recipe_copy.begin(), recipe_copy.end(), compareItemNames);
 	}
 
 	// Split recipe in group and non-group
-	std::vector<std::string> recipe_nogroup;
-	std::vector<std::string> recipe_onlygroup;
+	std::vector<ItemName> recipe_nogroup;
+	std::vector<ItemName> recipe_onlygroup;
 	std::partition_copy(recipe_copy.begin(), recipe_copy.end(),
 			std::back_inserter(recipe_onlygroup),
 			std::back_inserter(recipe_nogroup),
-			[](const std::string &name) { return str_starts_with(name, "group:"); });
+			[](ItemName name) { return isGroupRecipeStr(name); });
 
 	// Filter out non-group recipe slots, using sorted merge.
 	// (This prefiltering is only a performance optimization and not strictly
 	// necessary.)
-	std::vector<std::string> input_for_group;
+	std::vector<ItemName> input_for_group;
 	std::set_difference(input_filtered.begin(), input_filtered.end(),
 			recipe_nogroup.begin(), recipe_nogroup.end(),
-			std::back_inserter(input_for_group));
+			std::back_inserter(input_for_group), compareItemNames);
 
 	// All non-group slots must be satisfied
 	if (input_filtered.size() - input_for_group.size() != recipe_nogroup.size())
@@ -654,7 +771,7 @@ bool CraftDefinitionShapeless::check(const CraftInput &input, IGameDef *gamedef)
 		std::vector<u16> &neighbors_i = bip_graph[i];
 		for (u16 j = 0; j < graph_size; ++j) {
 			if (inputItemMatchesRecipe(input_for_group[i], recipe_onlygroup[j],
-					gamedef->idef()))
+					gamedef->idef(), group_table))
 				neighbors_i.push_back(j);
 		}
 	}
@@ -676,7 +793,8 @@ CraftInput CraftDefinitionShapeless::getInput(const CraftOutput &output, IGameDe
 void CraftDefinitionShapeless::decrementInput(CraftInput &input, std::vector<ItemStack> &output_replacements,
 	IGameDef *gamedef) const
 {
-	craftDecrementOrReplaceInput(input, output_replacements, replacements, gamedef);
+	craftDecrementOrReplaceInput(input, output_replacements, replacements, gamedef,
+			group_table);
 }
 
 u64 CraftDefinitionShapeless::getHash(CraftHashType type) const
@@ -693,7 +811,7 @@ void CraftDefinitionShapeless::initHash(IGameDef *gamedef)
 		return;
 	hash_inited = true;
 	recipe_names = craftGetItemNames(recipe, gamedef);
-	std::sort(recipe_names.begin(), recipe_names.end());
+	std::sort(recipe_names.begin(), recipe_names.end(), compareItemNames);
 
 	if (hasGroupItem(recipe_names))
 		hash_type = CRAFT_HASH_TYPE_COUNT;
@@ -701,6 +819,17 @@ void CraftDefinitionShapeless::initHash(IGameDef *gamedef)
 		hash_type = CRAFT_HASH_TYPE_ITEM_NAMES;
 }
 
+std::vector<ItemName> CraftDefinitionShapeless::getRecipeNames() const
+{
+	assert(hash_inited); // Pre-condition
+	std::vector<ItemName> names;
+	for (ItemName name : recipe_names) {
+		if (!name.empty())
+			names.push_back(name);
+	}
+	return names;
+}
+
 std::string CraftDefinitionShapeless::dump() const
 {
 	std::ostringstream os(std::ios::binary);
@@ -838,11 +967,10 @@ bool CraftDefinitionCooking::check(const CraftInput &input, IGameDef *gamedef) c
 		return false;
 
 	// Filter empty items out of input
-	std::vector<std::string> input_filtered;
+	std::vector<ItemName> input_filtered;
 	for (const auto &item : input.items) {
-		const std::string &name = item.name;
-		if (!name.empty())
-			input_filtered.push_back(name);
+		if (!item.name.empty())
+			input_filtered.push_back(item.name);
 	}
 
 	// If there is a wrong number of items in input, no match
@@ -854,8 +982,9 @@ bool CraftDefinitionCooking::check(const CraftInput &input, IGameDef *gamedef) c
 	}
 
 	// Check the single input item
-	std::string rec_name = craftGetItemName(recipe, gamedef);
-	return inputItemMatchesRecipe(input_filtered[0], rec_name, gamedef->idef());
+	ItemName rec_name = hash_inited ? recipe_name : craftGetItemName(recipe, gamedef);
+	return inputItemMatchesRecipe(input_filtered[0], rec_name, gamedef->idef(),
+			group_table);
 }
 
 CraftOutput CraftDefinitionCooking::getOutput(const CraftInput &input, IGameDef *gamedef) const
@@ -873,13 +1002,15 @@ CraftInput CraftDefinitionCooking::getInput(const CraftOutput &output, IGameDef
 void CraftDefinitionCooking::decrementInput(CraftInput &input, std::vector<ItemStack> &output_replacements,
 	IGameDef *gamedef) const
 {
-	craftDecrementOrReplaceInput(input, output_replacements, replacements, gamedef);
+	craftDecrementOrReplaceInput(input, output_replacements, replacements, gamedef,
+			group_table);
 }
 
 u64 CraftDefinitionCooking::getHash(CraftHashType type) const
 {
 	if (type == CRAFT_HASH_TYPE_ITEM_NAMES) {
-		return getHashForString(recipe_name);
+		u32 id = recipe_name.getId();
+		return getHashForIds(&id, 1);
 	}
 
 	if (type == CRAFT_HASH_TYPE_COUNT) {
@@ -904,6 +1035,12 @@ void CraftDefinitionCooking::initHash(IGameDef *gamedef)
 		hash_type = CRAFT_HASH_TYPE_ITEM_NAMES;
 }
 
+std::vector<ItemName> CraftDefinitionCooking::getRecipeNames() const
+{
+	assert(hash_inited); // Pre-condition
+	return {recipe_name};
+}
+
 std::string CraftDefinitionCooking::dump() const
 {
 	std::ostringstream os(std::ios::binary);
@@ -941,11 +1078,10 @@ bool CraftDefinitionFuel::check(const CraftInput &input, IGameDef *gamedef) cons
 		return false;
 
 	// Filter empty items out of input
-	std::vector<std::string> input_filtered;
+	std::vector<ItemName> input_filtered;
 	for (const auto &item : input.items) {
-		const std::string &name = item.name;
-		if (!name.empty())
-			input_filtered.push_back(name);
+		if (!item.name.empty())
+			input_filtered.push_back(item.name);
 	}
 
 	// If there is a wrong number of items in input, no match
@@ -957,8 +1093,9 @@ bool CraftDefinitionFuel::check(const CraftInput &input, IGameDef *gamedef) cons
 	}
 
 	// Check the single input item
-	std::string rec_name = craftGetItemName(recipe, gamedef);
-	return inputItemMatchesRecipe(input_filtered[0], rec_name, gamedef->idef());
+	ItemName rec_name = hash_inited ? recipe_name : craftGetItemName(recipe, gamedef);
+	return inputItemMatchesRecipe(input_filtered[0], rec_name, gamedef->idef(),
+			group_table);
 }
 
 CraftOutput CraftDefinitionFuel::getOutput(const CraftInput &input, IGameDef *gamedef) const
@@ -976,13 +1113,15 @@ CraftInput CraftDefinitionFuel::getInput(const CraftOutput &output, IGameDef *ga
 void CraftDefinitionFuel::decrementInput(CraftInput &input, std::vector<ItemStack> &output_replacements,
 	IGameDef *gamedef) const
 {
-	craftDecrementOrReplaceInput(input, output_replacements, replacements, gamedef);
+	craftDecrementOrReplaceInput(input, output_replacements, replacements, gamedef,
+			group_table);
 }
 
 u64 CraftDefinitionFuel::getHash(CraftHashType type) const
 {
 	if (type == CRAFT_HASH_TYPE_ITEM_NAMES) {
-		return getHashForString(recipe_name);
+		u32 id = recipe_name.getId();
+		return getHashForIds(&id, 1);
 	}
 
 	if (type == CRAFT_HASH_TYPE_COUNT) {
@@ -1007,6 +1146,12 @@ void CraftDefinitionFuel::initHash(IGameDef *gamedef)
 		hash_type = CRAFT_HASH_TYPE_ITEM_NAMES;
 }
 
+std::vector<ItemName> CraftDefinitionFuel::getRecipeNames() const
+{
+	assert(hash_inited); // Pre-condition
+	return {recipe_name};
+}
+
 std::string CraftDefinitionFuel::dump() const
 {
 	std::ostringstream os(std::ios::binary);
@@ -1040,60 +1185,34 @@ class CCraftDefManager: public IWritableCraftDefManager
 		if (input.empty())
 			return false;
 
-		std::vector<std::string> input_names;
-		input_names = craftGetItemNames(input.items, gamedef);
-		std::sort(input_names.begin(), input_names.end());
-
-		// Try hash types with increasing collision rate
-		// while remembering the latest, highest priority recipe.
-		CraftDefinition::RecipePriority priority_best =
-			CraftDefinition::PRIORITY_NO_RECIPE;
-		CraftDefinition *def_best = nullptr;
-		for (int type = 0; type <= craft_hash_type_max; type++) {
-			u64 hash = getHashForGrid((CraftHashType) type, input_names);
+		IndexedRecipe best = findIndexedRecipe(input, gamedef);
 
-			/*errorstream << "Checking type " << type << " with hash " << hash << std::endl;*/
-
-			// We'd like to do "const [...] hash_collisions = m_craft_defs[type][hash];"
-			// but that doesn't compile for some reason. This does.
-			auto col_iter = (m_craft_defs[type]).find(hash);
-
-			if (col_iter == (m_craft_defs[type]).end())
-				continue;
-
-			const std::vector<CraftDefinition*> &hash_collisions = col_iter->second;
-			// Walk crafting definitions from back to front, so that later
-			// definitions can override earlier ones.
-			for (std::vector<CraftDefinition*>::size_type
-					i = hash_collisions.size(); i > 0; i--) {
-				CraftDefinition *def = hash_collisions[i - 1];
-
-				/*errorstream << "Checking " << input.dump() << std::endl
-					<< " against " << def->dump() << std::endl;*/
-
-				CraftDefinition::RecipePriority priority = def->getPriority();
-				if (priority > priority_best
-						&& def->check(input, gamedef)) {
-					// Check if the crafted node/item exists
-					CraftOutput out = def->getOutput(input, gamedef);
-					ItemStack is;
-					is.deSerialize(out.item, gamedef->idef());
-					if (!is.isKnown(gamedef->idef())) {
-						infostream << "trying to craft non-existent "
-							<< out.item << ", ignoring recipe" << std::endl;
-						continue;
-					}
-
-					output = out;
-					priority_best = priority;
-					def_best = def;
-				}
+		// Recipes that are not in the index depend on more than the item
+		// names or were registered late, they are always checked
+		u64 count = 0;
+		for (const auto &item : input.items) {
+			if (!item.name.empty())
+				count++;
+		}
+		auto it = m_unindexed.find(count);
+		if (it != m_unindexed.end()) {
+			for (const IndexedRecipe &candidate : it->second)
+				tryRecipe(candidate, input, gamedef, best);
+		}
+		const auto &unhashed = m_craft_defs[(int) CRAFT_HASH_TYPE_UNHASHED].find(0);
+		if (unhashed != m_craft_defs[(int) CRAFT_HASH_TYPE_UNHASHED].end()) {
+			const std::vector<CraftDefinition *> &defs = unhashed->second;
+			for (size_t i = 0; i < defs.size(); i++) {
+				tryRecipe({defs[i], getOrder(CRAFT_HASH_TYPE_UNHASHED, i)},
+						input, gamedef, best);
 			}
 		}
-		if (priority_best == CraftDefinition::PRIORITY_NO_RECIPE)
+
+		if (!best.def)
 			return false;
+		output = best.def->getOutput(input, gamedef);
 		if (decrementInput)
-			def_best->decrementInput(input, output_replacement, gamedef);
+			best.def->decrementInput(input, output_replacement, gamedef);
 		return true;
 	}
 
@@ -1214,6 +1333,8 @@ class CCraftDefManager: public IWritableCraftDefManager
 			m_craft_defs[type].clear();
 		}
 		m_output_craft_definitions.clear();
+		clearIndex();
+		m_next_seq = 0;
 	}
 	virtual void initHashes(IGameDef *gamedef)
 	{
@@ -1228,14 +1349,231 @@ class CCraftDefManager: public IWritableCraftDefManager
 
 			// Enter the definition
 			m_craft_defs[type][hash].push_back(def);
+			m_seqs[def] = m_next_seq++;
 		}
 		unhashed.clear();
+
+		buildIndex(gamedef);
 	}
 private:
+	/*
+		A recipe together with its place in the search order. Of the
+		recipes with the highest priority, the one that comes first is used:
+		recipes without groups before those with groups, then later
+		registered before earlier registered ones.
+	*/
+	struct IndexedRecipe
+	{
+		CraftDefinition *def = nullptr;
+		u64 order = 0;
+	};
+
+	static u64 getOrder(CraftHashType type, u32 seq)
+	{
+		return ((u64)type << 32) | (U32_MAX - seq);
+	}
+
+	// Replaces best with candidate if it is preferred and applies to the input
+	static void tryRecipe(const IndexedRecipe &candidate, const CraftInput &input,
+			IGameDef *gamedef, IndexedRecipe &best)
+	{
+		CraftDefinition::RecipePriority priority = candidate.def->getPriority();
+		if (best.def) {
+			CraftDefinition::RecipePriority priority_best = best.def->getPriority();
+			if (priority < priority_best ||
+					(priority == priority_best && candidate.order >= best.order))
+				return;
+		}
+
+		if (!candidate.def->check(input, gamedef))
+			return;
+
+		// Check if the crafted node/item exists
+		CraftOutput out = candidate.def->getOutput(input, gamedef);
+		ItemStack is;
+		is.deSerialize(out.item, gamedef->idef());
+		if (!is.isKnown(gamedef->idef())) {
+			infostream << "trying to craft non-existent "
+				<< out.item << ", ignoring recipe" << std::endl;
+			return;
+		}
+
+		best = candidate;
+	}
+
+	static u64 getGroupIndexKey(u64 count, const ItemName &anchor)
+	{
+		return (count << 32) | anchor.getId();
+	}
+
+	void clearIndex()
+	{
+		m_name_index.clear();
+		m_group_index.clear();
+		m_unindexed.clear();
+		m_group_table.clear();
+		m_seqs.clear();
+		MutexAutoLock lock(m_cache_mutex);
+		m_result_cache.clear();
+	}
+
+	void buildIndex(IGameDef *gamedef)
+	{
+		m_name_index.clear();
+		m_group_index.clear();
+		m_unindexed.clear();
+
+		std::vector<ItemName> group_names;
+		for (CraftHashType type : {CRAFT_HASH_TYPE_ITEM_NAMES, CRAFT_HASH_TYPE_COUNT}) {
+			for (const auto &it : m_craft_defs[type]) {
+				for (CraftDefinition *def : it.second) {
+					IndexedRecipe recipe{def, getOrder(type, m_seqs[def])};
+					std::vector<ItemName> names = def->getRecipeNames();
+
+					if (type == CRAFT_HASH_TYPE_ITEM_NAMES) {
+						m_name_index[it.first].push_back(recipe);
+						continue;
+					}
+					if (names.empty()) {
+						m_unindexed[it.first].push_back(recipe);
+						continue;
+					}
+
+					// Recipes with groups are found through one of their
+					// items: a plain item if there is any (which must be in
+					// the input), otherwise a group.
+					std::vector<ItemName> plain_names;
+					for (ItemName name : names) {
+						if (isGroupRecipeStr(name))
+							group_names.push_back(name);
+						else
+							plain_names.push_back(name);
+					}
+					const std::vector<ItemName> &anchors =
+							plain_names.empty() ? names : plain_names;
+					ItemName anchor = *std::min_element(anchors.begin(),
+							anchors.end(), compareItemNames);
+					m_group_index[getGroupIndexKey(it.first, anchor)].push_back(recipe);
+				}
+			}
+		}
+
+		m_group_table.build(group_names, gamedef->idef());
+		for (int type = 0; type <= craft_hash_type_max; ++type) {
+			for (const auto &it : m_craft_defs[type]) {
+				for (CraftDefinition *def : it.second)
+					def->setGroupTable(&m_group_table);
+			}
+		}
+
+		MutexAutoLock lock(m_cache_mutex);
+		m_result_cache.clear();
+	}
+
+	// Finds the best recipe in the index, using the result cache
+	IndexedRecipe findIndexedRecipe(const CraftInput &input, IGameDef *gamedef) const
+	{
+		if (m_name_index.empty() && m_group_index.empty())
+			return {};
+
+		// Only the names are looked at, so they make up the cache key.
+		// Names that are not interned have no id of their own, inputs with
+		// such items are not cached.
+		ResultCacheKey key;
+		key.method = input.method;
+		key.width = input.width;
+		key.ids.reserve(input.items.size());
+		bool cacheable = true;
+		for (const auto &item : input.items) {
+			key.ids.push_back(item.name.getId());
+			cacheable &= item.name.isInterned();
+		}
+		if (cacheable) {
+			MutexAutoLock lock(m_cache_mutex);
+			auto it = m_result_cache.find(key);
+			if (it != m_result_cache.end())
+				return it->second;
+		}
+
+		std::vector<ItemName> input_names = craftGetItemNames(input.items, gamedef);
+		std::sort(input_names.begin(), input_names.end(), compareItemNames);
+
+		IndexedRecipe best;
+		auto try_all = [&] (const auto &index, u64 key) {
+			auto it = index.find(key);
+			if (it == index.end())
+				return;
+			for (const IndexedRecipe &candidate : it->second)
+				tryRecipe(candidate, input, gamedef, best);
+		};
+
+		try_all(m_name_index, getHashForGrid(CRAFT_HASH_TYPE_ITEM_NAMES, input_names));
+
+		u64 count = getHashForGrid(CRAFT_HASH_TYPE_COUNT, input_names);
+		for (size_t i = 0; i < input_names.size(); i++) {
+			ItemName name = input_names[i];
+			if (name.empty() || (i > 0 && name == input_names[i - 1]))
+				continue;
+			try_all(m_group_index, getGroupIndexKey(count, name));
+			for (ItemName group_name : m_group_table.getGroupsOf(name))
+				try_all(m_group_index, getGroupIndexKey(count, group_name));
+		}
+
+		if (!cacheable)
+			return best;
+		MutexAutoLock lock(m_cache_mutex);
+		if (m_result_cache.size() >= RESULT_CACHE_SIZE)
+			m_result_cache.clear();
+		m_result_cache.emplace(std::move(key), best);
+		return best;
+	}
+
+	struct ResultCacheKey
+	{
+		CraftMethod method;
+		unsigned int width;
+		std::vector<u32> ids;
+
+		bool operator==(const ResultCacheKey &other) const
+		{
+			return method == other.method && width == other.width &&
+					ids == other.ids;
+		}
+	};
+
+	struct ResultCacheKeyHash
+	{
+		size_t operator()(const ResultCacheKey &key) const
+		{
+			return murmur_hash_64_ua(key.ids.data(), key.ids.size() * sizeof(u32),
+					key.method | (key.width << 8));
+		}
+	};
+
+	// Crafting grids of autocrafters tend to repeat, but there is no
+	// bound on the different grids, so the cache starts over when full
+	static constexpr size_t RESULT_CACHE_SIZE = 4096;
+
 	std::vector<std::unordered_map<u64, std::vector<CraftDefinition*> > >
 		m_craft_defs;
 	std::unordered_map<std::string, std::vector<CraftDefinition*> >
 		m_output_craft_definitions;
+
+	// Registration order of the hashed definitions
+	std::unordered_map<const CraftDefinition *, u32> m_seqs;
+	u32 m_next_seq = 0;
+
+	// Recipes without groups, by the hash of their sorted item names
+	std::unordered_map<u64, std::vector<IndexedRecipe>> m_name_index;
+	// Recipes with groups, by item count and anchor item (see buildIndex)
+	std::unordered_map<u64, std::vector<IndexedRecipe>> m_group_index;
+	// Other hashed recipes (tool repair), by item count
+	std::unordered_map<u64, std::vector<IndexedRecipe>> m_unindexed;
+	CraftGroupTable m_group_table;
+
+	mutable std::mutex m_cache_mutex;
+	mutable std::unordered_map<ResultCacheKey, IndexedRecipe, ResultCacheKeyHash>
+		m_result_cache;
 };
 
 IWritableCraftDefManager* createCraftDefManager()
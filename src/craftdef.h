@@ -6,6 +6,9 @@
 
 #include <string>
 #include <iostream>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <utility>
 #include "gamedef.h"
@@ -111,6 +114,30 @@ struct CraftReplacements
 	std::string dump() const;
 };
 
+/*
+	Expansion of the "group:..." recipe items to the items that satisfy them,
+	so that matching an item against a group does not need to parse the
+	group list or look at the item definition.
+	Built after all items and recipes are registered.
+*/
+class CraftGroupTable
+{
+public:
+	void build(const std::vector<ItemName> &group_names, IItemDefManager *idef);
+	void clear();
+
+	// Whether the item satisfies the group recipe item, or nothing if
+	// the group recipe item is not in the table
+	std::optional<bool> matches(const ItemName &item, const ItemName &group_name) const;
+
+	// Group recipe items that the item satisfies
+	const std::vector<ItemName> &getGroupsOf(const ItemName &item) const;
+
+private:
+	std::unordered_map<ItemName, std::unordered_set<ItemName>> m_items_by_group;
+	std::unordered_map<ItemName, std::vector<ItemName>> m_groups_by_item;
+};
+
 /*
 	Crafting definition base class
 */
@@ -164,11 +191,22 @@ class CraftDefinition
 	// to be called after all mods are loaded, so that we catch all aliases
 	virtual void initHash(IGameDef *gamedef) = 0;
 
+	// Names of the non-empty recipe items, only valid after initHash.
+	// Empty if the recipe does not match by item names.
+	virtual std::vector<ItemName> getRecipeNames() const { return {}; }
+
+	// The table must outlive the definition
+	void setGroupTable(const CraftGroupTable *table)
+	{
+		group_table = table;
+	}
+
 	virtual std::string dump() const=0;
 
 protected:
 	CraftHashType hash_type;
 	RecipePriority priority;
+	const CraftGroupTable *group_table = nullptr;
 };
 
 /*
@@ -200,6 +238,8 @@ class CraftDefinitionShaped: public CraftDefinition
 
 	virtual void initHash(IGameDef *gamedef);
 
+	virtual std::vector<ItemName> getRecipeNames() const;
+
 	virtual std::string dump() const;
 
 private:
@@ -210,7 +250,7 @@ class CraftDefinitionShaped: public CraftDefinition
 	// Recipe matrix (itemstrings)
 	std::vector<std::string> recipe;
 	// Recipe matrix (item names)
-	std::vector<std::string> recipe_names;
+	std::vector<ItemName> recipe_names;
 	// bool indicating if initHash has been called already
 	bool hash_inited = false;
 	// Replacement items for decrementInput()
@@ -244,6 +284,8 @@ class CraftDefinitionShapeless: public CraftDefinition
 
 	virtual void initHash(IGameDef *gamedef);
 
+	virtual std::vector<ItemName> getRecipeNames() const;
+
 	virtual std::string dump() const;
 
 private:
@@ -251,8 +293,8 @@ class CraftDefinitionShapeless: public CraftDefinition
 	std::string output;
 	// Recipe list (itemstrings)
 	std::vector<std::string> recipe;
-	// Recipe list (item names), sorted
-	std::vector<std::string> recipe_names;
+	// Recipe list (item names), sorted by id
+	std::vector<ItemName> recipe_names;
 	// bool indicating if initHash has been called already
 	bool hash_inited = false;
 	// Replacement items for decrementInput()
@@ -325,6 +367,8 @@ class CraftDefinitionCooking: public CraftDefinition
 
 	virtual void initHash(IGameDef *gamedef);
 
+	virtual std::vector<ItemName> getRecipeNames() const;
+
 	virtual std::string dump() const;
 
 private:
@@ -333,7 +377,7 @@ class CraftDefinitionCooking: public CraftDefinition
 	// Recipe itemstring
 	std::string recipe;
 	// Recipe item name
-	std::string recipe_name;
+	ItemName recipe_name;
 	// bool indicating if initHash has been called already
 	bool hash_inited = false;
 	// Time in seconds
@@ -368,13 +412,15 @@ class CraftDefinitionFuel: public CraftDefinition
 
 	virtual void initHash(IGameDef *gamedef);
 
+	virtual std::vector<ItemName> getRecipeNames() const;
+
 	virtual std::string dump() const;
 
 private:
 	// Recipe itemstring
 	std::string recipe;
 	// Recipe item name
-	std::string recipe_name;
+	ItemName recipe_name;
 	// bool indicating if initHash has been called already
 	bool hash_inited = false;
 	// Time in seconds
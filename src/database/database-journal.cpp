@@ -0,0 +1,425 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "database-journal.h"
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "util/serialize.h"
+#include <zlib.h>
+
+/*
+	File format:
+		u8[4] magic "LMSJ"
+		u8 version
+		records, each:
+			u32 size
+			u32 crc32 of the body
+			u8[size] body:
+				u8 type
+				u16 len, u8[len] modname
+				RECORD_REMOVE, RECORD_SET: u32 len, u8[len] key
+				RECORD_SET: u32 len, u8[len] value
+*/
+
+#define JOURNAL_MAGIC "LMSJ"
+#define JOURNAL_VERSION 1
+#define RECORD_HEADER_SIZE 8
+
+enum RecordType : u8 {
+	RECORD_SET = 1,
+	RECORD_REMOVE = 2,
+	RECORD_REMOVE_MOD = 3,
+};
+
+static std::string make_header()
+{
+	std::string header(JOURNAL_MAGIC);
+	header.push_back(JOURNAL_VERSION);
+	return header;
+}
+
+static std::string make_record(RecordType type, std::string_view modname,
+	std::string_view key = {}, std::string_view value = {})
+{
+	std::string body;
+	body.push_back(type);
+	body.append(serializeString16(modname));
+	if (type != RECORD_REMOVE_MOD)
+		body.append(serializeString32(key));
+	if (type == RECORD_SET)
+		body.append(serializeString32(value));
+
+	std::string record(RECORD_HEADER_SIZE, '\0');
+	writeU32((u8 *)&record[0], body.size());
+	writeU32((u8 *)&record[4], crc32(0, (const u8 *)body.data(), body.size()));
+	return record + body;
+}
+
+static u64 set_record_size(const std::string &modname, const std::string &key,
+	const std::string &value)
+{
+	return RECORD_HEADER_SIZE + 1 + 2 + modname.size() + 4 + key.size() + 4 + value.size();
+}
+
+// Reads a string with a length prefix of len_size bytes, false if truncated
+static bool read_string(std::string_view &data, size_t len_size, std::string *out)
+{
+	if (data.size() < len_size)
+		return false;
+	const size_t len = len_size == 2 ? readU16((const u8 *)data.data()) :
+		readU32((const u8 *)data.data());
+	data.remove_prefix(len_size);
+	if (data.size() < len)
+		return false;
+	out->assign(data.substr(0, len));
+	data.remove_prefix(len);
+	return true;
+}
+
+static std::string serialize_entries(
+	const std::unordered_map<std::string, StringMap> &entries)
+{
+	std::string data = make_header();
+	for (const auto &mod : entries) {
+		for (const auto &entry : mod.second)
+			data.append(make_record(RECORD_SET, mod.first, entry.first, entry.second));
+	}
+	return data;
+}
+
+ModStorageDatabaseJournal::ModStorageDatabaseJournal(const std::string &savedir):
+	m_path(savedir + DIR_DELIM + "mod_storage.journal")
+{
+	load();
+	if (!openLog())
+		throw DatabaseException("ModStorageDatabaseJournal: cannot open " + m_path);
+}
+
+ModStorageDatabaseJournal::~ModStorageDatabaseJournal()
+{
+	finishCompaction();
+	writePending();
+}
+
+void ModStorageDatabaseJournal::load()
+{
+	const std::string compacted_path = m_path + ".new";
+	if (fs::PathExists(m_path)) {
+		// Left over by a compaction that did not finish
+		if (fs::PathExists(compacted_path))
+			fs::DeleteSingleFileOrEmptyDirectory(compacted_path);
+	} else if (fs::PathExists(compacted_path)) {
+		// The compaction was finished, but the log not replaced yet
+		if (!fs::Rename(compacted_path, m_path))
+			throw DatabaseException("ModStorageDatabaseJournal: cannot rename "
+				+ compacted_path + " to " + m_path);
+	}
+
+	std::string data;
+	if (!fs::PathExists(m_path))
+		return;
+	if (!fs::ReadFile(m_path, data, true))
+		throw DatabaseException("ModStorageDatabaseJournal: cannot read " + m_path);
+
+	const std::string header = make_header();
+	if (data.size() < header.size() && header.compare(0, data.size(), data) == 0) {
+		// Crashed while creating the file
+		fs::DeleteSingleFileOrEmptyDirectory(m_path);
+		return;
+	}
+	if (data.compare(0, header.size(), header) != 0)
+		throw DatabaseException("ModStorageDatabaseJournal: " + m_path
+			+ " is not a mod storage journal");
+
+	size_t pos = header.size();
+	std::string modname, key, value;
+	while (data.size() - pos >= RECORD_HEADER_SIZE) {
+		const u32 size = readU32((const u8 *)&data[pos]);
+		const u32 checksum = readU32((const u8 *)&data[pos + 4]);
+		if (size > data.size() - pos - RECORD_HEADER_SIZE)
+			break;
+		std::string_view body(&data[pos + RECORD_HEADER_SIZE], size);
+		if (body.empty() || crc32(0, (const u8 *)body.data(), body.size()) != checksum)
+			break;
+
+		const u8 type = body[0];
+		body.remove_prefix(1);
+		if (!read_string(body, 2, &modname))
+			break;
+		if (type == RECORD_SET) {
+			if (!read_string(body, 4, &key) || !read_string(body, 4, &value))
+				break;
+			applySet(modname, key, value);
+		} else if (type == RECORD_REMOVE) {
+			if (!read_string(body, 4, &key))
+				break;
+			applyRemove(modname, key);
+		} else if (type == RECORD_REMOVE_MOD) {
+			applyRemoveMod(modname);
+		} else {
+			break;
+		}
+		pos += RECORD_HEADER_SIZE + size;
+	}
+
+	if (pos < data.size()) {
+		warningstream << "ModStorageDatabaseJournal: Discarding "
+			<< (data.size() - pos) << " bytes of incomplete records at the end of "
+			<< m_path << std::endl;
+		data.resize(pos);
+		if (!fs::safeWriteToFile(m_path, data))
+			throw DatabaseException("ModStorageDatabaseJournal: cannot repair " + m_path);
+	}
+	m_file_size = pos;
+}
+
+bool ModStorageDatabaseJournal::openLog()
+{
+	m_file = open_ofstream(m_path.c_str(), true, std::ios::app);
+	if (!m_file.good())
+		return false;
+	if (m_file_size == 0) {
+		const std::string header = make_header();
+		m_file.write(header.data(), header.size());
+		m_file.flush();
+		m_file_size = header.size();
+	}
+	return m_file.good();
+}
+
+void ModStorageDatabaseJournal::applySet(const std::string &modname,
+	const std::string &key, const std::string &value)
+{
+	StringMap &mod = m_entries[modname];
+	auto it = mod.find(key);
+	if (it != mod.end()) {
+		m_live_size -= set_record_size(modname, key, it->second);
+		it->second = value;
+	} else {
+		mod.emplace(key, value);
+	}
+	m_live_size += set_record_size(modname, key, value);
+}
+
+bool ModStorageDatabaseJournal::applyRemove(const std::string &modname,
+	const std::string &key)
+{
+	auto mod = m_entries.find(modname);
+	if (mod == m_entries.end())
+		return false;
+	auto it = mod->second.find(key);
+	if (it == mod->second.end())
+		return false;
+
+	m_live_size -= set_record_size(modname, key, it->second);
+	mod->second.erase(it);
+	if (mod->second.empty())
+		m_entries.erase(mod);
+	return true;
+}
+
+bool ModStorageDatabaseJournal::applyRemoveMod(const std::string &modname)
+{
+	auto mod = m_entries.find(modname);
+	if (mod == m_entries.end())
+		return false;
+
+	for (const auto &entry : mod->second)
+		m_live_size -= set_record_size(modname, entry.first, entry.second);
+	m_entries.erase(mod);
+	return true;
+}
+
+void ModStorageDatabaseJournal::getModEntries(const std::string &modname, StringMap *storage)
+{
+	auto mod = m_entries.find(modname);
+	if (mod == m_entries.end())
+		return;
+	for (const auto &entry : mod->second)
+		(*storage)[entry.first] = entry.second;
+}
+
+void ModStorageDatabaseJournal::getModKeys(const std::string &modname,
+		std::vector<std::string> *storage)
+{
+	auto mod = m_entries.find(modname);
+	if (mod == m_entries.end())
+		return;
+	storage->reserve(storage->size() + mod->second.size());
+	for (const auto &entry : mod->second)
+		storage->push_back(entry.first);
+}
+
+bool ModStorageDatabaseJournal::getModEntry(const std::string &modname,
+	const std::string &key, std::string *value)
+{
+	auto mod = m_entries.find(modname);
+	if (mod == m_entries.end())
+		return false;
+	auto it = mod->second.find(key);
+	if (it == mod->second.end())
+		return false;
+	*value = it->second;
+	return true;
+}
+
+bool ModStorageDatabaseJournal::hasModEntry(const std::string &modname, const std::string &key)
+{
+	auto mod = m_entries.find(modname);
+	return mod != m_entries.end() && mod->second.count(key) > 0;
+}
+
+bool ModStorageDatabaseJournal::setModEntry(const std::string &modname,
+	const std::string &key, std::string_view value)
+{
+	m_pending.append(make_record(RECORD_SET, modname, key, value));
+	applySet(modname, key, std::string(value));
+	return true;
+}
+
+bool ModStorageDatabaseJournal::removeModEntry(const std::string &modname,
+		const std::string &key)
+{
+	if (!applyRemove(modname, key))
+		return false;
+	m_pending.append(make_record(RECORD_REMOVE, modname, key));
+	return true;
+}
+
+bool ModStorageDatabaseJournal::removeModEntries(const std::string &modname)
+{
+	if (!applyRemoveMod(modname))
+		return false;
+	m_pending.append(make_record(RECORD_REMOVE_MOD, modname));
+	return true;
+}
+
+void ModStorageDatabaseJournal::listMods(std::vector<std::string> *res)
+{
+	for (const auto &mod : m_entries)
+		res->push_back(mod.first);
+}
+
+void ModStorageDatabaseJournal::beginSave()
+{
+}
+
+void ModStorageDatabaseJournal::endSave()
+{
+	if (m_compaction_done)
+		finishCompaction();
+
+	writePending();
+
+	if (!isCompacting() && m_file_size > COMPACT_MIN_SIZE &&
+			m_file_size > 2 * m_live_size)
+		startCompaction();
+}
+
+void ModStorageDatabaseJournal::writePending()
+{
+	if (m_pending.empty())
+		return;
+
+	m_file.write(m_pending.data(), m_pending.size());
+	m_file.flush();
+	if (!m_file.good()) {
+		// Part of the records may have been written, which would make
+		// the following ones unreadable
+		errorstream << "ModStorageDatabaseJournal: Failed to write to "
+			<< m_path << ", rewriting it" << std::endl;
+		rewriteLog();
+		return;
+	}
+
+	m_file_size += m_pending.size();
+	if (isCompacting())
+		m_compaction_tail.append(m_pending);
+	m_pending.clear();
+}
+
+void ModStorageDatabaseJournal::rewriteLog()
+{
+	const std::string data = serialize_entries(m_entries);
+	m_file.close();
+	if (fs::safeWriteToFile(m_path, data)) {
+		m_file_size = data.size();
+		if (isCompacting())
+			m_compaction_tail.append(m_pending);
+		m_pending.clear();
+	} else {
+		errorstream << "ModStorageDatabaseJournal: Failed to rewrite "
+			<< m_path << ", keeping changes in memory" << std::endl;
+	}
+	if (!openLog())
+		errorstream << "ModStorageDatabaseJournal: Cannot open " << m_path << std::endl;
+}
+
+void ModStorageDatabaseJournal::startCompaction()
+{
+	infostream << "ModStorageDatabaseJournal: Compacting " << m_path << " ("
+		<< m_file_size << " bytes, " << m_live_size << " bytes in use)" << std::endl;
+
+	m_compaction_done = false;
+	m_compaction_tail.clear();
+	// The copy is cheap compared to serializing and writing it
+	m_compaction = std::thread([this, entries = m_entries] {
+		const std::string data = serialize_entries(entries);
+		m_compaction_size = data.size();
+		m_compaction_ok = fs::safeWriteToFile(m_path + ".new", data);
+		m_compaction_done = true;
+	});
+}
+
+void ModStorageDatabaseJournal::finishCompaction()
+{
+	if (!m_compaction.joinable())
+		return;
+	m_compaction.join();
+	m_compaction_done = false;
+
+	const std::string compacted_path = m_path + ".new";
+	std::string tail;
+	tail.swap(m_compaction_tail);
+	if (!m_compaction_ok) {
+		errorstream << "ModStorageDatabaseJournal: Failed to write "
+			<< compacted_path << std::endl;
+		fs::DeleteSingleFileOrEmptyDirectory(compacted_path);
+		return;
+	}
+
+	// Add what was written to the log since the compaction started
+	if (!tail.empty()) {
+		auto os = open_ofstream(compacted_path.c_str(), true, std::ios::app);
+		os.write(tail.data(), tail.size());
+		os.flush();
+		if (!os.good()) {
+			errorstream << "ModStorageDatabaseJournal: Failed to write "
+				<< compacted_path << std::endl;
+			os.close();
+			fs::DeleteSingleFileOrEmptyDirectory(compacted_path);
+			return;
+		}
+	}
+
+	m_file.close();
+	// Renaming over an existing file fails on Windows. If we crash in
+	// between, load() picks up the compacted log.
+	if (!fs::Rename(compacted_path, m_path)) {
+		fs::DeleteSingleFileOrEmptyDirectory(m_path);
+		if (!fs::Rename(compacted_path, m_path)) {
+			errorstream << "ModStorageDatabaseJournal: Failed to rename "
+				<< compacted_path << " to " << m_path << std::endl;
+			m_file_size = 0;
+			rewriteLog();
+			return;
+		}
+	}
+
+	infostream << "ModStorageDatabaseJournal: Compacted " << m_path << " from "
+		<< m_file_size << " to " << (m_compaction_size + tail.size()) << " bytes" << std::endl;
+	m_file_size = m_compaction_size + tail.size();
+	if (!openLog())
+		errorstream << "ModStorageDatabaseJournal: Cannot open " << m_path << std::endl;
+}
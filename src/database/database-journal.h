@@ -0,0 +1,87 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "database.h"
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+/*
+	Mod storage in an append-only log of set and remove records.
+
+	All entries are kept in memory. Changes are buffered until endSave(),
+	which appends them to the log in a single write, so saving costs only
+	as much as what changed. When the log grows to more than twice the size
+	of the live entries, a background thread writes a compacted copy which
+	then replaces the log.
+
+	Every record has a checksum. On startup a torn or corrupted tail, as
+	left by a crash during a write, is discarded.
+*/
+class ModStorageDatabaseJournal : public ModStorageDatabase
+{
+public:
+	// @throws DatabaseException if the file is not a mod storage journal
+	ModStorageDatabaseJournal(const std::string &savedir);
+	virtual ~ModStorageDatabaseJournal();
+
+	virtual void getModEntries(const std::string &modname, StringMap *storage);
+	virtual void getModKeys(const std::string &modname, std::vector<std::string> *storage);
+	virtual bool getModEntry(const std::string &modname,
+		const std::string &key, std::string *value);
+	virtual bool hasModEntry(const std::string &modname, const std::string &key);
+	virtual bool setModEntry(const std::string &modname,
+		const std::string &key, std::string_view value);
+	virtual bool removeModEntry(const std::string &modname, const std::string &key);
+	virtual bool removeModEntries(const std::string &modname);
+	virtual void listMods(std::vector<std::string> *res);
+
+	virtual void beginSave();
+	virtual void endSave();
+
+	// Size of the log file in bytes, excluding unsaved changes
+	u64 getFileSize() const { return m_file_size; }
+	// Whether a compaction is running
+	bool isCompacting() const { return m_compaction.joinable(); }
+	// Waits for a running compaction and replaces the log with its result
+	void finishCompaction();
+
+	// Compaction does not start for logs smaller than this
+	static constexpr u64 COMPACT_MIN_SIZE = 1024 * 1024;
+
+private:
+	typedef std::unordered_map<std::string, StringMap> Entries;
+
+	void load();
+	bool openLog();
+	void writePending();
+	// Replaces the log with the current entries
+	void rewriteLog();
+	void startCompaction();
+
+	void applySet(const std::string &modname, const std::string &key,
+		const std::string &value);
+	bool applyRemove(const std::string &modname, const std::string &key);
+	bool applyRemoveMod(const std::string &modname);
+
+	std::string m_path;
+	std::ofstream m_file;
+
+	Entries m_entries;
+	// Records not written yet
+	std::string m_pending;
+
+	u64 m_file_size = 0;
+	// Size of the set records of all entries, i.e. a compacted log
+	u64 m_live_size = 0;
+
+	std::thread m_compaction;
+	std::atomic<bool> m_compaction_done{false};
+	bool m_compaction_ok = false;
+	u64 m_compaction_size = 0;
+	// Records appended while the compaction is running
+	std::string m_compaction_tail;
+};
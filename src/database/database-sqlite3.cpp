@@ -347,6 +347,116 @@ void MapDatabaseSQLite3::listAllLoadableBlocks(std::vector<v3s16> &dst)
 	sqlite3_reset(m_stmt_list);
 }
 
+/*
+ * Block cache database
+ */
+
+BlockCacheDatabaseSQLite3::BlockCacheDatabaseSQLite3(const std::string &savedir):
+	Database_SQLite3(savedir, "block_cache")
+{
+}
+
+BlockCacheDatabaseSQLite3::~BlockCacheDatabaseSQLite3()
+{
+	FINALIZE_STATEMENT(read)
+	FINALIZE_STATEMENT(write)
+	FINALIZE_STATEMENT(list)
+	FINALIZE_STATEMENT(delete)
+}
+
+void BlockCacheDatabaseSQLite3::createDatabase()
+{
+	assert(m_database);
+
+	// The hash comes before the data, so listing the hashes does not need
+	// to read the overflow pages of the data
+	const char *schema =
+		"CREATE TABLE IF NOT EXISTS `blocks` (\n"
+			"`x` INTEGER,"
+			"`y` INTEGER,"
+			"`z` INTEGER,"
+			"`hash` INTEGER NOT NULL,"
+			"`data` BLOB NOT NULL,"
+			"PRIMARY KEY (`x`, `z`, `y`)"
+		");\n"
+	;
+	SQLOK(sqlite3_exec(m_database, schema, NULL, NULL, NULL),
+		"Failed to create database table");
+}
+
+void BlockCacheDatabaseSQLite3::initStatements()
+{
+	PREPARE_STATEMENT(read, "SELECT `data` FROM `blocks` WHERE `x` = ? AND `y` = ? AND `z` = ? LIMIT 1");
+	PREPARE_STATEMENT(write, "REPLACE INTO `blocks` (`x`, `y`, `z`, `hash`, `data`) VALUES (?, ?, ?, ?, ?)");
+	PREPARE_STATEMENT(delete, "DELETE FROM `blocks` WHERE `x` = ? AND `y` = ? AND `z` = ?");
+	PREPARE_STATEMENT(list, "SELECT `x`, `y`, `z`, `hash` FROM `blocks`");
+}
+
+inline int BlockCacheDatabaseSQLite3::bindPos(sqlite3_stmt *stmt, v3s16 pos, int index)
+{
+	int_to_sqlite(stmt, index, pos.X);
+	int_to_sqlite(stmt, index + 1, pos.Y);
+	int_to_sqlite(stmt, index + 2, pos.Z);
+	return index + 3;
+}
+
+bool BlockCacheDatabaseSQLite3::saveBlock(v3s16 pos, u64 hash, std::string_view data)
+{
+	verifyDatabase();
+
+	int col = bindPos(m_stmt_write, pos);
+	int64_to_sqlite(m_stmt_write, col, hash);
+	blob_to_sqlite(m_stmt_write, col + 1, data);
+
+	SQLRES(sqlite3_step(m_stmt_write), SQLITE_DONE, "Failed to save block")
+	sqlite3_reset(m_stmt_write);
+
+	return true;
+}
+
+void BlockCacheDatabaseSQLite3::loadBlock(v3s16 pos, std::string *data)
+{
+	verifyDatabase();
+
+	bindPos(m_stmt_read, pos);
+
+	if (sqlite3_step(m_stmt_read) != SQLITE_ROW)
+		data->clear();
+	else
+		data->assign(sqlite_to_blob(m_stmt_read, 0));
+
+	sqlite3_reset(m_stmt_read);
+}
+
+bool BlockCacheDatabaseSQLite3::deleteBlock(v3s16 pos)
+{
+	verifyDatabase();
+
+	bindPos(m_stmt_delete, pos);
+
+	bool good = sqlite3_step(m_stmt_delete) == SQLITE_DONE;
+	sqlite3_reset(m_stmt_delete);
+
+	if (!good) {
+		warningstream << "BlockCacheDatabaseSQLite3: Failed to delete block "
+			<< pos << ": " << sqlite3_errmsg(m_database) << std::endl;
+	}
+	return good;
+}
+
+void BlockCacheDatabaseSQLite3::listHashes(std::unordered_map<v3s16, u64> &dst)
+{
+	verifyDatabase();
+
+	while (sqlite3_step(m_stmt_list) == SQLITE_ROW) {
+		v3s16 p(sqlite_to_int(m_stmt_list, 0), sqlite_to_int(m_stmt_list, 1),
+			sqlite_to_int(m_stmt_list, 2));
+		dst[p] = sqlite_to_uint64(m_stmt_list, 3);
+	}
+
+	sqlite3_reset(m_stmt_list);
+}
+
 /*
  * Player Database
  */
@@ -6,6 +6,7 @@
 
 #include <cstring>
 #include <string>
+#include <unordered_map>
 #include "database.h"
 #include "exceptions.h"
 
@@ -196,6 +197,37 @@ class MapDatabaseSQLite3 : private Database_SQLite3, public MapDatabase
 	sqlite3_stmt *m_stmt_delete = nullptr;
 };
 
+/*
+	Client-side cache of map blocks received from a server. Every block is
+	stored with its content hash, so that the hashes can be listed without
+	reading the blocks.
+*/
+class BlockCacheDatabaseSQLite3 : private Database_SQLite3
+{
+public:
+	BlockCacheDatabaseSQLite3(const std::string &savedir);
+	virtual ~BlockCacheDatabaseSQLite3();
+
+	bool saveBlock(v3s16 pos, u64 hash, std::string_view data);
+	void loadBlock(v3s16 pos, std::string *data);
+	bool deleteBlock(v3s16 pos);
+	void listHashes(std::unordered_map<v3s16, u64> &dst);
+
+	PARENT_CLASS_FUNCS
+
+protected:
+	virtual void createDatabase();
+	virtual void initStatements();
+
+private:
+	int bindPos(sqlite3_stmt *stmt, v3s16 pos, int index = 1);
+
+	sqlite3_stmt *m_stmt_read = nullptr;
+	sqlite3_stmt *m_stmt_write = nullptr;
+	sqlite3_stmt *m_stmt_list = nullptr;
+	sqlite3_stmt *m_stmt_delete = nullptr;
+};
+
 class PlayerDatabaseSQLite3 : private Database_SQLite3, public PlayerDatabase
 {
 public:
@@ -6,6 +6,7 @@
 #include "porting.h"
 #include "debug.h"
 #include "exceptions.h"
+#include "log_internal.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -42,6 +43,7 @@ void sanity_check_fn(const char *assertion, const char *file,
 		<< std::this_thread::get_id() << ":\n" << std::dec;
 	errorstream << file << ":" << line << ": " << function
 		<< ": An engine assumption '" << assertion << "' failed." << std::endl;
+	g_logger.flush();
 
 	abort();
 }
@@ -57,6 +59,7 @@ void fatal_error_fn(const char *msg, const char *file,
 		<< std::this_thread::get_id() << ":\n" << std::dec;
 	errorstream << file << ":" << line << ": " << function
 		<< ": A fatal error occurred: " << msg << std::endl;
+	g_logger.flush();
 
 	abort();
 }
@@ -16,7 +16,7 @@ class DummyMap : public Map
 		for (s16 x = bpmin.X; x <= bpmax.X; x++) {
 			v2s16 p2d(x, z);
 			MapSector *sector = new MapSector(this, p2d, gamedef);
-			m_sectors[p2d] = sector;
+			addSector(sector);
 			for (s16 y = bpmin.Y; y <= bpmax.Y; y++)
 				sector->createBlankBlock(y);
 		}
@@ -31,9 +31,9 @@ class DummyMap : public Map
 		for (s16 x = bpmin.X; x <= bpmax.X; x++) {
 			MapBlock *block = getBlockNoCreateNoEx({x, y, z});
 			if (block) {
-				for (size_t i = 0; i < MapBlock::nodecount; i++)
-					block->getData()[i] = n;
+				block->fillData(n);
 				block->expireIsAirCache();
+				block->expireContentMask();
 			}
 		}
 	}
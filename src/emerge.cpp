@@ -9,6 +9,7 @@
 #include <iostream>
 
 #include "util/container.h"
+#include "util/trace.h"
 #include "config.h"
 #include "constants.h"
 #include "environment.h"
@@ -23,6 +24,7 @@
 #include "mapgen/mg_decoration.h"
 #include "mapgen/mg_schematic.h"
 #include "nodedef.h"
+#include "porting.h"
 #include "profiler.h"
 #include "scripting_server.h"
 #include "scripting_emerge.h"
@@ -88,6 +90,17 @@ EmergeManager::EmergeManager(Server *server, MetricsBackend *mb)
 			{{"status", emergeActionStrs[i]}}
 		);
 	}
+	m_queue_size_gauge = mb->addGauge(
+		"minetest_emerge_queue_size", "Number of blocks waiting to be emerged");
+	m_on_generated_mapgen_counter = mb->addCounter(
+		"minetest_emerge_on_generated_time",
+		"Time spent in Lua on_generated callbacks [us]", {{"env", "mapgen"}});
+	m_on_generated_server_counter = mb->addCounter(
+		"minetest_emerge_on_generated_time",
+		"Time spent in Lua on_generated callbacks [us]", {{"env", "server"}});
+	m_finish_gen_counter = mb->addCounter(
+		"minetest_emerge_finish_gen_time",
+		"Time the environment lock is held to finish generated chunks [us]");
 
 	s16 nthreads = 1;
 	g_settings->getS16NoEx("num_emerge_threads", nthreads);
@@ -390,6 +403,8 @@ bool EmergeManager::pushBlockEmergeData(
 		bedata.peer_requested = peer_requested;
 
 		count_peer++;
+		m_queue_size_gauge->set(m_blocks_enqueued.size());
+		g_tracer->counter("Emerge queue", m_blocks_enqueued.size());
 	}
 
 	return true;
@@ -414,6 +429,8 @@ bool EmergeManager::popBlockEmergeData(v3s16 pos, BlockEmergeData *bedata)
 	count_peer--;
 
 	m_blocks_enqueued.erase(it);
+	m_queue_size_gauge->set(m_blocks_enqueued.size());
+	g_tracer->counter("Emerge queue", m_blocks_enqueued.size());
 
 	return true;
 }
@@ -576,6 +593,7 @@ MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	Server::EnvAutoLock envlock(m_server);
 	ScopeProfiler sp(g_profiler,
 		"EmergeThread: after Mapgen::makeChunk", SPT_AVG);
+	const u64 t_start = porting::getTimeUs();
 
 	/*
 		Perform post-processing on blocks (invalidate lighting, queue liquid
@@ -603,12 +621,15 @@ MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	/*
 		Run Lua on_generated callbacks in the server environment
 	*/
+	const u64 t_lua = porting::getTimeUs();
 	try {
 		m_server->getScriptIface()->environment_OnGenerated(
 			minp, maxp, m_mapgen->blockseed);
 	} catch (LuaError &e) {
 		m_server->setAsyncFatalError(e);
 	}
+	m_emerge->m_on_generated_server_counter->increment(
+		porting::getTimeUs() - t_lua);
 
 	EMERGE_DBG_OUT("ended up with: " << analyze_block(block));
 
@@ -624,6 +645,7 @@ MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	*/
 	m_server->m_env->activateBlock(block, 0);
 
+	m_emerge->m_finish_gen_counter->increment(porting::getTimeUs() - t_start);
 	return block;
 }
 
@@ -731,12 +753,15 @@ void *EmergeThread::run()
 				ScopeProfiler sp(g_profiler,
 					"EmergeThread: Lua on_generated", SPT_AVG);
 
+				const u64 t_start = porting::getTimeUs();
 				try {
 					m_script->on_generated(&bmdata, m_mapgen->blockseed);
 				} catch (const LuaError &e) {
 					m_server->setAsyncFatalError(e);
 					error = true;
 				}
+				m_emerge->m_on_generated_mapgen_counter->increment(
+					porting::getTimeUs() - t_start);
 			}
 
 			if (!error)
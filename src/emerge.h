@@ -209,6 +209,13 @@ class EmergeManager {
 
 	// Emerge metrics
 	MetricCounterPtr m_completed_emerge_counter[5];
+	MetricGaugePtr m_queue_size_gauge;
+	// Lua on_generated time in microseconds, in the mapgen environment
+	// (no lock held) and in the server environment (environment locked)
+	MetricCounterPtr m_on_generated_mapgen_counter;
+	MetricCounterPtr m_on_generated_server_counter;
+	// Time the environment lock is held to finish generated chunks
+	MetricCounterPtr m_finish_gen_counter;
 
 	// Managers of various map generation-related components
 	// Note that each Mapgen gets a copy(!) of these to work with
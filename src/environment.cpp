@@ -5,6 +5,7 @@
 #include <fstream>
 #include "environment.h"
 #include "collision.h"
+#include "mapblock.h"
 #include "raycast.h"
 #include "scripting_server.h"
 #include "server.h"
@@ -69,10 +70,26 @@ float Environment::getTimeOfDayF()
 
 bool Environment::line_of_sight(v3f pos1, v3f pos2, v3s16 *p)
 {
+	Map &map = getMap();
+	// Block of the last node, air-only blocks need no node lookups
+	v3s16 last_blockpos(S16_MAX, S16_MAX, S16_MAX);
+	bool last_block_air = false;
+
 	// Iterate trough nodes on the line
 	voxalgo::VoxelLineIterator iterator(pos1 / BS, (pos2 - pos1) / BS);
 	do {
-		MapNode n = getMap().getNode(iterator.m_current_node_pos);
+		v3s16 blockpos = getNodeBlockPos(iterator.m_current_node_pos);
+		if (blockpos != last_blockpos) {
+			MapBlock *block = map.getBlockNoCreateNoEx(blockpos);
+			last_blockpos = blockpos;
+			last_block_air = block && block->isAir();
+		}
+		if (last_block_air) {
+			iterator.next();
+			continue;
+		}
+
+		MapNode n = map.getNode(iterator.m_current_node_pos);
 
 		// Return non-air
 		if (n.param0 != CONTENT_AIR) {
@@ -134,6 +151,29 @@ void Environment::continueRaycast(RaycastState *state, PointedThing *result_p)
 
 	Map &map = getMap();
 	std::vector<aabb3f> boxes;
+
+	// Whole blocks can be skipped if none of their nodes can be pointed at.
+	// With pointabilities this is only known for blocks of air.
+	const bool air_pointable = state->m_pointabilities &&
+			isPointableNode(MapNode(CONTENT_AIR), nodedef, state->m_liquids_pointable,
+				state->m_pointabilities) != PointabilityType::POINTABLE_NOT;
+	v3s16 last_blockpos(S16_MAX, S16_MAX, S16_MAX);
+	MapBlock *last_block = nullptr;
+	auto get_block = [&] (v3s16 blockpos) -> MapBlock * {
+		if (blockpos == last_blockpos)
+			return last_block;
+		last_blockpos = blockpos;
+		last_block = map.getBlockNoCreateNoEx(blockpos);
+		if (last_block) {
+			bool skip = state->m_pointabilities ?
+				!air_pointable && last_block->isAir() :
+				!last_block->mayBePointed(state->m_liquids_pointable);
+			if (skip)
+				last_block = nullptr;
+		}
+		return last_block;
+	};
+
 	while (state->m_iterator.m_current_index <= lastIndex) {
 		// Test the nodes around the current node in search_range.
 		core::aabbox3d<s16> new_nodes = state->m_search_range;
@@ -167,14 +207,16 @@ void Environment::continueRaycast(RaycastState *state, PointedThing *result_p)
 		for (s16 z = new_nodes.MinEdge.Z; z <= new_nodes.MaxEdge.Z; z++)
 		for (s16 y = new_nodes.MinEdge.Y; y <= new_nodes.MaxEdge.Y; y++)
 		for (s16 x = new_nodes.MinEdge.X; x <= new_nodes.MaxEdge.X; x++) {
-			MapNode n;
 			v3s16 np(x, y, z);
-			bool is_valid_position;
+			v3s16 blockpos = getNodeBlockPos(np);
 
-			n = map.getNode(np, &is_valid_position);
-			if (!is_valid_position)
+			// Not loaded or nothing to point at
+			MapBlock *block = get_block(blockpos);
+			if (!block)
 				continue;
 
+			MapNode n = block->getNodeNoCheck(np - blockpos * MAP_BLOCKSIZE);
+
 			PointabilityType pointable = isPointableNode(n, nodedef,
 					state->m_liquids_pointable,
 					state->m_pointabilities);
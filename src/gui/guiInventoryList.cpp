@@ -164,7 +164,7 @@ void GUIInventoryList::draw()
 		if (show_tooltip) {
 			std::string tooltip = orig_item.getDescription(client->idef());
 			if (m_fs_menu->doTooltipAppendItemname())
-				tooltip += "\n[" + orig_item.name + "]";
+				tooltip += "\n[" + orig_item.name.str() + "]";
 			m_fs_menu->addHoveredItemTooltip(tooltip);
 		}
 	}
@@ -30,6 +30,12 @@ static content_t content_translate_from_19_to_internal(content_t c_from)
 
 ItemStack::ItemStack(const std::string &name_, u16 count_,
 		u16 wear_, IItemDefManager *itemdef) :
+	ItemStack(itemdef->getItemName(name_), count_, wear_, itemdef)
+{
+}
+
+ItemStack::ItemStack(const ItemName &name_, u16 count_,
+		u16 wear_, IItemDefManager *itemdef) :
 	name(itemdef->getAlias(name_)),
 	count(count_),
 	wear(wear_)
@@ -54,7 +60,7 @@ void ItemStack::serialize(std::ostream &os, bool serialize_meta) const
 	else if (count != 1)
 		parts = 2;
 
-	os << serializeJsonStringIfNeeded(name);
+	os << serializeJsonStringIfNeeded(name.str());
 	if (parts >= 2)
 		os << " " << count;
 	if (parts >= 3)
@@ -73,7 +79,7 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 	clear();
 
 	// Read name
-	name = deSerializeJsonStringIfNeeded(is);
+	std::string name_str = deSerializeJsonStringIfNeeded(is);
 
 	// Skip space
 	std::string tmp;
@@ -81,7 +87,7 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 	if(!tmp.empty())
 		throw SerializationError("Unexpected text after item name");
 
-	if(name == "MaterialItem")
+	if(name_str == "MaterialItem")
 	{
 		// Obsoleted on 2011-07-30
 
@@ -97,14 +103,14 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 		// Convert old id to name
 		NameIdMapping legacy_nimap;
 		content_mapnode_get_name_id_mapping(&legacy_nimap);
-		legacy_nimap.getName(material, name);
-		if(name.empty())
-			name = "unknown_block";
-		if (itemdef)
-			name = itemdef->getAlias(name);
+		legacy_nimap.getName(material, name_str);
+		if(name_str.empty())
+			name_str = "unknown_block";
+		name = itemdef ? itemdef->getAlias(itemdef->getItemName(name_str)) :
+			ItemName(name_str);
 		count = materialcount;
 	}
-	else if(name == "MaterialItem2")
+	else if(name_str == "MaterialItem2")
 	{
 		// Obsoleted on 2011-11-16
 
@@ -117,15 +123,15 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 		// Convert old id to name
 		NameIdMapping legacy_nimap;
 		content_mapnode_get_name_id_mapping(&legacy_nimap);
-		legacy_nimap.getName(material, name);
-		if(name.empty())
-			name = "unknown_block";
-		if (itemdef)
-			name = itemdef->getAlias(name);
+		legacy_nimap.getName(material, name_str);
+		if(name_str.empty())
+			name_str = "unknown_block";
+		name = itemdef ? itemdef->getAlias(itemdef->getItemName(name_str)) :
+			ItemName(name_str);
 		count = materialcount;
 	}
-	else if(name == "node" || name == "NodeItem" || name == "MaterialItem3"
-			|| name == "craft" || name == "CraftItem")
+	else if(name_str == "node" || name_str == "NodeItem" || name_str == "MaterialItem3"
+			|| name_str == "craft" || name_str == "CraftItem")
 	{
 		// Obsoleted on 2012-01-07
 
@@ -136,24 +142,24 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 		fnd.next("\"");
 		// If didn't skip to end, we have ""s
 		if(!fnd.at_end()){
-			name = fnd.next("\"");
+			name_str = fnd.next("\"");
 		} else { // No luck, just read a word then
 			fnd.start(all);
-			name = fnd.next(" ");
+			name_str = fnd.next(" ");
 		}
 		fnd.skip_over(" ");
-		if (itemdef)
-			name = itemdef->getAlias(name);
+		name = itemdef ? itemdef->getAlias(itemdef->getItemName(name_str)) :
+			ItemName(name_str);
 		count = stoi(trim(fnd.next("")));
 		if(count == 0)
 			count = 1;
 	}
-	else if(name == "MBOItem")
+	else if(name_str == "MBOItem")
 	{
 		// Obsoleted on 2011-10-14
 		throw SerializationError("MBOItem not supported anymore");
 	}
-	else if(name == "tool" || name == "ToolItem")
+	else if(name_str == "tool" || name_str == "ToolItem")
 	{
 		// Obsoleted on 2012-01-07
 
@@ -164,16 +170,16 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 		fnd.next("\"");
 		// If didn't skip to end, we have ""s
 		if(!fnd.at_end()){
-			name = fnd.next("\"");
+			name_str = fnd.next("\"");
 		} else { // No luck, just read a word then
 			fnd.start(all);
-			name = fnd.next(" ");
+			name_str = fnd.next(" ");
 		}
 		count = 1;
 		// Then read wear
 		fnd.skip_over(" ");
-		if (itemdef)
-			name = itemdef->getAlias(name);
+		name = itemdef ? itemdef->getAlias(itemdef->getItemName(name_str)) :
+			ItemName(name_str);
 		wear = stoi(trim(fnd.next("")));
 	}
 	else
@@ -183,8 +189,8 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 			// The real thing
 
 			// Apply item aliases
-			if (itemdef)
-				name = itemdef->getAlias(name);
+			name = itemdef ? itemdef->getAlias(itemdef->getItemName(name_str)) :
+				ItemName(name_str);
 
 			// Read the count
 			std::string count_str;
@@ -467,16 +473,16 @@ void InventoryList::serialize(std::ostream &os, bool incremental) const
 
 	os<<"Width "<<m_width<<"\n";
 
-	for (const auto &item : m_items) {
-		if (item.empty()) {
+	for (u32 i = 0; i < m_items.size(); i++) {
+		const ItemStack &item = m_items[i];
+		if (incremental && !m_dirty_items[i]) {
+			os<<"Keep";
+		} else if (item.empty()) {
 			os<<"Empty";
 		} else {
 			os<<"Item ";
 			item.serialize(os);
 		}
-		// TODO: Implement this:
-		// if (!incremental || item.checkModified())
-		// os << "Keep";
 		os<<"\n";
 	}
 
@@ -549,6 +555,7 @@ InventoryList & InventoryList::operator = (const InventoryList &other)
 	m_name = other.m_name;
 	m_itemdef = other.m_itemdef;
 	//setDirty(true);
+	m_dirty_items.assign(m_size, true);
 
 	return *this;
 }
@@ -586,7 +593,7 @@ ItemStack InventoryList::changeItem(u32 i, const ItemStack &newitem)
 	ItemStack olditem = m_items[i];
 	if (olditem != newitem) {
 		m_items[i] = newitem;
-		setModified();
+		setItemModified(i);
 	}
 	return olditem;
 }
@@ -595,7 +602,7 @@ void InventoryList::deleteItem(u32 i)
 {
 	assert(i < m_items.size()); // Pre-condition
 	m_items[i].clear();
-	setModified();
+	setItemModified(i);
 }
 
 ItemStack InventoryList::addItem(const ItemStack &newitem_)
@@ -644,7 +651,7 @@ ItemStack InventoryList::addItem(u32 i, const ItemStack &newitem)
 
 	ItemStack leftover = m_items[i].addItem(newitem, m_itemdef);
 	if (leftover != newitem)
-		setModified();
+		setItemModified(i);
 	return leftover;
 }
 
@@ -696,11 +703,14 @@ bool InventoryList::containsItem(const ItemStack &item, bool match_meta) const
 ItemStack InventoryList::removeItem(const ItemStack &item, bool match_meta)
 {
 	ItemStack removed;
-	for (auto i = m_items.rbegin(); i != m_items.rend(); ++i) {
-		if (i->name == item.name && (!match_meta || i->metadata == item.metadata)) {
+	for (u32 i = m_items.size(); i-- > 0;) {
+		ItemStack &stack = m_items[i];
+		if (stack.name == item.name && (!match_meta || stack.metadata == item.metadata)) {
 			u32 still_to_remove = item.count - removed.count;
-			ItemStack leftover = removed.addItem(i->takeItem(still_to_remove),
-					m_itemdef);
+			ItemStack taken = stack.takeItem(still_to_remove);
+			if (!taken.empty())
+				setItemModified(i);
+			ItemStack leftover = removed.addItem(taken, m_itemdef);
 			// Allow oversized stacks
 			removed.count += leftover.count;
 
@@ -708,8 +718,6 @@ ItemStack InventoryList::removeItem(const ItemStack &item, bool match_meta)
 				break;
 		}
 	}
-	if (!removed.empty())
-		setModified();
 	return removed;
 }
 
@@ -720,7 +728,7 @@ ItemStack InventoryList::takeItem(u32 i, u32 takecount)
 
 	ItemStack taken = m_items[i].takeItem(takecount);
 	if (!taken.empty())
-		setModified();
+		setItemModified(i);
 	return taken;
 }
 
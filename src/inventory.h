@@ -21,6 +21,8 @@ struct ItemStack
 
 	ItemStack(const std::string &name_, u16 count_,
 			u16 wear, IItemDefManager *itemdef);
+	ItemStack(const ItemName &name_, u16 count_,
+			u16 wear, IItemDefManager *itemdef);
 
 	~ItemStack() = default;
 
@@ -53,7 +55,7 @@ struct ItemStack
 
 	void clear()
 	{
-		name = "";
+		name = ItemName();
 		count = 0;
 		wear = 0;
 		metadata.clear();
@@ -193,7 +195,8 @@ struct ItemStack
 	/*
 		Properties
 	*/
-	std::string name = "";
+	// Interned, so comparing and copying it is cheap
+	ItemName name;
 	u16 count = 0;
 	u16 wear = 0;
 	ItemStackMetadata metadata;
@@ -289,7 +292,20 @@ class InventoryList
 	void moveItemSomewhere(u32 i, InventoryList *dest, u32 count);
 
 	inline bool checkModified() const { return m_dirty; }
-	inline void setModified(bool dirty = true) { m_dirty = dirty; }
+	// Marks the whole list (all slots) as modified or handled
+	inline void setModified(bool dirty = true)
+	{
+		m_dirty = dirty;
+		m_dirty_items.assign(m_items.size(), dirty);
+	}
+
+	// Per-slot tracking, used for incremental serialization
+	inline bool checkItemModified(u32 i) const { return m_dirty_items[i]; }
+	inline void setItemModified(u32 i)
+	{
+		m_dirty = true;
+		m_dirty_items[i] = true;
+	}
 
 	// Problem: C++ keeps references to InventoryList and ItemStack indices
 	// until a better solution is found, this serves as a guard to prevent side-effects
@@ -316,6 +332,8 @@ class InventoryList
 	u32 m_width = 0;
 	IItemDefManager *m_itemdef;
 	bool m_dirty = true;
+	// Slots changed since the last setModified(false), same size as m_items
+	std::vector<bool> m_dirty_items;
 	int m_resize_locks = 0; // Lua callback sanity
 };
 
@@ -336,6 +354,8 @@ class Inventory
 	}
 
 	// Never ever serialize to disk using "incremental"!
+	// Incremental mode only includes the lists and slots that were modified
+	// since the last setModified(false).
 	void serialize(std::ostream &os, bool incremental = false) const;
 	void deSerialize(std::istream &is);
 
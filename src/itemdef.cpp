@@ -23,6 +23,7 @@
 #include "util/pointedthing.h"
 #include <map>
 #include <set>
+#include <unordered_map>
 
 TouchInteraction::TouchInteraction()
 {
@@ -401,7 +402,7 @@ class CItemDefManager: public IWritableItemDefManager
 	virtual const ItemDefinition& get(const std::string &name_) const
 	{
 		// Convert name according to possible alias
-		std::string name = getAlias(name_);
+		const std::string &name = getAlias(name_);
 		// Get the definition
 		auto i = m_item_definitions.find(name);
 		if (i == m_item_definitions.cend())
@@ -409,6 +410,13 @@ class CItemDefManager: public IWritableItemDefManager
 		assert(i != m_item_definitions.cend());
 		return *(i->second);
 	}
+	virtual const ItemDefinition& get(const ItemName &name) const
+	{
+		const NameSlot *slot = getSlot(getAlias(name));
+		if (slot && slot->def)
+			return *slot->def;
+		return *m_unknown_def;
+	}
 	virtual const std::string &getAlias(const std::string &name) const
 	{
 		auto it = m_aliases.find(name);
@@ -416,6 +424,27 @@ class CItemDefManager: public IWritableItemDefManager
 			return it->second;
 		return name;
 	}
+	virtual ItemName getAlias(const ItemName &name) const
+	{
+		if (!name.isInterned()) {
+			// Created before the item was registered
+			auto it = m_names.find(name.str());
+			if (it != m_names.end())
+				return getAlias(it->second);
+			return name;
+		}
+		const NameSlot *slot = getSlot(name);
+		if (slot && slot->is_alias)
+			return slot->alias;
+		return name;
+	}
+	virtual ItemName getItemName(std::string_view name) const
+	{
+		auto it = m_names.find(name);
+		if (it != m_names.end())
+			return it->second;
+		return ItemName(name);
+	}
 	virtual void getAll(std::set<std::string> &result) const
 	{
 		result.clear();
@@ -430,10 +459,15 @@ class CItemDefManager: public IWritableItemDefManager
 	virtual bool isKnown(const std::string &name_) const
 	{
 		// Convert name according to possible alias
-		std::string name = getAlias(name_);
+		const std::string &name = getAlias(name_);
 		// Get the definition
 		return m_item_definitions.find(name) != m_item_definitions.cend();
 	}
+	virtual bool isKnown(const ItemName &name) const
+	{
+		const NameSlot *slot = getSlot(getAlias(name));
+		return slot && slot->def;
+	}
 
 #if CHECK_CLIENT_BUILD()
 protected:
@@ -550,6 +584,8 @@ class CItemDefManager: public IWritableItemDefManager
 		}
 		m_item_definitions.clear();
 		m_aliases.clear();
+		m_names.clear();
+		m_name_slots.clear();
 
 		// Add the four builtin items:
 		//   "" is the hand
@@ -578,6 +614,10 @@ class CItemDefManager: public IWritableItemDefManager
 		ignore_def->type = ITEM_NODE;
 		ignore_def->name = "ignore";
 		m_item_definitions.insert(std::make_pair("ignore", ignore_def));
+
+		for (auto &it : m_item_definitions)
+			getSlotForWrite(internName(it.first)).def = it.second;
+		m_unknown_def = unknown_def;
 	}
 	virtual void registerItem(const ItemDefinition &def)
 	{
@@ -591,6 +631,11 @@ class CItemDefManager: public IWritableItemDefManager
 		else
 			*(m_item_definitions[def.name]) = def;
 
+		NameSlot &slot = getSlotForWrite(internName(def.name));
+		slot.def = m_item_definitions[def.name];
+		slot.is_alias = false;
+		slot.alias = ItemName();
+
 		// Remove conflicting alias if it exists
 		bool alias_removed = (m_aliases.erase(def.name) != 0);
 		if(alias_removed)
@@ -603,6 +648,7 @@ class CItemDefManager: public IWritableItemDefManager
 
 		delete m_item_definitions[name];
 		m_item_definitions.erase(name);
+		getSlotForWrite(internName(name)).def = nullptr;
 	}
 	virtual void registerAlias(const std::string &name,
 			const std::string &convert_to)
@@ -611,6 +657,10 @@ class CItemDefManager: public IWritableItemDefManager
 			TRACESTREAM(<< "ItemDefManager: setting alias " << name
 				<< " -> " << convert_to << std::endl);
 			m_aliases[name] = convert_to;
+
+			NameSlot &slot = getSlotForWrite(internName(name));
+			slot.is_alias = true;
+			slot.alias = internName(convert_to);
 		}
 	}
 	void serialize(std::ostream &os, u16 protocol_version)
@@ -662,10 +712,45 @@ class CItemDefManager: public IWritableItemDefManager
 	}
 
 private:
+	// Definition or alias of a name, indexed by ItemName id
+	struct NameSlot
+	{
+		const ItemDefinition *def = nullptr;
+		bool is_alias = false;
+		ItemName alias;
+	};
+
+	const NameSlot *getSlot(const ItemName &name) const
+	{
+		u32 id = name.getId();
+		return id < m_name_slots.size() ? &m_name_slots[id] : nullptr;
+	}
+
+	ItemName internName(const std::string &name)
+	{
+		ItemName ret = ItemName::intern(name);
+		m_names.emplace(ret.str(), ret);
+		return ret;
+	}
+
+	NameSlot &getSlotForWrite(const ItemName &name)
+	{
+		u32 id = name.getId();
+		if (id >= m_name_slots.size())
+			m_name_slots.resize(id + 1);
+		return m_name_slots[id];
+	}
+
 	// Key is name
 	std::map<std::string, ItemDefinition*> m_item_definitions;
 	// Aliases
 	StringMap m_aliases;
+	// Interned names of the two above. The keys point into the interned
+	// strings, which are never freed.
+	std::unordered_map<std::string_view, ItemName> m_names;
+	// Same as the two above, for lookups by ItemName
+	std::vector<NameSlot> m_name_slots;
+	const ItemDefinition *m_unknown_def = nullptr;
 #if CHECK_CLIENT_BUILD()
 	// The id of the thread that is allowed to use irrlicht directly
 	std::thread::id m_main_thread;
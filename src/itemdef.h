@@ -11,6 +11,7 @@
 #include <optional>
 #include <set>
 #include "itemgroup.h"
+#include "itemname.h"
 #include "sound.h"
 #include "texture_override.h" // TextureOverride
 #include "tool.h"
@@ -134,12 +135,17 @@ class IItemDefManager
 
 	// Get item definition
 	virtual const ItemDefinition& get(const std::string &name) const=0;
+	virtual const ItemDefinition& get(const ItemName &name) const=0;
 	// Get alias definition
 	virtual const std::string &getAlias(const std::string &name) const=0;
+	virtual ItemName getAlias(const ItemName &name) const=0;
+	// Interned name if it is registered here, without locking
+	virtual ItemName getItemName(std::string_view name) const=0;
 	// Get set of all defined item names and aliases
 	virtual void getAll(std::set<std::string> &result) const=0;
 	// Check if item is known
 	virtual bool isKnown(const std::string &name) const=0;
+	virtual bool isKnown(const ItemName &name) const=0;
 
 	virtual void serialize(std::ostream &os, u16 protocol_version)=0;
 
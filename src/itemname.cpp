@@ -0,0 +1,63 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "itemname.h"
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+const ItemName::Entry ItemName::s_empty{"", 0, std::hash<std::string_view>()("")};
+
+namespace {
+
+struct InternTable
+{
+	std::shared_mutex mutex;
+	// Keys point into the entries, which are never freed
+	std::unordered_map<std::string_view, std::unique_ptr<ItemName::Entry>> entries;
+};
+
+InternTable &getTable()
+{
+	static InternTable table;
+	return table;
+}
+
+}
+
+ItemName::ItemName(std::string_view name)
+{
+	if (name.empty())
+		return;
+
+	InternTable &table = getTable();
+	{
+		std::shared_lock lock(table.mutex);
+		auto it = table.entries.find(name);
+		if (it != table.entries.end()) {
+			m_entry = it->second.get();
+			return;
+		}
+	}
+
+	m_plain = std::make_shared<const Entry>(Entry{std::string(name), NO_ID,
+			std::hash<std::string_view>()(name)});
+	m_entry = m_plain.get();
+}
+
+ItemName ItemName::intern(std::string_view name)
+{
+	if (name.empty())
+		return ItemName();
+
+	InternTable &table = getTable();
+	std::unique_lock lock(table.mutex);
+	auto it = table.entries.find(name);
+	if (it != table.entries.end())
+		return ItemName(it->second.get());
+	auto entry = std::make_unique<Entry>(Entry{std::string(name),
+			(u32)table.entries.size() + 1, std::hash<std::string_view>()(name)});
+	const Entry *ret = entry.get();
+	table.entries.emplace(ret->name, std::move(entry));
+	return ItemName(ret);
+}
@@ -0,0 +1,112 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/*
+	Item name that is cheap to copy and compare.
+
+	Names of registered items, aliases and craft recipe items are interned:
+	they are stored once for the lifetime of the process and get a small
+	numeric id, so copying and comparing them does not touch the string.
+	Only content registers names, which bounds the table.
+
+	Any other name (unknown items, names sent by clients) is a plain string
+	that is freed with its last copy. It has no id and is compared by its
+	string, so it still equals the interned name of the same string.
+
+	Ids differ between processes and must never be serialized.
+*/
+class ItemName
+{
+public:
+	struct Entry
+	{
+		std::string name;
+		u32 id;
+		size_t hash;
+	};
+
+	// Id of names that are not interned
+	static constexpr u32 NO_ID = U32_MAX;
+
+	// The empty name (the hand), which always has id 0
+	ItemName() = default;
+
+	// Interned if the name has been interned before, plain otherwise.
+	// This looks the name up in a table shared by all threads, prefer
+	// IItemDefManager::getItemName where an item definition manager is at hand.
+	explicit ItemName(std::string_view name);
+
+	ItemName &operator=(std::string_view name)
+	{
+		return *this = ItemName(name);
+	}
+
+	// Adds the name to the table. Only meant for names that come from
+	// content, such as item and alias registrations.
+	static ItemName intern(std::string_view name);
+
+	// NO_ID if the name is not interned
+	u32 getId() const { return m_entry->id; }
+	bool isInterned() const { return m_entry->id != NO_ID; }
+
+	const std::string &str() const { return m_entry->name; }
+	operator const std::string &() const { return m_entry->name; }
+
+	const char *c_str() const { return m_entry->name.c_str(); }
+	size_t size() const { return m_entry->name.size(); }
+	bool empty() const { return m_entry->id == 0; }
+	size_t hash() const { return m_entry->hash; }
+
+	bool operator==(const ItemName &other) const
+	{
+		if (m_entry == other.m_entry)
+			return true;
+		// Two interned names are the same entry if they are equal
+		if (isInterned() && other.isInterned())
+			return false;
+		return m_entry->hash == other.m_entry->hash &&
+				m_entry->name == other.m_entry->name;
+	}
+	bool operator!=(const ItemName &other) const { return !(*this == other); }
+	bool operator==(const std::string &s) const { return m_entry->name == s; }
+	bool operator!=(const std::string &s) const { return m_entry->name != s; }
+	bool operator==(const char *s) const { return m_entry->name == s; }
+	bool operator!=(const char *s) const { return m_entry->name != s; }
+
+private:
+	explicit ItemName(const Entry *entry) : m_entry(entry) {}
+
+	static const Entry s_empty;
+
+	const Entry *m_entry = &s_empty;
+	// Owns the entry of a plain name, empty for interned names
+	std::shared_ptr<const Entry> m_plain;
+};
+
+inline bool operator==(const std::string &s, const ItemName &name) { return name == s; }
+inline bool operator!=(const std::string &s, const ItemName &name) { return name != s; }
+inline bool operator==(const char *s, const ItemName &name) { return name == s; }
+inline bool operator!=(const char *s, const ItemName &name) { return name != s; }
+
+inline std::ostream &operator<<(std::ostream &os, const ItemName &name)
+{
+	return os << name.str();
+}
+
+template <>
+struct std::hash<ItemName>
+{
+	size_t operator()(const ItemName &name) const noexcept
+	{
+		return name.hash();
+	}
+};
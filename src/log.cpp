@@ -25,6 +25,7 @@
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 
 class LevelTarget : public LogTarget {
@@ -112,10 +113,294 @@ void AndroidLogOutput::logRaw(LogLevel lev, std::string_view line)
 ///////////////////////////////////////////////////////////////////////////////
 
 
+////
+//// Asynchronous logging
+////
+
+// Records per thread ring buffer
+constexpr u32 LOG_RING_CAPACITY = 1024;
+// The writer wakes up early once a ring is filled up to this point
+constexpr u32 LOG_RING_WAKE_FILL = LOG_RING_CAPACITY / 2;
+// Longest time a record may wait for the writer
+constexpr auto LOG_WRITER_INTERVAL = std::chrono::milliseconds(50);
+
+struct LogRecord {
+	u64 seq;
+	LogLevel level;
+	bool raw;
+	// Raw text, or "timestamp: LEVEL[thread_name]: text" with the
+	// position of each part. The capacity is reused by later records.
+	std::string line;
+	u32 time_len;
+	u32 thread_pos, thread_len;
+	u32 text_pos;
+};
+
+/*
+	Single producer, single consumer queue of log records.
+	The producer is the thread owning the ring, the consumer is whoever
+	holds Logger::m_drain_mutex.
+*/
+class LogRecordRing {
+public:
+	LogRecordRing() : m_slots(LOG_RING_CAPACITY) {}
+
+	// Producer: slot to fill in, or nullptr if the ring is full
+	LogRecord *beginWrite()
+	{
+		u32 tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) >= LOG_RING_CAPACITY)
+			return nullptr;
+		return &m_slots[tail % LOG_RING_CAPACITY];
+	}
+
+	// Producer: publishes the slot returned by beginWrite(), returns the fill level
+	u32 commitWrite()
+	{
+		u32 tail = m_tail.load(std::memory_order_relaxed) + 1;
+		m_tail.store(tail, std::memory_order_release);
+		return tail - m_head.load(std::memory_order_relaxed);
+	}
+
+	// Consumer
+	u32 available() const
+	{
+		return m_tail.load(std::memory_order_acquire) -
+			m_head.load(std::memory_order_relaxed);
+	}
+
+	LogRecord &peek(u32 i)
+	{
+		return m_slots[(m_head.load(std::memory_order_relaxed) + i) % LOG_RING_CAPACITY];
+	}
+
+	void release(u32 count)
+	{
+		m_head.fetch_add(count, std::memory_order_release);
+	}
+
+	// Set once the owning thread has exited
+	std::atomic<bool> detached{false};
+
+private:
+	std::vector<LogRecord> m_slots;
+	alignas(64) std::atomic<u32> m_head{0};
+	alignas(64) std::atomic<u32> m_tail{0};
+};
+
+namespace {
+	struct ThreadLogRings {
+		struct Entry {
+			u64 logger_id;
+			std::shared_ptr<LogRecordRing> ring;
+		};
+		std::vector<Entry> entries;
+
+		~ThreadLogRings();
+	};
+
+	// Set when the thread's rings are gone, i.e. the thread is exiting
+	thread_local bool t_log_rings_gone = false;
+	thread_local ThreadLogRings t_log_rings;
+
+	ThreadLogRings::~ThreadLogRings()
+	{
+		t_log_rings_gone = true;
+		for (auto &entry : entries)
+			entry.ring->detached = true;
+	}
+
+	std::atomic<u64> g_next_logger_id{1};
+}
+
+LogRecordRing *Logger::getThreadRing()
+{
+	if (t_log_rings_gone)
+		return nullptr;
+	for (auto &entry : t_log_rings.entries) {
+		if (entry.logger_id == m_id)
+			return entry.ring.get();
+	}
+
+	auto ring = std::make_shared<LogRecordRing>();
+	{
+		MutexAutoLock lock(m_rings_mutex);
+		m_rings.push_back(ring);
+	}
+	t_log_rings.entries.push_back({m_id, ring});
+	return ring.get();
+}
+
+bool Logger::logAsync(LogLevel lev, bool raw, std::string_view text)
+{
+	LogRecordRing *ring = getThreadRing();
+	if (!ring)
+		return false;
+
+	LogRecord *rec = ring->beginWrite();
+	if (!rec) {
+		if (lev > LL_ACTION) {
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			m_writer_cv.notify_one();
+			return true;
+		}
+		// Backpressure: important messages are never dropped
+		drainRings();
+		rec = ring->beginWrite();
+		assert(rec);
+	}
+
+	rec->level = lev;
+	rec->raw = raw;
+	if (raw) {
+		rec->line.assign(text);
+	} else {
+		const std::string &thread_name = getThreadName();
+		const std::string timestamp = getTimestamp();
+		const char *label = getLevelLabel(lev);
+		rec->line.assign(timestamp).append(": ").append(label).append("[");
+		rec->time_len = timestamp.size();
+		rec->thread_pos = rec->line.size();
+		rec->thread_len = thread_name.size();
+		rec->line.append(thread_name).append("]: ");
+		rec->text_pos = rec->line.size();
+		rec->line.append(text);
+	}
+	rec->seq = m_next_seq.fetch_add(1, std::memory_order_relaxed);
+
+	u32 fill = ring->commitWrite();
+	if (lev <= LL_ACTION || fill == LOG_RING_WAKE_FILL)
+		m_writer_cv.notify_one();
+
+	// Asynchronous mode was disabled in the meantime
+	if (!isAsync())
+		flush();
+	return true;
+}
+
+void Logger::drainRings()
+{
+	MutexAutoLock drain_lock(m_drain_mutex);
+
+	{
+		MutexAutoLock lock(m_rings_mutex);
+		// Forget rings of exited threads once they are empty
+		m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(),
+			[] (const std::shared_ptr<LogRecordRing> &ring) {
+				return ring->detached && ring->available() == 0;
+			}), m_rings.end());
+		m_drain_rings = m_rings;
+	}
+
+	m_batch.clear();
+	m_drain_counts.clear();
+	for (auto &ring : m_drain_rings) {
+		u32 count = ring->available();
+		for (u32 i = 0; i < count; i++)
+			m_batch.push_back(&ring->peek(i));
+		m_drain_counts.push_back(count);
+	}
+
+	// Restore the order across threads
+	std::sort(m_batch.begin(), m_batch.end(),
+		[] (const LogRecord *a, const LogRecord *b) {
+			return a->seq < b->seq;
+		});
+
+	u64 dropped = m_dropped.load(std::memory_order_relaxed);
+	if (!m_batch.empty() || dropped != m_dropped_reported) {
+		MutexAutoLock lock(m_mutex);
+		for (const LogRecord *rec : m_batch) {
+			if (rec->raw) {
+				for (ILogOutput *out : m_outputs[rec->level])
+					out->logRaw(rec->level, rec->line);
+				continue;
+			}
+			std::string_view line(rec->line);
+			m_batch_time.assign(line.substr(0, rec->time_len));
+			m_batch_thread.assign(line.substr(rec->thread_pos, rec->thread_len));
+			for (ILogOutput *out : m_outputs[rec->level]) {
+				out->log(rec->level, rec->line, m_batch_time, m_batch_thread,
+					line.substr(rec->text_pos));
+			}
+		}
+
+		if (dropped != m_dropped_reported) {
+			std::string msg = "Logger: dropped " +
+				std::to_string(dropped - m_dropped_reported) +
+				" messages because a log buffer was full";
+			m_dropped_reported = dropped;
+			for (ILogOutput *out : m_outputs[LL_WARNING])
+				out->logRaw(LL_WARNING, msg);
+		}
+	}
+
+	for (size_t i = 0; i < m_drain_rings.size(); i++)
+		m_drain_rings[i]->release(m_drain_counts[i]);
+	m_drain_rings.clear();
+}
+
+void Logger::writerThread()
+{
+	std::unique_lock<std::mutex> lock(m_writer_mutex);
+	while (!m_writer_stop) {
+		m_writer_cv.wait_for(lock, LOG_WRITER_INTERVAL);
+		lock.unlock();
+		drainRings();
+		lock.lock();
+	}
+}
+
+void Logger::setAsync(bool async)
+{
+	std::unique_lock<std::mutex> lock(m_writer_mutex);
+	if (async == isAsync())
+		return;
+
+	if (async) {
+		m_writer_stop = false;
+		m_async = true;
+		m_writer = std::thread(&Logger::writerThread, this);
+		return;
+	}
+
+	m_async = false;
+	m_writer_stop = true;
+	lock.unlock();
+	m_writer_cv.notify_one();
+	m_writer.join();
+	drainRings();
+}
+
+void Logger::flush()
+{
+	drainRings();
+}
+
 ////
 //// Logger
 ////
 
+Logger::Logger() :
+	m_id(g_next_logger_id.fetch_add(1))
+{
+}
+
+Logger::~Logger()
+{
+	// The outputs may already be destroyed, so pending records are not
+	// written out here. Disable asynchronous mode beforehand to do that.
+	if (m_writer.joinable()) {
+		{
+			MutexAutoLock lock(m_writer_mutex);
+			m_async = false;
+			m_writer_stop = true;
+		}
+		m_writer_cv.notify_one();
+		m_writer.join();
+	}
+}
+
 LogLevel Logger::stringToLevel(std::string_view name)
 {
 	if (name == "none")
@@ -242,6 +527,9 @@ void Logger::log(LogLevel lev, std::string_view text)
 	if (isLevelSilenced(lev))
 		return;
 
+	if (isAsync() && logAsync(lev, false, text))
+		return;
+
 	const std::string &thread_name = getThreadName();
 	const char *label = getLevelLabel(lev);
 	const std::string timestamp = getTimestamp();
@@ -258,6 +546,9 @@ void Logger::logRaw(LogLevel lev, std::string_view text)
 	if (isLevelSilenced(lev))
 		return;
 
+	if (isAsync() && logAsync(lev, true, text))
+		return;
+
 	logToOutputsRaw(lev, text);
 }
 
@@ -3,7 +3,9 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <map>
+#include <memory>
 #include <queue>
 #include <string_view>
 #include <fstream>
@@ -16,6 +18,8 @@
 #include "log.h"
 
 class ILogOutput;
+class LogRecordRing;
+struct LogRecord;
 
 enum LogLevel {
 	LL_NONE, // Special level that is always printed
@@ -39,6 +43,9 @@ typedef u8 LogLevelMask;
 
 class Logger {
 public:
+	Logger();
+	~Logger();
+
 	void addOutput(ILogOutput *out);
 	void addOutput(ILogOutput *out, LogLevel lev);
 	void addOutputMasked(ILogOutput *out, LogLevelMask mask);
@@ -53,6 +60,21 @@ class Logger {
 	// Logs without a prefix
 	void logRaw(LogLevel lev, std::string_view text);
 
+	/*
+		In asynchronous mode log() and logRaw() only format the message into a
+		ring buffer owned by the calling thread. A writer thread passes the
+		records to the outputs in batches.
+		When a buffer is full, errors, warnings and unleveled messages are
+		written out by the calling thread; other messages are dropped.
+		Disabling asynchronous mode writes out all pending records.
+	*/
+	void setAsync(bool async);
+	bool isAsync() const { return m_async.load(std::memory_order_relaxed); }
+	// Writes out all records pending in asynchronous mode
+	void flush();
+	// Number of messages dropped because a buffer was full
+	u64 getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
 	static LogLevel stringToLevel(std::string_view name);
 	static const char *getLevelLabel(LogLevel lev);
 
@@ -74,11 +96,39 @@ class Logger {
 
 	const std::string &getThreadName();
 
+	LogRecordRing *getThreadRing();
+	// Returns false if the message has to be logged synchronously
+	bool logAsync(LogLevel lev, bool raw, std::string_view text);
+	void drainRings();
+	void writerThread();
+
 	std::vector<ILogOutput *> m_outputs[LL_MAX];
-	std::atomic<bool> m_has_outputs[LL_MAX];
-	std::atomic<bool> m_silenced_levels[LL_MAX];
+	std::atomic<bool> m_has_outputs[LL_MAX] = {};
+	std::atomic<bool> m_silenced_levels[LL_MAX] = {};
 	std::map<std::thread::id, std::string> m_thread_names;
 	mutable std::mutex m_mutex;
+
+	// Asynchronous mode
+	const u64 m_id;
+	std::atomic<bool> m_async{false};
+	std::atomic<u64> m_next_seq{0};
+	std::atomic<u64> m_dropped{0};
+	// Protects m_rings
+	std::mutex m_rings_mutex;
+	std::vector<std::shared_ptr<LogRecordRing>> m_rings;
+	// Only one thread may consume the rings at a time.
+	// The members below are scratch space of the consumer.
+	std::mutex m_drain_mutex;
+	std::vector<std::shared_ptr<LogRecordRing>> m_drain_rings;
+	std::vector<u32> m_drain_counts;
+	std::vector<LogRecord *> m_batch;
+	std::string m_batch_time, m_batch_thread;
+	u64 m_dropped_reported = 0;
+	// Writer thread
+	std::mutex m_writer_mutex;
+	std::condition_variable m_writer_cv;
+	bool m_writer_stop = false;
+	std::thread m_writer;
 };
 
 class ILogOutput {
@@ -10,6 +10,7 @@
 #include "debug.h"
 #include "unittest/test.h"
 #include "server.h"
+#include "server/session_recorder.h"
 #include "filesys.h"
 #include "version.h"
 #include "defaultsettings.h"
@@ -24,6 +25,7 @@
 #include "config.h"
 #include "player.h"
 #include "porting.h"
+#include "profiler.h"
 #include "serialization.h" // SER_FMT_VER_HIGHEST_*
 #include "network/socket.h"
 #include "mapblock.h"
@@ -113,6 +115,9 @@ static bool determine_subgame(GameParams *game_params);
 static bool run_dedicated_server(const GameParams &game_params, const Settings &cmd_args);
 static bool migrate_map_database(const GameParams &game_params, const Settings &cmd_args);
 static bool recompress_map_database(const GameParams &game_params, const Settings &cmd_args);
+static void setup_session_recording(Server &server, const GameParams &game_params,
+		const Settings &cmd_args);
+static bool replay_session(const Settings &cmd_args);
 
 /**********************************************************************/
 
@@ -242,6 +247,10 @@ int main(int argc, char *argv[])
 #endif
 	}
 
+	// Replay a recorded session
+	if (cmd_args.exists("replay"))
+		return replay_session(cmd_args) ? 0 : 1;
+
 	GameStartData game_params;
 #if !CHECK_CLIENT_BUILD()
 	porting::attachOrCreateConsole();
@@ -378,6 +387,10 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Enable ncurses interactive terminal" SERVER_ONLY))));
 	allowed_options->insert(std::make_pair("recompress", ValueSpec(VALUETYPE_FLAG,
 			_("Recompress the blocks of the given map database" SERVER_ONLY))));
+	allowed_options->insert(std::make_pair("record", ValueSpec(VALUETYPE_STRING,
+			_("Record the server session into a directory, for --replay" SERVER_ONLY))));
+	allowed_options->insert(std::make_pair("replay", ValueSpec(VALUETYPE_STRING,
+			_("Replay a recorded server session without network and print timings"))));
 #if CHECK_CLIENT_BUILD()
 	allowed_options->insert(std::make_pair("address", ValueSpec(VALUETYPE_STRING,
 			_("Address to connect to ('' = local game)"))));
@@ -718,6 +731,9 @@ static bool init_common(const Settings &cmd_args, int argc, char *argv[])
 
 static void uninit_common()
 {
+	// Write out pending log records while the outputs still exist
+	g_logger.setAsync(false);
+
 	httpfetch_cleanup();
 
 	sockets_cleanup();
@@ -787,6 +803,8 @@ static void init_log_streams(const Settings &cmd_args)
 	if (cmd_args.exists("logfile"))
 		log_filename = cmd_args.get("logfile");
 
+	g_logger.setAsync(g_settings->getBool("debug_log_async"));
+
 	g_logger.removeOutput(&file_log_output);
 	std::string conf_loglev = g_settings->get("debug_log_level");
 
@@ -1136,6 +1154,7 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 			// Create server
 			Server server(game_params.world_path, game_params.game_spec,
 					false, bind_addr, true, &iface);
+			setup_session_recording(server, game_params, cmd_args);
 
 			g_term_console.setup(&iface, &kill, admin_nick);
 
@@ -1170,6 +1189,7 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 			// Create server
 			Server server(game_params.world_path, game_params.game_spec, false,
 				bind_addr, true);
+			setup_session_recording(server, game_params, cmd_args);
 			server.start();
 
 			// Run server
@@ -1188,6 +1208,79 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	return true;
 }
 
+static void setup_session_recording(Server &server, const GameParams &game_params,
+		const Settings &cmd_args)
+{
+	if (!cmd_args.exists("record"))
+		return;
+	server.setSessionRecorder(std::make_unique<SessionRecorder>(
+		cmd_args.get("record"), game_params.world_path, game_params.game_spec.id));
+}
+
+static bool replay_session(const Settings &cmd_args)
+{
+	const std::string dir = cmd_args.get("replay");
+	std::unique_ptr<SessionReplay> replay;
+	try {
+		replay = std::make_unique<SessionReplay>(dir);
+	} catch (const BaseException &e) {
+		errorstream << "Replay failed: " << e.what() << std::endl;
+		return false;
+	}
+
+	// The replay modifies the world, so it runs on a copy
+	const std::string world_path = fs::CreateTempDir();
+	if (world_path.empty() ||
+			!fs::CopyDir(SessionReplay::getWorldPath(dir), world_path)) {
+		errorstream << "Replay failed: could not copy the world" << std::endl;
+		return false;
+	}
+
+	SubgameSpec gamespec = findSubgame(replay->getGameId());
+	if (!gamespec.isValid()) {
+		errorstream << "Replay failed: game \"" << replay->getGameId()
+			<< "\" not found" << std::endl;
+		fs::RecursiveDelete(world_path);
+		return false;
+	}
+
+	bool success = false;
+	SessionReplayStats stats;
+	u64 t_start = 0, t_total = 0;
+	try {
+		Server server(world_path, gamespec, false, Address(), true,
+			nullptr, nullptr, replay->createConnection());
+		server.setRandomSeed(replay->getSeed());
+		server.startOffline();
+
+		g_profiler->clear();
+		t_start = porting::getTimeUs();
+		success = replay->run(&server, &stats);
+		t_total = porting::getTimeUs() - t_start;
+		if (!success)
+			errorstream << "Replay: the recording is truncated" << std::endl;
+	} catch (const ModError &e) {
+		errorstream << "ModError: " << e.what() << std::endl;
+	} catch (const ServerError &e) {
+		errorstream << "ServerError: " << e.what() << std::endl;
+	}
+
+	fs::RecursiveDelete(world_path);
+
+	if (stats.steps == 0)
+		return false;
+
+	rawstream << "Replayed " << stats.steps << " steps, " << stats.packets
+		<< " packets from " << stats.peers << " peers in "
+		<< t_total / 1000 << " ms" << std::endl;
+	rawstream << "  server steps:       " << stats.step_time_us / 1000 << " ms ("
+		<< stats.step_time_us / stats.steps << " us/step)" << std::endl;
+	rawstream << "  packet processing:  " << stats.packet_time_us / 1000 << " ms" << std::endl;
+	rawstream << "  data sent to peers: " << stats.bytes_sent / 1024 << " KiB" << std::endl;
+	g_profiler->print(rawstream);
+	return success;
+}
+
 static bool migrate_map_database(const GameParams &game_params, const Settings &cmd_args)
 {
 	std::string migrate_to = cmd_args.get("migrate");
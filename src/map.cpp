@@ -17,13 +17,43 @@
 #include "rollback_interface.h"
 #include "environment.h"
 #include "irrlicht_changes/printing.h"
+#include <algorithm>
+#include <atomic>
 
 /*
 	Map
 */
 
+// Source of Map::m_block_version
+static std::atomic<u64> next_block_version(1);
+
+/*
+	Recently found blocks of the current thread. Each position has one slot,
+	and an entry is only valid while the version of its map is unchanged.
+	Misses are not cached, as adding a block would have to invalidate them.
+*/
+#define BLOCK_CACHE_SIZE 16
+
+namespace {
+	struct BlockCacheEntry {
+		u64 version = 0;
+		v3s16 pos;
+		MapBlock *block = nullptr;
+	};
+}
+
+static thread_local BlockCacheEntry block_cache[BLOCK_CACHE_SIZE];
+
+static inline BlockCacheEntry &block_cache_slot(v3s16 p)
+{
+	static_assert((BLOCK_CACHE_SIZE & (BLOCK_CACHE_SIZE - 1)) == 0);
+	// Neighbouring blocks get different slots
+	return block_cache[(p.X + p.Y * 3 + p.Z * 7) & (BLOCK_CACHE_SIZE - 1)];
+}
+
 Map::Map(IGameDef *gamedef):
 	m_gamedef(gamedef),
+	m_block_version(next_block_version++),
 	m_nodedef(gamedef->ndef())
 {
 }
@@ -83,11 +113,16 @@ MapSector *Map::getSectorNoGenerate(v2s16 p)
 
 MapBlock *Map::getBlockNoCreateNoEx(v3s16 p3d)
 {
-	v2s16 p2d(p3d.X, p3d.Z);
-	MapSector *sector = getSectorNoGenerate(p2d);
-	if (!sector)
-		return nullptr;
-	MapBlock *block = sector->getBlockNoCreateNoEx(p3d.Y);
+	BlockCacheEntry &entry = block_cache_slot(p3d);
+	if (entry.version == m_block_version && entry.pos == p3d)
+		return entry.block;
+
+	MapBlock *block = m_block_index.find(p3d);
+	if (block) {
+		entry.version = m_block_version;
+		entry.pos = p3d;
+		entry.block = block;
+	}
 	return block;
 }
 
@@ -255,21 +290,6 @@ bool Map::removeNodeWithEvent(v3s16 p)
 	return succeeded;
 }
 
-struct TimeOrderedMapBlock {
-	MapSector *sect;
-	MapBlock *block;
-
-	TimeOrderedMapBlock(MapSector *sect, MapBlock *block) :
-		sect(sect),
-		block(block)
-	{}
-
-	bool operator<(const TimeOrderedMapBlock &b) const
-	{
-		return block->getUsageTimer() < b.block->getUsageTimer();
-	};
-};
-
 /*
 	Updates usage timers
 */
@@ -281,116 +301,55 @@ void Map::timerUpdate(float dtime, float unload_timeout, s32 max_loaded_blocks,
 	// Profile modified reasons
 	Profiler modprofiler;
 
-	std::vector<v2s16> sector_deletion_queue;
 	u32 deleted_blocks_count = 0;
 	u32 saved_blocks_count = 0;
-	u32 block_count_all = 0;
 	u32 locked_blocks = 0;
 
 	const auto start_time = porting::getTimeUs();
 	beginSave();
 
-	// If there is no practical limit, we spare creation of mapblock_queue
-	if (max_loaded_blocks < 0) {
-		MapBlockVect blocks;
-		for (auto &sector_it : m_sectors) {
-			MapSector *sector = sector_it.second;
-
-			bool all_blocks_deleted = true;
-
-			blocks.clear();
-			sector->getBlocks(blocks);
-
-			for (MapBlock *block : blocks) {
-				block->incrementUsageTimer(dtime);
-
-				if (block->refGet() == 0
-						&& block->getUsageTimer() > unload_timeout) {
-					v3s16 p = block->getPos();
-
-					// Save if modified
-					if (block->getModified() != MOD_STATE_CLEAN
-							&& save_before_unloading) {
-						modprofiler.add(block->getModifiedReasonString(), 1);
-						if (!saveBlock(block))
-							continue;
-						saved_blocks_count++;
-					}
-
-					// Delete from memory
-					sector->deleteBlock(block);
-
-					if (unloaded_blocks)
-						unloaded_blocks->push_back(p);
-
-					deleted_blocks_count++;
-				} else {
-					all_blocks_deleted = false;
-					block_count_all++;
-				}
-			}
-
-			// Delete sector if we emptied it
-			if (all_blocks_deleted) {
-				sector_deletion_queue.push_back(sector_it.first);
-			}
-		}
-	} else {
-		std::priority_queue<TimeOrderedMapBlock> mapblock_queue;
-		MapBlockVect blocks;
-		for (auto &sector_it : m_sectors) {
-			MapSector *sector = sector_it.second;
-
-			blocks.clear();
-			sector->getBlocks(blocks);
+	m_block_usage.step(dtime);
 
-			for (MapBlock *block : blocks) {
-				block->incrementUsageTimer(dtime);
-				mapblock_queue.push(TimeOrderedMapBlock(sector, block));
-			}
+	/*
+		The usage list is ordered by the time of last use, so the blocks over
+		the timeout are at its front, followed by the ones to unload if there
+		are too many. Blocks that cannot be unloaded count as candidates like
+		the others, but stay in the list for the next update.
+	*/
+	size_t remaining = m_block_usage.size();
+	MapBlock *next = m_block_usage.getOldest();
+	while (next && ((max_loaded_blocks >= 0 && remaining > (size_t)max_loaded_blocks)
+			|| next->getUsageTimer() > unload_timeout)) {
+		MapBlock *block = next;
+		next = MapBlockUsageList::getNext(block);
+		remaining--;
+
+		if (block->refGet() != 0) {
+			locked_blocks++;
+			continue;
 		}
-		block_count_all = mapblock_queue.size();
-
-		// Delete old blocks, and blocks over the limit from the memory
-		while (!mapblock_queue.empty() && ((s32)mapblock_queue.size() > max_loaded_blocks
-				|| mapblock_queue.top().block->getUsageTimer() > unload_timeout)) {
-			TimeOrderedMapBlock b = mapblock_queue.top();
-			mapblock_queue.pop();
 
-			MapBlock *block = b.block;
+		v3s16 p = block->getPos();
 
-			if (block->refGet() != 0) {
-				locked_blocks++;
+		// Save if modified
+		if (block->getModified() != MOD_STATE_CLEAN && save_before_unloading) {
+			modprofiler.add(block->getModifiedReasonString(), 1);
+			if (!saveBlock(block))
 				continue;
-			}
-
-			v3s16 p = block->getPos();
-
-			// Save if modified
-			if (block->getModified() != MOD_STATE_CLEAN && save_before_unloading) {
-				modprofiler.add(block->getModifiedReasonString(), 1);
-				if (!saveBlock(block))
-					continue;
-				saved_blocks_count++;
-			}
-
-			// Delete from memory
-			b.sect->deleteBlock(block);
+			saved_blocks_count++;
+		}
 
-			if (unloaded_blocks)
-				unloaded_blocks->push_back(p);
+		// Delete from memory
+		MapSector *sector = getSectorNoGenerateNoLock(v2s16(p.X, p.Z));
+		assert(sector);
+		sector->deleteBlock(block);
 
-			deleted_blocks_count++;
-			block_count_all--;
-		}
+		if (unloaded_blocks)
+			unloaded_blocks->push_back(p);
 
-		// Delete empty sectors
-		for (auto &sector_it : m_sectors) {
-			if (sector_it.second->empty()) {
-				sector_deletion_queue.push_back(sector_it.first);
-			}
-		}
+		deleted_blocks_count++;
 	}
+	const u32 block_count_all = m_block_usage.size();
 
 	endSave();
 	const auto end_time = porting::getTimeUs();
@@ -398,6 +357,16 @@ void Map::timerUpdate(float dtime, float unload_timeout, s32 max_loaded_blocks,
 	reportMetrics(end_time - start_time, saved_blocks_count, block_count_all);
 
 	// Finally delete the empty sectors
+	std::sort(m_unchecked_sectors.begin(), m_unchecked_sectors.end());
+	m_unchecked_sectors.erase(std::unique(m_unchecked_sectors.begin(),
+		m_unchecked_sectors.end()), m_unchecked_sectors.end());
+	std::vector<v2s16> sector_deletion_queue;
+	for (v2s16 p2d : m_unchecked_sectors) {
+		auto it = m_sectors.find(p2d);
+		if (it != m_sectors.end() && it->second->empty())
+			sector_deletion_queue.push_back(p2d);
+	}
+	m_unchecked_sectors.clear();
 	deleteSectors(sector_deletion_queue);
 
 	if(deleted_blocks_count != 0)
@@ -435,6 +404,30 @@ void Map::deleteSectors(const std::vector<v2s16> &sectorList)
 	}
 }
 
+void Map::addSector(MapSector *sector)
+{
+	v2s16 p2d = sector->getPos();
+	m_sectors[p2d] = sector;
+	// Deleted by the next timerUpdate() unless it gets blocks
+	m_unchecked_sectors.push_back(p2d);
+}
+
+void Map::onBlockInserted(MapBlock *block)
+{
+	m_block_index.insert(block->getPos(), block);
+	m_block_usage.add(block);
+}
+
+void Map::onBlockDetached(MapBlock *block, MapSector *sector)
+{
+	[[maybe_unused]] bool found = m_block_index.erase(block->getPos());
+	assert(found);
+	m_block_version = next_block_version++;
+	m_block_usage.remove(block);
+	if (sector->empty())
+		m_unchecked_sectors.push_back(sector->getPos());
+}
+
 void Map::PrintInfo(std::ostream &out)
 {
 	out<<"Map: ";
@@ -663,16 +656,25 @@ bool Map::isOccluded(const v3s16 pos_camera, const v3s16 pos_target,
 
 	v3f pos_origin_f = intToFloat(pos_camera, BS);
 	u32 count = 0;
-	bool is_valid_position;
+
+	// Consecutive steps mostly stay within one block. Remember it locally
+	// instead of using the shared lookup caches, so that occlusion checks
+	// can run on several threads at once.
+	v3s16 last_blockpos(S16_MAX, S16_MAX, S16_MAX);
+	MapBlock *block = nullptr;
 
 	for (; offset < distance + end_offset; offset += step) {
 		v3f pos_node_f = pos_origin_f + direction * offset;
 		v3s16 pos_node = floatToInt(pos_node_f, BS);
 
-		MapNode node = getNode(pos_node, &is_valid_position);
+		v3s16 blockpos = getNodeBlockPos(pos_node);
+		if (blockpos != last_blockpos) {
+			last_blockpos = blockpos;
+			block = findBlock(blockpos);
+		}
 
-		if (is_valid_position &&
-				!m_nodedef->getLightingFlags(node).light_propagates) {
+		if (block && !m_nodedef->getLightingFlags(
+				block->getNodeNoCheck(pos_node - blockpos * MAP_BLOCKSIZE)).light_propagates) {
 			// Cannot see through light-blocking nodes --> occluded
 			count++;
 			if (count >= needed_count)
@@ -10,10 +10,12 @@
 
 #include "irrlichttypes_bloated.h"
 #include "mapblock.h"
+#include "mapblockindex.h"
 #include "mapnode.h"
 #include "constants.h"
 #include "voxel.h"
 #include "modifiedstate.h"
+#include "util/basic_macros.h"
 #include "util/numeric.h"
 #include "nodetimer.h"
 #include "debug.h"
@@ -124,7 +126,12 @@ class Map /*: public NodeContainer*/
 	// Returns InvalidPositionException if not found
 	MapBlock * getBlockNoCreate(v3s16 p);
 	// Returns NULL if not found
+	// Goes through a small per-thread cache, which makes repeated lookups of
+	// the same few blocks (like in getNode() loops) cheap.
 	MapBlock * getBlockNoCreateNoEx(v3s16 p);
+	// Same as getBlockNoCreateNoEx() but does not touch the lookup caches.
+	// Safe to call from several threads as long as the map is not modified.
+	MapBlock *findBlock(v3s16 p) const { return m_block_index.find(p); }
 
 	/* Server overrides */
 	virtual MapBlock * emergeBlock(v3s16 p, bool create_blank=true)
@@ -193,6 +200,13 @@ class Map /*: public NodeContainer*/
 	// If deleted sector is in sector cache, clears cache
 	void deleteSectors(const std::vector<v2s16> &list);
 
+	// Called by MapSector to keep the block index and usage list up to date
+	void onBlockInserted(MapBlock *block);
+	void onBlockDetached(MapBlock *block, MapSector *sector);
+
+	// Number of blocks in memory
+	size_t getBlockCount() const { return m_block_usage.size(); }
+
 	// For debug printing. Prints "Map: ", "ServerMap: " or "ClientMap: "
 	virtual void PrintInfo(std::ostream &out);
 
@@ -268,6 +282,71 @@ class Map /*: public NodeContainer*/
 		}
 	}
 
+	// Like forEachNodeInArea, but only calls func for the nodes whose content
+	// is in 'filter' (in the same order). Blocks that cannot contain any of
+	// them are skipped using their content presence summary.
+	template<typename F>
+	void forEachNodeInAreaWithContent(v3s16 minp, v3s16 maxp,
+			const std::vector<content_t> &filter, F func)
+	{
+		u64 filter_mask = 0;
+		for (content_t c : filter)
+			filter_mask |= MapBlock::getContentBit(c);
+		const bool want_ignore = CONTAINS(filter, CONTENT_IGNORE);
+
+		v3s16 bpmin = getNodeBlockPos(minp);
+		v3s16 bpmax = getNodeBlockPos(maxp);
+		for (s16 bz = bpmin.Z; bz <= bpmax.Z; bz++)
+		for (s16 bx = bpmin.X; bx <= bpmax.X; bx++)
+		for (s16 by = bpmin.Y; by <= bpmax.Y; by++) {
+			v3s16 bp(bx, by, bz);
+			MapBlock *block = getBlockNoCreateNoEx(bp);
+			if (block ? !block->mayContain(filter_mask) : !want_ignore)
+				continue;
+
+			v3s16 basep = bp * MAP_BLOCKSIZE;
+			s16 minx_block = rangelim(minp.X - basep.X, 0, MAP_BLOCKSIZE - 1);
+			s16 miny_block = rangelim(minp.Y - basep.Y, 0, MAP_BLOCKSIZE - 1);
+			s16 minz_block = rangelim(minp.Z - basep.Z, 0, MAP_BLOCKSIZE - 1);
+			s16 maxx_block = rangelim(maxp.X - basep.X, 0, MAP_BLOCKSIZE - 1);
+			s16 maxy_block = rangelim(maxp.Y - basep.Y, 0, MAP_BLOCKSIZE - 1);
+			s16 maxz_block = rangelim(maxp.Z - basep.Z, 0, MAP_BLOCKSIZE - 1);
+
+			if (!block) {
+				for (s16 z_block = minz_block; z_block <= maxz_block; z_block++)
+				for (s16 y_block = miny_block; y_block <= maxy_block; y_block++)
+				for (s16 x_block = minx_block; x_block <= maxx_block; x_block++) {
+					v3s16 p = basep + v3s16(x_block, y_block, z_block);
+					if (!func(p, MapNode(CONTENT_IGNORE)))
+						return;
+				}
+				continue;
+			}
+
+			const MapNode *data = block->getData();
+			for (s16 z_block = minz_block; z_block <= maxz_block; z_block++)
+			for (s16 y_block = miny_block; y_block <= maxy_block; y_block++) {
+				const MapNode *row = &data[z_block * MapBlock::zstride +
+						y_block * MapBlock::ystride];
+				// Cheap test whether the row can contain a match at all,
+				// free of branches so that the compiler can vectorize it
+				u64 row_mask = 0;
+				for (s16 x_block = minx_block; x_block <= maxx_block; x_block++)
+					row_mask |= MapBlock::getContentBit(row[x_block].getContent());
+				if (!(row_mask & filter_mask))
+					continue;
+
+				for (s16 x_block = minx_block; x_block <= maxx_block; x_block++) {
+					if (!CONTAINS(filter, row[x_block].getContent()))
+						continue;
+					v3s16 p = basep + v3s16(x_block, y_block, z_block);
+					if (!func(p, row[x_block]))
+						return;
+				}
+			}
+		}
+	}
+
 	bool isBlockOccluded(MapBlock *block, v3s16 cam_pos_nodes)
 	{
 		return isBlockOccluded(block->getPosRelative(), cam_pos_nodes, false);
@@ -285,6 +364,24 @@ class Map /*: public NodeContainer*/
 	MapSector *m_sector_cache = nullptr;
 	v2s16 m_sector_cache_p;
 
+	/*
+		All blocks in memory by position. The sectors still own the blocks,
+		but lookups do not go through them.
+	*/
+	MapBlockIndex m_block_index;
+	// Changes whenever a block is removed. Unique among all maps, it
+	// invalidates the entries of the per-thread block cache.
+	u64 m_block_version;
+
+	// All blocks in memory, for finding the unload candidates of timerUpdate()
+	// without visiting every block
+	MapBlockUsageList m_block_usage;
+	// Sectors that might have become empty since the last timerUpdate()
+	std::vector<v2s16> m_unchecked_sectors;
+
+	// Inserts a new sector into m_sectors
+	void addSector(MapSector *sector);
+
 	// This stores the properties of the nodes on the map.
 	const NodeDefManager *m_nodedef;
 
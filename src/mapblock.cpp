@@ -4,6 +4,8 @@
 
 #include "mapblock.h"
 
+#include <algorithm>
+#include <memory>
 #include <sstream>
 #include "map.h"
 #include "light.h"
@@ -20,6 +22,7 @@
 #include "client/mapblock_mesh.h"
 #endif
 #include "porting.h"
+#include "threading/mutex_auto_lock.h"
 #include "util/string.h"
 #include "util/serialize.h"
 #include "util/basic_macros.h"
@@ -53,7 +56,6 @@ static const char *modified_reason_strings[] = {
 MapBlock::MapBlock(v3s16 pos, IGameDef *gamedef):
 		m_pos(pos),
 		m_pos_relative(pos * MAP_BLOCKSIZE),
-		data(new MapNode[nodecount]),
 		m_gamedef(gamedef)
 {
 	reallocate();
@@ -62,6 +64,9 @@ MapBlock::MapBlock(v3s16 pos, IGameDef *gamedef):
 
 MapBlock::~MapBlock()
 {
+	if (m_usage_list)
+		m_usage_list->remove(this);
+
 #if CHECK_CLIENT_BUILD()
 	{
 		delete mesh;
@@ -69,8 +74,115 @@ MapBlock::~MapBlock()
 	}
 #endif
 
-	delete[] data;
-	porting::TrackFreedMemory(sizeof(MapNode) * nodecount);
+	freeData();
+}
+
+/*
+	Node arrays of uniform blocks, one per distinct node. They are never
+	freed while the process runs, so their number is limited.
+*/
+#define MAX_UNIFORM_ARRAYS 64
+
+static std::mutex uniform_arrays_mutex;
+static std::vector<std::unique_ptr<MapNode[]>> uniform_arrays;
+
+// Returns nullptr if there are too many different ones
+static MapNode *get_uniform_array(MapNode n)
+{
+	MutexAutoLock lock(uniform_arrays_mutex);
+	for (auto &array : uniform_arrays) {
+		if (array[0] == n)
+			return array.get();
+	}
+	if (uniform_arrays.size() >= MAX_UNIFORM_ARRAYS)
+		return nullptr;
+
+	auto array = std::make_unique<MapNode[]>(MapBlock::nodecount);
+	std::fill_n(array.get(), MapBlock::nodecount, n);
+	uniform_arrays.push_back(std::move(array));
+	return uniform_arrays.back().get();
+}
+
+static bool compact_uniform_mapblocks()
+{
+	// Blocks are also created without settings, e.g. in benchmarks
+	return !g_settings || g_settings->getBool("compact_uniform_mapblocks");
+}
+
+void MapBlock::freeData()
+{
+	if (!m_data_shared && data) {
+		delete[] data;
+		porting::TrackFreedMemory(sizeof(MapNode) * nodecount);
+	}
+	data = nullptr;
+	m_data_shared = false;
+}
+
+void MapBlock::unshareData()
+{
+	assert(m_data_shared);
+	MapNode *copy = new MapNode[nodecount];
+	std::copy_n(data, nodecount, copy);
+	data = copy;
+	m_data_shared = false;
+}
+
+void MapBlock::fillData(MapNode n)
+{
+	MapNode *shared = compact_uniform_mapblocks() ? get_uniform_array(n) : nullptr;
+	if (shared) {
+		freeData();
+		data = shared;
+		m_data_shared = true;
+		return;
+	}
+	if (m_data_shared || !data)
+		freeData();
+	if (!data)
+		data = new MapNode[nodecount];
+	std::fill_n(data, nodecount, n);
+}
+
+bool MapBlock::compactData()
+{
+	if (m_data_shared)
+		return true;
+	const MapNode n = data[0];
+	for (u32 i = 1; i < nodecount; i++) {
+		if (data[i] != n)
+			return false;
+	}
+	if (!compact_uniform_mapblocks())
+		return false;
+	MapNode *shared = get_uniform_array(n);
+	if (!shared)
+		return false;
+	freeData();
+	data = shared;
+	m_data_shared = true;
+	return true;
+}
+
+/*
+	MapBlockUsageList
+*/
+
+void MapBlockUsageList::add(MapBlock *block)
+{
+	assert(!block->m_usage_list);
+	block->m_usage_list = this;
+	block->m_last_used = m_time;
+	link(block);
+	m_size++;
+}
+
+void MapBlockUsageList::remove(MapBlock *block)
+{
+	assert(block->m_usage_list == this);
+	unlink(block);
+	block->m_usage_list = nullptr;
+	m_size--;
 }
 
 static inline size_t get_max_objects_per_block()
@@ -175,8 +287,10 @@ void MapBlock::copyFrom(const VoxelManipulator &src)
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
 	// Copy from VoxelManipulator to data
-	src.copyTo(data, data_area, v3s16(0,0,0),
+	src.copyTo(getDataMutable(), data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
+	compactData();
+	expireContentMask();
 }
 
 void MapBlock::actuallyUpdateIsAir()
@@ -202,6 +316,34 @@ void MapBlock::expireIsAirCache()
 	m_is_air_expired = true;
 }
 
+void MapBlock::actuallyUpdateContentMask()
+{
+	u64 mask = 0;
+	for (u32 i = 0; i < nodecount; i++)
+		mask |= getContentBit(data[i].getContent());
+
+	m_content_mask = mask;
+	m_content_mask_expired = false;
+}
+
+void MapBlock::actuallyUpdatePointable()
+{
+	const NodeDefManager *nodedef = m_gamedef->ndef();
+	u8 flags = 0;
+	for (u32 i = 0; i < nodecount; i++) {
+		const ContentFeatures &f = nodedef->get(data[i]);
+		if (f.pointable != PointabilityType::POINTABLE_NOT)
+			flags |= POINTABLE_FLAG_NODES;
+		if (f.isLiquid())
+			flags |= POINTABLE_FLAG_LIQUIDS;
+		if (flags == (POINTABLE_FLAG_NODES | POINTABLE_FLAG_LIQUIDS))
+			break;
+	}
+
+	m_pointable_flags = flags;
+	m_pointable_expired = false;
+}
+
 /*
 	Serialization
 */
@@ -316,9 +458,29 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 	if (!ser_ver_supported_write(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
 
+	if (version < 29) {
+		serializeData(os_compressed, version, disk, compression_level);
+		return;
+	}
+
 	std::ostringstream os_raw(std::ios_base::binary);
-	std::ostream &os = version >= 29 ? os_raw : os_compressed;
+	serializeData(os_raw, version, disk, compression_level);
+	// now compress the whole thing
+	compress(os_raw.str(), os_compressed, version, compression_level);
+}
 
+void MapBlock::serializeUncompressed(std::ostream &os, u8 version, bool disk)
+{
+	if (version < 29 || !ser_ver_supported_write(version))
+		throw VersionMismatchException("ERROR: MapBlock format not supported");
+
+	serializeData(os, version, disk, 0);
+}
+
+// For version < 29, os receives the final output with individually compressed
+// parts, otherwise the uncompressed data
+void MapBlock::serializeData(std::ostream &os, u8 version, bool disk, int compression_level)
+{
 	// First byte
 	u8 flags = 0;
 	if(is_underground)
@@ -382,7 +544,7 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 	if (version >= 29) {
 		m_node_metadata.serialize(os, version, disk);
 	} else {
-		// use os_raw from above to avoid allocating another stream object
+		std::ostringstream os_raw(std::ios_base::binary);
 		m_node_metadata.serialize(os_raw, version, disk);
 		// prior to 29 node data was compressed individually
 		compress(os_raw.str(), os, version, compression_level);
@@ -413,11 +575,6 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 			m_node_timers.serialize(os, version);
 		}
 	}
-
-	if (version >= 29) {
-		// now compress the whole thing
-		compress(os_raw.str(), os_compressed, version, compression_level);
-	}
 }
 
 void MapBlock::serializeNetworkSpecific(std::ostream &os)
@@ -433,10 +590,14 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()<<std::endl);
 
 	m_is_air_expired = true;
+	expireContentMask();
+	getDataMutable();
 
 	if(version <= 21)
 	{
 		deSerialize_pre22(in_compressed, version, disk);
+		if (disk)
+			compactData();
 		return;
 	}
 
@@ -566,6 +727,15 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 		m_is_air_expired = false;
 	}
 
+	/*
+		Only blocks loaded from disk are compacted, which happens before they
+		are inserted into the map. The client deserializes received blocks in
+		place while mesh threads read their node array without a lock, so the
+		array must not be freed or swapped there.
+	*/
+	if (disk)
+		compactData();
+
 	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()
 			<<": Done."<<std::endl);
 }
@@ -20,6 +20,7 @@ class Map;
 class NodeMetadataList;
 class IGameDef;
 class MapBlockMesh;
+class MapBlockUsageList;
 class VoxelManipulator;
 
 #define BLOCK_TIMESTAMP_UNDEFINED 0xffffffff
@@ -75,16 +76,42 @@ class MapBlock
 
 	void reallocate()
 	{
-		for (u32 i = 0; i < nodecount; i++)
-			data[i] = MapNode(CONTENT_IGNORE);
+		fillData(MapNode(CONTENT_IGNORE));
+		m_content_mask = getContentBit(CONTENT_IGNORE);
+		m_content_mask_expired = false;
+		m_pointable_flags = 0;
+		m_pointable_expired = false;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
 	}
 
-	MapNode* getData()
+	// For reading only, the array may be shared with other blocks
+	const MapNode *getData() const
 	{
 		return data;
 	}
 
+	// Note: call expireContentMask() after modifying nodes through this
+	MapNode *getDataMutable()
+	{
+		if (m_data_shared)
+			unshareData();
+		return data;
+	}
+
+	// Sets all nodes to n
+	void fillData(MapNode n);
+
+	/*
+		Uniform blocks, which consist of a single node (e.g. air or stone),
+		share one read-only node array with all other blocks of that node
+		instead of using 16 KiB each. The first change makes a copy.
+	*/
+	bool isUniform() const { return m_data_shared; }
+
+	// Shares the node array if all nodes are the same and
+	// compact_uniform_mapblocks is enabled. Returns isUniform().
+	bool compactData();
+
 	////
 	//// Modification tracking methods
 	////
@@ -255,7 +282,10 @@ class MapBlock
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
-		data[z * zstride + y * ystride + x] = n;
+		writeNode(z * zstride + y * ystride + x, n);
+		m_content_mask |= getContentBit(n.getContent());
+		if (n.getContent() != CONTENT_AIR)
+			m_pointable_expired = true;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
 
@@ -280,7 +310,10 @@ class MapBlock
 
 	inline void setNodeNoCheck(s16 x, s16 y, s16 z, MapNode n)
 	{
-		data[z * zstride + y * ystride + x] = n;
+		writeNode(z * zstride + y * ystride + x, n);
+		m_content_mask |= getContentBit(n.getContent());
+		if (n.getContent() != CONTENT_AIR)
+			m_pointable_expired = true;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
 
@@ -310,6 +343,53 @@ class MapBlock
 		return m_is_air;
 	}
 
+	/*
+		Content presence summary: a bit mask with the bit getContentBit(c)
+		set for every content c that may be in the block. Bits are only added
+		when nodes are set, so this can have false positives but never false
+		negatives. It is recomputed from the node data when expired.
+	*/
+	static inline u64 getContentBit(content_t c)
+	{
+		return (u64)1 << (c & 63);
+	}
+
+	inline u64 getContentMask()
+	{
+		if (m_content_mask_expired)
+			actuallyUpdateContentMask();
+		return m_content_mask;
+	}
+
+	// Returns false if none of the contents in 'mask' can be in the block
+	inline bool mayContain(u64 mask)
+	{
+		return (getContentMask() & mask) != 0;
+	}
+
+	void actuallyUpdateContentMask();
+
+	void expireContentMask()
+	{
+		m_content_mask_expired = true;
+		m_pointable_expired = true;
+	}
+
+	/*
+		Whether the block may contain nodes that can be pointed at, not
+		taking pointabilities overrides into account. Raycasts use this
+		to skip whole blocks. Expires together with the content mask.
+	*/
+	inline bool mayBePointed(bool liquids_pointable)
+	{
+		if (m_pointable_expired)
+			actuallyUpdatePointable();
+		return (m_pointable_flags & POINTABLE_FLAG_NODES) ||
+				(liquids_pointable && (m_pointable_flags & POINTABLE_FLAG_LIQUIDS));
+	}
+
+	void actuallyUpdatePointable();
+
 	bool onObjectsActivation();
 	bool saveStaticObject(u16 id, const StaticObject &obj, u32 reason);
 
@@ -343,23 +423,14 @@ class MapBlock
 	}
 
 	////
-	//// Usage timer (see m_usage_timer)
+	//// Usage timer (see m_last_used)
 	////
 
-	inline void resetUsageTimer()
-	{
-		m_usage_timer = 0;
-	}
+	// Marks the block as used, in O(1)
+	inline void resetUsageTimer();
 
-	inline void incrementUsageTimer(float dtime)
-	{
-		m_usage_timer += dtime;
-	}
-
-	inline float getUsageTimer()
-	{
-		return m_usage_timer;
-	}
+	// Time since the last use, zero if the block is not part of a map
+	inline float getUsageTimer() const;
 
 	////
 	//// Reference counting (see m_refcount)
@@ -414,11 +485,15 @@ class MapBlock
 	// Set disk to true for on-disk format, false for over-the-network format
 	// Precondition: version >= SER_FMT_VER_LOWEST_WRITE
 	void serialize(std::ostream &result, u8 version, bool disk, int compression_level);
+	// Writes what serialize() compresses as a whole, for version >= 29.
+	// Passing it to compress() later gives the same result, but only this
+	// part needs access to the block.
+	void serializeUncompressed(std::ostream &os, u8 version, bool disk);
 	// If disk == true: In addition to doing other things, will add
 	// unknown blocks from id-name mapping to wndef
 	void deSerialize(std::istream &is, u8 version, bool disk);
 
-	void serializeNetworkSpecific(std::ostream &os);
+	static void serializeNetworkSpecific(std::ostream &os);
 	void deSerializeNetworkSpecific(std::istream &is);
 
 	bool storeActiveObject(u16 id);
@@ -435,6 +510,7 @@ class MapBlock
 		Private methods
 	*/
 
+	void serializeData(std::ostream &os, u8 version, bool disk, int compression_level);
 	void deSerialize_pre22(std::istream &is, u8 version, bool disk);
 
 	/*
@@ -478,16 +554,37 @@ class MapBlock
 	 * heap fragmentation (the array is exactly 16K), CPU caches and/or
 	 * optimizability of algorithms working on this array.
 	 */
-	MapNode *const data; // of `nodecount` elements
+	MapNode *data = nullptr; // of `nodecount` elements
+	// data is a shared array of a uniform block, see isUniform()
+	bool m_data_shared = false;
+
+	inline void writeNode(u32 i, MapNode n)
+	{
+		if (m_data_shared) {
+			// Stays uniform
+			if (data[i] == n)
+				return;
+			unshareData();
+		}
+		data[i] = n;
+	}
+
+	// Replaces the shared array with a copy owned by this block
+	void unshareData();
+	void freeData();
 
 	// provides the item and node definitions
 	IGameDef *m_gamedef;
 
 	/*
-		When the block is accessed, this is set to 0.
-		Map will unload the block when this reaches a timeout.
+		Links into the usage list of the map, which is ordered by m_last_used.
+		Map will unload the block when it was not used for a timeout.
 	*/
-	float m_usage_timer = 0;
+	friend class MapBlockUsageList;
+	MapBlockUsageList *m_usage_list = nullptr;
+	MapBlock *m_usage_prev = nullptr;
+	MapBlock *m_usage_next = nullptr;
+	double m_last_used = 0;
 
 public:
 	//// ABM optimizations ////
@@ -504,6 +601,14 @@ class MapBlock
 	bool m_is_air = false;
 	bool m_is_air_expired = true;
 
+	u64 m_content_mask = 0;
+	bool m_content_mask_expired = true;
+
+	static constexpr u8 POINTABLE_FLAG_NODES = 1;
+	static constexpr u8 POINTABLE_FLAG_LIQUIDS = 2;
+	u8 m_pointable_flags = 0;
+	bool m_pointable_expired = true;
+
 	/*
 		- On the server, this is used for telling whether the
 		  block has been modified from the one on disk.
@@ -553,6 +658,82 @@ class MapBlock
 
 typedef std::vector<MapBlock*> MapBlockVect;
 
+/*
+	The blocks of a map, ordered from the least to the most recently used.
+	Touching a block moves it to the back, so the blocks that exceed the
+	unload timeout are always at the front.
+*/
+class MapBlockUsageList
+{
+public:
+	MapBlockUsageList() = default;
+	DISABLE_CLASS_COPY(MapBlockUsageList);
+
+	// Adds a block as the most recently used one
+	void add(MapBlock *block);
+	void remove(MapBlock *block);
+
+	inline void touch(MapBlock *block)
+	{
+		block->m_last_used = m_time;
+		if (block == m_tail)
+			return;
+		unlink(block);
+		link(block);
+	}
+
+	// Advances the clock of the usage timers
+	void step(float dtime) { m_time += dtime; }
+	double getTime() const { return m_time; }
+
+	MapBlock *getOldest() const { return m_head; }
+	static MapBlock *getNext(const MapBlock *block) { return block->m_usage_next; }
+
+	size_t size() const { return m_size; }
+
+private:
+	// Appends the block at the back
+	inline void link(MapBlock *block)
+	{
+		block->m_usage_prev = m_tail;
+		block->m_usage_next = nullptr;
+		if (m_tail)
+			m_tail->m_usage_next = block;
+		else
+			m_head = block;
+		m_tail = block;
+	}
+
+	inline void unlink(MapBlock *block)
+	{
+		if (block->m_usage_prev)
+			block->m_usage_prev->m_usage_next = block->m_usage_next;
+		else
+			m_head = block->m_usage_next;
+		if (block->m_usage_next)
+			block->m_usage_next->m_usage_prev = block->m_usage_prev;
+		else
+			m_tail = block->m_usage_prev;
+		block->m_usage_prev = block->m_usage_next = nullptr;
+	}
+
+	MapBlock *m_head = nullptr;
+	MapBlock *m_tail = nullptr;
+	size_t m_size = 0;
+	double m_time = 0;
+};
+
+inline void MapBlock::resetUsageTimer()
+{
+	if (m_usage_list)
+		m_usage_list->touch(this);
+}
+
+inline float MapBlock::getUsageTimer() const
+{
+	return m_usage_list ? m_usage_list->getTime() - m_last_used : 0;
+}
+
 inline bool objectpos_over_limit(v3f p)
 {
 	const float max_limit_bs = (MAX_MAP_GENERATION_LIMIT + 0.5f) * BS;
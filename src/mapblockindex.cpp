@@ -0,0 +1,87 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "mapblockindex.h"
+#include <cassert>
+
+// Capacity of the first allocation, must be a power of two
+#define INDEX_MIN_CAPACITY 64
+
+void MapBlockIndex::insert(v3s16 p, MapBlock *block)
+{
+	assert(block);
+	// Keep the load factor at or below 1/2 so probe sequences stay short
+	if ((m_size + 1) * 2 > m_slots.size())
+		rehash(m_slots.empty() ? INDEX_MIN_CAPACITY : m_slots.size() * 2);
+
+	size_t i = home(p);
+	while (m_slots[i].block) {
+		assert(m_slots[i].pos != p);
+		i = (i + 1) & m_mask;
+	}
+	m_slots[i].pos = p;
+	m_slots[i].block = block;
+	m_size++;
+}
+
+bool MapBlockIndex::erase(v3s16 p)
+{
+	if (m_slots.empty())
+		return false;
+
+	size_t i = home(p);
+	while (m_slots[i].pos != p || !m_slots[i].block) {
+		if (!m_slots[i].block)
+			return false;
+		i = (i + 1) & m_mask;
+	}
+
+	/*
+		Backward shift deletion: move the following entries of the cluster
+		into the hole unless that would put them in front of their home slot.
+		This avoids tombstones, which would make lookups slower over time.
+	*/
+	for (size_t j = (i + 1) & m_mask; m_slots[j].block; j = (j + 1) & m_mask) {
+		const size_t k = home(m_slots[j].pos);
+		// Stays if its home is cyclically in (i, j]
+		const bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+		if (stays)
+			continue;
+		m_slots[i] = m_slots[j];
+		i = j;
+	}
+	m_slots[i].block = nullptr;
+	m_size--;
+	return true;
+}
+
+void MapBlockIndex::clear()
+{
+	m_slots.clear();
+	m_mask = 0;
+	m_shift = 64;
+	m_size = 0;
+}
+
+void MapBlockIndex::rehash(size_t capacity)
+{
+	assert((capacity & (capacity - 1)) == 0);
+	std::vector<Slot> old;
+	old.swap(m_slots);
+	m_slots.resize(capacity);
+	m_mask = capacity - 1;
+	m_shift = 64;
+	for (size_t c = capacity; c > 1; c >>= 1)
+		m_shift--;
+	m_size = 0;
+
+	for (const Slot &slot : old) {
+		if (!slot.block)
+			continue;
+		size_t i = home(slot.pos);
+		while (m_slots[i].block)
+			i = (i + 1) & m_mask;
+		m_slots[i] = slot;
+		m_size++;
+	}
+}
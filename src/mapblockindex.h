@@ -0,0 +1,65 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "irr_v3d.h"
+#include "util/basic_macros.h"
+#include <vector>
+
+class MapBlock;
+
+/*
+	Finds the loaded blocks of a map by their position.
+
+	This is an open addressing hash table with linear probing, so a lookup
+	usually touches a single cache line. It does not own the blocks.
+*/
+class MapBlockIndex
+{
+public:
+	MapBlockIndex() = default;
+	DISABLE_CLASS_COPY(MapBlockIndex);
+
+	// Returns nullptr if there is no such block
+	inline MapBlock *find(v3s16 p) const
+	{
+		if (m_slots.empty())
+			return nullptr;
+		for (size_t i = home(p); ; i = (i + 1) & m_mask) {
+			const Slot &slot = m_slots[i];
+			if (!slot.block || slot.pos == p)
+				return slot.block;
+		}
+	}
+
+	// The position must not be in the index yet
+	void insert(v3s16 p, MapBlock *block);
+	// Returns whether the position was in the index
+	bool erase(v3s16 p);
+	void clear();
+
+	size_t size() const { return m_size; }
+	size_t capacity() const { return m_slots.size(); }
+
+private:
+	struct Slot {
+		v3s16 pos;
+		MapBlock *block = nullptr;
+	};
+
+	inline size_t home(v3s16 p) const
+	{
+		const u64 key = (u64)(u16)p.X | (u64)(u16)p.Y << 16 | (u64)(u16)p.Z << 32;
+		// Fibonacci hashing, the upper bits are well mixed
+		return (key * 0x9E3779B97F4A7C15ULL) >> m_shift;
+	}
+
+	void rehash(size_t capacity);
+
+	std::vector<Slot> m_slots;
+	size_t m_mask = 0;
+	u8 m_shift = 64;
+	size_t m_size = 0;
+};
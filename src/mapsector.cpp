@@ -4,6 +4,7 @@
 
 #include "mapsector.h"
 #include "exceptions.h"
+#include "map.h"
 #include "mapblock.h"
 #include "serialization.h"
 
@@ -25,6 +26,8 @@ void MapSector::deleteBlocks()
 	m_block_cache = nullptr;
 
 	// Delete all blocks
+	for (auto &it : m_blocks)
+		m_parent->onBlockDetached(it.second.get(), this);
 	m_blocks.clear();
 }
 
@@ -52,6 +55,12 @@ MapBlock *MapSector::getBlockNoCreateNoEx(s16 y)
 	return getBlockBuffered(y);
 }
 
+MapBlock *MapSector::findBlock(s16 y) const
+{
+	auto it = m_blocks.find(y);
+	return it != m_blocks.end() ? it->second.get() : nullptr;
+}
+
 std::unique_ptr<MapBlock> MapSector::createBlankBlockNoInsert(s16 y)
 {
 	assert(getBlockBuffered(y) == nullptr); // Pre-condition
@@ -70,6 +79,7 @@ MapBlock *MapSector::createBlankBlock(s16 y)
 	MapBlock *block = block_u.get();
 
 	m_blocks[y] = std::move(block_u);
+	m_parent->onBlockInserted(block);
 
 	return block;
 }
@@ -87,7 +97,9 @@ void MapSector::insertBlock(std::unique_ptr<MapBlock> block)
 	assert(p2d == m_pos);
 
 	// Insert into container
+	MapBlock *block_p = block.get();
 	m_blocks[block_y] = std::move(block);
+	m_parent->onBlockInserted(block_p);
 }
 
 void MapSector::deleteBlock(MapBlock *block)
@@ -109,6 +121,7 @@ std::unique_ptr<MapBlock> MapSector::detachBlock(MapBlock *block)
 	std::unique_ptr<MapBlock> ret = std::move(it->second);
 	assert(ret.get() == block);
 	m_blocks.erase(it);
+	m_parent->onBlockDetached(block, this);
 
 	// Mark as removed
 	block->makeOrphan();
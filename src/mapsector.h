@@ -36,6 +36,9 @@ class MapSector
 	}
 
 	MapBlock *getBlockNoCreateNoEx(s16 y);
+	// Same as getBlockNoCreateNoEx() but without updating the lookup cache,
+	// so concurrent readers are fine while nobody modifies the sector.
+	MapBlock *findBlock(s16 y) const;
 	std::unique_ptr<MapBlock> createBlankBlockNoInsert(s16 y);
 	MapBlock *createBlankBlock(s16 y);
 
@@ -11,6 +11,7 @@
 #include "client/mesh_generator_thread.h"
 #include "chatmessage.h"
 #include "client/clientmedia.h"
+#include "client/blockcache.h"
 #include "log.h"
 #include "servermap.h"
 #include "mapsector.h"
@@ -29,6 +30,7 @@
 #include "util/serialize.h"
 #include "util/srp.h"
 #include "util/hashing.h"
+#include "util/formspec_diff.h"
 #include "tileanimation.h"
 #include "gettext.h"
 #include "skyparams.h"
@@ -283,7 +285,31 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 	*pkt >> p;
 
 	std::string datastring(pkt->getRemainingString(), pkt->getRemainingBytes());
-	std::istringstream istr(datastring, std::ios_base::binary);
+
+	updateBlockData(p, datastring);
+
+	if (m_block_cache)
+		m_block_cache->update(p, datastring);
+}
+
+void Client::handleCommand_BlockDataCached(NetworkPacket* pkt)
+{
+	v3s16 p;
+	*pkt >> p;
+
+	std::string datastring;
+	if (!m_block_cache || !m_block_cache->load(p, &datastring)) {
+		// Have the server send the full block instead
+		sendBlockCacheMiss(p);
+		return;
+	}
+
+	updateBlockData(p, datastring);
+}
+
+void Client::updateBlockData(v3s16 p, const std::string &data)
+{
+	std::istringstream istr(data, std::ios_base::binary);
 
 	MapSector *sector;
 	MapBlock *block;
@@ -944,6 +970,10 @@ void Client::handleCommand_ShowFormSpec(NetworkPacket* pkt)
 
 	*pkt >> formname;
 
+	// The server keeps the last formspec when the form is closed as well
+	if (!formspec.empty())
+		m_last_formspec = formspec;
+
 	ClientEvent *event = new ClientEvent();
 	event->type = CE_SHOW_FORMSPEC;
 	// pointer is required as event is a struct only!
@@ -953,6 +983,37 @@ void Client::handleCommand_ShowFormSpec(NetworkPacket* pkt)
 	m_client_event_queue.push(event);
 }
 
+void Client::handleCommand_FormspecDiff(NetworkPacket* pkt)
+{
+	std::string datastring(pkt->getString(0), pkt->getSize());
+	std::istringstream is(datastring, std::ios_base::binary);
+
+	std::string formname = deSerializeString16(is);
+	FormspecDiff diff;
+	diff.deSerialize(is);
+
+	std::string formspec;
+	if (!diff.apply(m_last_formspec, &formspec)) {
+		// Can only happen if the server lost track of what it sent
+		warningstream << "Client: Received formspec update for \"" << formname
+			<< "\" that does not apply to the last formspec, requesting it in full"
+			<< std::endl;
+		m_last_formspec.clear();
+
+		NetworkPacket resp(TOSERVER_FORMSPEC_DIFF_FAILED, 2 + formname.size());
+		resp << formname;
+		Send(&resp);
+		return;
+	}
+	m_last_formspec = formspec;
+
+	ClientEvent *event = new ClientEvent();
+	event->type = CE_SHOW_FORMSPEC;
+	event->show_formspec.formspec = new std::string(std::move(formspec));
+	event->show_formspec.formname = new std::string(formname);
+	m_client_event_queue.push(event);
+}
+
 void Client::handleCommand_SpawnParticle(NetworkPacket* pkt)
 {
 	std::string datastring(pkt->getString(0), pkt->getSize());
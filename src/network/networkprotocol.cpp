@@ -64,6 +64,8 @@
 		[scheduled bump for 5.11.0]
 	PROTOCOL VERSION 48
 		Add compression to some existing packets
+		Add TOSERVER_BLOCK_CACHE and TOCLIENT_BLOCKDATA_CACHED
+		Add TOCLIENT_FORMSPEC_DIFF and TOSERVER_FORMSPEC_DIFF_FAILED
 		[scheduled bump for 5.12.0]
 */
 
@@ -17,6 +17,9 @@ constexpr u16 CLIENT_PROTOCOL_VERSION_MIN = 37;
 
 extern const u16 FORMSPEC_API_VERSION;
 
+// Seed of the content hash used by TOSERVER_BLOCK_CACHE
+constexpr unsigned int BLOCK_CACHE_HASH_SEED = 0x6d74;
+
 #define TEXTURENAME_ALLOWED_CHARS "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_.-"
 
 typedef u16 session_t;
@@ -80,6 +83,15 @@ enum ToClientCommand : u16
 		v3s16 position
 	*/
 
+	TOCLIENT_BLOCKDATA_CACHED = 0x23,
+	/*
+		v3s16 position
+
+		The client announced (TOSERVER_BLOCK_CACHE) that it has this block
+		cached with the data the server would have sent in TOCLIENT_BLOCKDATA.
+		The client loads it from its cache instead.
+	*/
+
 	TOCLIENT_INVENTORY = 0x27,
 	/*
 		serialized inventory
@@ -649,6 +661,29 @@ enum ToClientCommand : u16
 		v3f added_pos
 	*/
 
+	TOCLIENT_FORMSPEC_DIFF = 0x5e,
+	/*
+		u16 len
+		u8[len] formname
+		u64 base_hash
+		u64 result_hash
+		u32 count
+		for each:
+			u32 start
+			u32 remove
+			u32 count
+			for each:
+				u32 len
+				u8[len] element
+
+		Like TOCLIENT_SHOW_FORMSPEC, but only sends the elements that changed
+		since the last formspec sent with either of the two packets.
+		Closing a form does not reset this base.
+		See FormspecDiff in util/formspec_diff.h.
+		If the diff does not apply, the client answers with
+		TOSERVER_FORMSPEC_DIFF_FAILED.
+	*/
+
 	TOCLIENT_SRP_BYTES_S_B = 0x60,
 	/*
 		Belonging to AUTH_MECHANISM_SRP.
@@ -761,6 +796,19 @@ enum ToServerCommand : u16
 		...
 	*/
 
+	TOSERVER_BLOCK_CACHE = 0x26,
+	/*
+		u16 count
+		for each:
+			v3s16 pos
+			u64 hash
+
+		Announces blocks held in the client-side block cache. `hash` is
+		murmur_hash_64_ua() (seed BLOCK_CACHE_HASH_SEED) of the data that was
+		received in TOCLIENT_BLOCKDATA after the position.
+		A hash of 0 means the block is no longer cached.
+	*/
+
 	TOSERVER_INVENTORY_ACTION = 0x31,
 	/*
 		See InventoryAction in inventorymanager.h
@@ -833,6 +881,15 @@ enum ToServerCommand : u16
 			u8[len] field value
 	*/
 
+	TOSERVER_FORMSPEC_DIFF_FAILED = 0x3d,
+	/*
+		u16 len
+		u8[len] formname
+
+		A TOCLIENT_FORMSPEC_DIFF did not apply. The server sends the last
+		formspec in full again.
+	*/
+
 	TOSERVER_REQUEST_MEDIA = 0x40,
 	/*
 		u16 number of files requested
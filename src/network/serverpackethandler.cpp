@@ -23,6 +23,7 @@
 #include "network/serveropcodes.h"
 #include "server/player_sao.h"
 #include "server/serverinventorymgr.h"
+#include "server/session_recorder.h"
 #include "util/auth.h"
 #include "util/base64.h"
 #include "util/pointedthing.h"
@@ -546,6 +547,35 @@ void Server::handleCommand_DeletedBlocks(NetworkPacket* pkt)
 	}
 }
 
+void Server::handleCommand_BlockCache(NetworkPacket* pkt)
+{
+	/*
+		[0] u16 command
+		[2] u16 count
+		[4] v3s16 pos_0
+		[4+6] u64 hash_0
+		...
+	*/
+
+	u16 count;
+	*pkt >> count;
+
+	ClientInterface::AutoLock lock(m_clients);
+	RemoteClient *client = m_clients.lockedGetClientNoEx(pkt->getPeerId(), CS_InitDone);
+	if (!client)
+		return;
+
+	for (u16 i = 0; i < count; i++) {
+		v3s16 p;
+		u64 hash;
+		*pkt >> p >> hash;
+		client->setCachedBlock(p, hash);
+		// The client no longer has this block, send it again
+		if (hash == 0)
+			client->SetBlockNotSent(p);
+	}
+}
+
 void Server::handleCommand_InventoryAction(NetworkPacket* pkt)
 {
 	session_t peer_id = pkt->getPeerId();
@@ -1413,6 +1443,30 @@ void Server::handleCommand_InventoryFields(NetworkPacket* pkt)
 	actionstream << ", possible exploitation attempt" << std::endl;
 }
 
+void Server::handleCommand_FormspecDiffFailed(NetworkPacket* pkt)
+{
+	session_t peer_id = pkt->getPeerId();
+	std::string formname;
+	*pkt >> formname;
+
+	const auto sent = m_formspec_sent.find(peer_id);
+	if (sent == m_formspec_sent.end())
+		return;
+
+	// Only show the form again if it is still open
+	const auto state = m_formspec_state_data.find(peer_id);
+	if (state == m_formspec_state_data.end() || state->second != formname) {
+		// The client dropped its base, the next formspec is sent in full
+		m_formspec_sent.erase(sent);
+		return;
+	}
+
+	NetworkPacket resp(TOCLIENT_SHOW_FORMSPEC, 0, peer_id);
+	resp.putLongString(sent->second);
+	resp << formname;
+	Send(&resp);
+}
+
 void Server::handleCommand_FirstSrp(NetworkPacket* pkt)
 {
 	session_t peer_id = pkt->getPeerId();
@@ -1652,12 +1706,23 @@ void Server::handleCommand_SrpBytesM(NetworkPacket* pkt)
 		return;
 	}
 
-	unsigned char *bytes_HAMK = 0;
+	bool verified;
+	auto recorded = m_recorded_auth.find(peer_id);
+	if (recorded != m_recorded_auth.end()) {
+		// Replayed session: B is random, so the recorded bytes_M can't match it
+		verified = recorded->second;
+		m_recorded_auth.erase(recorded);
+	} else {
+		unsigned char *bytes_HAMK = 0;
+		srp_verifier_verify_session((SRPVerifier *) client->auth_data,
+			(unsigned char *)bytes_M.c_str(), &bytes_HAMK);
+		verified = bytes_HAMK != nullptr;
+	}
 
-	srp_verifier_verify_session((SRPVerifier *) client->auth_data,
-		(unsigned char *)bytes_M.c_str(), &bytes_HAMK);
+	if (m_session_recorder)
+		m_session_recorder->recordAuth(peer_id, verified);
 
-	if (!bytes_HAMK) {
+	if (!verified) {
 		if (wantSudo) {
 			actionstream << "Server: User " << playername << " at " << addr_s
 				<< " tried to change their password, but supplied wrong"
@@ -9,8 +9,12 @@
 
 #include "pathfinder.h"
 #include "map.h"
+#include "mapblock.h"
 #include "nodedef.h"
+#include "profiler.h"
 #include "irrlicht_changes/printing.h"
+#include "threading/mutex_auto_lock.h"
+#include "threading/task_pool.h"
 
 //#define PATHFINDER_DEBUG
 //#define PATHFINDER_CALC_TIME
@@ -47,6 +51,12 @@
 
 #define PATHFINDER_MAX_WAYPOINTS 700
 
+/** number of mapblocks the navigation cache may hold (4 KiB each) */
+#define NAVIGATION_CACHE_MAX_BLOCKS 4096
+
+/** queued searches over more mapblocks than this run on the server thread */
+#define PATHFINDER_MAX_PREFETCH_BLOCKS 512
+
 /******************************************************************************/
 /* Class definitions                                                          */
 /******************************************************************************/
@@ -159,7 +169,7 @@ class MapGridNodeContainer : public GridNodeContainer {
 	MapGridNodeContainer(Pathfinder *pathf);
 	virtual PathGridnode &access(v3s16 p);
 private:
-	std::map<v3s16, PathGridnode> m_nodes;
+	std::unordered_map<v3s16, PathGridnode> m_nodes;
 };
 
 /** class doing pathfinding */
@@ -167,7 +177,7 @@ class Pathfinder {
 
 public:
 	Pathfinder() = delete;
-	Pathfinder(Map *map, const NodeDefManager *ndef) : m_map(map), m_ndef(ndef) {}
+	Pathfinder(NavigationView *nav) : m_nav(nav) {}
 
 	~Pathfinder();
 
@@ -309,9 +319,7 @@ class Pathfinder {
 	friend class GridNodeContainer;
 	GridNodeContainer *m_nodes_container = nullptr;
 
-	Map *m_map = nullptr;
-
-	const NodeDefManager *m_ndef = nullptr;
+	NavigationView *m_nav = nullptr;
 
 	friend class PathfinderCompareHeuristic;
 
@@ -401,10 +409,223 @@ std::vector<v3s16> get_path(Map* map, const NodeDefManager *ndef,
 		unsigned int max_drop,
 		PathAlgorithm algo)
 {
-	return Pathfinder(map, ndef).getPath(source, destination,
+	NavigationCache cache(map, ndef);
+	NavigationView nav(&cache);
+	return Pathfinder(&nav).getPath(source, destination,
 				searchdistance, max_jump, max_drop, algo);
 }
 
+/******************************************************************************/
+/**
+ * nodes a path search may look at; the pathfinder looks one node below its
+ * limits and walks down from the start and end positions
+ */
+static core::aabbox3d<s16> getSearchArea(const PathQuery &query)
+{
+	auto clamp = [] (s32 v) -> s16 {
+		return rangelim(v, -MAX_MAP_GENERATION_LIMIT, MAX_MAP_GENERATION_LIMIT);
+	};
+	s32 d = MYMIN(query.searchdistance, (unsigned int)MAX_MAP_GENERATION_LIMIT);
+	s32 down = MYMIN(MYMAX(query.max_jump, query.max_drop),
+			(unsigned int)MAX_MAP_GENERATION_LIMIT) + 1;
+	core::aabbox3d<s16> area(query.source);
+	area.addInternalPoint(query.destination);
+	area.MinEdge.X = clamp(area.MinEdge.X - d);
+	area.MinEdge.Y = clamp(area.MinEdge.Y - d - down);
+	area.MinEdge.Z = clamp(area.MinEdge.Z - d);
+	area.MaxEdge.X = clamp(area.MaxEdge.X + d);
+	area.MaxEdge.Y = clamp(area.MaxEdge.Y + d);
+	area.MaxEdge.Z = clamp(area.MaxEdge.Z + d);
+	return area;
+}
+
+/******************************************************************************/
+std::shared_ptr<const NavBlock> NavigationCache::getBlock(v3s16 blockpos)
+{
+	auto it = m_blocks.find(blockpos);
+	if (it != m_blocks.end())
+		return it->second;
+
+	// Unloaded blocks are not cached as no event tells when they are loaded
+	MapBlock *block = m_map->getBlockNoCreateNoEx(blockpos);
+	if (!block)
+		return nullptr;
+
+	if (m_blocks.size() >= NAVIGATION_CACHE_MAX_BLOCKS) {
+		VERBOSE_TARGET << "Navigation cache full, clearing it" << std::endl;
+		m_blocks.clear();
+	}
+	auto nav_block = buildBlock(block);
+	m_blocks.emplace(blockpos, nav_block);
+	return nav_block;
+}
+
+/******************************************************************************/
+std::shared_ptr<const NavBlock> NavigationCache::buildBlock(MapBlock *block)
+{
+	if (block->isAir()) {
+		if (!m_air_block) {
+			auto air_block = std::make_shared<NavBlock>();
+			air_block->fill(NAV_OPEN);
+			m_air_block = air_block;
+		}
+		return m_air_block;
+	}
+
+	auto nav_block = std::make_shared<NavBlock>();
+	const MapNode *data = block->getData();
+	for (u32 i = 0; i < MapBlock::nodecount; i++) {
+		content_t c = data[i].getContent();
+		if (c == CONTENT_IGNORE)
+			(*nav_block)[i] = NAV_IGNORE;
+		else
+			(*nav_block)[i] = m_ndef->get(c).walkable ? NAV_WALKABLE : NAV_OPEN;
+	}
+	return nav_block;
+}
+
+/******************************************************************************/
+void NavigationCache::onMapEditEvent(const MapEditEvent &event)
+{
+	for (v3s16 blockpos : event.modified_blocks)
+		m_blocks.erase(blockpos);
+}
+
+/******************************************************************************/
+void NavigationView::prefetch(const core::aabbox3d<s16> &area)
+{
+	v3s16 bpmin = getNodeBlockPos(area.MinEdge);
+	v3s16 bpmax = getNodeBlockPos(area.MaxEdge);
+	for (s16 z = bpmin.Z; z <= bpmax.Z; z++)
+	for (s16 y = bpmin.Y; y <= bpmax.Y; y++)
+	for (s16 x = bpmin.X; x <= bpmax.X; x++) {
+		v3s16 blockpos(x, y, z);
+		if (m_blocks.find(blockpos) == m_blocks.end())
+			m_blocks.emplace(blockpos, m_cache->getBlock(blockpos));
+	}
+}
+
+/******************************************************************************/
+NavNode NavigationView::get(v3s16 pos)
+{
+	v3s16 blockpos = getNodeBlockPos(pos);
+	if (blockpos != m_last_blockpos) {
+		auto it = m_blocks.find(blockpos);
+		if (it == m_blocks.end()) {
+			std::shared_ptr<const NavBlock> block;
+			if (m_cache)
+				block = m_cache->getBlock(blockpos);
+			it = m_blocks.emplace(blockpos, std::move(block)).first;
+		}
+		m_last_blockpos = blockpos;
+		m_last_block = it->second.get();
+	}
+	if (!m_last_block)
+		return NAV_IGNORE;
+
+	v3s16 rel = pos - blockpos * MAP_BLOCKSIZE;
+	return (*m_last_block)[rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+			rel.Y * MAP_BLOCKSIZE + rel.X];
+}
+
+/******************************************************************************/
+PathfinderService::PathfinderService(Map *map, const NodeDefManager *ndef) :
+	m_map(map),
+	m_cache(map, ndef),
+	m_results(std::make_shared<Results>())
+{
+	m_map->addEventReceiver(&m_cache);
+}
+
+/******************************************************************************/
+PathfinderService::~PathfinderService()
+{
+	m_map->removeEventReceiver(&m_cache);
+}
+
+/******************************************************************************/
+std::vector<v3s16> PathfinderService::findPath(const PathQuery &query)
+{
+	NavigationView nav(&m_cache);
+	return Pathfinder(&nav).getPath(query.source, query.destination,
+			query.searchdistance, query.max_jump, query.max_drop, query.algo);
+}
+
+/******************************************************************************/
+void PathfinderService::queuePath(const PathQuery &query, Callback callback)
+{
+	m_queued.emplace_back(query, std::move(callback));
+}
+
+/******************************************************************************/
+void PathfinderService::step()
+{
+	deliverResults(false);
+
+	if (m_queued.empty())
+		return;
+
+	g_profiler->avg("Pathfinder: paths started", m_queued.size());
+
+	// Everything a search reads is fetched here, so that the searches do
+	// not need to access the map
+	for (auto &it : m_queued) {
+		m_running++;
+
+		// Prefetching would cost more than the search itself for huge areas
+		core::aabbox3d<s16> area = getSearchArea(it.first);
+		v3s32 blocks = v3s32::from(getNodeBlockPos(area.MaxEdge) -
+				getNodeBlockPos(area.MinEdge)) + 1;
+		if (blocks.X * blocks.Y * blocks.Z > PATHFINDER_MAX_PREFETCH_BLOCKS) {
+			std::vector<v3s16> path = findPath(it.first);
+			MutexAutoLock lock(m_results->mutex);
+			m_results->done.emplace_back(std::move(it.second), std::move(path));
+			continue;
+		}
+
+		auto nav = std::make_shared<NavigationView>(&m_cache);
+		nav->prefetch(area);
+		nav->detach();
+
+		std::shared_ptr<Results> results = m_results;
+		TaskPool::get().post([nav, query = it.first,
+				callback = std::move(it.second), results] () mutable {
+			std::vector<v3s16> path = Pathfinder(nav.get()).getPath(
+					query.source, query.destination, query.searchdistance,
+					query.max_jump, query.max_drop, query.algo);
+			MutexAutoLock lock(results->mutex);
+			results->done.emplace_back(std::move(callback), std::move(path));
+			results->cv.notify_all();
+		}, TaskPriority::Low, "Pathfinder: path search");
+	}
+	m_queued.clear();
+
+	g_profiler->avg("Pathfinder: cached blocks", m_cache.size());
+}
+
+/******************************************************************************/
+void PathfinderService::finish()
+{
+	step();
+	while (m_running > 0)
+		deliverResults(true);
+}
+
+/******************************************************************************/
+void PathfinderService::deliverResults(bool wait)
+{
+	std::vector<std::pair<Callback, std::vector<v3s16>>> done;
+	{
+		std::unique_lock<std::mutex> lock(m_results->mutex);
+		if (wait)
+			m_results->cv.wait(lock, [&] { return !m_results->done.empty(); });
+		done.swap(m_results->done);
+	}
+	m_running -= done.size();
+	for (auto &it : done)
+		it.first(std::move(it.second));
+}
+
 /******************************************************************************/
 PathCost::PathCost(const PathCost &b)
 {
@@ -501,20 +722,19 @@ void PathGridnode::setCost(v3s16 dir, const PathCost &cost)
 
 void GridNodeContainer::initNode(v3s16 ipos, PathGridnode *p_node)
 {
-	const NodeDefManager *ndef = m_pathf->m_ndef;
 	PathGridnode &elem = *p_node;
 
 	v3s16 realpos = m_pathf->getRealPos(ipos);
 
-	MapNode current = m_pathf->m_map->getNode(realpos);
-	MapNode below   = m_pathf->m_map->getNode(realpos + v3s16(0, -1, 0));
+	NavNode current = m_pathf->m_nav->get(realpos);
+	NavNode below   = m_pathf->m_nav->get(realpos + v3s16(0, -1, 0));
 
 
-	if ((current.param0 == CONTENT_IGNORE) ||
-			(below.param0 == CONTENT_IGNORE)) {
+	if ((current == NAV_IGNORE) ||
+			(below == NAV_IGNORE)) {
 		DEBUG_OUT("Pathfinder: " << realpos <<
 			" current or below is invalid element" << std::endl);
-		if (current.param0 == CONTENT_IGNORE) {
+		if (current == NAV_IGNORE) {
 			elem.type = 'i';
 			DEBUG_OUT(ipos << ": " << 'i' << std::endl);
 		}
@@ -522,10 +742,10 @@ void GridNodeContainer::initNode(v3s16 ipos, PathGridnode *p_node)
 	}
 
 	//don't add anything if it isn't an air node
-	if (ndef->get(current).walkable || !ndef->get(below).walkable) {
+	if (current == NAV_WALKABLE || below != NAV_WALKABLE) {
 			DEBUG_OUT("Pathfinder: " << realpos
 				<< " not on surface" << std::endl);
-			if (ndef->get(current).walkable) {
+			if (current == NAV_WALKABLE) {
 				elem.type = 's';
 				DEBUG_OUT(ipos << ": " << 's' << std::endl);
 			} else {
@@ -652,14 +872,12 @@ std::vector<v3s16> Pathfinder::getPath(v3s16 source,
 #endif
 
 	//fail if source or destination is walkable
-	MapNode node_at_pos = m_map->getNode(destination);
-	if (m_ndef->get(node_at_pos).walkable) {
+	if (m_nav->get(destination) == NAV_WALKABLE) {
 		VERBOSE_TARGET << "Destination is walkable. " <<
 				"Pos: " << destination << std::endl;
 		return retval;
 	}
-	node_at_pos = m_map->getNode(source);
-	if (m_ndef->get(node_at_pos).walkable) {
+	if (m_nav->get(source) == NAV_WALKABLE) {
 		VERBOSE_TARGET << "Source is walkable. " <<
 				"Pos: " << source << std::endl;
 		return retval;
@@ -825,28 +1043,28 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 		return retval;
 	}
 
-	MapNode node_at_pos2 = m_map->getNode(pos2);
+	NavNode node_at_pos2 = m_nav->get(pos2);
 
 	//did we get information about node?
-	if (node_at_pos2.param0 == CONTENT_IGNORE ) {
+	if (node_at_pos2 == NAV_IGNORE) {
 			VERBOSE_TARGET << "Pathfinder: (1) area at pos: "
 					<< pos2 << " not loaded";
 			return retval;
 	}
 
-	if (!m_ndef->get(node_at_pos2).walkable) {
-		MapNode node_below_pos2 =
-			m_map->getNode(pos2 + v3s16(0, -1, 0));
+	if (node_at_pos2 != NAV_WALKABLE) {
+		NavNode node_below_pos2 =
+			m_nav->get(pos2 + v3s16(0, -1, 0));
 
 		//did we get information about node?
-		if (node_below_pos2.param0 == CONTENT_IGNORE ) {
+		if (node_below_pos2 == NAV_IGNORE) {
 				VERBOSE_TARGET << "Pathfinder: (2) area at pos: "
 					<< (pos2 + v3s16(0, -1, 0)) << " not loaded";
 				return retval;
 		}
 
 		//test if the same-height neighbor is suitable
-		if (m_ndef->get(node_below_pos2).walkable) {
+		if (node_below_pos2 == NAV_WALKABLE) {
 			//SUCCESS!
 			retval.valid = true;
 			retval.value = 1;
@@ -857,19 +1075,19 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 		else {
 			//test if we can fall a couple of nodes (m_maxdrop)
 			v3s16 testpos = pos2 + v3s16(0, -1, 0);
-			MapNode node_at_pos = m_map->getNode(testpos);
+			NavNode node_at_pos = m_nav->get(testpos);
 
-			while ((node_at_pos.param0 != CONTENT_IGNORE) &&
-					(!m_ndef->get(node_at_pos).walkable) &&
+			while ((node_at_pos != NAV_IGNORE) &&
+					(node_at_pos != NAV_WALKABLE) &&
 					(testpos.Y > m_limits.MinEdge.Y)) {
 				testpos += v3s16(0, -1, 0);
-				node_at_pos = m_map->getNode(testpos);
+				node_at_pos = m_nav->get(testpos);
 			}
 
 			//did we find surface?
 			if ((testpos.Y >= m_limits.MinEdge.Y) &&
-					(node_at_pos.param0 != CONTENT_IGNORE) &&
-					(m_ndef->get(node_at_pos).walkable)) {
+					(node_at_pos != NAV_IGNORE) &&
+					(node_at_pos == NAV_WALKABLE)) {
 				if ((pos2.Y - testpos.Y - 1) <= m_maxdrop) {
 					//SUCCESS!
 					retval.valid = true;
@@ -895,34 +1113,34 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 
 		v3s16 targetpos = pos2; // position for jump target
 		v3s16 jumppos = pos; // position for checking if jumping space is free
-		MapNode node_target = m_map->getNode(targetpos);
-		MapNode node_jump = m_map->getNode(jumppos);
+		NavNode node_target = m_nav->get(targetpos);
+		NavNode node_jump = m_nav->get(jumppos);
 		bool headbanger = false; // true if anything blocks jumppath
 
-		while ((node_target.param0 != CONTENT_IGNORE) &&
-				(m_ndef->get(node_target).walkable) &&
+		while ((node_target != NAV_IGNORE) &&
+				(node_target == NAV_WALKABLE) &&
 				(targetpos.Y < m_limits.MaxEdge.Y)) {
 			//if the jump would hit any solid node, discard
-			if ((node_jump.param0 == CONTENT_IGNORE) ||
-					(m_ndef->get(node_jump).walkable)) {
+			if ((node_jump == NAV_IGNORE) ||
+					(node_jump == NAV_WALKABLE)) {
 					headbanger = true;
 				break;
 			}
 			targetpos += v3s16(0, 1, 0);
 			jumppos   += v3s16(0, 1, 0);
-			node_target = m_map->getNode(targetpos);
-			node_jump   = m_map->getNode(jumppos);
+			node_target = m_nav->get(targetpos);
+			node_jump   = m_nav->get(jumppos);
 
 		}
 		//check headbanger one last time
-		if ((node_jump.param0 == CONTENT_IGNORE) ||
-			(m_ndef->get(node_jump).walkable)) {
+		if ((node_jump == NAV_IGNORE) ||
+			(node_jump == NAV_WALKABLE)) {
 			headbanger = true;
 		}
 
 		//did we find surface without banging our head?
 		if ((!headbanger) && (targetpos.Y <= m_limits.MaxEdge.Y) &&
-				(!m_ndef->get(node_target).walkable)) {
+				(node_target != NAV_WALKABLE)) {
 
 			if (targetpos.Y - pos2.Y <= m_maxjump) {
 				//SUCCESS!
@@ -1222,20 +1440,20 @@ v3s16 Pathfinder::walkDownwards(v3s16 pos, unsigned int max_down) {
 	if (max_down == 0)
 		return pos;
 	v3s16 testpos = v3s16(pos);
-	MapNode node_at_pos = m_map->getNode(testpos);
+	NavNode node_at_pos = m_nav->get(testpos);
 	unsigned int down = 0;
-	while ((node_at_pos.param0 != CONTENT_IGNORE) &&
-			(!m_ndef->get(node_at_pos).walkable) &&
+	while ((node_at_pos != NAV_IGNORE) &&
+			(node_at_pos != NAV_WALKABLE) &&
 			(testpos.Y > m_limits.MinEdge.Y) &&
 			(down <= max_down)) {
 		testpos += v3s16(0, -1, 0);
 		down++;
-		node_at_pos = m_map->getNode(testpos);
+		node_at_pos = m_nav->get(testpos);
 	}
 	//did we find surface?
 	if ((testpos.Y >= m_limits.MinEdge.Y) &&
-			(node_at_pos.param0 != CONTENT_IGNORE) &&
-			(m_ndef->get(node_at_pos).walkable)) {
+			(node_at_pos != NAV_IGNORE) &&
+			(node_at_pos == NAV_WALKABLE)) {
 		if (down == 0) {
 			pos = testpos;
 		} else if ((down - 1) <= max_down) {
@@ -7,8 +7,16 @@
 /******************************************************************************/
 /* Includes                                                                   */
 /******************************************************************************/
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include "irr_v3d.h"
+#include "constants.h"
+#include "map.h"
 
 /******************************************************************************/
 /* Forward declarations                                                       */
@@ -16,6 +24,7 @@
 
 class NodeDefManager;
 class Map;
+class MapBlock;
 
 /******************************************************************************/
 /* Typedefs and macros                                                        */
@@ -35,11 +44,140 @@ typedef enum {
 	PA_PLAIN_NP          /**< A* algorithm without prefetching of map data */
 } PathAlgorithm;
 
+/** walkability of a node as seen by the pathfinder */
+enum NavNode : u8 {
+	NAV_IGNORE,            /**< node is not loaded                 */
+	NAV_OPEN,              /**< node can be walked through         */
+	NAV_WALKABLE           /**< node can be walked on              */
+};
+
+/** walkability of all nodes of a mapblock, indexed like MapBlock data */
+typedef std::array<NavNode, MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE> NavBlock;
+
+/** parameters of a single path search */
+struct PathQuery {
+	v3s16 source;
+	v3s16 destination;
+	unsigned int searchdistance = 0;
+	unsigned int max_jump = 0;
+	unsigned int max_drop = 0;
+	PathAlgorithm algo = PA_PLAIN_NP;
+};
+
+/**
+ * Walkability of the loaded map, kept per mapblock so that path searches
+ * do not need to look up the same nodes again. Blocks are dropped on
+ * map edit events, so only use it for maps that send them.
+ * Not thread-safe, use it with the environment lock held.
+ */
+class NavigationCache : public MapEventReceiver {
+public:
+	NavigationCache(Map *map, const NodeDefManager *ndef) :
+		m_map(map), m_ndef(ndef) {}
+
+	/**
+	 * get the walkability data of a mapblock
+	 * @param blockpos position of the block
+	 * @return block data or nullptr if the block is not loaded
+	 */
+	std::shared_ptr<const NavBlock> getBlock(v3s16 blockpos);
+
+	void onMapEditEvent(const MapEditEvent &event) override;
+
+	size_t size() const { return m_blocks.size(); }
+
+	void clear() { m_blocks.clear(); }
+
+private:
+	std::shared_ptr<const NavBlock> buildBlock(MapBlock *block);
+
+	Map *m_map;
+	const NodeDefManager *m_ndef;
+	std::unordered_map<v3s16, std::shared_ptr<const NavBlock>> m_blocks;
+	/** shared by all blocks that only contain air */
+	std::shared_ptr<const NavBlock> m_air_block;
+};
+
+/**
+ * Node lookups of a single path search. Blocks are fetched from the
+ * cache on first use and kept, so a detached view can be searched on
+ * another thread.
+ */
+class NavigationView {
+public:
+	NavigationView(NavigationCache *cache) : m_cache(cache) {}
+
+	/**
+	 * fetch all blocks containing a part of an area
+	 * @param area node positions that will be looked up
+	 */
+	void prefetch(const core::aabbox3d<s16> &area);
+
+	/** stop fetching blocks, all others are treated as not loaded */
+	void detach() { m_cache = nullptr; }
+
+	NavNode get(v3s16 pos);
+
+private:
+	NavigationCache *m_cache;
+	std::unordered_map<v3s16, std::shared_ptr<const NavBlock>> m_blocks;
+	v3s16 m_last_blockpos{S16_MAX, S16_MAX, S16_MAX};
+	const NavBlock *m_last_block = nullptr;
+};
+
+/**
+ * Runs path searches for the server environment, sharing one navigation
+ * cache between them. Queued searches are started in step() and run on
+ * the task pool; their callbacks are run by a later step().
+ */
+class PathfinderService {
+public:
+	typedef std::function<void(std::vector<v3s16> &&path)> Callback;
+
+	PathfinderService(Map *map, const NodeDefManager *ndef);
+	~PathfinderService();
+
+	/** search a path right away */
+	std::vector<v3s16> findPath(const PathQuery &query);
+
+	/**
+	 * queue a path search
+	 * @param callback receives the path, empty if none was found
+	 */
+	void queuePath(const PathQuery &query, Callback callback);
+
+	/** start queued searches and run the callbacks of finished ones */
+	void step();
+
+	/** wait for all started searches and run their callbacks */
+	void finish();
+
+	/** number of searches that are queued or running */
+	size_t getPendingCount() const { return m_queued.size() + m_running; }
+
+	NavigationCache &getCache() { return m_cache; }
+
+private:
+	struct Results {
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::vector<std::pair<Callback, std::vector<v3s16>>> done;
+	};
+
+	void deliverResults(bool wait);
+
+	Map *m_map;
+	NavigationCache m_cache;
+	std::vector<std::pair<PathQuery, Callback>> m_queued;
+	std::shared_ptr<Results> m_results;
+	size_t m_running = 0;
+};
+
 /******************************************************************************/
 /* declarations                                                               */
 /******************************************************************************/
 
-/** c wrapper function to use from scriptapi */
+/** search a path without any caching */
 std::vector<v3s16> get_path(Map *map, const NodeDefManager *ndef,
 		v3s16 source,
 		v3s16 destination,
@@ -4,6 +4,7 @@
 
 #include "profiler.h"
 #include "porting.h"
+#include "util/trace.h"
 
 static Profiler main_profiler;
 Profiler *g_profiler = &main_profiler;
@@ -13,12 +14,17 @@ ScopeProfiler::ScopeProfiler(Profiler *profiler, const std::string &name,
 	m_profiler(profiler),
 	m_name(name), m_type(type), m_precision(prec)
 {
+	if (g_tracer->isRecording() && g_tracer->begin(m_name))
+		m_trace_session = g_tracer->getSession();
 	m_name.append(" [").append(TimePrecision_units[prec]).append("]");
 	m_time1 = porting::getTime(prec);
 }
 
 ScopeProfiler::~ScopeProfiler()
 {
+	if (m_trace_session != 0 && g_tracer->getSession() == m_trace_session)
+		g_tracer->end();
+
 	if (!m_profiler)
 		return;
 
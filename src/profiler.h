@@ -116,4 +116,6 @@ class ScopeProfiler
 	u64 m_time1;
 	ScopeProfilerType m_type;
 	TimePrecision m_precision;
+	// See TraceScope
+	u32 m_trace_session = 0;
 };
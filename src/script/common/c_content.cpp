@@ -1380,11 +1380,18 @@ ItemStack read_item(lua_State* L, int index, IItemDefManager *idef)
 
 	if (lua_isstring(L, index)) {
 		// Convert from itemstring
-		std::string itemstring = lua_tostring(L, index);
+		size_t len;
+		const char *str = lua_tolstring(L, index, &len);
+		std::string_view itemstring(str, len);
+		// Plain item names are by far the most common itemstrings. They go
+		// straight to the interned name without the parser.
+		if (idef && itemstring.find_first_of(" \"") == std::string_view::npos)
+			return ItemStack(idef->getItemName(itemstring), 1, 0, idef);
+
 		try
 		{
 			ItemStack item;
-			item.deSerialize(itemstring, idef);
+			item.deSerialize(std::string(itemstring), idef);
 			return item;
 		}
 		catch(SerializationError &e)
@@ -1397,11 +1404,12 @@ ItemStack read_item(lua_State* L, int index, IItemDefManager *idef)
 	else if(lua_istable(L, index))
 	{
 		// Convert from table
-		std::string name = getstringfield_default(L, index, "name", "");
+		std::string_view name;
+		getstringfield(L, index, "name", name);
 		int count = getintfield_default(L, index, "count", 1);
 		int wear = getintfield_default(L, index, "wear", 0);
 
-		ItemStack istack(name, count, wear, idef);
+		ItemStack istack(idef->getItemName(name), count, wear, idef);
 
 		// BACKWARDS COMPATIBLITY
 		std::string value = getstringfield_default(L, index, "metadata", "");
@@ -0,0 +1,258 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "cpp_api/s_accounting.h"
+#include "cpp_api/s_base.h"
+#include "log.h"
+#include "porting.h"
+#include <algorithm>
+
+// Minimum time between two budget warnings of a mod
+#define BUDGET_WARNING_INTERVAL_US 10000000
+
+static const char *const callback_type_names[] = {
+	"globalstep",
+	"abm",
+	"lbm",
+	"entity_step",
+	"node_timer",
+	"on_generated",
+};
+
+static_assert(ARRLEN(callback_type_names) == (size_t)ScriptCallbackType::COUNT);
+
+const char *script_callback_type_name(ScriptCallbackType type)
+{
+	return callback_type_names[(size_t)type];
+}
+
+ScriptAccounting::ScriptAccounting(lua_State *L, MetricsBackend *metrics) :
+	m_lua(L), m_metrics(metrics)
+{
+}
+
+s64 ScriptAccounting::getHeapSize() const
+{
+	return (s64)lua_gc(m_lua, LUA_GCCOUNT, 0) * 1024 + lua_gc(m_lua, LUA_GCCOUNTB, 0);
+}
+
+void ScriptAccounting::beginScope(ScriptCallbackType type, const std::string &name)
+{
+	if (m_depth++ > 0)
+		return;
+	m_type = type;
+	m_name = name;
+	m_in_slice = false;
+}
+
+void ScriptAccounting::endScope()
+{
+	assert(m_depth > 0);
+	if (--m_depth > 0)
+		return;
+	if (m_in_slice)
+		endSlice();
+}
+
+void ScriptAccounting::setMod(const std::string &mod)
+{
+	if (m_depth == 0)
+		return;
+	if (m_in_slice) {
+		if (mod == m_mod)
+			return;
+		endSlice();
+	}
+	m_mod = mod;
+	beginSlice();
+}
+
+void ScriptAccounting::beginNested()
+{
+	m_nested.push_back({m_depth > 0 && m_in_slice, m_mod});
+}
+
+void ScriptAccounting::endNested()
+{
+	assert(!m_nested.empty());
+	NestedOrigin &origin = m_nested.back();
+	// Scopes opened by the callback itself are closed by now
+	if (origin.in_slice && m_depth > 0 &&
+			!(m_in_slice && m_mod == origin.mod)) {
+		if (m_in_slice)
+			endSlice();
+		m_mod = std::move(origin.mod);
+		beginSlice(true);
+	}
+	m_nested.pop_back();
+}
+
+void ScriptAccounting::beginSlice(bool resumed)
+{
+	m_in_slice = true;
+	m_slice_resumed = resumed;
+	m_slice_heap = getHeapSize();
+	m_slice_start_us = porting::getTimeUs();
+}
+
+void ScriptAccounting::endSlice()
+{
+	const u64 time_us = porting::getTimeUs() - m_slice_start_us;
+	const u64 memory = std::max<s64>(getHeapSize() - m_slice_heap, 0);
+	m_in_slice = false;
+
+	Entry &entry = getEntry(m_type, m_mod, m_name);
+	ScriptCallbackStats &stats = entry.stats;
+	if (!m_slice_resumed)
+		stats.calls++;
+	stats.time_us += time_us;
+	stats.max_time_us = std::max(stats.max_time_us, time_us);
+	stats.memory += memory;
+
+	if (entry.metrics) {
+		if (!m_slice_resumed)
+			entry.metrics->calls->increment();
+		entry.metrics->time->increment(time_us);
+		entry.metrics->memory->increment(memory);
+	}
+
+	if (m_budget_us > 0) {
+		entry.step_time_us += time_us;
+		if (!entry.in_step) {
+			entry.in_step = true;
+			m_step_entries.push_back(&entry);
+		}
+	}
+}
+
+ScriptAccounting::Entry &ScriptAccounting::getEntry(ScriptCallbackType type,
+		const std::string &mod, const std::string &name)
+{
+	m_key.clear();
+	m_key.push_back('0' + (char)type);
+	m_key.append(mod);
+	m_key.push_back('\0');
+	m_key.append(name);
+
+	auto it = m_entries.find(m_key);
+	if (it != m_entries.end())
+		return it->second;
+
+	Entry &entry = m_entries[m_key];
+	entry.stats.type = type;
+	entry.stats.mod = mod;
+	entry.stats.name = name;
+	if (!m_metrics)
+		return entry;
+
+	// The key up to the name
+	m_key.resize(1 + mod.size());
+	auto series = m_metric_series.find(m_key);
+	if (series == m_metric_series.end()) {
+		const char *type_name = script_callback_type_name(type);
+		Metrics metrics;
+		metrics.calls = m_metrics->addCounter(
+			"minetest_lua_callback_calls", "Number of Lua callback calls",
+			{{"type", type_name}, {"mod", mod}});
+		metrics.time = m_metrics->addCounter(
+			"minetest_lua_callback_time", "Time spent in Lua callbacks (in microseconds)",
+			{{"type", type_name}, {"mod", mod}});
+		metrics.memory = m_metrics->addCounter(
+			"minetest_lua_callback_memory", "Lua heap growth in callbacks (in bytes)",
+			{{"type", type_name}, {"mod", mod}});
+		series = m_metric_series.emplace(m_key, std::move(metrics)).first;
+	}
+	entry.metrics = &series->second;
+	return entry;
+}
+
+void ScriptAccounting::endStep()
+{
+	if (m_step_entries.empty())
+		return;
+
+	for (Entry *entry : m_step_entries)
+		m_mods[entry->stats.mod].step_time_us += entry->step_time_us;
+
+	const u64 now = porting::getTimeUs();
+	for (auto &it : m_mods) {
+		const std::string &mod = it.first;
+		ModBudget &budget = it.second;
+		if (budget.step_time_us <= m_budget_us) {
+			budget.step_time_us = 0;
+			continue;
+		}
+
+		if (!budget.exceeded_counter && m_metrics) {
+			budget.exceeded_counter = m_metrics->addCounter(
+				"minetest_lua_budget_exceeded",
+				"Number of server steps in which a mod exceeded its Lua time budget",
+				{{"mod", mod}});
+		}
+		if (budget.exceeded_counter)
+			budget.exceeded_counter->increment();
+
+		if (budget.last_warning_us == 0 ||
+				now - budget.last_warning_us >= BUDGET_WARNING_INTERVAL_US) {
+			budget.last_warning_us = now;
+			const Entry *worst = nullptr;
+			for (const Entry *entry : m_step_entries) {
+				if (entry->stats.mod == mod &&
+						(!worst || entry->step_time_us > worst->step_time_us))
+					worst = entry;
+			}
+			warningstream << "Mod \"" << mod << "\" used " << budget.step_time_us / 1000.0f
+				<< " ms of Lua time in a server step (budget: " << m_budget_us / 1000.0f
+				<< " ms), mostly in " << script_callback_type_name(worst->stats.type);
+			if (!worst->stats.name.empty())
+				warningstream << " \"" << worst->stats.name << "\"";
+			warningstream << std::endl;
+		}
+		budget.step_time_us = 0;
+	}
+
+	for (Entry *entry : m_step_entries) {
+		entry->step_time_us = 0;
+		entry->in_step = false;
+	}
+	m_step_entries.clear();
+}
+
+std::vector<ScriptCallbackStats> ScriptAccounting::getStats() const
+{
+	std::vector<ScriptCallbackStats> ret;
+	ret.reserve(m_entries.size());
+	for (const auto &it : m_entries) {
+		if (it.second.stats.calls > 0)
+			ret.push_back(it.second.stats);
+	}
+	std::sort(ret.begin(), ret.end(),
+		[] (const ScriptCallbackStats &a, const ScriptCallbackStats &b) {
+			return a.time_us > b.time_us;
+		});
+	return ret;
+}
+
+void ScriptAccounting::clear()
+{
+	// The metrics are counters, they keep counting
+	for (auto &it : m_entries) {
+		ScriptCallbackStats &stats = it.second.stats;
+		stats.calls = stats.time_us = stats.max_time_us = stats.memory = 0;
+	}
+}
+
+ScriptAccountingScope::ScriptAccountingScope(ScriptApiBase *script,
+		ScriptCallbackType type, const std::string &name) :
+	m_accounting(script->getAccounting())
+{
+	if (m_accounting)
+		m_accounting->beginScope(type, name);
+}
+
+ScriptAccountingNested::ScriptAccountingNested(ScriptApiBase *script) :
+	m_accounting(script->getAccounting())
+{
+	if (m_accounting)
+		m_accounting->beginNested();
+}
@@ -0,0 +1,186 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+#include "util/metricsbackend.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include <lua.h>
+}
+
+class ScriptApiBase;
+
+/*
+	Per-mod and per-callback accounting of the Lua time spent in the
+	server step (enabled by the setting "lua_accounting").
+
+	An entry point opens a scope with ScriptAccountingScope. The time and
+	Lua heap growth inside the scope are attributed to the mod that is set
+	as origin (see ScriptApiBase::setOriginDirect()), so a scope running the
+	callbacks of several mods (e.g. the globalsteps) is split into one slice
+	per mod. Nested scopes are part of the outer one.
+
+	A callback can run another mod's callback, for example when an ABM calls
+	core.set_node() and that runs an on_construct. Every script API entry
+	point therefore saves the mod with ScriptAccountingNested. When the inner
+	callback returns, the rest of the time goes to the caller's mod again.
+	That resumed slice does not count as another call.
+
+	The memory figure is the growth of the Lua heap, garbage collected
+	during the callback is not seen. It is a hint at allocation-heavy
+	callbacks, not an exact measure.
+*/
+
+enum class ScriptCallbackType : u8 {
+	Globalstep,
+	ABM,
+	LBM,
+	EntityStep,
+	NodeTimer,
+	Generated,
+	COUNT
+};
+
+const char *script_callback_type_name(ScriptCallbackType type);
+
+struct ScriptCallbackStats {
+	ScriptCallbackType type;
+	std::string mod;
+	// e.g. ABM label or entity name, empty for globalsteps
+	std::string name;
+
+	u64 calls = 0;
+	u64 time_us = 0;
+	u64 max_time_us = 0;
+	u64 memory = 0;
+};
+
+class ScriptAccounting
+{
+public:
+	// metrics may be nullptr
+	ScriptAccounting(lua_State *L, MetricsBackend *metrics);
+	DISABLE_CLASS_COPY(ScriptAccounting)
+
+	// Soft limit of the Lua time (in microseconds) of a mod per server
+	// step, 0 disables it. Mods exceeding it are logged.
+	void setBudget(u64 budget_us) { m_budget_us = budget_us; }
+
+	void beginScope(ScriptCallbackType type, const std::string &name);
+	void endScope();
+	// Attributes the following time of the open scope (if any) to the mod
+	void setMod(const std::string &mod);
+
+	// Around a callback that may run inside an open scope, see above
+	void beginNested();
+	void endNested();
+
+	// Called at the end of a server step to check the budget
+	void endStep();
+
+	// Sorted by descending time
+	std::vector<ScriptCallbackStats> getStats() const;
+	void clear();
+
+private:
+	// Per type and mod, names would make too many series
+	struct Metrics {
+		MetricCounterPtr calls;
+		MetricCounterPtr time;
+		MetricCounterPtr memory;
+	};
+
+	struct Entry {
+		ScriptCallbackStats stats;
+		Metrics *metrics = nullptr;
+		// Time spent in the current step
+		u64 step_time_us = 0;
+		bool in_step = false;
+	};
+
+	struct ModBudget {
+		u64 step_time_us = 0;
+		u64 last_warning_us = 0;
+		MetricCounterPtr exceeded_counter;
+	};
+
+	s64 getHeapSize() const;
+	void beginSlice(bool resumed = false);
+	void endSlice();
+	Entry &getEntry(ScriptCallbackType type, const std::string &mod,
+		const std::string &name);
+
+	lua_State *m_lua;
+	MetricsBackend *m_metrics;
+	u64 m_budget_us = 0;
+
+	// The open scope
+	u32 m_depth = 0;
+	ScriptCallbackType m_type = ScriptCallbackType::Globalstep;
+	std::string m_name;
+
+	// The open slice of the scope
+	bool m_in_slice = false;
+	// Continues a slice that was interrupted by a nested callback
+	bool m_slice_resumed = false;
+	std::string m_mod;
+
+	// The mods to return to after nested callbacks, empty outside of scopes
+	struct NestedOrigin {
+		bool in_slice;
+		std::string mod;
+	};
+	std::vector<NestedOrigin> m_nested;
+	u64 m_slice_start_us = 0;
+	s64 m_slice_heap = 0;
+
+	// Key buffer for lookups without allocations
+	std::string m_key;
+	std::unordered_map<std::string, Entry> m_entries;
+	std::unordered_map<std::string, Metrics> m_metric_series;
+	std::unordered_map<std::string, ModBudget> m_mods;
+	// Entries with time in the current step
+	std::vector<Entry *> m_step_entries;
+};
+
+// Accounts the lifetime of the object if accounting is enabled
+class ScriptAccountingScope
+{
+public:
+	ScriptAccountingScope(ScriptApiBase *script, ScriptCallbackType type,
+		const std::string &name = "");
+	~ScriptAccountingScope()
+	{
+		if (m_accounting)
+			m_accounting->endScope();
+	}
+
+	DISABLE_CLASS_COPY(ScriptAccountingScope)
+
+private:
+	ScriptAccounting *m_accounting;
+};
+
+// Saves and restores the accounted mod around a callback, if accounting
+// is enabled (see SCRIPTAPI_PRECHECKHEADER)
+class ScriptAccountingNested
+{
+public:
+	ScriptAccountingNested(ScriptApiBase *script);
+	~ScriptAccountingNested()
+	{
+		if (m_accounting)
+			m_accounting->endNested();
+	}
+
+	DISABLE_CLASS_COPY(ScriptAccountingNested)
+
+private:
+	ScriptAccounting *m_accounting;
+};
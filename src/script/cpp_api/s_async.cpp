@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 // Copyright (C) 2013 sapier, <sapier AT gmx DOT net>
 
+#include <algorithm>
+#include <cassert>
 #include <cstdio>
 #include <cstdlib>
 
@@ -24,6 +26,86 @@ extern "C" {
 #endif
 #include "lua_api/l_base.h"
 
+// A worker is added when a job waited this long (in microseconds)
+#define AUTOSCALE_LATENCY_US 200000
+// Minimum time between adding two workers (in milliseconds)
+#define AUTOSCALE_INTERVAL_MS 500
+
+/******************************************************************************/
+void AsyncJobQueue::setShardCount(size_t count)
+{
+	assert(!m_shards && count > 0);
+	m_shards.reset(new Shard[count]);
+	m_shard_count = count;
+}
+
+void AsyncJobQueue::push(std::vector<LuaJobInfo> &&jobs)
+{
+	assert(m_shard_count > 0);
+	if (jobs.empty())
+		return;
+	const size_t active = std::min<size_t>(m_active_shards, m_shard_count);
+	// Hand out contiguous runs so a batch locks each shard only once
+	const size_t per_shard = (jobs.size() + active - 1) / active;
+	for (size_t start = 0; start < jobs.size(); start += per_shard) {
+		Shard &shard = m_shards[m_next_shard];
+		m_next_shard = (m_next_shard + 1) % active;
+		const size_t end = std::min(jobs.size(), start + per_shard);
+
+		MutexAutoLock lock(shard.mutex);
+		for (size_t i = start; i < end; i++)
+			shard.jobs.emplace_back(std::move(jobs[i]));
+		m_size += end - start;
+	}
+	m_counter.post(jobs.size());
+}
+
+bool AsyncJobQueue::pop(size_t shard, LuaJobInfo *job)
+{
+	m_counter.wait();
+
+	/*
+		Every job comes with one post of the semaphore, but the job of this
+		post may be taken by another worker that was woken up earlier.
+		Then there is still another one left, unless the queue is empty.
+	*/
+	while (m_size > 0) {
+		for (size_t n = 0; n < m_shard_count; n++) {
+			Shard &s = m_shards[(shard + n) % m_shard_count];
+			MutexAutoLock lock(s.mutex);
+			if (s.jobs.empty())
+				continue;
+			*job = std::move(s.jobs.front());
+			s.jobs.pop_front();
+			m_size--;
+			return true;
+		}
+	}
+	return false;
+}
+
+u64 AsyncJobQueue::getOldestAge(u64 now_us)
+{
+	u64 oldest = now_us;
+	for (size_t n = 0; n < m_shard_count; n++) {
+		Shard &s = m_shards[n];
+		MutexAutoLock lock(s.mutex);
+		if (!s.jobs.empty())
+			oldest = std::min(oldest, s.jobs.front().time_queued);
+	}
+	return now_us - oldest;
+}
+
+void AsyncJobQueue::clear()
+{
+	for (size_t n = 0; n < m_shard_count; n++) {
+		Shard &s = m_shards[n];
+		MutexAutoLock lock(s.mutex);
+		m_size -= s.jobs.size();
+		s.jobs.clear();
+	}
+}
+
 /******************************************************************************/
 AsyncEngine::~AsyncEngine()
 {
@@ -33,10 +115,7 @@ AsyncEngine::~AsyncEngine()
 	}
 
 	// Wake up all threads
-	for (auto it : workerThreads) {
-		(void)it;
-		jobQueueCounter.post();
-	}
+	jobQueue.wakeUp(workerThreads.size());
 
 	// Wait for threads to finish
 	infostream << "AsyncEngine: Waiting for " << workerThreads.size()
@@ -49,9 +128,7 @@ AsyncEngine::~AsyncEngine()
 		delete workerThread;
 	}
 
-	jobQueueMutex.lock();
 	jobQueue.clear();
-	jobQueueMutex.unlock();
 	workerThreads.clear();
 }
 
@@ -67,6 +144,20 @@ void AsyncEngine::initialize(unsigned int numEngines)
 {
 	initDone = true;
 
+	if (server) {
+		MetricsBackend *mb = server->getMetricsBackend();
+		const std::vector<double> buckets{1e2, 1e3, 5e3, 1e4, 5e4,
+			1e5, 2e5, 5e5, 1e6, 5e6};
+		const char *help = "Time async jobs and results wait in their "
+			"queue (in microseconds)";
+		jobLatencyHistogram = mb->addHistogram("minetest_async_queue_latency",
+			help, buckets, {{"queue", "job"}});
+		resultLatencyHistogram = mb->addHistogram("minetest_async_queue_latency",
+			help, buckets, {{"queue", "result"}});
+		workerGauge = mb->addGauge("minetest_async_workers",
+			"Number of async worker threads");
+	}
+
 	if (numEngines == 0) {
 		// Leave one core for the main thread and one for whatever else
 		autoscaleMaxWorkers = Thread::getNumberOfProcessors();
@@ -75,8 +166,10 @@ void AsyncEngine::initialize(unsigned int numEngines)
 		infostream << "AsyncEngine: using at most " << autoscaleMaxWorkers
 			<< " threads with automatic scaling" << std::endl;
 
+		jobQueue.setShardCount(std::max(autoscaleMaxWorkers, 1U));
 		addWorkerThread();
 	} else {
+		jobQueue.setShardCount(numEngines);
 		for (unsigned int i = 0; i < numEngines; i++)
 			addWorkerThread();
 	}
@@ -84,9 +177,13 @@ void AsyncEngine::initialize(unsigned int numEngines)
 
 void AsyncEngine::addWorkerThread()
 {
+	const size_t shard = workerThreads.size() % jobQueue.getShardCount();
 	AsyncWorkerThread *toAdd = new AsyncWorkerThread(this,
-		std::string("AsyncWorker-") + itos(workerThreads.size()));
+		std::string("AsyncWorker-") + itos(workerThreads.size()), shard);
 	workerThreads.push_back(toAdd);
+	jobQueue.setActiveShards(workerThreads.size());
+	if (workerGauge)
+		workerGauge->set(workerThreads.size());
 	toAdd->start();
 }
 
@@ -94,61 +191,74 @@ void AsyncEngine::addWorkerThread()
 u32 AsyncEngine::queueAsyncJob(std::string &&func, std::string &&params,
 		const std::string &mod_origin)
 {
-	MutexAutoLock autolock(jobQueueMutex);
-	u32 jobId = jobIdCounter++;
-
-	jobQueue.emplace_back();
-	auto &to_add = jobQueue.back();
-	to_add.id = jobId;
+	std::vector<LuaJobInfo> jobs(1);
+	auto &to_add = jobs.back();
+	to_add.id = jobIdCounter++;
 	to_add.function = std::move(func);
 	to_add.params = std::move(params);
 	to_add.mod_origin = mod_origin;
+	to_add.time_queued = porting::getTimeUs();
 
-	jobQueueCounter.post();
+	const u32 jobId = to_add.id;
+	jobQueue.push(std::move(jobs));
 	return jobId;
 }
 
 u32 AsyncEngine::queueAsyncJob(std::string &&func, PackedValue *params,
 		const std::string &mod_origin)
 {
-	MutexAutoLock autolock(jobQueueMutex);
-	u32 jobId = jobIdCounter++;
-
-	jobQueue.emplace_back();
-	auto &to_add = jobQueue.back();
-	to_add.id = jobId;
+	std::vector<LuaJobInfo> jobs(1);
+	auto &to_add = jobs.back();
+	to_add.id = jobIdCounter++;
 	to_add.function = std::move(func);
 	to_add.params_ext.reset(params);
 	to_add.mod_origin = mod_origin;
+	to_add.time_queued = porting::getTimeUs();
 
-	jobQueueCounter.post();
+	const u32 jobId = to_add.id;
+	jobQueue.push(std::move(jobs));
 	return jobId;
 }
 
-/******************************************************************************/
-bool AsyncEngine::getJob(LuaJobInfo *job)
+u32 AsyncEngine::queueAsyncJobs(const std::string &func,
+		std::vector<std::unique_ptr<PackedValue>> &&params,
+		const std::string &mod_origin)
 {
-	jobQueueCounter.wait();
-	jobQueueMutex.lock();
+	const u32 firstId = jobIdCounter.fetch_add(params.size());
+	const u64 now = porting::getTimeUs();
+
+	std::vector<LuaJobInfo> jobs(params.size());
+	for (size_t i = 0; i < jobs.size(); i++) {
+		LuaJobInfo &to_add = jobs[i];
+		to_add.id = firstId + i;
+		to_add.function = func;
+		to_add.params_ext = std::move(params[i]);
+		to_add.mod_origin = mod_origin;
+		to_add.time_queued = now;
+	}
 
-	bool retval = false;
+	jobQueue.push(std::move(jobs));
+	return firstId;
+}
 
-	if (!jobQueue.empty()) {
-		*job = std::move(jobQueue.front());
-		jobQueue.pop_front();
-		retval = true;
-	}
-	jobQueueMutex.unlock();
+/******************************************************************************/
+bool AsyncEngine::getJob(size_t shard, LuaJobInfo *job)
+{
+	if (!jobQueue.pop(shard, job))
+		return false;
 
-	return retval;
+	if (jobLatencyHistogram)
+		jobLatencyHistogram->observe(porting::getTimeUs() - job->time_queued);
+	return true;
 }
 
 /******************************************************************************/
 void AsyncEngine::putJobResult(LuaJobInfo &&result)
 {
-	resultQueueMutex.lock();
+	result.time_queued = porting::getTimeUs();
+
+	MutexAutoLock autolock(resultQueueMutex);
 	resultQueue.emplace_back(std::move(result));
-	resultQueueMutex.unlock();
 }
 
 /******************************************************************************/
@@ -160,33 +270,59 @@ void AsyncEngine::step(lua_State *L)
 
 void AsyncEngine::stepJobResults(lua_State *L)
 {
+	// Take all results at once, so the workers are not blocked meanwhile
+	std::vector<LuaJobInfo> results;
+	{
+		MutexAutoLock autolock(resultQueueMutex);
+		results.swap(resultQueue);
+	}
+	if (results.empty())
+		return;
+
 	int error_handler = PUSH_ERROR_HANDLER(L);
 	lua_getglobal(L, "core");
 
 	ScriptApiBase *script = ModApiBase::getScriptApiBase(L);
+	const u64 now = porting::getTimeUs();
 
-	MutexAutoLock autolock(resultQueueMutex);
-	while (!resultQueue.empty()) {
-		LuaJobInfo j = std::move(resultQueue.front());
-		resultQueue.pop_front();
+	// Consecutive results of the same mod are handed over in one call
+	size_t start = 0;
+	while (start < results.size()) {
+		const std::string &mod_origin = results[start].mod_origin;
+		size_t end = start + 1;
+		while (end < results.size() && results[end].mod_origin == mod_origin)
+			end++;
 
 		lua_getfield(L, -1, "async_event_handler");
 		if (lua_isnil(L, -1))
 			FATAL_ERROR("Async event handler does not exist!");
 		luaL_checktype(L, -1, LUA_TFUNCTION);
 
-		lua_pushinteger(L, j.id);
-		if (j.result_ext)
-			script_unpack(L, j.result_ext.get());
-		else
-			lua_pushlstring(L, j.result.data(), j.result.size());
+		// Job IDs and results
+		lua_createtable(L, end - start, 0);
+		lua_createtable(L, end - start, 0);
+		for (size_t i = start; i < end; i++) {
+			LuaJobInfo &j = results[i];
+			lua_pushinteger(L, j.id);
+			lua_rawseti(L, -3, i - start + 1);
+			if (j.result_ext)
+				script_unpack(L, j.result_ext.get());
+			else
+				lua_pushlstring(L, j.result.data(), j.result.size());
+			lua_rawseti(L, -2, i - start + 1);
+
+			if (resultLatencyHistogram)
+				resultLatencyHistogram->observe(now - j.time_queued);
+		}
 
 		// Call handler
-		const char *origin = j.mod_origin.empty() ? nullptr : j.mod_origin.c_str();
+		const char *origin = mod_origin.empty() ? nullptr : mod_origin.c_str();
 		script->setOriginDirect(origin);
 		int result = lua_pcall(L, 2, 0, error_handler);
 		if (result)
 			script_error(L, result, origin, "<async>");
+
+		start = end;
 	}
 
 	lua_pop(L, 2); // Pop core and error handler
@@ -196,34 +332,17 @@ void AsyncEngine::stepAutoscale()
 {
 	if (workerThreads.size() >= autoscaleMaxWorkers)
 		return;
-
-	MutexAutoLock autolock(jobQueueMutex);
-
-	// 2) If the timer elapsed, check again
-	if (autoscaleTimer && porting::getTimeMs() >= autoscaleTimer) {
-		autoscaleTimer = 0;
-		// Determine overlap with previous snapshot
-		unsigned int n = 0;
-		for (const auto &it : jobQueue)
-			n += autoscaleSeenJobs.count(it.id);
-		autoscaleSeenJobs.clear();
-		infostream << "AsyncEngine: " << n << " jobs were still waiting after 1s" << std::endl;
-		// Start this many new threads
-		while (workerThreads.size() < autoscaleMaxWorkers && n > 0) {
-			addWorkerThread();
-			n--;
-		}
+	if (jobQueue.size() == 0 || porting::getTimeMs() < autoscaleTimer)
 		return;
-	}
 
-	// 1) Check if there's anything in the queue
-	if (!autoscaleTimer && !jobQueue.empty()) {
-		// Take a snapshot of all jobs we have seen
-		for (const auto &it : jobQueue)
-			autoscaleSeenJobs.emplace(it.id);
-		// and set a timer for 1 second
-		autoscaleTimer = porting::getTimeMs() + 1000;
-	}
+	// Add a worker if jobs wait too long, then give it time to start
+	const u64 age = jobQueue.getOldestAge(porting::getTimeUs());
+	if (age < AUTOSCALE_LATENCY_US)
+		return;
+	infostream << "AsyncEngine: a job has been waiting for " << age / 1000
+		<< "ms, starting another thread" << std::endl;
+	addWorkerThread();
+	autoscaleTimer = porting::getTimeMs() + AUTOSCALE_INTERVAL_MS;
 }
 
 /******************************************************************************/
@@ -261,10 +380,11 @@ bool AsyncEngine::prepareEnvironment(lua_State* L, int top)
 }
 
 AsyncWorkerThread::AsyncWorkerThread(AsyncEngine* jobDispatcher,
-		const std::string &name) :
+		const std::string &name, size_t shard) :
 	ScriptApiBase(ScriptingType::Async),
 	Thread(name),
-	jobDispatcher(jobDispatcher)
+	jobDispatcher(jobDispatcher),
+	shard(shard)
 {
 	lua_State *L = getStack();
 
@@ -338,7 +458,7 @@ void* AsyncWorkerThread::run()
 	LuaJobInfo j;
 	while (!stopRequested()) {
 		// Wait for job
-		if (!jobDispatcher->getJob(&j) || stopRequested())
+		if (!jobDispatcher->getJob(shard, &j) || stopRequested())
 			continue;
 
 		const bool use_ext = !!j.params_ext;
@@ -4,15 +4,17 @@
 
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <deque>
-#include <unordered_set>
 #include <memory>
 
 #include <lua.h>
 #include "threading/semaphore.h"
 #include "threading/thread.h"
 #include "common/c_packer.h"
+#include "util/basic_macros.h"
+#include "util/metricsbackend.h"
 #include "cpp_api/s_base.h"
 #include "cpp_api/s_security.h"
 
@@ -41,6 +43,66 @@ struct LuaJobInfo
 	std::string mod_origin;
 	// JobID used to identify a job and match it to callback
 	u32 id;
+	// Time the job or its result was queued (in microseconds)
+	u64 time_queued = 0;
+};
+
+/*
+	Job queue of the worker threads of an AsyncEngine.
+
+	The jobs are spread over several shards, each with its own mutex, so the
+	workers do not all wait for one lock. A worker takes the jobs of its own
+	shard first and steals from the others when it runs out.
+*/
+class AsyncJobQueue {
+public:
+	AsyncJobQueue() = default;
+	DISABLE_CLASS_COPY(AsyncJobQueue)
+
+	// Must be called before any other method
+	void setShardCount(size_t count);
+	size_t getShardCount() const { return m_shard_count; }
+	// New jobs are only put in the first `count` shards (those with a worker)
+	void setActiveShards(size_t count) { m_active_shards = count; }
+
+	// Queues the jobs and wakes up one worker per job
+	void push(std::vector<LuaJobInfo> &&jobs);
+
+	/**
+	 * Get a job, this blocks until one is queued or wakeUp() is called
+	 * @param shard the preferred shard, usually that of the worker
+	 * @param job the job to be processed
+	 * @return whether a job was available
+	 */
+	bool pop(size_t shard, LuaJobInfo *job);
+
+	// Wakes up `count` workers even if there are no jobs
+	void wakeUp(size_t count)
+	{
+		if (count > 0)
+			m_counter.post(count);
+	}
+
+	size_t size() const { return m_size; }
+	// Time the oldest queued job has waited (in microseconds), 0 if none
+	u64 getOldestAge(u64 now_us);
+	void clear();
+
+private:
+	struct Shard {
+		std::mutex mutex;
+		std::deque<LuaJobInfo> jobs;
+	};
+
+	std::unique_ptr<Shard[]> m_shards;
+	size_t m_shard_count = 0;
+	std::atomic<size_t> m_active_shards{1};
+	// Shard that gets the next job
+	size_t m_next_shard = 0;
+	// Number of queued jobs, changed while holding the mutex of a shard
+	std::atomic<size_t> m_size{0};
+	// Counter semaphore for job dispatching
+	Semaphore m_counter;
 };
 
 // Asynchronous working environment
@@ -53,13 +115,16 @@ class AsyncWorkerThread : public Thread,
 	void *run() override;
 
 protected:
-	AsyncWorkerThread(AsyncEngine* jobDispatcher, const std::string &name);
+	AsyncWorkerThread(AsyncEngine* jobDispatcher, const std::string &name,
+		size_t shard);
 
 	bool checkPathInternal(const std::string &abs_path, bool write_required,
 		bool *write_allowed) override;
 
 private:
 	AsyncEngine *jobDispatcher = nullptr;
+	// Shard of the job queue this worker prefers
+	size_t shard;
 	bool isErrored = false;
 };
 
@@ -102,6 +167,16 @@ class AsyncEngine {
 	u32 queueAsyncJob(std::string &&func, PackedValue *params,
 			const std::string &mod_origin = "");
 
+	/**
+	 * Queue several async jobs calling the same function
+	 * @param func Serialized lua function
+	 * @param params Serialized parameters of each job (takes ownership!)
+	 * @return ID of the first job, the others follow without gaps
+	 */
+	u32 queueAsyncJobs(const std::string &func,
+			std::vector<std::unique_ptr<PackedValue>> &&params,
+			const std::string &mod_origin = "");
+
 	/**
 	 * Engine step to process finished jobs
 	 * @param L The Lua stack
@@ -112,10 +187,11 @@ class AsyncEngine {
 	/**
 	 * Get a Job from queue to be processed
 	 *  this function blocks until a job is ready
+	 * @param shard the shard of the calling worker
 	 * @param job a job to be processed
 	 * @return whether a job was available
 	 */
-	bool getJob(LuaJobInfo *job);
+	bool getJob(size_t shard, LuaJobInfo *job);
 
 	/**
 	 * Put a Job result back to result queue
@@ -155,8 +231,8 @@ class AsyncEngine {
 	// Maximum number of worker threads for automatic scaling
 	// 0 if disabled
 	unsigned int autoscaleMaxWorkers = 0;
+	// No more threads are started before this time (in milliseconds)
 	u64 autoscaleTimer = 0;
-	std::unordered_set<u32> autoscaleSeenJobs;
 
 	// Only set for the server async environment (duh)
 	Server *server = nullptr;
@@ -165,21 +241,22 @@ class AsyncEngine {
 	std::vector<StateInitializer> stateInitializers;
 
 	// Internal counter to create job IDs
-	u32 jobIdCounter = 0;
+	std::atomic<u32> jobIdCounter{0};
 
-	// Mutex to protect job queue
-	std::mutex jobQueueMutex;
 	// Job queue
-	std::deque<LuaJobInfo> jobQueue;
+	AsyncJobQueue jobQueue;
 
 	// Mutex to protect result queue
 	std::mutex resultQueueMutex;
 	// Result queue
-	std::deque<LuaJobInfo> resultQueue;
+	std::vector<LuaJobInfo> resultQueue;
 
 	// List of current worker threads
 	std::vector<AsyncWorkerThread*> workerThreads;
 
-	// Counter semaphore for job dispatching
-	Semaphore jobQueueCounter;
+	// Time jobs wait for a worker and results for the main thread,
+	// only set for the server
+	MetricHistogramPtr jobLatencyHistogram;
+	MetricHistogramPtr resultLatencyHistogram;
+	MetricGaugePtr workerGauge;
 };
@@ -393,6 +393,8 @@ void ScriptApiBase::stackDump(std::ostream &o)
 void ScriptApiBase::setOriginDirect(const char *origin)
 {
 	m_last_run_mod = origin ? origin : "??";
+	if (m_accounting)
+		m_accounting->setMod(m_last_run_mod);
 }
 
 void ScriptApiBase::setOriginFromTableRaw(int index, const char *fxn)
@@ -400,6 +402,8 @@ void ScriptApiBase::setOriginFromTableRaw(int index, const char *fxn)
 	lua_State *L = getStack();
 	m_last_run_mod = lua_istable(L, index) ?
 		getstringfield_default(L, index, "mod_origin", "") : "";
+	if (m_accounting)
+		m_accounting->setMod(m_last_run_mod);
 }
 
 /*
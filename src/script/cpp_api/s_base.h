@@ -19,6 +19,7 @@ extern "C" {
 
 #include "irrlichttypes.h"
 #include "common/c_internal.h"
+#include "cpp_api/s_accounting.h"
 #include "debug.h"
 #include "config.h"
 
@@ -101,6 +102,9 @@ class ScriptApiBase : protected LuaHelper {
 	void setOriginDirect(const char *origin);
 	void setOriginFromTableRaw(int index, const char *fxn);
 
+	// nullptr unless Lua accounting is enabled
+	ScriptAccounting *getAccounting() { return m_accounting.get(); }
+
 	/**
 	 * Returns the currently running mod, only during init time.
 	 * The reason this is insecure is that mods can mess with each others code,
@@ -169,6 +173,7 @@ class ScriptApiBase : protected LuaHelper {
 
 	std::recursive_mutex m_luastackmutex;
 	std::string     m_last_run_mod;
+	std::unique_ptr<ScriptAccounting> m_accounting;
 
 #ifdef SCRIPTAPI_LOCK_DEBUG
 	int             m_lock_recursion_count{};
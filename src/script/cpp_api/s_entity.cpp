@@ -229,6 +229,12 @@ void ScriptApiEntity::luaentity_Step(u16 id, float dtime,
 		return;
 	}
 	luaL_checktype(L, -1, LUA_TFUNCTION);
+
+	std::string name;
+	if (getAccounting())
+		name = getstringfield_default(L, object, "name", "");
+	ScriptAccountingScope accounting(this, ScriptCallbackType::EntityStep, name);
+
 	lua_pushvalue(L, object); // self
 	lua_pushnumber(L, dtime); // dtime
 	/* moveresult */
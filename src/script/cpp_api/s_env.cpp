@@ -29,13 +29,15 @@ class LuaABM : public ActiveBlockModifier {
 	bool m_simple_catch_up;
 	s16 m_min_y;
 	s16 m_max_y;
+	// For accounting
+	std::string m_label;
 public:
 	LuaABM(int id,
 			const std::vector<std::string> &trigger_contents,
 			const std::vector<std::string> &required_neighbors,
 			const std::vector<std::string> &without_neighbors,
 			float trigger_interval, u32 trigger_chance, bool simple_catch_up,
-			s16 min_y, s16 max_y):
+			s16 min_y, s16 max_y, const std::string &label):
 		m_id(id),
 		m_trigger_contents(trigger_contents),
 		m_required_neighbors(required_neighbors),
@@ -44,7 +46,8 @@ class LuaABM : public ActiveBlockModifier {
 		m_trigger_chance(trigger_chance),
 		m_simple_catch_up(simple_catch_up),
 		m_min_y(min_y),
-		m_max_y(max_y)
+		m_max_y(max_y),
+		m_label(label)
 	{
 	}
 	virtual const std::vector<std::string> &getTriggerContents() const
@@ -84,7 +87,8 @@ class LuaABM : public ActiveBlockModifier {
 			u32 active_object_count, u32 active_object_count_wider)
 	{
 		auto *script = env->getScriptIface();
-		script->triggerABM(m_id, p, n, active_object_count, active_object_count_wider);
+		script->triggerABM(m_id, m_label, p, n,
+			active_object_count, active_object_count_wider);
 	}
 };
 
@@ -107,7 +111,7 @@ class LuaLBM : public LoadingBlockModifierDef
 		const std::unordered_set<v3s16> &positions, float dtime_s)
 	{
 		auto *script = env->getScriptIface();
-		script->triggerLBM(m_id, block, positions, dtime_s);
+		script->triggerLBM(m_id, name, block, positions, dtime_s);
 	}
 };
 
@@ -119,6 +123,8 @@ void ScriptApiEnv::environment_OnGenerated(v3s16 minp, v3s16 maxp,
 	u32 blockseed)
 {
 	SCRIPTAPI_PRECHECKHEADER
+	// Runs in an emerge thread that holds the environment lock
+	ScriptAccountingScope accounting(this, ScriptCallbackType::Generated);
 
 	// Get core.registered_on_generateds
 	lua_getglobal(L, "core");
@@ -137,7 +143,8 @@ void ScriptApiEnv::environment_Step(float dtime)
 	// Get core.registered_globalsteps
 	lua_getglobal(L, "core");
 	lua_getfield(L, -1, "registered_globalsteps");
-	// Call callbacks
+	// Call callbacks, core.run_callbacks() sets the origin of each one
+	ScriptAccountingScope accounting(this, ScriptCallbackType::Globalstep);
 	lua_pushnumber(L, dtime);
 	runCallbacks(1, RUN_CALLBACKS_MODE_FIRST);
 }
@@ -246,9 +253,12 @@ void ScriptApiEnv::readABMs()
 		luaL_checktype(L, current_abm + 1, LUA_TFUNCTION);
 		lua_pop(L, 1);
 
+		std::string label = "#" + itos(id);
+		getstringfield(L, current_abm, "label", label);
+
 		LuaABM *abm = new LuaABM(id, trigger_contents, required_neighbors,
 			without_neighbors, trigger_interval, trigger_chance,
-			simple_catch_up, min_y, max_y);
+			simple_catch_up, min_y, max_y, label);
 
 		env->addActiveBlockModifier(abm);
 
@@ -343,6 +353,48 @@ void ScriptApiEnv::on_emerge_area_completion(
 	}
 }
 
+void ScriptApiEnv::on_path_found(const std::vector<v3s16> &path,
+	ScriptCallbackState *state)
+{
+	Server *server = getServer();
+
+	// Runs from ServerEnvironment::step(), so the envlock is held
+
+	SCRIPTAPI_PRECHECKHEADER
+
+	int error_handler = PUSH_ERROR_HANDLER(L);
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, state->callback_ref);
+	luaL_checktype(L, -1, LUA_TFUNCTION);
+
+	if (path.empty()) {
+		lua_pushnil(L);
+	} else {
+		lua_createtable(L, path.size(), 0);
+		for (size_t i = 0; i < path.size(); i++) {
+			push_v3s16(L, path[i]);
+			lua_rawseti(L, -2, i + 1);
+		}
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, state->args_ref);
+
+	setOriginDirect(state->origin.c_str());
+
+	try {
+		PCALL_RES(lua_pcall(L, 2, 0, error_handler));
+	} catch (LuaError &e) {
+		// Note: don't throw here, we still need to run the cleanup code below
+		server->setAsyncFatalError(e);
+	}
+
+	lua_pop(L, 1); // Pop error handler
+
+	if (state->refcount == 0) {
+		luaL_unref(L, LUA_REGISTRYINDEX, state->callback_ref);
+		luaL_unref(L, LUA_REGISTRYINDEX, state->args_ref);
+	}
+}
+
 void ScriptApiEnv::check_for_falling(v3s16 p)
 {
 	SCRIPTAPI_PRECHECKHEADER
@@ -419,11 +471,13 @@ bool ScriptApiEnv::has_on_mapblocks_changed()
 	return lua_objlen(L, -1) > 0;
 }
 
-void ScriptApiEnv::triggerABM(int id, v3s16 p, MapNode n,
+void ScriptApiEnv::triggerABM(int id, const std::string &label, v3s16 p, MapNode n,
 		u32 active_object_count, u32 active_object_count_wider)
 {
 	SCRIPTAPI_PRECHECKHEADER
 
+	ScriptAccountingScope accounting(this, ScriptCallbackType::ABM, label);
+
 	int error_handler = PUSH_ERROR_HANDLER(L);
 
 	// Get registered_abms
@@ -457,11 +511,14 @@ void ScriptApiEnv::triggerABM(int id, v3s16 p, MapNode n,
 	lua_pop(L, 1); // Pop error handler
 }
 
-void ScriptApiEnv::triggerLBM(int id, MapBlock *block,
+void ScriptApiEnv::triggerLBM(int id, const std::string &name, MapBlock *block,
 		const std::unordered_set<v3s16> &positions, float dtime_s)
 {
 	SCRIPTAPI_PRECHECKHEADER
 
+	// core.run_lbm() sets the origin
+	ScriptAccountingScope accounting(this, ScriptCallbackType::LBM, name);
+
 	int error_handler = PUSH_ERROR_HANDLER(L);
 
 	const v3s16 pos_of_block = block->getPosRelative();
@@ -30,6 +30,10 @@ class ScriptApiEnv : virtual public ScriptApiBase
 	void on_emerge_area_completion(v3s16 blockpos, int action,
 		ScriptCallbackState *state);
 
+	// Called after a search queued from core.find_path_async() finished
+	void on_path_found(const std::vector<v3s16> &path,
+		ScriptCallbackState *state);
+
 	void check_for_falling(v3s16 p);
 
 	// Called after liquid transform changes
@@ -44,10 +48,11 @@ class ScriptApiEnv : virtual public ScriptApiBase
 	// Initializes environment and loads some definitions from Lua
 	void initializeEnvironment(ServerEnvironment *env);
 
-	void triggerABM(int id, v3s16 p, MapNode n,
+	// label and name are used for accounting
+	void triggerABM(int id, const std::string &label, v3s16 p, MapNode n,
 			u32 active_object_count, u32 active_object_count_wider);
 
-	void triggerLBM(int id, MapBlock *block,
+	void triggerLBM(int id, const std::string &name, MapBlock *block,
 		const std::unordered_set<v3s16> &positions, float dtime_s);
 
 private:
@@ -38,7 +38,7 @@ bool ScriptApiItem::item_OnDrop(ItemStack &item,
 		try {
 			item = read_item(L, -1, getServer()->idef());
 		} catch (LuaError &e) {
-			throw WRAP_LUAERROR(e, "item=" + item.name);
+			throw WRAP_LUAERROR(e, "item=" + item.name.str());
 		}
 	}
 	lua_pop(L, 2);  // Pop item and error handler
@@ -71,7 +71,7 @@ bool ScriptApiItem::item_OnPlace(std::optional<ItemStack> &ret_item,
 		try {
 			ret_item = read_item(L, -1, getServer()->idef());
 		} catch (LuaError &e) {
-			throw WRAP_LUAERROR(e, "item=" + item.name);
+			throw WRAP_LUAERROR(e, "item=" + item.name.str());
 		}
 	} else {
 		ret_item = std::nullopt;
@@ -101,7 +101,7 @@ bool ScriptApiItem::item_OnUse(std::optional<ItemStack> &ret_item,
 		try {
 			ret_item = read_item(L, -1, getServer()->idef());
 		} catch (LuaError &e) {
-			throw WRAP_LUAERROR(e, "item=" + item.name);
+			throw WRAP_LUAERROR(e, "item=" + item.name.str());
 		}
 	} else {
 		ret_item = std::nullopt;
@@ -129,7 +129,7 @@ bool ScriptApiItem::item_OnSecondaryUse(std::optional<ItemStack> &ret_item,
 		try {
 			ret_item = read_item(L, -1, getServer()->idef());
 		} catch (LuaError &e) {
-			throw WRAP_LUAERROR(e, "item=" + item.name);
+			throw WRAP_LUAERROR(e, "item=" + item.name.str());
 		}
 	} else {
 		ret_item = std::nullopt;
@@ -163,7 +163,7 @@ bool ScriptApiItem::item_OnCraft(ItemStack &item, ServerActiveObject *user,
 		try {
 			item = read_item(L, -1, getServer()->idef());
 		} catch (LuaError &e) {
-			throw WRAP_LUAERROR(e, "item=" + item.name);
+			throw WRAP_LUAERROR(e, "item=" + item.name.str());
 		}
 	}
 	lua_pop(L, 2);  // Pop item and error handler
@@ -195,7 +195,7 @@ bool ScriptApiItem::item_CraftPredict(ItemStack &item, ServerActiveObject *user,
 		try {
 			item = read_item(L, -1, getServer()->idef());
 		} catch (LuaError &e) {
-			throw WRAP_LUAERROR(e, "item=" + item.name);
+			throw WRAP_LUAERROR(e, "item=" + item.name.str());
 		}
 	}
 	lua_pop(L, 2);  // Pop item and error handler
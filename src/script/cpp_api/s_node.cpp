@@ -222,9 +222,13 @@ bool ScriptApiNode::node_on_timer(v3s16 p, MapNode node, f32 dtime)
 	int error_handler = PUSH_ERROR_HANDLER(L);
 
 	const NodeDefManager *ndef = getServer()->ndef();
+	const std::string &name = ndef->get(node).name;
+
+	// getItemCallback() sets the origin
+	ScriptAccountingScope accounting(this, ScriptCallbackType::NodeTimer, name);
 
 	// Push callback function on stack
-	if (!getItemCallback(ndef->get(node).name.c_str(), "on_timer", &p))
+	if (!getItemCallback(name.c_str(), "on_timer", &p))
 		return false;
 
 	// Call function
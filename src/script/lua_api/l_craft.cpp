@@ -352,13 +352,8 @@ int ModApiCraft::l_clear_craft(lua_State *L)
 	return 1;
 }
 
-// get_craft_result(input)
-int ModApiCraft::l_get_craft_result(lua_State *L)
+void ModApiCraft::craftAndPush(lua_State *L, IGameDef *gdef, int input_i)
 {
-	NO_MAP_LOCK_REQUIRED;
-	IGameDef *gdef = getGameDef(L);
-
-	const int input_i = 1;
 	std::string method_s = getstringfield_default(L, input_i, "method", "normal");
 	enum CraftMethod method = (CraftMethod)getenumfield(L, input_i, "method",
 				es_CraftMethod, CRAFT_METHOD_NORMAL);
@@ -399,6 +394,34 @@ int ModApiCraft::l_get_craft_result(lua_State *L)
 	lua_setfield(L, -2, "width");
 	push_items(L, input.items);
 	lua_setfield(L, -2, "items");
+}
+
+// get_craft_result(input)
+int ModApiCraft::l_get_craft_result(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	craftAndPush(L, getGameDef(L), 1);
+	return 2;
+}
+
+// get_craft_results(inputs)
+int ModApiCraft::l_get_craft_results(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	IGameDef *gdef = getGameDef(L);
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	int count = lua_objlen(L, 1);
+	lua_settop(L, 1);
+	lua_createtable(L, count, 0); // outputs
+	lua_createtable(L, count, 0); // decremented inputs
+	for (int i = 1; i <= count; i++) {
+		lua_rawgeti(L, 1, i);
+		craftAndPush(L, gdef, lua_gettop(L));
+		lua_rawseti(L, 3, i);
+		lua_rawseti(L, 2, i);
+		lua_pop(L, 1); // input
+	}
 	return 2;
 }
 
@@ -507,6 +530,7 @@ void ModApiCraft::Initialize(lua_State *L, int top)
 	API_FCT(get_all_craft_recipes);
 	API_FCT(get_craft_recipe);
 	API_FCT(get_craft_result);
+	API_FCT(get_craft_results);
 	API_FCT(register_craft);
 	API_FCT(clear_craft);
 }
@@ -517,4 +541,5 @@ void ModApiCraft::InitializeAsync(lua_State *L, int top)
 	API_FCT(get_all_craft_recipes);
 	API_FCT(get_craft_recipe);
 	API_FCT(get_craft_result);
+	API_FCT(get_craft_results);
 }
@@ -17,6 +17,7 @@ class ModApiCraft : public ModApiBase {
 	static int l_get_craft_recipe(lua_State *L);
 	static int l_get_all_craft_recipes(lua_State *L);
 	static int l_get_craft_result(lua_State *L);
+	static int l_get_craft_results(lua_State *L);
 	static int l_clear_craft(lua_State *L);
 
 	static bool readCraftReplacements(lua_State *L, int index,
@@ -26,6 +27,10 @@ class ModApiCraft : public ModApiBase {
 	static bool readCraftRecipeShaped(lua_State *L, int index,
 			int &width, std::vector<std::string> &recipe);
 
+	// Crafts the input table at input_i and pushes the output and the
+	// decremented input table
+	static void craftAndPush(lua_State *L, IGameDef *gdef, int input_i);
+
 	static struct EnumString es_CraftMethod[];
 
 public:
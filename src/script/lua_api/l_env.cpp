@@ -3,6 +3,7 @@
 // Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
 
 #include <algorithm>
+#include <tuple>
 #include "lua_api/l_env.h"
 #include "lua_api/l_internal.h"
 #include "lua_api/l_nodemeta.h"
@@ -50,10 +51,27 @@ const EnumString ModApiEnvBase::es_BlockStatusType[] =
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// Like Environment::continueRaycast but skips objects that are gone
+static void next_pointed_thing(Environment *env, RaycastState *state,
+	PointedThing *pointed)
+{
+	ServerEnvironment *senv = dynamic_cast<ServerEnvironment*>(env);
+	for (;;) {
+		env->continueRaycast(state, pointed);
+		if (pointed->type != POINTEDTHING_OBJECT)
+			break;
+		if (!senv)
+			break;
+		const auto *obj = senv->getActiveObject(pointed->object_id);
+		if (obj && !obj->isGone())
+			break;
+		// skip gone object
+	}
+}
+
 int LuaRaycast::l_next(lua_State *L)
 {
 	GET_PLAIN_ENV_PTR;
-	ServerEnvironment *senv = dynamic_cast<ServerEnvironment*>(env);
 
 	bool csm = false;
 #if CHECK_CLIENT_BUILD()
@@ -62,17 +80,7 @@ int LuaRaycast::l_next(lua_State *L)
 
 	LuaRaycast *o = checkObject<LuaRaycast>(L, 1);
 	PointedThing pointed;
-	for (;;) {
-		env->continueRaycast(&o->state, &pointed);
-		if (pointed.type != POINTEDTHING_OBJECT)
-			break;
-		if (!senv)
-			break;
-		const auto *obj = senv->getActiveObject(pointed.object_id);
-		if (obj && !obj->isGone())
-			break;
-		// skip gone object
-	}
+	next_pointed_thing(env, &o->state, &pointed);
 	if (pointed.type == POINTEDTHING_NOTHING)
 		lua_pushnil(L);
 	else
@@ -858,11 +866,58 @@ void ModApiEnvBase::checkArea(v3s16 &minp, v3s16 &maxp)
 #undef CLAMP
 }
 
+bool ModApiEnvBase::readGroupedMode(lua_State *L, int idx, bool *flat)
+{
+	*flat = lua_type(L, idx) == LUA_TSTRING &&
+			readParam<std::string_view>(L, idx) == "flat";
+	return *flat || (lua_isboolean(L, idx) && readParam<bool>(L, idx));
+}
+
 template <typename F>
 int ModApiEnvBase::findNodesInArea(lua_State *L, const NodeDefManager *ndef,
-		const std::vector<content_t> &filter, bool grouped, F &&iterate)
+		const std::vector<content_t> &filter, bool grouped, bool flat, F &&iterate)
 {
-	if (grouped) {
+	if (flat) {
+		// Same as grouped, but with the coordinates of all positions stored
+		// one after another in a single array per node name
+		lua_createtable(L, 0, filter.size());
+		int base = lua_gettop(L);
+
+		std::vector<u32> idx;
+		idx.resize(filter.size());
+		for (u32 i = 0; i < filter.size(); i++)
+			lua_newtable(L);
+
+		iterate([&](v3s16 p, MapNode n) -> bool {
+			content_t c = n.getContent();
+
+			auto it = std::find(filter.begin(), filter.end(), c);
+			if (it != filter.end()) {
+				u32 filt_index = it - filter.begin();
+				int table = base + 1 + filt_index;
+				u32 &i = idx[filt_index];
+				lua_pushinteger(L, p.X);
+				lua_rawseti(L, table, ++i);
+				lua_pushinteger(L, p.Y);
+				lua_rawseti(L, table, ++i);
+				lua_pushinteger(L, p.Z);
+				lua_rawseti(L, table, ++i);
+			}
+
+			return true;
+		});
+
+		u32 i = filter.size();
+		while (i --> 0) {
+			if (idx[i] == 0)
+				lua_pop(L, 1);
+			else
+				lua_setfield(L, base, ndef->get(filter[i]).name.c_str());
+		}
+
+		assert(lua_gettop(L) == base);
+		return 1;
+	} else if (grouped) {
 		// create the table we will be returning
 		lua_createtable(L, 0, filter.size());
 		int base = lua_gettop(L);
@@ -955,12 +1010,13 @@ int ModApiEnv::l_find_nodes_in_area(lua_State *L)
 	std::vector<content_t> filter;
 	collectNodeIds(L, 3, ndef, filter);
 
-	bool grouped = lua_isboolean(L, 4) && readParam<bool>(L, 4);
+	bool flat;
+	bool grouped = readGroupedMode(L, 4, &flat);
 
 	auto iterate = [&] (auto &&callback) {
-		map.forEachNodeInArea(minp, maxp, callback);
+		map.forEachNodeInAreaWithContent(minp, maxp, filter, callback);
 	};
-	return findNodesInArea(L, ndef, filter, grouped, iterate);
+	return findNodesInArea(L, ndef, filter, grouped, flat, iterate);
 }
 
 template <typename F>
@@ -1016,11 +1072,29 @@ int ModApiEnv::l_find_nodes_in_area_under_air(lua_State *L)
 
 	std::vector<content_t> filter;
 	collectNodeIds(L, 3, ndef, filter);
-
-	auto getNode = [&map] (v3s16 p) -> MapNode {
-		return map.getNode(p);
-	};
-	return findNodesInAreaUnderAir(L, minp, maxp, filter, getNode);
+	// Air nodes never qualify
+	filter.erase(std::remove(filter.begin(), filter.end(), CONTENT_AIR), filter.end());
+
+	// Only look at the nodes above the candidates found using the content
+	// presence summaries of the blocks
+	std::vector<v3s16> found;
+	map.forEachNodeInAreaWithContent(minp, maxp, filter, [&] (v3s16 p, MapNode n) -> bool {
+		if (map.getNode(p + v3s16(0, 1, 0)).getContent() == CONTENT_AIR)
+			found.push_back(p);
+		return true;
+	});
+
+	// Keep the order of the generic implementation (X, Z, then Y)
+	std::sort(found.begin(), found.end(), [] (v3s16 a, v3s16 b) {
+		return std::tie(a.X, a.Z, a.Y) < std::tie(b.X, b.Z, b.Y);
+	});
+
+	lua_createtable(L, found.size(), 0);
+	for (u32 i = 0; i < found.size(); i++) {
+		push_v3s16(L, found[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
 }
 
 // get_perlin(seeddiff, octaves, persistence, scale)
@@ -1146,6 +1220,51 @@ int ModApiEnv::l_raycast(lua_State *L)
 	return LuaRaycast::create_object(L);
 }
 
+// raycast_batch(rays, objects, liquids, pointabilities) -> list of pointed things
+int ModApiEnv::l_raycast_batch(lua_State *L)
+{
+	GET_PLAIN_ENV_PTR;
+
+	bool csm = false;
+#if CHECK_CLIENT_BUILD()
+	csm = getClient(L) != nullptr;
+#endif
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	bool objects = true;
+	bool liquids = false;
+	std::optional<Pointabilities> pointabilities = std::nullopt;
+	if (lua_isboolean(L, 2))
+		objects = readParam<bool>(L, 2);
+	if (lua_isboolean(L, 3))
+		liquids = readParam<bool>(L, 3);
+	if (lua_istable(L, 4))
+		pointabilities = read_pointabilities(L, 4);
+
+	size_t num_rays = lua_objlen(L, 1);
+	lua_createtable(L, num_rays, 0);
+	for (size_t i = 1; i <= num_rays; i++) {
+		lua_rawgeti(L, 1, i);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		lua_rawgeti(L, -1, 1);
+		v3f pos1 = checkFloatPos(L, -1);
+		lua_rawgeti(L, -2, 2);
+		v3f pos2 = checkFloatPos(L, -1);
+		lua_pop(L, 3);
+
+		RaycastState state(core::line3d<f32>(pos1, pos2),
+			objects, liquids, pointabilities);
+		PointedThing pointed;
+		next_pointed_thing(env, &state, &pointed);
+		if (pointed.type == POINTEDTHING_NOTHING)
+			lua_pushboolean(L, false);
+		else
+			push_pointed_thing(L, pointed, csm, true);
+		lua_rawseti(L, -2, i);
+	}
+	return 1;
+}
+
 // load_area(p1, [p2])
 // load mapblocks in area p1..p2, but do not generate map
 int ModApiEnv::l_load_area(lua_State *L)
@@ -1249,30 +1368,34 @@ int ModApiEnv::l_delete_area(lua_State *L)
 	return 1;
 }
 
-// find_path(pos1, pos2, searchdistance,
-//     max_jump, max_drop, algorithm) -> table containing path
-int ModApiEnv::l_find_path(lua_State *L)
+static PathQuery read_path_query(lua_State *L)
 {
-	GET_ENV_PTR;
-
-	v3s16 pos1                  = read_v3s16(L, 1);
-	v3s16 pos2                  = read_v3s16(L, 2);
-	unsigned int searchdistance = luaL_checkint(L, 3);
-	unsigned int max_jump       = luaL_checkint(L, 4);
-	unsigned int max_drop       = luaL_checkint(L, 5);
-	PathAlgorithm algo          = PA_PLAIN_NP;
+	PathQuery query;
+	query.source         = read_v3s16(L, 1);
+	query.destination    = read_v3s16(L, 2);
+	query.searchdistance = luaL_checkint(L, 3);
+	query.max_jump       = luaL_checkint(L, 4);
+	query.max_drop       = luaL_checkint(L, 5);
+	query.algo           = PA_PLAIN_NP;
 	if (!lua_isnoneornil(L, 6)) {
 		std::string algorithm = luaL_checkstring(L,6);
 
 		if (algorithm == "A*")
-			algo = PA_PLAIN;
+			query.algo = PA_PLAIN;
 
 		if (algorithm == "Dijkstra")
-			algo = PA_DIJKSTRA;
+			query.algo = PA_DIJKSTRA;
 	}
+	return query;
+}
+
+// find_path(pos1, pos2, searchdistance,
+//     max_jump, max_drop, algorithm) -> table containing path
+int ModApiEnv::l_find_path(lua_State *L)
+{
+	GET_ENV_PTR;
 
-	std::vector<v3s16> path = get_path(&env->getServerMap(), env->getGameDef()->ndef(), pos1, pos2,
-		searchdistance, max_jump, max_drop, algo);
+	std::vector<v3s16> path = env->getPathfinder().findPath(read_path_query(L));
 
 	if (!path.empty()) {
 		lua_createtable(L, path.size(), 0);
@@ -1290,6 +1413,37 @@ int ModApiEnv::l_find_path(lua_State *L)
 	return 0;
 }
 
+// find_path_async(pos1, pos2, searchdistance,
+//     max_jump, max_drop, algorithm, callback, [param])
+int ModApiEnv::l_find_path_async(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	PathQuery query = read_path_query(L);
+	luaL_checktype(L, 7, LUA_TFUNCTION);
+
+	lua_pushvalue(L, 7);
+	int callback_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	lua_pushvalue(L, 8);
+	int args_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	auto state = std::make_shared<ScriptCallbackState>();
+	state->script       = getServer(L)->getScriptIface();
+	state->callback_ref = callback_ref;
+	state->args_ref     = args_ref;
+	state->refcount     = 1;
+	state->origin       = getScriptApiBase(L)->getOrigin();
+
+	// Callbacks run from ServerEnvironment::step() with the envlock held
+	env->getPathfinder().queuePath(query, [state] (std::vector<v3s16> &&path) {
+		state->refcount--;
+		state->script->on_path_found(path, state.get());
+	});
+
+	return 0;
+}
+
 // spawn_tree(pos, treedef)
 int ModApiEnv::l_spawn_tree(lua_State *L)
 {
@@ -1421,8 +1575,10 @@ void ModApiEnv::Initialize(lua_State *L, int top)
 	API_FCT(clear_objects);
 	API_FCT(spawn_tree);
 	API_FCT(find_path);
+	API_FCT(find_path_async);
 	API_FCT(line_of_sight);
 	API_FCT(raycast);
+	API_FCT(raycast_batch);
 	API_FCT(transforming_liquid_add);
 	API_FCT(forceload_block);
 	API_FCT(forceload_free_block);
@@ -1442,6 +1598,7 @@ void ModApiEnv::InitializeClient(lua_State *L, int top)
 	API_FCT(find_nodes_in_area_under_air);
 	API_FCT(line_of_sight);
 	API_FCT(raycast);
+	API_FCT(raycast_batch);
 }
 
 #define GET_VM_PTR               \
@@ -1555,7 +1712,8 @@ int ModApiEnvVM::l_find_nodes_in_area(lua_State *L)
 	std::vector<content_t> filter;
 	collectNodeIds(L, 3, ndef, filter);
 
-	bool grouped = lua_isboolean(L, 4) && readParam<bool>(L, 4);
+	bool flat;
+	bool grouped = readGroupedMode(L, 4, &flat);
 
 	auto iterate = [&] (auto callback) {
 		for (s16 z = minp.Z; z <= maxp.Z; z++)
@@ -1570,7 +1728,7 @@ int ModApiEnvVM::l_find_nodes_in_area(lua_State *L)
 			}
 		}
 	};
-	return findNodesInArea(L, ndef, filter, grouped, iterate);
+	return findNodesInArea(L, ndef, filter, grouped, flat, iterate);
 }
 
 // find_nodes_in_area_under_air(minp, maxp, nodenames)
@@ -23,12 +23,16 @@ class ModApiEnvBase : public ModApiBase {
 	static int findNodeNear(lua_State *L, v3s16 pos, int radius,
 		const std::vector<content_t> &filter, int start_radius, F &&getNode);
 
+	// Reads the 'grouped' argument of find_nodes_in_area, which can also be
+	// "flat" to get the positions as flat coordinate arrays
+	static bool readGroupedMode(lua_State *L, int idx, bool *flat);
+
 	// F must be (G callback) -> void
 	// with G being (v3s16 p, MapNode n) -> bool
 	// and behave like Map::forEachNodeInArea
 	template <typename F>
 	static int findNodesInArea(lua_State *L,  const NodeDefManager *ndef,
-		const std::vector<content_t> &filter, bool grouped, F &&iterate);
+		const std::vector<content_t> &filter, bool grouped, bool flat, F &&iterate);
 
 	// F must be (v3s16 pos) -> MapNode
 	template <typename F>
@@ -204,10 +208,17 @@ class ModApiEnv : public ModApiEnvBase {
 	// raycast(pos1, pos2, objects, liquids) -> Raycast
 	static int l_raycast(lua_State *L);
 
+	// raycast_batch(rays, objects, liquids, pointabilities) -> list of pointed things
+	static int l_raycast_batch(lua_State *L);
+
 	// find_path(pos1, pos2, searchdistance,
 	//     max_jump, max_drop, algorithm) -> table containing path
 	static int l_find_path(lua_State *L);
 
+	// find_path_async(pos1, pos2, searchdistance,
+	//     max_jump, max_drop, algorithm, callback, [param])
+	static int l_find_path_async(lua_State *L);
+
 	// transforming_liquid_add(pos)
 	static int l_transforming_liquid_add(lua_State *L);
 
@@ -3,6 +3,7 @@
 
 #include "lua_api/l_ipc.h"
 #include "lua_api/l_internal.h"
+#include "lua_api/l_shared.h"
 #include "common/c_packer.h"
 #include "server.h"
 #include "debug.h"
@@ -11,17 +12,33 @@
 typedef std::shared_lock<std::shared_mutex> SharedReadLock;
 typedef std::unique_lock<std::shared_mutex> SharedWriteLock;
 
-static inline auto read_pv(lua_State *L, int idx)
+// Returns an empty value for nil
+static inline ModIPCStore::Value read_value(lua_State *L, int idx)
 {
-	std::unique_ptr<PackedValue> ret;
-	if (!lua_isnil(L, idx)) {
-		ret.reset(script_pack(L, idx));
-		if (ret->contains_userdata)
+	ModIPCStore::Value ret;
+	if (LuaSharedTable *shared = LuaSharedTable::toObject(L, idx)) {
+		ret.shared = shared->getTable();
+	} else if (!lua_isnil(L, idx)) {
+		ret.packed.reset(script_pack(L, idx));
+		if (ret.packed->contains_userdata)
 			throw LuaError("Userdata not allowed");
 	}
 	return ret;
 }
 
+static inline bool is_empty(const ModIPCStore::Value &value)
+{
+	return !value.packed && !value.shared;
+}
+
+static inline void push_value(lua_State *L, const ModIPCStore::Value &value)
+{
+	if (value.shared)
+		LuaSharedTable::create(L, value.shared);
+	else
+		script_unpack(L, value.packed.get());
+}
+
 int ModApiIPC::l_ipc_get(lua_State *L)
 {
 	auto *store = getGameDef(L)->getModIPCStore();
@@ -34,7 +51,7 @@ int ModApiIPC::l_ipc_get(lua_State *L)
 		if (it == store->map.end())
 			lua_pushnil(L);
 		else
-			script_unpack(L, it->second.get());
+			push_value(L, it->second);
 	}
 	return 1;
 }
@@ -46,12 +63,12 @@ int ModApiIPC::l_ipc_set(lua_State *L)
 	auto key = readParam<std::string>(L, 1);
 
 	luaL_checkany(L, 2);
-	auto pv = read_pv(L, 2);
+	auto value = read_value(L, 2);
 
 	{
 		SharedWriteLock autolock(store->mutex);
-		if (pv)
-			store->map[key] = std::move(pv);
+		if (!is_empty(value))
+			store->map[key] = std::move(value);
 		else
 			store->map.erase(key); // delete the map value for nil
 	}
@@ -69,7 +86,7 @@ int ModApiIPC::l_ipc_cas(lua_State *L)
 	const int idx_old = 2;
 
 	luaL_checkany(L, 3);
-	auto pv_new = read_pv(L, 3);
+	auto value_new = read_value(L, 3);
 
 	bool ok = false;
 	{
@@ -79,14 +96,14 @@ int ModApiIPC::l_ipc_cas(lua_State *L)
 		if (it == store->map.end()) {
 			ok = lua_isnil(L, idx_old);
 		} else {
-			script_unpack(L, it->second.get());
+			push_value(L, it->second);
 			ok = lua_equal(L, idx_old, -1);
 			lua_pop(L, 1);
 		}
 		// put new value
 		if (ok) {
-			if (pv_new)
-				store->map[key] = std::move(pv_new);
+			if (!is_empty(value_new))
+				store->map[key] = std::move(value_new);
 			else
 				store->map.erase(key);
 		}
@@ -15,6 +15,8 @@
 #include "remoteplayer.h"
 #include "log.h"
 #include "filesys.h"
+#include "threading/task_pool.h"
+#include "util/trace.h"
 #include <algorithm>
 
 // request_shutdown()
@@ -53,6 +55,71 @@ int ModApiServer::l_get_server_max_lag(lua_State *L)
 	return 1;
 }
 
+// start_trace()
+int ModApiServer::l_start_trace(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	lua_pushboolean(L, g_tracer->start());
+	return 1;
+}
+
+// stop_trace()
+int ModApiServer::l_stop_trace(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	std::shared_ptr<TraceData> data = g_tracer->stop();
+	if (!data)
+		return 0;
+
+	// Traces can be large, don't block the server thread
+	const Server *srv = getServer(L);
+	std::string path = srv->getWorldPath() + DIR_DELIM + TraceData::getDefaultFileName();
+	TaskPool::get().post([data, path] {
+		data->writeFile(path);
+	}, TaskPriority::Low);
+
+	lua_pushstring(L, path.c_str());
+	return 1;
+}
+
+// get_lua_usage()
+int ModApiServer::l_get_lua_usage(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	ScriptAccounting *accounting = getScriptApiBase(L)->getAccounting();
+	if (!accounting)
+		return 0;
+
+	const auto stats = accounting->getStats();
+	lua_createtable(L, stats.size(), 0);
+	int i = 1;
+	for (const ScriptCallbackStats &entry : stats) {
+		lua_createtable(L, 0, 7);
+		setstringfield(L, -1, "type", script_callback_type_name(entry.type));
+		setstringfield(L, -1, "mod", entry.mod);
+		setstringfield(L, -1, "name", entry.name);
+		lua_pushnumber(L, entry.calls);
+		lua_setfield(L, -2, "calls");
+		lua_pushnumber(L, entry.time_us);
+		lua_setfield(L, -2, "time");
+		lua_pushnumber(L, entry.max_time_us);
+		lua_setfield(L, -2, "max_time");
+		lua_pushnumber(L, entry.memory);
+		lua_setfield(L, -2, "memory");
+		lua_rawseti(L, -2, i++);
+	}
+	return 1;
+}
+
+// reset_lua_usage()
+int ModApiServer::l_reset_lua_usage(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	if (ScriptAccounting *accounting = getScriptApiBase(L)->getAccounting())
+		accounting->clear();
+	return 0;
+}
+
 // print(text)
 int ModApiServer::l_print(lua_State *L)
 {
@@ -652,6 +719,42 @@ int ModApiServer::l_do_async_callback(lua_State *L)
 	return 1;
 }
 
+// do_async_callback_batch(func, params_list, mod_origin)
+int ModApiServer::l_do_async_callback_batch(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	ServerScripting *script = getScriptApi<ServerScripting>(L);
+
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	luaL_checktype(L, 3, LUA_TSTRING);
+
+	// The function is dumped once for all jobs
+	call_string_dump(L, 1);
+	size_t func_length;
+	const char *serialized_func_raw = lua_tolstring(L, -1, &func_length);
+	std::string serialized_func(serialized_func_raw, func_length);
+
+	const size_t count = lua_objlen(L, 2);
+	std::vector<std::unique_ptr<PackedValue>> params;
+	params.reserve(count);
+	for (size_t i = 1; i <= count; i++) {
+		lua_rawgeti(L, 2, i);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		params.emplace_back(script_pack(L, -1));
+		lua_pop(L, 1);
+	}
+
+	std::string mod_origin = readParam<std::string>(L, 3);
+
+	u32 jobId = script->queueAsyncBatch(serialized_func,
+		std::move(params), mod_origin);
+
+	lua_settop(L, 0);
+	lua_pushinteger(L, jobId);
+	return 1;
+}
+
 // register_async_dofile(path)
 int ModApiServer::l_register_async_dofile(lua_State *L)
 {
@@ -716,6 +819,10 @@ void ModApiServer::Initialize(lua_State *L, int top)
 	API_FCT(get_server_status);
 	API_FCT(get_server_uptime);
 	API_FCT(get_server_max_lag);
+	API_FCT(start_trace);
+	API_FCT(stop_trace);
+	API_FCT(get_lua_usage);
+	API_FCT(reset_lua_usage);
 	API_FCT(get_mod_data_path);
 	API_FCT(get_worldpath);
 	API_FCT(is_singleplayer);
@@ -748,6 +855,7 @@ void ModApiServer::Initialize(lua_State *L, int top)
 	API_FCT(notify_authentication_modified);
 
 	API_FCT(do_async_callback);
+	API_FCT(do_async_callback_batch);
 	API_FCT(register_async_dofile);
 	API_FCT(serialize_roundtrip);
 
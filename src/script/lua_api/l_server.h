@@ -21,6 +21,18 @@ class ModApiServer : public ModApiBase
 	// get_server_max_lag()
 	static int l_get_server_max_lag(lua_State *L);
 
+	// start_trace() -> success
+	static int l_start_trace(lua_State *L);
+
+	// stop_trace() -> path or nil
+	static int l_stop_trace(lua_State *L);
+
+	// get_lua_usage() -> list of usage tables or nil
+	static int l_get_lua_usage(lua_State *L);
+
+	// reset_lua_usage()
+	static int l_reset_lua_usage(lua_State *L);
+
 	// get_worldpath()
 	static int l_get_worldpath(lua_State *L);
 
@@ -103,6 +115,9 @@ class ModApiServer : public ModApiBase
 	// do_async_callback(func, params, mod_origin)
 	static int l_do_async_callback(lua_State *L);
 
+	// do_async_callback_batch(func, params_list, mod_origin)
+	static int l_do_async_callback_batch(lua_State *L);
+
 	// register_async_dofile(path)
 	static int l_register_async_dofile(lua_State *L);
 
@@ -0,0 +1,438 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "lua_api/l_shared.h"
+#include "lua_api/l_internal.h"
+#include "common/c_packer.h"
+#include <cmath>
+#include <unordered_set>
+
+/*
+	LuaSharedTable
+*/
+
+// Returns whether n is a key of the array part, sets the index into it
+static inline bool array_index(const SharedTable &t, lua_Number n, size_t *i)
+{
+	if (!(n >= 1 && n <= t.array.size()) || n != std::floor(n))
+		return false;
+	*i = (size_t)n - 1;
+	return true;
+}
+
+// Returns nullptr if there is no such key
+static const SharedValue *find_value(lua_State *L, const SharedTable &t, int idx)
+{
+	switch (lua_type(L, idx)) {
+	case LUA_TSTRING: {
+		size_t len;
+		const char *s = lua_tolstring(L, idx, &len);
+		auto it = t.strings.find(std::string(s, len));
+		return it == t.strings.end() ? nullptr : &it->second;
+	}
+	case LUA_TNUMBER: {
+		lua_Number n = lua_tonumber(L, idx);
+		size_t i;
+		if (array_index(t, n, &i))
+			return &t.array[i];
+		auto it = t.numbers.find(n);
+		return it == t.numbers.end() ? nullptr : &it->second;
+	}
+	case LUA_TBOOLEAN:
+		return &t.booleans[lua_toboolean(L, idx) ? 1 : 0];
+	default:
+		return nullptr;
+	}
+}
+
+int LuaSharedTable::gc_object(lua_State *L)
+{
+	LuaSharedTable *o = *(LuaSharedTable **)lua_touserdata(L, 1);
+	delete o;
+	return 0;
+}
+
+int LuaSharedTable::mt_index(lua_State *L)
+{
+	LuaSharedTable *o = checkObject<LuaSharedTable>(L, 1);
+	const SharedValue *value = find_value(L, *o->m_table, 2);
+	if (value)
+		pushValue(L, *value);
+	else
+		lua_pushnil(L);
+	return 1;
+}
+
+int LuaSharedTable::mt_newindex(lua_State *L)
+{
+	throw LuaError("Attempt to modify a shared table");
+}
+
+int LuaSharedTable::mt_len(lua_State *L)
+{
+	LuaSharedTable *o = checkObject<LuaSharedTable>(L, 1);
+	lua_pushinteger(L, o->m_table->array.size());
+	return 1;
+}
+
+int LuaSharedTable::mt_eq(lua_State *L)
+{
+	LuaSharedTable *a = toObject(L, 1);
+	LuaSharedTable *b = toObject(L, 2);
+	lua_pushboolean(L, a && b && a->m_table == b->m_table);
+	return 1;
+}
+
+int LuaSharedTable::mt_pairs(lua_State *L)
+{
+	checkObject<LuaSharedTable>(L, 1);
+	lua_pushcfunction(L, l_next);
+	lua_pushvalue(L, 1);
+	lua_pushnil(L);
+	return 3;
+}
+
+int LuaSharedTable::l_next(lua_State *L)
+{
+	const SharedTable &t = *checkObject<LuaSharedTable>(L, 1)->m_table;
+
+	/*
+		The keys are visited in this order: the array part, the string keys,
+		the other numeric keys and then false and true.
+		Find where to continue after the given key first.
+	*/
+	enum { ARRAY, STRINGS, NUMBERS, BOOLEANS } part = ARRAY;
+	size_t i = 0;
+	auto sit = t.strings.begin();
+	auto nit = t.numbers.begin();
+	int b = 0;
+
+	switch (lua_type(L, 2)) {
+	case LUA_TNONE:
+	case LUA_TNIL:
+		break;
+	case LUA_TSTRING: {
+		size_t len;
+		const char *s = lua_tolstring(L, 2, &len);
+		sit = t.strings.find(std::string(s, len));
+		if (sit == t.strings.end())
+			throw LuaError("Invalid key to 'next'");
+		++sit;
+		part = STRINGS;
+		break;
+	}
+	case LUA_TNUMBER: {
+		lua_Number n = lua_tonumber(L, 2);
+		if (array_index(t, n, &i)) {
+			i++;
+			break;
+		}
+		nit = t.numbers.find(n);
+		if (nit == t.numbers.end())
+			throw LuaError("Invalid key to 'next'");
+		++nit;
+		part = NUMBERS;
+		break;
+	}
+	case LUA_TBOOLEAN:
+		b = lua_toboolean(L, 2) ? 2 : 1;
+		part = BOOLEANS;
+		break;
+	default:
+		throw LuaError("Invalid key to 'next'");
+	}
+
+	if (part == ARRAY) {
+		for (; i < t.array.size(); i++) {
+			if (t.array[i].type == SharedValue::Type::Nil)
+				continue;
+			lua_pushinteger(L, i + 1);
+			pushValue(L, t.array[i]);
+			return 2;
+		}
+		part = STRINGS;
+	}
+	if (part == STRINGS) {
+		if (sit != t.strings.end()) {
+			lua_pushlstring(L, sit->first.data(), sit->first.size());
+			pushValue(L, sit->second);
+			return 2;
+		}
+		part = NUMBERS;
+	}
+	if (part == NUMBERS) {
+		if (nit != t.numbers.end()) {
+			lua_pushnumber(L, nit->first);
+			pushValue(L, nit->second);
+			return 2;
+		}
+	}
+	for (; b < 2; b++) {
+		if (t.booleans[b].type == SharedValue::Type::Nil)
+			continue;
+		lua_pushboolean(L, b);
+		pushValue(L, t.booleans[b]);
+		return 2;
+	}
+
+	lua_pushnil(L);
+	return 1;
+}
+
+void *LuaSharedTable::packIn(lua_State *L, int idx)
+{
+	LuaSharedTable *o = checkObject<LuaSharedTable>(L, idx);
+	// Only the reference is passed on
+	return new SharedTablePtr(o->m_table);
+}
+
+void LuaSharedTable::packOut(lua_State *L, void *ptr)
+{
+	SharedTablePtr *table = reinterpret_cast<SharedTablePtr*>(ptr);
+	if (L)
+		create(L, std::move(*table));
+	delete table;
+}
+
+void LuaSharedTable::create(lua_State *L, SharedTablePtr table)
+{
+	LuaSharedTable *o = new LuaSharedTable(std::move(table));
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+}
+
+LuaSharedTable *LuaSharedTable::toObject(lua_State *L, int idx)
+{
+	if (lua_type(L, idx) != LUA_TUSERDATA || !lua_getmetatable(L, idx))
+		return nullptr;
+	luaL_getmetatable(L, className);
+	const bool match = lua_rawequal(L, -1, -2);
+	lua_pop(L, 2);
+	return match ? *(LuaSharedTable **)lua_touserdata(L, idx) : nullptr;
+}
+
+namespace {
+
+struct ShareState {
+	// Tables that were converted already, to keep tables referenced
+	// several times shared
+	std::unordered_map<const void *, SharedTablePtr> done;
+	// Tables that are being converted, to detect cycles
+	std::unordered_set<const void *> open;
+};
+
+}
+
+static SharedTablePtr share_table(lua_State *L, int idx, ShareState &state);
+
+static void share_value(lua_State *L, int idx, SharedValue &out, ShareState &state)
+{
+	switch (lua_type(L, idx)) {
+	case LUA_TNIL:
+		out.type = SharedValue::Type::Nil;
+		break;
+	case LUA_TBOOLEAN:
+		out.type = SharedValue::Type::Boolean;
+		out.bdata = lua_toboolean(L, idx);
+		break;
+	case LUA_TNUMBER:
+		out.type = SharedValue::Type::Number;
+		out.ndata = lua_tonumber(L, idx);
+		break;
+	case LUA_TSTRING: {
+		size_t len;
+		const char *s = lua_tolstring(L, idx, &len);
+		out.type = SharedValue::Type::String;
+		out.sdata.assign(s, len);
+		break;
+	}
+	case LUA_TTABLE:
+		out.type = SharedValue::Type::Table;
+		out.table = share_table(L, idx, state);
+		break;
+	case LUA_TUSERDATA:
+		if (LuaSharedTable *o = LuaSharedTable::toObject(L, idx)) {
+			out.type = SharedValue::Type::Table;
+			out.table = o->getTable();
+			break;
+		}
+		[[fallthrough]];
+	default:
+		throw LuaError(std::string("Can not share a value of type ") +
+			luaL_typename(L, idx));
+	}
+}
+
+static SharedTablePtr share_table(lua_State *L, int idx, ShareState &state)
+{
+	const void *ptr = lua_topointer(L, idx);
+	auto it = state.done.find(ptr);
+	if (it != state.done.end())
+		return it->second;
+	if (!state.open.insert(ptr).second)
+		throw LuaError("Can not share a table that contains itself");
+
+	luaL_checkstack(L, 3, "Shared table is nested too deeply");
+	auto table = std::make_shared<SharedTable>();
+	table->array.resize(lua_objlen(L, idx));
+
+	lua_pushnil(L);
+	while (lua_next(L, idx)) {
+		// key at -2, value at -1
+		const int value = lua_gettop(L);
+		switch (lua_type(L, -2)) {
+		case LUA_TSTRING: {
+			size_t len;
+			const char *s = lua_tolstring(L, -2, &len);
+			share_value(L, value, table->strings[std::string(s, len)], state);
+			break;
+		}
+		case LUA_TNUMBER: {
+			lua_Number n = lua_tonumber(L, -2);
+			size_t i;
+			if (array_index(*table, n, &i))
+				share_value(L, value, table->array[i], state);
+			else
+				share_value(L, value, table->numbers[n], state);
+			break;
+		}
+		case LUA_TBOOLEAN:
+			share_value(L, value, table->booleans[lua_toboolean(L, -2) ? 1 : 0],
+				state);
+			break;
+		default:
+			throw LuaError(std::string("Can not share a table with keys of type ") +
+				luaL_typename(L, -2));
+		}
+		lua_pop(L, 1);
+	}
+
+	state.open.erase(ptr);
+	state.done.emplace(ptr, table);
+	return table;
+}
+
+SharedTablePtr LuaSharedTable::share(lua_State *L, int idx)
+{
+	if (idx < 0)
+		idx = lua_gettop(L) + idx + 1;
+	luaL_checktype(L, idx, LUA_TTABLE);
+	ShareState state;
+	return share_table(L, idx, state);
+}
+
+void LuaSharedTable::pushValue(lua_State *L, const SharedValue &value)
+{
+	switch (value.type) {
+	case SharedValue::Type::Nil:
+		lua_pushnil(L);
+		break;
+	case SharedValue::Type::Boolean:
+		lua_pushboolean(L, value.bdata);
+		break;
+	case SharedValue::Type::Number:
+		lua_pushnumber(L, value.ndata);
+		break;
+	case SharedValue::Type::String:
+		lua_pushlstring(L, value.sdata.data(), value.sdata.size());
+		break;
+	case SharedValue::Type::Table:
+		create(L, value.table);
+		break;
+	}
+}
+
+static void push_copy_value(lua_State *L, const SharedValue &value)
+{
+	if (value.type == SharedValue::Type::Table)
+		LuaSharedTable::pushCopy(L, *value.table);
+	else
+		LuaSharedTable::pushValue(L, value);
+}
+
+void LuaSharedTable::pushCopy(lua_State *L, const SharedTable &table)
+{
+	luaL_checkstack(L, 3, "Shared table is nested too deeply");
+	lua_createtable(L, table.array.size(), table.strings.size() + table.numbers.size());
+	for (size_t i = 0; i < table.array.size(); i++) {
+		push_copy_value(L, table.array[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	for (const auto &it : table.strings) {
+		lua_pushlstring(L, it.first.data(), it.first.size());
+		push_copy_value(L, it.second);
+		lua_rawset(L, -3);
+	}
+	for (const auto &it : table.numbers) {
+		lua_pushnumber(L, it.first);
+		push_copy_value(L, it.second);
+		lua_rawset(L, -3);
+	}
+	for (int b = 0; b < 2; b++) {
+		if (table.booleans[b].type == SharedValue::Type::Nil)
+			continue;
+		lua_pushboolean(L, b);
+		push_copy_value(L, table.booleans[b]);
+		lua_rawset(L, -3);
+	}
+}
+
+void LuaSharedTable::Register(lua_State *L)
+{
+	static const luaL_Reg metamethods[] = {
+		{"__gc", gc_object},
+		{"__newindex", mt_newindex},
+		{"__len", mt_len},
+		{"__eq", mt_eq},
+		{"__pairs", mt_pairs},
+		{0, 0}
+	};
+	registerClass(L, className, methods, metamethods);
+
+	// Indexing looks up the keys of the table, there are no methods
+	luaL_getmetatable(L, className);
+	lua_pushcfunction(L, mt_index);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
+	script_register_packer(L, className, packIn, packOut);
+}
+
+const char LuaSharedTable::className[] = "SharedTable";
+// This is what getmetatable() returns, __pairs is here for pairs() in builtin
+const luaL_Reg LuaSharedTable::methods[] = {
+	{"__pairs", mt_pairs},
+	{0, 0}
+};
+
+/*
+	ModApiShared
+*/
+
+// share(table) -> shared table
+int ModApiShared::l_share(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	if (LuaSharedTable::toObject(L, 1)) {
+		lua_settop(L, 1);
+		return 1;
+	}
+	LuaSharedTable::create(L, LuaSharedTable::share(L, 1));
+	return 1;
+}
+
+// unshare(shared table) -> table
+int ModApiShared::l_unshare(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	LuaSharedTable *o = checkObject<LuaSharedTable>(L, 1);
+	LuaSharedTable::pushCopy(L, *o->getTable());
+	return 1;
+}
+
+void ModApiShared::Initialize(lua_State *L, int top)
+{
+	API_FCT(share);
+	API_FCT(unshare);
+}
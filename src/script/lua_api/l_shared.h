@@ -0,0 +1,114 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "lua_api/l_base.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct SharedTable;
+typedef std::shared_ptr<const SharedTable> SharedTablePtr;
+
+// A value in a shared table: nil, boolean, number, string or another table
+struct SharedValue
+{
+	enum class Type : u8 { Nil, Boolean, Number, String, Table };
+
+	Type type = Type::Nil;
+	bool bdata = false;
+	lua_Number ndata = 0;
+	std::string sdata;
+	SharedTablePtr table;
+};
+
+/*
+	An immutable table that Lua code in any environment can read without
+	unpacking it first. It is reference counted, so passing it through IPC
+	or to an async job does not copy it.
+*/
+struct SharedTable
+{
+	// Values of the keys 1 to n
+	std::vector<SharedValue> array;
+	std::unordered_map<std::string, SharedValue> strings;
+	// Numeric keys that are not in the array part
+	std::unordered_map<lua_Number, SharedValue> numbers;
+	// Values of the keys false and true
+	SharedValue booleans[2];
+};
+
+class LuaSharedTable : public ModApiBase {
+private:
+	SharedTablePtr m_table;
+
+	static const luaL_Reg methods[];
+
+	// garbage collector
+	static int gc_object(lua_State *L);
+
+	// __index(self, key) -> value
+	static int mt_index(lua_State *L);
+
+	// __newindex(self, key, value), always fails
+	static int mt_newindex(lua_State *L);
+
+	// __len(self) -> size of the array part
+	static int mt_len(lua_State *L);
+
+	// __eq(self, other) -> whether both are the same table
+	static int mt_eq(lua_State *L);
+
+	// __pairs(self) -> next, self, nil
+	static int mt_pairs(lua_State *L);
+
+	// next(self, key) -> key, value
+	static int l_next(lua_State *L);
+
+	static void *packIn(lua_State *L, int idx);
+	static void packOut(lua_State *L, void *ptr);
+
+public:
+	LuaSharedTable(SharedTablePtr table) : m_table(std::move(table)) {}
+	~LuaSharedTable() = default;
+
+	const SharedTablePtr &getTable() const { return m_table; }
+
+	// Pushes a shared table
+	static void create(lua_State *L, SharedTablePtr table);
+
+	// Returns nullptr if the value at idx is not a shared table
+	static LuaSharedTable *toObject(lua_State *L, int idx);
+
+	/**
+	 * Make a shared table from the Lua table at idx. Shared tables nested
+	 * in it are reused instead of being copied.
+	 * @throws LuaError if it contains values that can not be shared,
+	 *  e.g. functions, or contains itself
+	 */
+	static SharedTablePtr share(lua_State *L, int idx);
+
+	// Pushes a value, nested tables are pushed as shared tables
+	static void pushValue(lua_State *L, const SharedValue &value);
+
+	// Pushes a deep copy as regular Lua table
+	static void pushCopy(lua_State *L, const SharedTable &table);
+
+	static void Register(lua_State *L);
+
+	static const char className[];
+};
+
+class ModApiShared : public ModApiBase {
+private:
+	// share(table) -> shared table
+	static int l_share(lua_State *L);
+
+	// unshare(shared table) -> table
+	static int l_unshare(lua_State *L);
+
+public:
+	static void Initialize(lua_State *L, int top);
+};
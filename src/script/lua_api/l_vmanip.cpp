@@ -312,6 +312,26 @@ int LuaVoxelManip::l_set_param2_data(lua_State *L)
 	return 0;
 }
 
+// get_buffer(self, [field])
+int LuaVoxelManip::l_get_buffer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	checkObject<LuaVoxelManip>(L, 1);
+	std::string_view field = lua_isnoneornil(L, 2) ? "content" : readParam<std::string_view>(L, 2);
+
+	if (field == "content")
+		LuaVoxelBuffer::create(L, 1, LuaVoxelBuffer::FIELD_CONTENT);
+	else if (field == "param1")
+		LuaVoxelBuffer::create(L, 1, LuaVoxelBuffer::FIELD_PARAM1);
+	else if (field == "param2")
+		LuaVoxelBuffer::create(L, 1, LuaVoxelBuffer::FIELD_PARAM2);
+	else
+		throw LuaError("VoxelManip:get_buffer: unknown field \"" + std::string(field) + "\"");
+
+	return 1;
+}
+
 int LuaVoxelManip::l_update_map(lua_State *L)
 {
 	return 0;
@@ -431,6 +451,8 @@ void LuaVoxelManip::Register(lua_State *L)
 	lua_register(L, className, create_object);
 
 	script_register_packer(L, className, packIn, packOut);
+
+	LuaVoxelBuffer::Register(L);
 }
 
 const char LuaVoxelManip::className[] = "VoxelManip";
@@ -449,7 +471,292 @@ const luaL_Reg LuaVoxelManip::methods[] = {
 	luamethod(LuaVoxelManip, set_light_data),
 	luamethod(LuaVoxelManip, get_param2_data),
 	luamethod(LuaVoxelManip, set_param2_data),
+	luamethod(LuaVoxelManip, get_buffer),
 	luamethod(LuaVoxelManip, was_modified),
 	luamethod(LuaVoxelManip, get_emerged_area),
 	{0,0}
 };
+
+/*
+	LuaVoxelBuffer
+*/
+
+// Calls func with a reference to the buffer's field of every node in [first, last]
+template <typename F>
+static void foreach_field(MapNode *data, LuaVoxelBuffer::Field field,
+		u32 first, u32 last, F &&func)
+{
+	switch (field) {
+	case LuaVoxelBuffer::FIELD_CONTENT:
+		for (u32 i = first; i <= last; i++)
+			func(data[i].param0);
+		break;
+	case LuaVoxelBuffer::FIELD_PARAM1:
+		for (u32 i = first; i <= last; i++)
+			func(data[i].param1);
+		break;
+	case LuaVoxelBuffer::FIELD_PARAM2:
+		for (u32 i = first; i <= last; i++)
+			func(data[i].param2);
+		break;
+	}
+}
+
+u32 LuaVoxelBuffer::getVolume() const
+{
+	return m_vm->vm->m_area.getVolume();
+}
+
+u16 LuaVoxelBuffer::get(u32 i) const
+{
+	const MMVManip *vm = m_vm->vm;
+	// Do not push unintialized data to Lua, same as get_data()
+	if (vm->m_flags[i] & VOXELFLAG_NO_DATA)
+		return m_field == FIELD_CONTENT ? CONTENT_IGNORE : 0;
+
+	switch (m_field) {
+	case FIELD_CONTENT:
+		return vm->m_data[i].getContent();
+	case FIELD_PARAM1:
+		return vm->m_data[i].getParam1();
+	case FIELD_PARAM2:
+		return vm->m_data[i].getParam2();
+	}
+	return 0;
+}
+
+void LuaVoxelBuffer::set(u32 i, u16 value)
+{
+	MapNode &n = m_vm->vm->m_data[i];
+	switch (m_field) {
+	case FIELD_CONTENT:
+		n.setContent(value);
+		break;
+	case FIELD_PARAM1:
+		n.setParam1(value);
+		break;
+	case FIELD_PARAM2:
+		n.setParam2(value);
+		break;
+	}
+}
+
+void LuaVoxelBuffer::readRange(lua_State *L, int idx, u32 *first, u32 *last) const
+{
+	const lua_Integer volume = getVolume();
+	lua_Integer i1 = lua_isnoneornil(L, idx) ? 1 : luaL_checkinteger(L, idx);
+	lua_Integer i2 = lua_isnoneornil(L, idx + 1) ? volume : luaL_checkinteger(L, idx + 1);
+	if (i1 < 1 || i2 > volume || i1 > i2 + 1)
+		throw LuaError("VoxelBuffer: index range out of bounds");
+	// Callers must check for an empty range (first > last)
+	*first = i1 - 1;
+	*last = i2 - 1;
+}
+
+void LuaVoxelBuffer::create(lua_State *L, int vm_idx, Field field)
+{
+	LuaVoxelManip *vm = checkObject<LuaVoxelManip>(L, vm_idx);
+	lua_pushvalue(L, vm_idx);
+	int vm_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	LuaVoxelBuffer *o = new LuaVoxelBuffer(vm, vm_ref, field);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+}
+
+int LuaVoxelBuffer::gc_object(lua_State *L)
+{
+	LuaVoxelBuffer *o = *(LuaVoxelBuffer **)(lua_touserdata(L, 1));
+	luaL_unref(L, LUA_REGISTRYINDEX, o->m_vm_ref);
+	delete o;
+
+	return 0;
+}
+
+// __index(self, key)
+int LuaVoxelBuffer::mt_index(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = *(LuaVoxelBuffer **)(lua_touserdata(L, 1));
+
+	if (lua_type(L, 2) != LUA_TNUMBER) {
+		// Method lookup
+		lua_pushvalue(L, 2);
+		lua_rawget(L, lua_upvalueindex(1));
+		return 1;
+	}
+
+	lua_Integer i = lua_tointeger(L, 2);
+	if (i < 1 || i > (lua_Integer)o->getVolume()) {
+		lua_pushnil(L);
+		return 1;
+	}
+	lua_pushinteger(L, o->get(i - 1));
+	return 1;
+}
+
+// __newindex(self, index, value)
+int LuaVoxelBuffer::mt_newindex(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = *(LuaVoxelBuffer **)(lua_touserdata(L, 1));
+	lua_Integer i = luaL_checkinteger(L, 2);
+	lua_Integer value = luaL_checkinteger(L, 3);
+
+	if (i < 1 || i > (lua_Integer)o->getVolume())
+		throw LuaError("VoxelBuffer: index " + std::to_string(i) + " out of bounds");
+	o->set(i - 1, value);
+	return 0;
+}
+
+// __len(self)
+int LuaVoxelBuffer::mt_len(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = *(LuaVoxelBuffer **)(lua_touserdata(L, 1));
+	lua_pushinteger(L, o->getVolume());
+	return 1;
+}
+
+// get_field(self)
+int LuaVoxelBuffer::l_get_field(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = checkObject<LuaVoxelBuffer>(L, 1);
+	static const char *names[] = {"content", "param1", "param2"};
+	lua_pushstring(L, names[o->m_field]);
+	return 1;
+}
+
+// fill(self, value, [first], [last])
+int LuaVoxelBuffer::l_fill(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = checkObject<LuaVoxelBuffer>(L, 1);
+	lua_Integer value = luaL_checkinteger(L, 2);
+	u32 first, last;
+	o->readRange(L, 3, &first, &last);
+	if (first > last)
+		return 0;
+
+	foreach_field(o->m_vm->vm->m_data, o->m_field, first, last, [value] (auto &v) {
+		v = value;
+	});
+	return 0;
+}
+
+// copy_from(self, src, [first])
+// src is another VoxelBuffer or an array table
+int LuaVoxelBuffer::l_copy_from(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = checkObject<LuaVoxelBuffer>(L, 1);
+	const u32 volume = o->getVolume();
+	lua_Integer first = lua_isnoneornil(L, 3) ? 1 : luaL_checkinteger(L, 3);
+	if (first < 1 || first > (lua_Integer)volume + 1)
+		throw LuaError("VoxelBuffer: index out of bounds");
+	const u32 offset = first - 1;
+
+	if (lua_istable(L, 2)) {
+		const u32 count = MYMIN(lua_objlen(L, 2), volume - offset);
+		for (u32 i = 0; i < count; i++) {
+			lua_rawgeti(L, 2, i + 1);
+			o->set(offset + i, lua_tointeger(L, -1));
+			lua_pop(L, 1);
+		}
+		return 0;
+	}
+
+	LuaVoxelBuffer *src = checkObject<LuaVoxelBuffer>(L, 2);
+	const u32 count = MYMIN(src->getVolume(), volume - offset);
+	if (src->m_vm == o->m_vm && src->m_field == o->m_field) {
+		if (offset == 0)
+			return 0;
+		// Overlapping, copy backwards
+		for (u32 i = count; i-- > 0;)
+			o->set(offset + i, src->get(i));
+		return 0;
+	}
+	for (u32 i = 0; i < count; i++)
+		o->set(offset + i, src->get(i));
+	return 0;
+}
+
+// replace(self, lut, [first], [last])
+// Replaces every value that is a key of lut by the associated value
+int LuaVoxelBuffer::l_replace(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = checkObject<LuaVoxelBuffer>(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	u32 first, last;
+	o->readRange(L, 3, &first, &last);
+
+	// Turn the table into a dense lookup table once, so that the loop over
+	// the nodes does not need to touch Lua at all
+	const u32 max_value = o->getMaxValue();
+	std::vector<u16> lut(max_value + 1);
+	for (u32 i = 0; i <= max_value; i++)
+		lut[i] = i;
+	lua_pushnil(L);
+	while (lua_next(L, 2) != 0) {
+		lua_Integer from = luaL_checkinteger(L, -2);
+		lua_Integer to = luaL_checkinteger(L, -1);
+		if (from >= 0 && from <= (lua_Integer)max_value)
+			lut[from] = to;
+		lua_pop(L, 1);
+	}
+
+	u32 replaced = 0;
+	if (first <= last) {
+		const u8 *flags = o->m_vm->vm->m_flags;
+		MapNode *data = o->m_vm->vm->m_data;
+		// Nodes without data are left alone, they never match real content
+		u32 i = first;
+		foreach_field(data, o->m_field, first, last, [&] (auto &v) {
+			if (!(flags[i++] & VOXELFLAG_NO_DATA) && lut[v] != v) {
+				v = lut[v];
+				replaced++;
+			}
+		});
+	}
+
+	lua_pushinteger(L, replaced);
+	return 1;
+}
+
+void LuaVoxelBuffer::Register(lua_State *L)
+{
+	static const luaL_Reg metamethods[] = {
+		{"__gc", gc_object},
+		{"__newindex", mt_newindex},
+		{"__len", mt_len},
+		{0, 0}
+	};
+	registerClass(L, className, methods, metamethods);
+
+	// Replace the plain method table lookup so that numeric indices can be
+	// resolved too
+	luaL_getmetatable(L, className);
+	lua_getfield(L, -1, "__index");
+	lua_pushcclosure(L, mt_index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+}
+
+const char LuaVoxelBuffer::className[] = "VoxelBuffer";
+const luaL_Reg LuaVoxelBuffer::methods[] = {
+	luamethod(LuaVoxelBuffer, get_field),
+	luamethod(LuaVoxelBuffer, fill),
+	luamethod(LuaVoxelBuffer, copy_from),
+	luamethod(LuaVoxelBuffer, replace),
+	{0,0}
+};
@@ -42,6 +42,8 @@ class LuaVoxelManip : public ModApiBase
 	static int l_get_param2_data(lua_State *L);
 	static int l_set_param2_data(lua_State *L);
 
+	static int l_get_buffer(lua_State *L);
+
 	static int l_was_modified(lua_State *L);
 	static int l_get_emerged_area(lua_State *L);
 
@@ -65,3 +67,59 @@ class LuaVoxelManip : public ModApiBase
 
 	static const char className[];
 };
+
+/*
+  VoxelBuffer
+
+  View on one field (content, param1 or param2) of the nodes in a VoxelManip.
+  Reads and writes go straight to the VoxelManip's data without any Lua
+  tables in between. The buffer keeps its VoxelManip alive and always
+  reflects its current area.
+ */
+class LuaVoxelBuffer : public ModApiBase
+{
+public:
+	enum Field : u8 {
+		FIELD_CONTENT,
+		FIELD_PARAM1,
+		FIELD_PARAM2,
+	};
+
+	LuaVoxelBuffer(LuaVoxelManip *vm, int vm_ref, Field field) :
+		m_vm(vm), m_vm_ref(vm_ref), m_field(field)
+	{}
+
+	// Creates a buffer for the VoxelManip at index vm_idx and leaves it on top
+	// of the stack
+	static void create(lua_State *L, int vm_idx, Field field);
+
+	static void Register(lua_State *L);
+
+	static const char className[];
+
+private:
+	LuaVoxelManip *m_vm;
+	// Registry reference that keeps the VoxelManip userdata alive
+	int m_vm_ref;
+	Field m_field;
+
+	u32 getVolume() const;
+	u16 get(u32 i) const;
+	void set(u32 i, u16 value);
+	u16 getMaxValue() const { return m_field == FIELD_CONTENT ? U16_MAX : U8_MAX; }
+
+	// Reads an optional 1-based index range, defaulting to the whole buffer
+	void readRange(lua_State *L, int idx, u32 *first, u32 *last) const;
+
+	static const luaL_Reg methods[];
+
+	static int gc_object(lua_State *L);
+	static int mt_index(lua_State *L);
+	static int mt_newindex(lua_State *L);
+	static int mt_len(lua_State *L);
+
+	static int l_get_field(lua_State *L);
+	static int l_fill(lua_State *L);
+	static int l_copy_from(lua_State *L);
+	static int l_replace(lua_State *L);
+};
@@ -20,6 +20,7 @@
 #include "lua_api/l_util.h"
 #include "lua_api/l_vmanip.h"
 #include "lua_api/l_settings.h"
+#include "lua_api/l_shared.h"
 #include "lua_api/l_ipc.h"
 
 extern "C" {
@@ -67,6 +68,7 @@ void EmergeScripting::InitializeModApi(lua_State *L, int top)
 	LuaSecureRandom::Register(L);
 	LuaVoxelManip::Register(L);
 	LuaSettings::Register(L);
+	LuaSharedTable::Register(L);
 
 	// Initialize mod api modules
 	ModApiCraft::InitializeAsync(L, top);
@@ -76,5 +78,6 @@ void EmergeScripting::InitializeModApi(lua_State *L, int top)
 	ModApiServer::InitializeAsync(L, top);
 	ModApiUtil::InitializeAsync(L, top);
 	ModApiIPC::Initialize(L, top);
+	ModApiShared::Initialize(L, top);
 	// TODO ^ these should also be renamed to InitializeRO or such
 }
@@ -29,6 +29,7 @@
 #include "lua_api/l_util.h"
 #include "lua_api/l_vmanip.h"
 #include "lua_api/l_settings.h"
+#include "lua_api/l_shared.h"
 #include "lua_api/l_http.h"
 #include "lua_api/l_storage.h"
 #include "lua_api/l_ipc.h"
@@ -73,6 +74,11 @@ ServerScripting::ServerScripting(Server* server):
 	lua_pushstring(L, "game");
 	lua_setglobal(L, "INIT");
 
+	if (g_settings->getBool("lua_accounting")) {
+		m_accounting = std::make_unique<ScriptAccounting>(L, server->getMetricsBackend());
+		m_accounting->setBudget(g_settings->getFloat("lua_accounting_budget", 0.0f, 1e6f) * 1000);
+	}
+
 	infostream << "SCRIPTAPI: Initialized game modules" << std::endl;
 }
 
@@ -99,6 +105,18 @@ void ServerScripting::saveGlobals()
 	lua_pop(L, 2); // pop 'core', return value
 }
 
+void ServerScripting::setRandomSeed(u64 seed)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	lua_getglobal(L, "math");
+	lua_getfield(L, -1, "randomseed");
+	// Same range as the seed builtin picks
+	lua_pushnumber(L, seed % (1ULL << 40));
+	lua_call(L, 1, 0);
+	lua_pop(L, 1); // pop 'math'
+}
+
 void ServerScripting::initAsync()
 {
 	infostream << "SCRIPTAPI: Initializing async engine" << std::endl;
@@ -108,6 +126,7 @@ void ServerScripting::initAsync()
 	asyncEngine.registerStateInitializer(ModApiItem::InitializeAsync);
 	asyncEngine.registerStateInitializer(ModApiServer::InitializeAsync);
 	asyncEngine.registerStateInitializer(ModApiIPC::Initialize);
+	asyncEngine.registerStateInitializer(ModApiShared::Initialize);
 	// not added: ModApiMapgen is a minefield for thread safety
 	// not added: ModApiHttp async api can't really work together with our jobs
 	// not added: ModApiStorage is probably not thread safe(?)
@@ -127,6 +146,14 @@ u32 ServerScripting::queueAsync(std::string &&serialized_func,
 			param, mod_origin);
 }
 
+u32 ServerScripting::queueAsyncBatch(const std::string &serialized_func,
+	std::vector<std::unique_ptr<PackedValue>> &&params,
+	const std::string &mod_origin)
+{
+	return asyncEngine.queueAsyncJobs(serialized_func,
+			std::move(params), mod_origin);
+}
+
 void ServerScripting::InitializeModApi(lua_State *L, int top)
 {
 	// Register reference classes (userdata)
@@ -146,6 +173,7 @@ void ServerScripting::InitializeModApi(lua_State *L, int top)
 	ObjectRef::Register(L);
 	PlayerMetaRef::Register(L);
 	LuaSettings::Register(L);
+	LuaSharedTable::Register(L);
 	StorageRef::Register(L);
 	ModChannelRef::Register(L);
 
@@ -164,6 +192,7 @@ void ServerScripting::InitializeModApi(lua_State *L, int top)
 	ModApiStorage::Initialize(L, top);
 	ModApiChannels::Initialize(L, top);
 	ModApiIPC::Initialize(L, top);
+	ModApiShared::Initialize(L, top);
 }
 
 void ServerScripting::InitializeAsync(lua_State *L, int top)
@@ -179,6 +208,7 @@ void ServerScripting::InitializeAsync(lua_State *L, int top)
 	LuaSecureRandom::Register(L);
 	LuaVoxelManip::Register(L);
 	LuaSettings::Register(L);
+	LuaSharedTable::Register(L);
 
 	// globals data
 	auto *data = ModApiBase::getServer(L)->m_lua_globals_data.get();
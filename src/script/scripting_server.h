@@ -40,6 +40,9 @@ class ServerScripting:
 	// Save globals that are copied into other Lua envs
 	void saveGlobals();
 
+	// Reseed math.random, used to make replays deterministic
+	void setRandomSeed(u64 seed);
+
 	// Initialize async engine, call this AFTER loading all mods
 	void initAsync();
 
@@ -49,6 +52,10 @@ class ServerScripting:
 	// Pass job to async threads
 	u32 queueAsync(std::string &&serialized_func,
 		PackedValue *param, const std::string &mod_origin);
+	// Pass several jobs with the same function, returns the first job ID
+	u32 queueAsyncBatch(const std::string &serialized_func,
+		std::vector<std::unique_ptr<PackedValue>> &&params,
+		const std::string &mod_origin);
 
 protected:
 	// from ScriptApiSecurity:
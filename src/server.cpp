@@ -15,6 +15,7 @@
 #include "environment.h"
 #include "servermap.h"
 #include "threading/mutex_auto_lock.h"
+#include "threading/task_pool.h"
 #include "constants.h"
 #include "voxel.h"
 #include "config.h"
@@ -38,6 +39,7 @@
 #include "content/mods.h"
 #include "modchannels.h"
 #include "server/serverlist.h"
+#include "server/session_recorder.h"
 #include "util/string.h"
 #include "server/rollback.h"
 #include "util/serialize.h"
@@ -45,6 +47,7 @@
 #include "defaultsettings.h"
 #include "server/mods.h"
 #include "util/base64.h"
+#include "util/formspec_diff.h"
 #include "util/hashing.h"
 #include "util/hex.h"
 #include "database/database.h"
@@ -59,6 +62,7 @@
 #include "database/database-postgresql.h"
 #endif
 #include "database/database-files.h"
+#include "database/database-journal.h"
 #include "database/database-dummy.h"
 #include "gameparams.h"
 #include "particles.h"
@@ -259,7 +263,8 @@ Server::Server(
 		Address bind_addr,
 		bool dedicated,
 		ChatInterface *iface,
-		std::string *shutdown_errmsg
+		std::string *shutdown_errmsg,
+		std::shared_ptr<con::IConnection> con
 	):
 	m_bind_addr(bind_addr),
 	m_path_world(path_world),
@@ -267,7 +272,8 @@ Server::Server(
 	m_simple_singleplayer_mode(simple_singleplayer_mode),
 	m_dedicated(dedicated),
 	m_async_fatal_error(""),
-	m_con(con::createMTP(CONNECTION_TIMEOUT, m_bind_addr.isIPv6(), this)),
+	m_con(con ? std::move(con) :
+		std::shared_ptr<con::IConnection>(con::createMTP(CONNECTION_TIMEOUT, m_bind_addr.isIPv6(), this))),
 	m_itemdef(createItemDefManager()),
 	m_nodedef(createNodeDefManager()),
 	m_craftdef(createCraftDefManager()),
@@ -325,6 +331,27 @@ Server::Server(
 			"minetest_core_map_edit_events",
 			"Number of map edit events");
 
+	m_block_cache_hit_counter = m_metrics_backend->addCounter(
+			"minetest_core_block_cache_hits",
+			"Number of map blocks not sent because the client had them cached");
+
+	m_step_time_histogram = m_metrics_backend->addHistogram(
+			"minetest_core_server_step_time",
+			"Duration of server steps (in microseconds)",
+			{1e3, 2e3, 5e3, 1e4, 2e4, 5e4, 1e5, 2e5, 5e5, 1e6});
+
+	m_envlock_counter = m_metrics_backend->addCounter(
+			"minetest_core_envlock_acquisitions",
+			"Number of times the environment lock was taken");
+
+	m_envlock_contended_counter = m_metrics_backend->addCounter(
+			"minetest_core_envlock_contended",
+			"Number of times a thread had to wait for the environment lock");
+
+	m_envlock_wait_counter = m_metrics_backend->addCounter(
+			"minetest_core_envlock_wait_time",
+			"Time spent waiting for the environment lock (in microseconds)");
+
 	m_lag_gauge->set(g_settings->getFloat("dedicated_server_step"));
 
 	m_path_mod_data = porting::path_user + DIR_DELIM "mod_data";
@@ -493,6 +520,12 @@ void Server::init()
 
 	m_script->loadBuiltin();
 
+	if (m_random_seed) {
+		// builtin seeds math.random from the clock
+		mysrand(*m_random_seed);
+		m_script->setRandomSeed(*m_random_seed);
+	}
+
 	m_gamespec.checkAndLog();
 	m_modmgr->loadMods(*m_script);
 
@@ -602,6 +635,21 @@ void Server::start()
 	actionstream << "." << std::endl;
 }
 
+void Server::startOffline()
+{
+	init();
+
+	actionstream << "World at [" << m_path_world << "]" << std::endl;
+	actionstream << "Server for gameid=\"" << m_gamespec.id
+			<< "\" started without network." << std::endl;
+}
+
+void Server::setSessionRecorder(std::unique_ptr<SessionRecorder> recorder)
+{
+	m_random_seed = recorder->getSeed();
+	m_session_recorder = std::move(recorder);
+}
+
 void Server::stop()
 {
 	infostream<<"Server: Stopping and waiting for threads"<<std::endl;
@@ -631,12 +679,16 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 {
 	ZoneScoped;
 	auto framemarker = FrameMarker("Server::AsyncRunStep()-frame").started();
+	const u64 step_start = porting::getTimeUs();
 
 	if (!m_async_fatal_error.get().empty()) {
 		infostream << "Refusing server step in error state" << std::endl;
 		return;
 	}
 
+	if (m_session_recorder)
+		m_session_recorder->recordStep(dtime, initial_step);
+
 	{
 		// Send blocks to clients
 		SendBlocks(dtime);
@@ -1061,27 +1113,39 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 			g_settings->getFloat("server_map_save_interval");
 		if (counter >= save_interval) {
 			counter = 0.0;
-			EnvAutoLock lock(this);
 
 			ScopeProfiler sp(g_profiler, "Server: map saving (sum)");
+			ServerMap &map = m_env->getServerMap();
+			MapSaveSnapshot snapshot;
+			{
+				EnvAutoLock lock(this);
+
+				// Save ban file
+				if (m_banmanager->isModified()) {
+					m_banmanager->save();
+				}
 
-			// Save ban file
-			if (m_banmanager->isModified()) {
-				m_banmanager->save();
-			}
+				// Serialize changed parts of map
+				map.snapshotModified(MOD_STATE_WRITE_NEEDED, snapshot);
+
+				// Save players
+				m_env->saveLoadedPlayers();
 
-			// Save changed parts of map
-			m_env->getMap().save(MOD_STATE_WRITE_NEEDED);
+				// Save environment metadata
+				m_env->saveMeta();
+			}
 
-			// Save players
-			m_env->saveLoadedPlayers();
+			// Compress and write them while others use the map
+			map.writeSnapshot(snapshot);
 
-			// Save environment metadata
-			m_env->saveMeta();
+			EnvAutoLock lock(this);
+			map.releaseSnapshot(snapshot);
 		}
 	}
 
 	m_shutdown_state.tick(dtime, this);
+
+	m_step_time_histogram->observe(porting::getTimeUs() - step_start);
 }
 
 void Server::Receive(float min_time)
@@ -1096,10 +1160,8 @@ void Server::Receive(float min_time)
 	};
 
 	NetworkPacket pkt;
-	session_t peer_id;
 	for (;;) {
 		pkt.clear();
-		peer_id = 0;
 		try {
 			// Round up since the target step length is the minimum step length,
 			// we only have millisecond precision and we don't want to busy-wait
@@ -1114,28 +1176,38 @@ void Server::Receive(float min_time)
 					break;
 			}
 
-			peer_id = pkt.getPeerId();
-			m_packet_recv_counter->increment();
-			ProcessData(&pkt);
-			m_packet_recv_processed_counter->increment();
+			processPacket(&pkt);
 		} catch (const con::InvalidIncomingDataException &e) {
 			infostream << "Server::Receive(): InvalidIncomingDataException: what()="
 					<< e.what() << std::endl;
-		} catch (const SerializationError &e) {
-			infostream << "Server::Receive(): SerializationError: what()="
-					<< e.what() << std::endl;
-		} catch (const ClientStateError &e) {
-			errorstream << "ClientStateError: peer=" << peer_id << " what()="
-					 << e.what() << std::endl;
-			DenyAccess(peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
-		} catch (con::PeerNotFoundException &e) {
-			infostream << "Server: PeerNotFoundException" << std::endl;
-		} catch (ClientNotFoundException &e) {
-			infostream << "Server: ClientNotFoundException" << std::endl;
 		}
 	}
 }
 
+void Server::processPacket(NetworkPacket *pkt)
+{
+	const session_t peer_id = pkt->getPeerId();
+	if (m_session_recorder)
+		m_session_recorder->recordPacket(pkt);
+
+	try {
+		m_packet_recv_counter->increment();
+		ProcessData(pkt);
+		m_packet_recv_processed_counter->increment();
+	} catch (const SerializationError &e) {
+		infostream << "Server::Receive(): SerializationError: what()="
+				<< e.what() << std::endl;
+	} catch (const ClientStateError &e) {
+		errorstream << "ClientStateError: peer=" << peer_id << " what()="
+				 << e.what() << std::endl;
+		DenyAccess(peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
+	} catch (con::PeerNotFoundException &e) {
+		infostream << "Server: PeerNotFoundException" << std::endl;
+	} catch (ClientNotFoundException &e) {
+		infostream << "Server: ClientNotFoundException" << std::endl;
+	}
+}
+
 void Server::yieldToOtherThreads(float dtime)
 {
 	/*
@@ -1349,6 +1421,9 @@ void Server::peerAdded(con::IPeer *peer)
 {
 	verbosestream << "Server::peerAdded(): id=" << peer->id << std::endl;
 
+	if (m_session_recorder)
+		m_session_recorder->recordPeerAdded(peer->id, peer->getAddress());
+
 	m_clients.CreateClient(peer->id);
 }
 
@@ -1357,6 +1432,9 @@ void Server::deletingPeer(con::IPeer *peer, bool timeout)
 	verbosestream << "Server::deletingPeer(): id=" << peer->id
 		<< ", timeout=" << timeout << std::endl;
 
+	if (m_session_recorder)
+		m_session_recorder->recordPeerRemoved(peer->id, timeout);
+
 	m_clients.event(peer->id, CSE_Disconnect);
 	DeleteClient(peer->id, timeout ? CDR_TIMEOUT : CDR_LEAVE);
 }
@@ -1594,6 +1672,14 @@ void Server::SendShowFormspecMessage(session_t peer_id, const std::string &forms
 		pkt.putLongString("");
 	} else {
 		m_formspec_state_data[peer_id] = formname;
+		if (m_clients.getProtocolVersion(peer_id) >= 48) {
+			std::string &last_formspec = m_formspec_sent[peer_id];
+			const bool sent_diff = !last_formspec.empty() &&
+				SendFormspecDiff(peer_id, last_formspec, formspec, formname);
+			last_formspec = formspec;
+			if (sent_diff)
+				return;
+		}
 		pkt.putLongString(formspec);
 	}
 	pkt << formname;
@@ -1601,6 +1687,24 @@ void Server::SendShowFormspecMessage(session_t peer_id, const std::string &forms
 	Send(&pkt);
 }
 
+bool Server::SendFormspecDiff(session_t peer_id, const std::string &last_formspec,
+	const std::string &formspec, const std::string &formname)
+{
+	std::ostringstream os(std::ios_base::binary);
+	os << serializeString16(formname);
+	FormspecDiff::make(last_formspec, formspec).serialize(os);
+
+	// Not worth it if most of the form changed
+	const std::string data = os.str();
+	if (data.size() >= formspec.size())
+		return false;
+
+	NetworkPacket pkt(TOCLIENT_FORMSPEC_DIFF, data.size(), peer_id);
+	pkt.putRawString(data);
+	Send(&pkt);
+	return true;
+}
+
 // Spawns a particle on peer with peer_id
 void Server::SendSpawnParticle(session_t peer_id, u16 protocol_version,
 	const ParticleParameters &p)
@@ -2431,10 +2535,27 @@ void Server::sendMetadataChanged(const std::unordered_set<v3s16> &positions, flo
 	}
 }
 
-void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
-		u16 net_proto_version, SerializedBlockCache *cache)
+Server::EnvAutoLock::EnvAutoLock(Server *server) :
+	m_mutex(server->m_env_mutex)
+{
+	// Also fails while others are queued, so this does not jump the queue
+	if (!m_mutex.try_lock()) {
+		const u64 start_us = porting::getTimeUs();
+		m_mutex.lock();
+		if (server->m_envlock_contended_counter) {
+			server->m_envlock_contended_counter->increment();
+			server->m_envlock_wait_counter->increment(porting::getTimeUs() - start_us);
+		}
+	}
+	if (server->m_envlock_counter)
+		server->m_envlock_counter->increment();
+}
+
+void Server::SendBlockNoLock(RemoteClient *client, MapBlock *block,
+		SerializedBlockCache *cache)
 {
 	thread_local const int net_compression_level = rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
+	const u8 ver = client->serialization_version;
 	std::string s, *sptr = nullptr;
 
 	if (cache) {
@@ -2452,82 +2573,152 @@ void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 		sptr = &s;
 	}
 
-	NetworkPacket pkt(TOCLIENT_BLOCKDATA, 2 + 2 + 2 + sptr->size(), peer_id);
-	pkt << block->getPos();
-	pkt.putRawString(*sptr);
-	Send(&pkt);
+	SendBlockData(client, block->getPos(), *sptr);
 
 	// Store away in cache
 	if (cache && sptr == &s)
 		(*cache)[{block->getPos(), ver}] = std::move(s);
 }
 
-void Server::SendBlocks(float dtime)
+void Server::SendBlockData(RemoteClient *client, v3s16 blockpos, const std::string &data)
 {
-	EnvAutoLock envlock(this);
+	bool cached = false;
+	if (client->hasBlockCache()) {
+		u64 hash = murmur_hash_64_ua(data.data(), data.size(), BLOCK_CACHE_HASH_SEED);
+		cached = client->checkCachedBlock(blockpos, hash);
+	}
+
+	if (cached) {
+		NetworkPacket pkt(TOCLIENT_BLOCKDATA_CACHED, 2 + 2 + 2, client->peer_id);
+		pkt << blockpos;
+		Send(&pkt);
+		m_block_cache_hit_counter->increment();
+	} else {
+		NetworkPacket pkt(TOCLIENT_BLOCKDATA, 2 + 2 + 2 + data.size(), client->peer_id);
+		pkt << blockpos;
+		pkt.putRawString(data);
+		Send(&pkt);
+	}
+}
 
-	std::vector<PrioritySortedBlockTransfer> queue;
+void Server::SendBlocks(float dtime)
+{
+	thread_local const int net_compression_level = rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
 
-	u32 total_sending = 0, unique_clients = 0;
+	/*
+		Blocks are only serialized while the environment is locked. The
+		compression, which takes most of the time, happens afterwards on
+		the serialized data, so other threads can use the map meanwhile.
+	*/
+	struct BlockSend {
+		session_t peer_id;
+		std::pair<v3s16, u16> key;
+	};
+	std::vector<BlockSend> sends;
+	// Uncompressed data for version >= 29, shared by clients of the same version
+	SerializedBlockCache serialized;
 
 	{
-		ScopeProfiler sp2(g_profiler, "Server::SendBlocks(): Collect list");
+		EnvAutoLock envlock(this);
 
-		std::vector<session_t> clients = m_clients.getClientIDs();
+		std::vector<PrioritySortedBlockTransfer> queue;
 
-		ClientInterface::AutoLock clientlock(m_clients);
-		for (const session_t client_id : clients) {
-			RemoteClient *client = m_clients.lockedGetClientNoEx(client_id, CS_Active);
+		u32 total_sending = 0;
 
-			if (!client)
-				continue;
+		{
+			ScopeProfiler sp2(g_profiler, "Server::SendBlocks(): Collect list");
+
+			std::vector<session_t> clients = m_clients.getClientIDs();
+
+			ClientInterface::AutoLock clientlock(m_clients);
+			for (const session_t client_id : clients) {
+				RemoteClient *client = m_clients.lockedGetClientNoEx(client_id, CS_Active);
+
+				if (!client)
+					continue;
 
-			total_sending += client->getSendingCount();
-			const auto old_count = queue.size();
-			client->GetNextBlocks(m_env, m_emerge.get(), dtime, queue);
-			unique_clients += queue.size() > old_count ? 1 : 0;
+				total_sending += client->getSendingCount();
+				client->GetNextBlocks(m_env, m_emerge.get(), dtime, queue);
+			}
 		}
-	}
 
-	// Sort.
-	// Lowest priority number comes first.
-	// Lowest is most important.
-	std::sort(queue.begin(), queue.end());
+		// Sort.
+		// Lowest priority number comes first.
+		// Lowest is most important.
+		std::sort(queue.begin(), queue.end());
 
-	ClientInterface::AutoLock clientlock(m_clients);
+		ClientInterface::AutoLock clientlock(m_clients);
 
-	// Maximal total count calculation
-	// The per-client block sends is halved with the maximal online users
-	u32 max_blocks_to_send = (m_env->getPlayerCount() + g_settings->getU32("max_users")) *
-		g_settings->getU32("max_simultaneous_block_sends_per_client") / 4 + 1;
+		// Maximal total count calculation
+		// The per-client block sends is halved with the maximal online users
+		u32 max_blocks_to_send = (m_env->getPlayerCount() + g_settings->getU32("max_users")) *
+			g_settings->getU32("max_simultaneous_block_sends_per_client") / 4 + 1;
 
-	ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Send to clients");
-	Map &map = m_env->getMap();
+		ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Serialize");
+		Map &map = m_env->getMap();
 
-	SerializedBlockCache cache, *cache_ptr = nullptr;
-	if (unique_clients > 1) {
-		// caching is pointless with a single client
-		cache_ptr = &cache;
-	}
+		for (const PrioritySortedBlockTransfer &block_to_send : queue) {
+			if (total_sending >= max_blocks_to_send)
+				break;
 
-	for (const PrioritySortedBlockTransfer &block_to_send : queue) {
-		if (total_sending >= max_blocks_to_send)
-			break;
+			MapBlock *block = map.getBlockNoCreateNoEx(block_to_send.pos);
+			if (!block)
+				continue;
 
-		MapBlock *block = map.getBlockNoCreateNoEx(block_to_send.pos);
-		if (!block)
-			continue;
+			RemoteClient *client = m_clients.lockedGetClientNoEx(block_to_send.peer_id,
+					CS_Active);
+			if (!client)
+				continue;
 
-		RemoteClient *client = m_clients.lockedGetClientNoEx(block_to_send.peer_id,
-				CS_Active);
-		if (!client)
-			continue;
+			const u8 ver = client->serialization_version;
+			const std::pair<v3s16, u16> key(block_to_send.pos, ver);
+			if (serialized.find(key) == serialized.end()) {
+				std::ostringstream os(std::ios_base::binary);
+				if (ver >= 29) {
+					block->serializeUncompressed(os, ver, false);
+				} else {
+					block->serialize(os, ver, false, net_compression_level);
+					MapBlock::serializeNetworkSpecific(os);
+				}
+				serialized[key] = os.str();
+			}
+			sends.push_back({block_to_send.peer_id, key});
 
-		SendBlockNoLock(block_to_send.peer_id, block, client->serialization_version,
-				client->net_proto_version, cache_ptr);
+			// While still locked, so that a change of the block in the
+			// meantime marks it as not sent again
+			client->SentBlock(block_to_send.pos);
+			total_sending++;
+		}
+	}
+
+	if (sends.empty())
+		return;
+
+	{
+		ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Compress");
+		std::vector<std::pair<u8, std::string *>> to_compress;
+		for (auto &it : serialized) {
+			if (it.first.second >= 29)
+				to_compress.emplace_back(it.first.second, &it.second);
+		}
+		// The blocks are independent, compress them on the shared pool.
+		// net_compression_level is thread_local, so it is copied.
+		const int level = net_compression_level;
+		TaskPool::get().parallelFor(0, to_compress.size(), [&] (size_t i) {
+			auto [ver, data] = to_compress[i];
+			std::ostringstream os(std::ios_base::binary);
+			compress(*data, os, ver, level);
+			MapBlock::serializeNetworkSpecific(os);
+			*data = os.str();
+		}, 4);
+	}
 
-		client->SentBlock(block_to_send.pos);
-		total_sending++;
+	ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Send to clients");
+	ClientInterface::AutoLock clientlock(m_clients);
+	for (const BlockSend &send : sends) {
+		RemoteClient *client = m_clients.lockedGetClientNoEx(send.peer_id, CS_Active);
+		if (client)
+			SendBlockData(client, send.key.first, serialized[send.key]);
 	}
 }
 
@@ -2541,8 +2732,7 @@ bool Server::SendBlock(session_t peer_id, const v3s16 &blockpos)
 	RemoteClient *client = m_clients.lockedGetClientNoEx(peer_id, CS_Active);
 	if (!client || client->isBlockSent(blockpos))
 		return false;
-	SendBlockNoLock(peer_id, block, client->serialization_version,
-			client->net_proto_version);
+	SendBlockNoLock(client, block);
 
 	return true;
 }
@@ -2872,30 +3062,73 @@ void Server::SendMinimapModes(session_t peer_id,
 	Send(&pkt);
 }
 
-void Server::sendDetachedInventory(Inventory *inventory, const std::string &name, session_t peer_id)
+void Server::sendDetachedInventory(Inventory *inventory, const std::string &name,
+		session_t peer_id, bool incremental)
 {
-	NetworkPacket pkt(TOCLIENT_DETACHED_INVENTORY, 0, peer_id);
-	pkt << name;
+	auto send = [&] (session_t to, const std::string *contents) {
+		NetworkPacket pkt(TOCLIENT_DETACHED_INVENTORY, 0, to);
+		pkt << name;
+
+		if (!contents) {
+			pkt << false; // Remove inventory
+		} else {
+			pkt << true; // Update inventory
+			pkt << static_cast<u16>(contents->size()); // HACK: to keep compatibility with 5.0.0 clients
+			pkt.putRawString(*contents);
+		}
+
+		if (to == PEER_ID_INEXISTENT)
+			m_clients.sendToAll(&pkt);
+		else
+			Send(&pkt);
+	};
 
 	if (!inventory) {
-		pkt << false; // Remove inventory
-	} else {
-		pkt << true; // Update inventory
+		send(peer_id, nullptr);
+		return;
+	}
 
-		// Serialization & NetworkPacket isn't a love story
-		std::ostringstream os(std::ios_base::binary);
-		inventory->serialize(os);
-		inventory->setModified(false);
+	// Serialization & NetworkPacket isn't a love story
+	std::string full;
+	auto get_full = [&] () -> const std::string * {
+		if (full.empty()) {
+			std::ostringstream os(std::ios_base::binary);
+			inventory->serialize(os);
+			full = os.str();
+		}
+		return &full;
+	};
 
-		const std::string &os_str = os.str();
-		pkt << static_cast<u16>(os_str.size()); // HACK: to keep compatibility with 5.0.0 clients
-		pkt.putRawString(os_str);
+	if (!incremental) {
+		send(peer_id, get_full());
+		// Only mark as sent if every client got it
+		if (peer_id == PEER_ID_INEXISTENT)
+			inventory->setModified(false);
+		return;
 	}
 
+	std::ostringstream os(std::ios_base::binary);
+	inventory->serialize(os, true);
+	const std::string changes = os.str();
+	inventory->setModified(false);
+
+	// The changes can only be applied by clients which received the
+	// complete inventory before (see handleCommand_Init2) and understand
+	// the incremental format
+	std::vector<session_t> peers;
 	if (peer_id == PEER_ID_INEXISTENT)
-		m_clients.sendToAll(&pkt);
+		peers = m_clients.getClientIDs(CS_DefinitionsSent);
 	else
-		Send(&pkt);
+		peers.push_back(peer_id);
+
+	for (session_t to : peers) {
+		if (!getClientNoEx(to, CS_DefinitionsSent))
+			continue;
+		if (m_clients.getProtocolVersion(to) >= 38)
+			send(to, &changes);
+		else
+			send(to, get_full());
+	}
 }
 
 void Server::sendDetachedInventories(session_t peer_id, bool incremental)
@@ -2906,8 +3139,17 @@ void Server::sendDetachedInventories(session_t peer_id, bool incremental)
 		peer_name = getClient(peer_id, CS_Created)->getName();
 	}
 
-	auto send_cb = [this, peer_id](const std::string &name, Inventory *inv) {
-		sendDetachedInventory(inv, name, peer_id);
+	auto send_cb = [this, peer_id, incremental](const std::string &name,
+			Inventory *inv, const std::string &owner) {
+		session_t to = peer_id;
+		// Updates of inventories with an owner only concern the owner
+		if (incremental && to == PEER_ID_INEXISTENT && !owner.empty()) {
+			RemotePlayer *player = m_env->getPlayer(owner.c_str());
+			if (!player || player->getPeerId() == PEER_ID_INEXISTENT)
+				return;
+			to = player->getPeerId();
+		}
+		sendDetachedInventory(inv, name, to, incremental);
 	};
 
 	m_inventory_mgr->sendDetachedInventories(peer_name, incremental, send_cb);
@@ -3002,6 +3244,7 @@ void Server::DeleteClient(session_t peer_id, ClientDeletionReason reason)
 
 		// clear formspec info so the next client can't abuse the current state
 		m_formspec_state_data.erase(peer_id);
+		m_formspec_sent.erase(peer_id);
 
 		RemotePlayer *player = m_env->getPlayer(peer_id);
 
@@ -4293,6 +4536,9 @@ ModStorageDatabase *Server::openModStorageDatabase(const std::string &backend,
 	if (backend == "files")
 		return new ModStorageDatabaseFiles(world_path);
 
+	if (backend == "journal")
+		return new ModStorageDatabaseJournal(world_path);
+
 	if (backend == "dummy")
 		return new Database_Dummy();
 
@@ -64,7 +64,9 @@ class ServerThread;
 class ServerModManager;
 class ServerInventoryManager;
 struct PackedValue;
+struct SharedTable;
 struct ParticleParameters;
+class SessionRecorder;
 struct ParticleSpawnerParameters;
 
 // Anticheat flags
@@ -152,12 +154,18 @@ struct ModIPCStore {
 	std::shared_mutex mutex;
 	/// Signalled on any changes to the map contents
 	std::condition_variable_any condvar;
+	/// A stored value, exactly one of the members is set
+	struct Value {
+		std::unique_ptr<PackedValue> packed;
+		/// Shared tables are handed out as they are, without copying
+		std::shared_ptr<const SharedTable> shared;
+	};
 	/**
 	 * Map storing the data
 	 *
 	 * @note Do not store `nil` data in this map, instead remove the whole key.
 	 */
-	std::unordered_map<std::string, std::unique_ptr<PackedValue>> map;
+	std::unordered_map<std::string, Value> map;
 
 	/// @note Should be called without holding the lock.
 	inline void signal() { condvar.notify_all(); }
@@ -178,12 +186,17 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 		Address bind_addr,
 		bool dedicated,
 		ChatInterface *iface = nullptr,
-		std::string *shutdown_errmsg = nullptr
+		std::string *shutdown_errmsg = nullptr,
+		// Replaces the network connection, used for replays
+		std::shared_ptr<con::IConnection> con = nullptr
 	);
 	~Server();
 	DISABLE_CLASS_COPY(Server);
 
 	void start();
+	// Like start() but without network and server thread. The caller runs
+	// the steps with AsyncRunStep() and processPacket().
+	void startOffline();
 	void stop();
 	// Actual processing is done in another thread.
 	// This just checks if there was an error in that thread.
@@ -194,6 +207,8 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	/// Receive and process all incoming packets. Sleep if the time goal isn't met.
 	/// @param min_time minimum time to take [s]
 	void Receive(float min_time);
+	/// Process one received packet, errors caused by the client are logged.
+	void processPacket(NetworkPacket *pkt);
 	void yieldToOtherThreads(float dtime);
 
 	// Full player initialization after they processed all static media
@@ -218,6 +233,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void handleCommand_GotBlocks(NetworkPacket* pkt);
 	void handleCommand_PlayerPos(NetworkPacket* pkt);
 	void handleCommand_DeletedBlocks(NetworkPacket* pkt);
+	void handleCommand_BlockCache(NetworkPacket* pkt);
 	void handleCommand_InventoryAction(NetworkPacket* pkt);
 	void handleCommand_ChatMessage(NetworkPacket* pkt);
 	void handleCommand_Damage(NetworkPacket* pkt);
@@ -226,6 +242,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void handleCommand_RemovedSounds(NetworkPacket* pkt);
 	void handleCommand_NodeMetaFields(NetworkPacket* pkt);
 	void handleCommand_InventoryFields(NetworkPacket* pkt);
+	void handleCommand_FormspecDiffFailed(NetworkPacket* pkt);
 	void handleCommand_FirstSrp(NetworkPacket* pkt);
 	void handleCommand_SrpBytesA(NetworkPacket* pkt);
 	void handleCommand_SrpBytesM(NetworkPacket* pkt);
@@ -302,7 +319,10 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	bool dynamicAddMedia(const DynamicMediaArgs &args);
 
 	ServerInventoryManager *getInventoryMgr() const { return m_inventory_mgr.get(); }
-	void sendDetachedInventory(Inventory *inventory, const std::string &name, session_t peer_id);
+	// With 'incremental', only the slots changed since the last update are
+	// sent to the clients that can apply them
+	void sendDetachedInventory(Inventory *inventory, const std::string &name,
+			session_t peer_id, bool incremental = false);
 
 	// Envlock and conlock should be locked when using scriptapi
 	inline ServerScripting *getScriptIface() { return m_script.get(); }
@@ -320,6 +340,14 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	virtual u16 allocateUnknownNodeId(const std::string &name);
 	IRollbackManager *getRollbackManager() { return m_rollback; }
 	virtual EmergeManager *getEmergeManager() { return m_emerge.get(); }
+	MetricsBackend *getMetricsBackend() { return m_metrics_backend.get(); }
+
+	// Must be called before start(). The recording also fixes the random seed.
+	void setSessionRecorder(std::unique_ptr<SessionRecorder> recorder);
+	// Seeds the C++ and Lua random number generators on start
+	void setRandomSeed(u64 seed) { m_random_seed = seed; }
+	// Replaces the next SRP verification of the peer by a recorded outcome
+	void setRecordedAuth(session_t peer_id, bool success) { m_recorded_auth[peer_id] = success; }
 	virtual ModStorageDatabase *getModStorageDatabase() { return m_mod_storage_database; }
 
 	IWritableItemDefManager* getWritableItemDefManager();
@@ -456,12 +484,15 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	Address m_bind_addr;
 
 	// Public helper for taking the envlock in a scope
+	// Counts how often and how long threads wait for it
 	class EnvAutoLock {
 	public:
-		EnvAutoLock(Server *server): m_lock(server->m_env_mutex) {}
+		EnvAutoLock(Server *server);
+		~EnvAutoLock() { m_mutex.unlock(); }
+		DISABLE_CLASS_COPY(EnvAutoLock);
 
 	private:
-		std::lock_guard<ordered_mutex> m_lock;
+		ordered_mutex &m_mutex;
 	};
 
 protected:
@@ -536,6 +567,9 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void SendPlayerFormspecPrepend(session_t peer_id);
 	void SendShowFormspecMessage(session_t peer_id, const std::string &formspec,
 		const std::string &formname);
+	// Returns false if the diff would not be smaller than the formspec
+	bool SendFormspecDiff(session_t peer_id, const std::string &last_formspec,
+		const std::string &formspec, const std::string &formname);
 	void SendHUDAdd(session_t peer_id, u32 id, HudElement *form);
 	void SendHUDRemove(session_t peer_id, u32 id);
 	void SendHUDChange(session_t peer_id, u32 id, HudElementStat stat, void *value);
@@ -571,8 +605,10 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 
 	// Environment and Connection must be locked when called
 	// `cache` may only be very short lived! (invalidation not handeled)
-	void SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
-		u16 net_proto_version, SerializedBlockCache *cache = nullptr);
+	void SendBlockNoLock(RemoteClient *client, MapBlock *block,
+		SerializedBlockCache *cache = nullptr);
+	// Sends serialized block data, needs only the client lock
+	void SendBlockData(RemoteClient *client, v3s16 blockpos, const std::string &data);
 
 	// Sends blocks to clients (locks env and con on its own)
 	void SendBlocks(float dtime);
@@ -712,6 +748,8 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	ClientInterface m_clients;
 
 	std::unordered_map<session_t, std::string> m_formspec_state_data;
+	// Last formspec sent to each client, the base of TOCLIENT_FORMSPEC_DIFF
+	std::unordered_map<session_t, std::string> m_formspec_sent;
 
 	/*
 		Random stuff
@@ -772,6 +810,11 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// ModChannel manager
 	std::unique_ptr<ModChannelMgr> m_modchannel_mgr;
 
+	// Session recording (see server/session_recorder.h)
+	std::unique_ptr<SessionRecorder> m_session_recorder;
+	std::optional<u64> m_random_seed;
+	std::unordered_map<session_t, bool> m_recorded_auth;
+
 	// Inventory manager
 	std::unique_ptr<ServerInventoryManager> m_inventory_mgr;
 
@@ -787,6 +830,11 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	MetricCounterPtr m_packet_recv_counter;
 	MetricCounterPtr m_packet_recv_processed_counter;
 	MetricCounterPtr m_map_edit_event_counter;
+	MetricCounterPtr m_block_cache_hit_counter;
+	MetricHistogramPtr m_step_time_histogram;
+	MetricCounterPtr m_envlock_counter;
+	MetricCounterPtr m_envlock_contended_counter;
+	MetricCounterPtr m_envlock_wait_counter;
 };
 
 /*
@@ -446,6 +446,27 @@ void RemoteClient::SetBlockNotSent(v3s16 p)
 		m_blocks_modified.insert(p);
 }
 
+void RemoteClient::setCachedBlock(v3s16 p, u64 hash)
+{
+	// Bound memory use, the client may announce as much as it wants
+	constexpr size_t MAX_CACHED_BLOCKS = 1 << 20;
+
+	m_has_block_cache = true;
+	if (hash == 0)
+		m_cached_blocks.erase(p);
+	else if (m_cached_blocks.size() < MAX_CACHED_BLOCKS)
+		m_cached_blocks[p] = hash;
+}
+
+bool RemoteClient::checkCachedBlock(v3s16 p, u64 hash)
+{
+	auto it = m_cached_blocks.find(p);
+	if (it != m_cached_blocks.end() && it->second == hash)
+		return true;
+	setCachedBlock(p, hash);
+	return false;
+}
+
 void RemoteClient::SetBlocksNotSent(const std::vector<v3s16> &blocks)
 {
 	m_nothing_to_send_pause_timer = 0;
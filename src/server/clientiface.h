@@ -264,6 +264,21 @@ class RemoteClient
 
 	u32 getSendingCount() const { return m_blocks_sending.size(); }
 
+	/*
+		Client-side block cache (see TOSERVER_BLOCK_CACHE).
+		A hash of 0 removes the entry.
+	*/
+	void setCachedBlock(v3s16 p, u64 hash);
+
+	bool hasBlockCache() const { return m_has_block_cache; }
+
+	/*
+		Returns true if the client has a block with this content hash cached.
+		Otherwise remembers the hash, as the client will cache the data that
+		is sent to it now.
+	*/
+	bool checkCachedBlock(v3s16 p, u64 hash);
+
 	bool isBlockSent(v3s16 p) const
 	{
 		return m_blocks_sent.find(p) != m_blocks_sent.end();
@@ -402,6 +417,13 @@ class RemoteClient
 	*/
 	std::unordered_set<v3s16> m_blocks_modified;
 
+	/*
+		Content hashes of the blocks in the client-side block cache.
+		Only used if the client announced that it has one.
+	*/
+	bool m_has_block_cache = false;
+	std::unordered_map<v3s16, u64> m_cached_blocks;
+
 	/*
 		Count of excess GotBlocks().
 		There is an excess amount because the client sometimes
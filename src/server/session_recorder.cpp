@@ -0,0 +1,286 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "session_recorder.h"
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "network/connection.h"
+#include "network/networkexceptions.h"
+#include "network/networkpacket.h"
+#include "porting.h"
+#include "server.h"
+#include "settings.h"
+#include "util/numeric.h"
+#include "util/serialize.h"
+#include <sstream>
+#include <unordered_map>
+
+// "MTSR" followed by the format version
+static const char SESSION_MAGIC[4] = {'M', 'T', 'S', 'R'};
+static const u8 SESSION_VERSION = 2;
+
+#define SESSION_LOG_NAME "session.bin"
+#define SESSION_WORLD_NAME "world"
+#define SESSION_SETTINGS_NAME "settings.conf"
+
+/*
+	SessionRecorder
+*/
+
+SessionRecorder::SessionRecorder(const std::string &dir, const std::string &world_path,
+		const std::string &gameid)
+{
+	const std::string target = SessionReplay::getWorldPath(dir);
+	if (fs::PathExists(target))
+		throw ServerError("Recording target \"" + dir + "\" already exists");
+	if (!fs::CreateAllDirs(dir))
+		throw ServerError("Failed to create \"" + dir + "\"");
+	if (fs::PathExists(world_path) && !fs::CopyDir(world_path, target))
+		throw ServerError("Failed to copy the world to \"" + target + "\"");
+
+	std::ostringstream os;
+	g_settings->writeLines(os);
+	if (!fs::safeWriteToFile(dir + DIR_DELIM SESSION_SETTINGS_NAME, os.str()))
+		throw ServerError("Failed to write the settings to \"" + dir + "\"");
+
+	const std::string path = dir + DIR_DELIM SESSION_LOG_NAME;
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_file.good())
+		throw ServerError("Failed to open \"" + path + "\"");
+
+	myrand_bytes(&m_seed, sizeof(m_seed));
+
+	m_file.write(SESSION_MAGIC, sizeof(SESSION_MAGIC));
+	writeU8(m_file, SESSION_VERSION);
+	m_file << serializeString16(gameid);
+	writeU64(m_file, m_seed);
+
+	actionstream << "Recording server session to " << dir << std::endl;
+}
+
+void SessionRecorder::recordStep(float dtime, bool initial_step)
+{
+	writeU8(m_file, SESSION_EVENT_STEP);
+	writeF32(m_file, dtime);
+	writeU8(m_file, initial_step);
+}
+
+void SessionRecorder::recordPeerAdded(session_t peer_id, const Address &address)
+{
+	writeU8(m_file, SESSION_EVENT_PEER_ADDED);
+	writeU16(m_file, peer_id);
+	m_file << serializeString16(address.serializeString());
+	writeU16(m_file, address.getPort());
+}
+
+void SessionRecorder::recordPeerRemoved(session_t peer_id, bool timeout)
+{
+	writeU8(m_file, SESSION_EVENT_PEER_REMOVED);
+	writeU16(m_file, peer_id);
+	writeU8(m_file, timeout);
+}
+
+void SessionRecorder::recordPacket(const NetworkPacket *pkt)
+{
+	writeU8(m_file, SESSION_EVENT_PACKET);
+	writeU16(m_file, pkt->getPeerId());
+	writeU16(m_file, pkt->getCommand());
+	writeU32(m_file, pkt->getSize());
+	if (pkt->getSize() > 0)
+		m_file.write(pkt->getString(0), pkt->getSize());
+}
+
+void SessionRecorder::recordAuth(session_t peer_id, bool success)
+{
+	writeU8(m_file, SESSION_EVENT_AUTH);
+	writeU16(m_file, peer_id);
+	writeU8(m_file, success);
+}
+
+/*
+	Replay
+*/
+
+class ReplayPeer : public con::IPeer
+{
+public:
+	ReplayPeer(session_t id, const Address &address) :
+		IPeer(id), m_address(address)
+	{}
+
+	const Address &getAddress() const override { return m_address; }
+
+private:
+	Address m_address;
+};
+
+// Stands in for the network: nothing is received and sent data is discarded
+class ReplayConnection : public con::IConnection
+{
+public:
+	void Serve(Address bind_addr) override {}
+	void Connect(Address address) override {}
+	bool Connected() override { return false; }
+	void Disconnect() override {}
+	// The disconnect that follows is part of the recording
+	void DisconnectPeer(session_t peer_id) override {}
+
+	bool ReceiveTimeoutMs(NetworkPacket *pkt, u32 timeout_ms) override { return false; }
+
+	void Send(session_t peer_id, u8 channelnum, NetworkPacket *pkt, bool reliable) override
+	{
+		bytes_sent += 2 + pkt->getSize();
+	}
+
+	session_t GetPeerID() const override { return PEER_ID_SERVER; }
+
+	Address GetPeerAddress(session_t peer_id) override
+	{
+		auto it = peers.find(peer_id);
+		if (it == peers.end())
+			throw con::PeerNotFoundException("No address for peer found!");
+		return it->second->getAddress();
+	}
+
+	float getPeerStat(session_t peer_id, con::rtt_stat_type type) override { return 0.0f; }
+	float getLocalStat(con::rate_stat_type type) override { return 0.0f; }
+
+	std::unordered_map<session_t, std::unique_ptr<ReplayPeer>> peers;
+	u64 bytes_sent = 0;
+};
+
+std::string SessionReplay::getWorldPath(const std::string &dir)
+{
+	return dir + DIR_DELIM SESSION_WORLD_NAME;
+}
+
+SessionReplay::SessionReplay(const std::string &dir)
+{
+	const std::string path = dir + DIR_DELIM SESSION_LOG_NAME;
+	m_file.open(path, std::ios::binary);
+	if (!m_file.good())
+		throw ServerError("Failed to open \"" + path + "\"");
+
+	char magic[sizeof(SESSION_MAGIC)] = {};
+	m_file.read(magic, sizeof(magic));
+	if (memcmp(magic, SESSION_MAGIC, sizeof(magic)) != 0)
+		throw ServerError("\"" + path + "\" is not a session recording");
+	const u8 version = readU8(m_file);
+	if (version != SESSION_VERSION)
+		throw ServerError("Unsupported session recording version " + itos(version));
+	m_gameid = deSerializeString16(m_file);
+	m_seed = readU64(m_file);
+	if (!m_file.good())
+		throw ServerError("\"" + path + "\" is truncated");
+
+	const std::string settings_path = dir + DIR_DELIM SESSION_SETTINGS_NAME;
+	if (!g_settings->readConfigFile(settings_path.c_str()))
+		throw ServerError("Failed to read \"" + settings_path + "\"");
+}
+
+std::shared_ptr<con::IConnection> SessionReplay::createConnection()
+{
+	m_con = std::make_shared<ReplayConnection>();
+	return m_con;
+}
+
+static Address deserialize_address(std::istream &is)
+{
+	const std::string host = deSerializeString16(is);
+	const u16 port = readU16(is);
+	Address address(127, 0, 0, 1, port);
+	try {
+		address.Resolve(host.c_str());
+	} catch (ResolveError &e) {
+		// Only used for logging and bans, keep the loopback address
+	}
+	address.setPort(port);
+	return address;
+}
+
+bool SessionReplay::run(Server *server, SessionReplayStats *stats)
+{
+	sanity_check(m_con);
+	NetworkPacket pkt;
+	std::string data;
+
+	for (;;) {
+		const int type = m_file.get();
+		if (type == std::char_traits<char>::eof())
+			break;
+
+		switch (type) {
+		case SESSION_EVENT_STEP: {
+			const float dtime = readF32(m_file);
+			const bool initial_step = readU8(m_file);
+			if (!m_file.good())
+				return false;
+			const u64 t0 = porting::getTimeUs();
+			server->AsyncRunStep(dtime, initial_step);
+			stats->step_time_us += porting::getTimeUs() - t0;
+			stats->steps++;
+			break;
+		}
+		case SESSION_EVENT_PEER_ADDED: {
+			const session_t peer_id = readU16(m_file);
+			Address address;
+			try {
+				address = deserialize_address(m_file);
+			} catch (SerializationError &e) {
+				return false;
+			}
+			if (!m_file.good())
+				return false;
+			auto &peer = m_con->peers[peer_id];
+			peer = std::make_unique<ReplayPeer>(peer_id, address);
+			server->peerAdded(peer.get());
+			stats->peers++;
+			break;
+		}
+		case SESSION_EVENT_PEER_REMOVED: {
+			const session_t peer_id = readU16(m_file);
+			const bool timeout = readU8(m_file);
+			if (!m_file.good())
+				return false;
+			auto it = m_con->peers.find(peer_id);
+			if (it == m_con->peers.end())
+				break;
+			server->deletingPeer(it->second.get(), timeout);
+			m_con->peers.erase(it);
+			break;
+		}
+		case SESSION_EVENT_PACKET: {
+			const session_t peer_id = readU16(m_file);
+			const u16 command = readU16(m_file);
+			const u32 size = readU32(m_file);
+			data.resize(2 + size);
+			writeU16((u8 *)&data[0], command);
+			m_file.read(&data[2], size);
+			if (!m_file.good())
+				return false;
+			if (m_file.peek() == SESSION_EVENT_AUTH) {
+				m_file.get();
+				const session_t auth_peer_id = readU16(m_file);
+				const bool success = readU8(m_file);
+				if (!m_file.good())
+					return false;
+				server->setRecordedAuth(auth_peer_id, success);
+			}
+			pkt.clear();
+			pkt.putRawPacket((const u8 *)data.data(), data.size(), peer_id);
+			const u64 t0 = porting::getTimeUs();
+			server->processPacket(&pkt);
+			stats->packet_time_us += porting::getTimeUs() - t0;
+			stats->packets++;
+			break;
+		}
+		default:
+			errorstream << "SessionReplay: unknown event type " << type << std::endl;
+			return false;
+		}
+	}
+
+	stats->bytes_sent = m_con->bytes_sent;
+	return true;
+}
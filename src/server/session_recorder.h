@@ -0,0 +1,108 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "network/address.h"
+#include "network/networkprotocol.h"
+#include <fstream>
+#include <memory>
+#include <string>
+
+class NetworkPacket;
+class Server;
+
+namespace con {
+	class IConnection;
+}
+class ReplayConnection;
+
+/*
+	Server session recording for performance regression tests.
+
+	A recording is a directory with a copy of the world taken before the
+	server started ("world"), the settings ("settings.conf") and a log of
+	everything that drives the server
+	step ("session.bin"): the game, the random seed, the dtime of every step, peers
+	connecting and disconnecting and every packet passed to ProcessData().
+	SRP logins use random values, so their outcome is recorded as well and
+	replaces the verification in the replay.
+
+	Replaying the log against a fresh copy of the world runs the same steps
+	without network or sleeps. It is deterministic as far as the server
+	thread goes; the emerge and async threads and wall-clock dependent code
+	(e.g. core.get_us_time()) are not captured.
+*/
+
+enum SessionEventType : u8 {
+	SESSION_EVENT_STEP = 0,
+	SESSION_EVENT_PEER_ADDED = 1,
+	SESSION_EVENT_PEER_REMOVED = 2,
+	SESSION_EVENT_PACKET = 3,
+	// Outcome of the SRP verification, follows its TOSERVER_SRP_BYTES_M packet
+	SESSION_EVENT_AUTH = 4,
+};
+
+class SessionRecorder
+{
+public:
+	// Copies the world and creates the log. Throws ServerError on failure.
+	SessionRecorder(const std::string &dir, const std::string &world_path,
+		const std::string &gameid);
+
+	u64 getSeed() const { return m_seed; }
+
+	// All of these are called from the server thread
+	void recordStep(float dtime, bool initial_step);
+	void recordPeerAdded(session_t peer_id, const Address &address);
+	void recordPeerRemoved(session_t peer_id, bool timeout);
+	void recordPacket(const NetworkPacket *pkt);
+	void recordAuth(session_t peer_id, bool success);
+
+private:
+	std::ofstream m_file;
+	u64 m_seed;
+};
+
+struct SessionReplayStats {
+	u32 steps = 0;
+	u32 packets = 0;
+	u32 peers = 0;
+	u64 bytes_sent = 0;
+	// Wall-clock time spent in Server::AsyncRunStep() and packet processing
+	u64 step_time_us = 0;
+	u64 packet_time_us = 0;
+};
+
+class SessionReplay
+{
+public:
+	/*
+		Opens the log in a recording directory and applies the recorded
+		settings to g_settings. Throws BaseException on failure.
+	*/
+	SessionReplay(const std::string &dir);
+
+	u64 getSeed() const { return m_seed; }
+	const std::string &getGameId() const { return m_gameid; }
+	static std::string getWorldPath(const std::string &dir);
+
+	/*
+		Creates a connection to pass to a new Server that replaces the network.
+		It has to be used for the replay.
+	*/
+	std::shared_ptr<con::IConnection> createConnection();
+
+	/*
+		Runs all recorded events on a server that was started with
+		Server::startOffline(). Returns false if the log is truncated.
+	*/
+	bool run(Server *server, SessionReplayStats *stats);
+
+private:
+	std::ifstream m_file;
+	std::string m_gameid;
+	u64 m_seed;
+	std::shared_ptr<ReplayConnection> m_con;
+};
@@ -11,6 +11,7 @@
 #include "mapblock.h"
 #include "nodedef.h"
 #include "nodemetadata.h"
+#include "pathfinder.h"
 #include "gamedef.h"
 #include "porting.h"
 #include "profiler.h"
@@ -22,6 +23,7 @@
 #include "util/numeric.h"
 #include "util/basic_macros.h"
 #include "util/pointedthing.h"
+#include "util/trace.h"
 #include "threading/mutex_auto_lock.h"
 #include "filesys.h"
 #include "gameparams.h"
@@ -317,27 +319,21 @@ void LBMManager::applyLBMs(ServerEnvironment *env, MapBlock *block,
 	ActiveBlockList
 */
 
-static void fillRadiusBlock(v3s16 p0, s16 r, std::set<v3s16> &list)
-{
-	v3s16 p;
-	for(p.X=p0.X-r; p.X<=p0.X+r; p.X++)
-		for(p.Y=p0.Y-r; p.Y<=p0.Y+r; p.Y++)
-			for(p.Z=p0.Z-r; p.Z<=p0.Z+r; p.Z++)
-			{
-				// limit to a sphere
-				if (p.getDistanceFrom(p0) <= r) {
-					// Set in list
-					list.insert(p);
-				}
-			}
-}
+/*
+	The view cone of a player is only recomputed when they enter another
+	block, turn by more than about 5 degrees or change their fov by more than
+	this many radians. Players look around all the time, smaller changes
+	barely move the edges of the cone.
+*/
+#define VIEW_CONE_TURN_COS 0.996f
+#define VIEW_CONE_FOV_STEP 0.05f
 
 static void fillViewConeBlock(v3s16 p0,
 	const s16 r,
 	const v3f camera_pos,
 	const v3f camera_dir,
 	const float camera_fov,
-	std::set<v3s16> &list)
+	std::vector<v3s16> &list)
 {
 	v3s16 p;
 	const s16 r_nodes = r * BS * MAP_BLOCKSIZE;
@@ -345,97 +341,193 @@ static void fillViewConeBlock(v3s16 p0,
 	for (p.Y = p0.Y - r; p.Y <= p0.Y+r; p.Y++)
 	for (p.Z = p0.Z - r; p.Z <= p0.Z+r; p.Z++) {
 		if (isBlockInSight(p, camera_pos, camera_dir, camera_fov, r_nodes)) {
-			list.insert(p);
+			list.push_back(p);
 		}
 	}
 }
 
-void ActiveBlockList::update(std::vector<PlayerSAO*> &active_players,
+const std::vector<v3s16> &ActiveBlockList::getSphere(s16 radius)
+{
+	if (radius == m_sphere_radius)
+		return m_sphere;
+
+	m_sphere.clear();
+	const v3s16 p0;
+	v3s16 p;
+	for (p.X = -radius; p.X <= radius; p.X++)
+	for (p.Y = -radius; p.Y <= radius; p.Y++)
+	for (p.Z = -radius; p.Z <= radius; p.Z++) {
+		// limit to a sphere
+		if (p.getDistanceFrom(p0) <= radius)
+			m_sphere.push_back(p);
+	}
+	m_sphere_radius = radius;
+	return m_sphere;
+}
+
+void ActiveBlockList::addRefs(v3s16 p, s32 abm, s32 extra)
+{
+	BlockRefs &refs = m_refs[p];
+	refs.abm_refs += abm;
+	refs.extra_refs += extra;
+	if (!refs.changed) {
+		refs.changed = true;
+		m_changed.push_back(p);
+	}
+}
+
+void ActiveBlockList::addSphereRefs(v3s16 center, s16 radius, s32 delta)
+{
+	for (v3s16 offset : getSphere(radius))
+		addRefs(center + offset, delta, 0);
+}
+
+void ActiveBlockList::addConeRefs(const std::vector<v3s16> &cone, s32 delta)
+{
+	for (v3s16 p : cone)
+		addRefs(p, 0, delta);
+}
+
+void ActiveBlockList::update(const std::vector<ActiveBlockViewer> &viewers,
 	s16 active_block_range,
 	s16 active_object_range,
-	std::set<v3s16> &blocks_removed,
-	std::set<v3s16> &blocks_added,
-	std::set<v3s16> &extra_blocks_added)
+	std::vector<v3s16> &blocks_removed,
+	std::vector<v3s16> &blocks_added,
+	std::vector<v3s16> &extra_blocks_added)
 {
 	/*
-		Create the new list
+		Update the references of the players that moved or looked around
 	*/
-	std::set<v3s16> newlist = m_forceloaded_list;
-	std::set<v3s16> extralist;
-	m_abm_list = m_forceloaded_list;
-	for (const PlayerSAO *playersao : active_players) {
-		v3s16 pos = getNodeBlockPos(floatToInt(playersao->getBasePosition(), BS));
-		fillRadiusBlock(pos, active_block_range, m_abm_list);
-		fillRadiusBlock(pos, active_block_range, newlist);
-
-		s16 player_ao_range = std::min(active_object_range, playersao->getWantedRange());
+	m_generation++;
+	for (const ActiveBlockViewer &viewer : viewers) {
+		auto [it, is_new] = m_viewers.try_emplace(viewer.id);
+		ViewerState &state = it->second;
+		state.generation = m_generation;
+
+		const bool moved = is_new || viewer.blockpos != state.blockpos;
+		if (moved || state.radius != active_block_range) {
+			if (!is_new)
+				addSphereRefs(state.blockpos, state.radius, -1);
+			addSphereRefs(viewer.blockpos, active_block_range, 1);
+		}
+
+		s16 cone_range = std::min(active_object_range, viewer.object_range);
 		// only do this if this would add blocks
-		if (player_ao_range > active_block_range) {
-			v3f camera_dir = v3f(0,0,1);
-			camera_dir.rotateYZBy(playersao->getLookPitch());
-			camera_dir.rotateXZBy(playersao->getRotation().Y);
-			if (playersao->getCameraInverted())
-				camera_dir = -camera_dir;
-			fillViewConeBlock(pos,
-				player_ao_range,
-				playersao->getEyePosition(),
-				camera_dir,
-				playersao->getFov(),
-				extralist);
+		if (cone_range <= active_block_range)
+			cone_range = 0;
+		if (cone_range != state.cone_range || (cone_range > 0 && (moved ||
+				viewer.camera_dir.dotProduct(state.camera_dir) < VIEW_CONE_TURN_COS ||
+				std::fabs(viewer.fov - state.fov) > VIEW_CONE_FOV_STEP))) {
+			addConeRefs(state.cone, -1);
+			state.cone.clear();
+			if (cone_range > 0) {
+				fillViewConeBlock(viewer.blockpos, cone_range, viewer.eye_pos,
+					viewer.camera_dir, viewer.fov, state.cone);
+			}
+			addConeRefs(state.cone, 1);
+			state.cone_range = cone_range;
+			state.camera_dir = viewer.camera_dir;
+			state.fov = viewer.fov;
 		}
+
+		state.blockpos = viewer.blockpos;
+		state.radius = active_block_range;
 	}
 
-	/*
-		Find out which blocks on the new list are not on the old list
-	*/
-	for (v3s16 p : newlist) {
-		// also remove duplicate blocks from the extra list
-		extralist.erase(p);
-		// If not on old list, it's been added
-		if (m_list.find(p) == m_list.end())
-			blocks_added.insert(p);
+	// Players that left
+	for (auto it = m_viewers.begin(); it != m_viewers.end(); ) {
+		ViewerState &state = it->second;
+		if (state.generation == m_generation) {
+			++it;
+			continue;
+		}
+		addSphereRefs(state.blockpos, state.radius, -1);
+		addConeRefs(state.cone, -1);
+		it = m_viewers.erase(it);
 	}
+
 	/*
-		Find out which blocks on the extra list are not on the old list
+		Forceloaded blocks are changed from outside, compare with the
+		ones that were referenced before
 	*/
-	for (v3s16 p : extralist) {
-		// also make sure newlist has all blocks
-		newlist.insert(p);
-		// If not on old list, it's been added
-		if (m_list.find(p) == m_list.end())
-			extra_blocks_added.insert(p);
+	if (m_forceloaded_list != m_forceloaded_applied) {
+		for (v3s16 p : m_forceloaded_list) {
+			if (m_forceloaded_applied.find(p) == m_forceloaded_applied.end())
+				addRefs(p, 1, 0);
+		}
+		for (v3s16 p : m_forceloaded_applied) {
+			if (m_forceloaded_list.find(p) == m_forceloaded_list.end())
+				addRefs(p, -1, 0);
+		}
+		m_forceloaded_applied = m_forceloaded_list;
 	}
 
 	/*
-		Find out which blocks on the old list are not on the new + extra list
+		Emit the blocks whose membership changed
 	*/
-	std::set_difference(m_list.begin(), m_list.end(), newlist.begin(), newlist.end(),
-			std::inserter(blocks_removed, blocks_removed.end()));
+	for (v3s16 p : m_changed) {
+		auto it = m_refs.find(p);
+		assert(it != m_refs.end());
+		BlockRefs &refs = it->second;
+		refs.changed = false;
+
+		const bool in_abm_list = refs.abm_refs > 0;
+		const bool in_list = in_abm_list || refs.extra_refs > 0;
+		if (in_list && !refs.in_list) {
+			m_list.insert(p);
+			if (in_abm_list)
+				blocks_added.push_back(p);
+			else
+				extra_blocks_added.push_back(p);
+		} else if (!in_list && refs.in_list) {
+			m_list.erase(p);
+			blocks_removed.push_back(p);
+		}
 
-	/*
-		Do some least-effort sanity checks to hopefully catch code bugs.
-	*/
-	assert(newlist.size() >= extralist.size());
-	assert(blocks_removed.size() <= m_list.size());
-	if (!blocks_added.empty()) {
-		assert(newlist.count(*blocks_added.begin()) > 0);
-		assert(blocks_removed.count(*blocks_added.begin()) == 0);
-	}
-	if (!extra_blocks_added.empty()) {
-		assert(newlist.count(*extra_blocks_added.begin()) > 0);
-		assert(extralist.count(*extra_blocks_added.begin()) > 0);
-		assert(blocks_added.count(*extra_blocks_added.begin()) == 0);
-	}
-	if (!blocks_removed.empty()) {
-		assert(newlist.count(*blocks_removed.begin()) == 0);
-		assert(extralist.count(*blocks_removed.begin()) == 0);
-		assert(m_list.count(*blocks_removed.begin()) > 0);
+		if (in_abm_list && !refs.in_abm_list)
+			m_abm_list.insert(p);
+		else if (!in_abm_list && refs.in_abm_list)
+			m_abm_list.erase(p);
+
+		if (in_list) {
+			refs.in_list = true;
+			refs.in_abm_list = in_abm_list;
+		} else {
+			m_refs.erase(it);
+		}
 	}
+	m_changed.clear();
 
-	/*
-		Update m_list
-	*/
-	m_list = std::move(newlist);
+	assert(m_abm_list.size() <= m_list.size());
+	assert(m_list.size() <= m_refs.size());
+}
+
+void ActiveBlockList::clear()
+{
+	m_list.clear();
+	m_abm_list.clear();
+	m_refs.clear();
+	m_changed.clear();
+	m_viewers.clear();
+	m_forceloaded_applied.clear();
+}
+
+void ActiveBlockList::remove(v3s16 p)
+{
+	m_list.erase(p);
+	m_abm_list.erase(p);
+
+	auto it = m_refs.find(p);
+	if (it == m_refs.end())
+		return;
+	// Still referenced, so the next update adds it again
+	BlockRefs &refs = it->second;
+	refs.in_list = false;
+	refs.in_abm_list = false;
+	if (!refs.changed) {
+		refs.changed = true;
+		m_changed.push_back(p);
+	}
 }
 
 /*
@@ -469,6 +561,9 @@ ServerEnvironment::ServerEnvironment(std::unique_ptr<ServerMap> map,
 
 	m_active_object_gauge = mb->addGauge(
 		"minetest_env_active_objects", "Number of active objects");
+
+	if (m_map)
+		m_pathfinder = std::make_unique<PathfinderService>(m_map.get(), server->ndef());
 }
 
 void ServerEnvironment::init()
@@ -560,6 +655,9 @@ ServerEnvironment::~ServerEnvironment()
 {
 	assert(m_active_blocks.size() == 0); // deactivateBlocksAndObjects does this
 
+	// Stops listening to map events
+	m_pathfinder.reset();
+
 	// Drop/delete map
 	m_map.reset();
 
@@ -1402,10 +1500,10 @@ void ServerEnvironment::step(float dtime)
 		ScopeProfiler sp(g_profiler, "ServerEnv: update active blocks", SPT_AVG);
 
 		/*
-			Get player block positions
+			Get player block positions and views
 		*/
-		std::vector<PlayerSAO*> players;
-		players.reserve(m_players.size());
+		std::vector<ActiveBlockViewer> viewers;
+		viewers.reserve(m_players.size());
 		for (RemotePlayer *player : m_players) {
 			// Ignore disconnected players
 			if (player->getPeerId() == PEER_ID_INEXISTENT)
@@ -1414,7 +1512,17 @@ void ServerEnvironment::step(float dtime)
 			PlayerSAO *playersao = player->getPlayerSAO();
 			assert(playersao);
 
-			players.push_back(playersao);
+			ActiveBlockViewer &viewer = viewers.emplace_back();
+			viewer.id = playersao->getId();
+			viewer.blockpos = getNodeBlockPos(floatToInt(playersao->getBasePosition(), BS));
+			viewer.object_range = playersao->getWantedRange();
+			viewer.eye_pos = playersao->getEyePosition();
+			viewer.camera_dir = v3f(0,0,1);
+			viewer.camera_dir.rotateYZBy(playersao->getLookPitch());
+			viewer.camera_dir.rotateXZBy(playersao->getRotation().Y);
+			if (playersao->getCameraInverted())
+				viewer.camera_dir = -viewer.camera_dir;
+			viewer.fov = playersao->getFov();
 		}
 
 		/*
@@ -1426,10 +1534,10 @@ void ServerEnvironment::step(float dtime)
 				g_settings->getS16("active_object_send_range_blocks");
 		static thread_local const s16 active_block_range =
 				g_settings->getS16("active_block_range");
-		std::set<v3s16> blocks_removed;
-		std::set<v3s16> blocks_added;
-		std::set<v3s16> extra_blocks_added;
-		m_active_blocks.update(players, active_block_range, active_object_range,
+		std::vector<v3s16> blocks_removed;
+		std::vector<v3s16> blocks_added;
+		std::vector<v3s16> extra_blocks_added;
+		m_active_blocks.update(viewers, active_block_range, active_object_range,
 			blocks_removed, blocks_added, extra_blocks_added);
 
 		/*
@@ -1479,6 +1587,7 @@ void ServerEnvironment::step(float dtime)
 
 		// Some blocks may be removed again by the code above so do this here
 		m_active_block_gauge->set(m_active_blocks.size());
+		g_tracer->counter("Active blocks", m_active_blocks.size());
 
 		if (m_fast_active_block_divider > 1)
 			--m_fast_active_block_divider;
@@ -1576,6 +1685,11 @@ void ServerEnvironment::step(float dtime)
 
 	m_script->stepAsync();
 
+	/*
+		Start queued path searches, run callbacks of finished ones
+	*/
+	m_pathfinder->step();
+
 	/*
 		Step active objects
 	*/
@@ -1605,6 +1719,7 @@ void ServerEnvironment::step(float dtime)
 		m_ao_manager.step(dtime, cb_state);
 
 		m_active_object_gauge->set(object_count);
+		g_tracer->counter("Active objects", object_count);
 	}
 
 	/*
@@ -1654,6 +1769,9 @@ void ServerEnvironment::step(float dtime)
 		m_script->on_mapblocks_changed(modified_blocks);
 	}
 
+	if (ScriptAccounting *accounting = m_script->getAccounting())
+		accounting->endStep();
+
 	const auto end_time = porting::getTimeUs();
 	m_step_time_counter->increment(end_time - start_time);
 }
@@ -5,6 +5,8 @@
 #pragma once
 
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 #include "activeobject.h"
@@ -27,6 +29,7 @@ struct StaticObject;
 class ServerActiveObject;
 class Server;
 class ServerScripting;
+class PathfinderService;
 enum AccessDeniedCode : u8;
 typedef u16 session_t;
 
@@ -158,17 +161,36 @@ class LBMManager
 
 /*
 	List of active blocks, used by ServerEnvironment
+
+	The blocks are reference counted by the players (and forceloading) that
+	keep them active, so an update only has to redo the players that moved
+	to another block or changed their view.
 */
 
+// What a player contributes to the active blocks
+struct ActiveBlockViewer {
+	// Identifies the player across updates, e.g. the object ID
+	u16 id;
+	v3s16 blockpos;
+	// Range of the view cone in blocks, only used if larger than the
+	// active block range
+	s16 object_range;
+	v3f eye_pos;
+	// Unit vector
+	v3f camera_dir;
+	f32 fov;
+};
+
 class ActiveBlockList
 {
 public:
-	void update(std::vector<PlayerSAO*> &active_players,
+	// Appends the changes to the vectors
+	void update(const std::vector<ActiveBlockViewer> &viewers,
 		s16 active_block_range,
 		s16 active_object_range,
-		std::set<v3s16> &blocks_removed,
-		std::set<v3s16> &blocks_added,
-		std::set<v3s16> &extra_blocks_added);
+		std::vector<v3s16> &blocks_removed,
+		std::vector<v3s16> &blocks_added,
+		std::vector<v3s16> &extra_blocks_added);
 
 	bool contains(v3s16 p) const {
 		return (m_list.find(p) != m_list.end());
@@ -178,19 +200,56 @@ class ActiveBlockList
 		return m_list.size();
 	}
 
-	void clear() {
-		m_list.clear();
-	}
+	void clear();
 
-	void remove(v3s16 p) {
-		m_list.erase(p);
-		m_abm_list.erase(p);
-	}
+	// Deactivates a block until it is added again by the next update
+	void remove(v3s16 p);
 
-	std::set<v3s16> m_list;
-	std::set<v3s16> m_abm_list;
+	// Blocks in the active block range of a player, or forceloaded
+	std::unordered_set<v3s16> m_abm_list;
+	// m_abm_list and the blocks in the view cones of the players
+	std::unordered_set<v3s16> m_list;
 	// list of blocks that are always active, not modified by this class
 	std::set<v3s16> m_forceloaded_list;
+
+private:
+	struct BlockRefs {
+		u32 abm_refs = 0;
+		u32 extra_refs = 0;
+		// Membership of m_abm_list and m_list as of the last update
+		bool in_abm_list = false;
+		bool in_list = false;
+		// Queued in m_changed
+		bool changed = false;
+	};
+
+	struct ViewerState {
+		v3s16 blockpos;
+		s16 radius = 0;
+		// Blocks of the view cone and what it was computed from
+		std::vector<v3s16> cone;
+		s16 cone_range = 0;
+		v3f camera_dir;
+		f32 fov = 0;
+		// Last update that saw the player
+		u32 generation = 0;
+	};
+
+	void addRefs(v3s16 p, s32 abm, s32 extra);
+	void addSphereRefs(v3s16 center, s16 radius, s32 delta);
+	void addConeRefs(const std::vector<v3s16> &cone, s32 delta);
+	const std::vector<v3s16> &getSphere(s16 radius);
+
+	std::unordered_map<v3s16, BlockRefs> m_refs;
+	// Blocks whose membership may have changed since the last update
+	std::vector<v3s16> m_changed;
+	std::unordered_map<u16, ViewerState> m_viewers;
+	u32 m_generation = 0;
+	std::set<v3s16> m_forceloaded_applied;
+
+	// Offsets of the blocks within a radius
+	s16 m_sphere_radius = -1;
+	std::vector<v3s16> m_sphere;
 };
 
 /*
@@ -227,6 +286,8 @@ class ServerEnvironment final : public Environment
 
 	ServerMap & getServerMap();
 
+	PathfinderService &getPathfinder() { return *m_pathfinder; }
+
 	//TODO find way to remove this fct!
 	ServerScripting* getScriptIface()
 	{ return m_script; }
@@ -463,6 +524,8 @@ class ServerEnvironment final : public Environment
 	server::ActiveObjectMgr m_ao_manager;
 	// on_mapblocks_changed map event receiver
 	OnMapblocksChangedReceiver m_on_mapblocks_changed_receiver;
+	// Path searches and their navigation cache
+	std::unique_ptr<PathfinderService> m_pathfinder;
 	// Outgoing network message buffer for active objects
 	std::queue<ActiveObjectMessage> m_active_object_messages;
 	// Some timers
@@ -26,6 +26,7 @@
 #include "database/database-sqlite3.h"
 #include "script/scripting_server.h"
 #include "irrlicht_changes/printing.h"
+#include "threading/task_pool.h"
 #if USE_LEVELDB
 #include "database/database-leveldb.h"
 #endif
@@ -347,7 +348,7 @@ MapSector *ServerMap::createSector(v2s16 p2d)
 	/*
 		Insert to container
 	*/
-	m_sectors[p2d] = sector;
+	addSector(sector);
 
 	return sector;
 }
@@ -549,6 +550,97 @@ void ServerMap::save(ModifiedState save_level)
 	reportMetrics(end_time - start_time, block_count, block_count_all);
 }
 
+void ServerMap::snapshotModified(ModifiedState save_level, MapSaveSnapshot &snapshot)
+{
+	if (!m_map_saving_enabled) {
+		warningstream<<"Not saving map, saving disabled."<<std::endl;
+		return;
+	}
+
+	const auto start_time = porting::getTimeUs();
+
+	if (m_map_metadata_changed || save_level == MOD_STATE_CLEAN) {
+		if (settings_mgr.saveMapMeta())
+			m_map_metadata_changed = false;
+	}
+
+	// Profile modified reasons
+	Profiler modprofiler;
+
+	for (auto &sector_it : m_sectors) {
+		MapSector *sector = sector_it.second;
+
+		MapBlockVect blocks;
+		sector->getBlocks(blocks);
+
+		for (MapBlock *block : blocks) {
+			snapshot.block_count_all++;
+			if (block->getModified() < (u32)save_level)
+				continue;
+
+			modprofiler.add(block->getModifiedReasonString(), 1);
+
+			std::ostringstream os(std::ios_base::binary);
+			block->serializeUncompressed(os, SER_FMT_VER_HIGHEST_WRITE, true);
+			// A change from now on marks it as modified again
+			block->resetModified();
+			// Not unloaded before the data is written, as it could be
+			// loaded again with the old data from the database
+			block->refGrab();
+			snapshot.blocks.push_back({block, os.str()});
+		}
+	}
+
+	if (!snapshot.blocks.empty()) {
+		infostream << "ServerMap: Writing " << snapshot.blocks.size() << " blocks"
+				<< ", " << snapshot.block_count_all << " blocks in memory."
+				<< std::endl;
+		infostream<<"Blocks modified by: "<<std::endl;
+		modprofiler.print(infostream);
+	}
+
+	snapshot.time_us = porting::getTimeUs() - start_time;
+}
+
+void ServerMap::writeSnapshot(MapSaveSnapshot &snapshot)
+{
+	if (snapshot.blocks.empty())
+		return;
+
+	const auto start_time = porting::getTimeUs();
+
+	// Only the data is used here, the blocks may be changed meanwhile
+	const u8 version = SER_FMT_VER_HIGHEST_WRITE;
+	TaskPool::get().parallelFor(0, snapshot.blocks.size(), [&] (size_t i) {
+		std::string &data = snapshot.blocks[i].data;
+		std::ostringstream os(std::ios_base::binary);
+		os.write((char*) &version, 1);
+		compress(data, os, version, m_map_compression_level);
+		data = os.str();
+	}, 4);
+
+	{
+		MutexAutoLock dblock(m_db.mutex);
+		m_db.dbase->beginSave();
+		for (MapSaveSnapshot::Block &it : snapshot.blocks)
+			it.saved = m_db.dbase->saveBlock(it.block->getPos(), it.data);
+		m_db.dbase->endSave();
+	}
+
+	snapshot.time_us += porting::getTimeUs() - start_time;
+}
+
+void ServerMap::releaseSnapshot(MapSaveSnapshot &snapshot)
+{
+	for (MapSaveSnapshot::Block &it : snapshot.blocks) {
+		if (!it.saved)
+			it.block->raiseModified(MOD_STATE_WRITE_NEEDED);
+		it.block->refDrop();
+	}
+	reportMetrics(snapshot.time_us, snapshot.blocks.size(), snapshot.block_count_all);
+	snapshot.blocks.clear();
+}
+
 void ServerMap::listAllLoadableBlocks(std::vector<v3s16> &dst)
 {
 	MutexAutoLock dblock(m_db.mutex);
@@ -34,6 +34,24 @@ struct MapDatabaseAccessor {
 	void loadBlock(v3s16 blockpos, std::string &ret);
 };
 
+/*
+	Modified blocks of a map save, serialized while holding the environment
+	lock so that compressing and writing them can happen without it.
+	See ServerMap::snapshotModified().
+*/
+struct MapSaveSnapshot {
+	struct Block {
+		// Kept loaded until the snapshot is released
+		MapBlock *block;
+		// Uncompressed, then as stored in the database
+		std::string data;
+		bool saved = false;
+	};
+	std::vector<Block> blocks;
+	u32 block_count_all = 0;
+	u64 time_us = 0;
+};
+
 /*
 	ServerMap
 
@@ -105,6 +123,17 @@ class ServerMap : public Map
 	void endSave() override;
 
 	void save(ModifiedState save_level) override;
+
+	/*
+		Same as save() in three steps, used by the periodic save:
+		snapshotModified() and releaseSnapshot() need the environment lock,
+		writeSnapshot() in between runs without it.
+		A block changed in the meantime is saved again the next time.
+	*/
+	void snapshotModified(ModifiedState save_level, MapSaveSnapshot &snapshot);
+	void writeSnapshot(MapSaveSnapshot &snapshot);
+	void releaseSnapshot(MapSaveSnapshot &snapshot);
+
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 	void listAllLoadedBlocks(std::vector<v3s16> &dst);
 
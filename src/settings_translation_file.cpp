@@ -281,6 +281,8 @@ fake_function() {
 	gettext("Client");
 	gettext("Saving map received from server");
 	gettext("Save the map received by the client on disk.");
+	gettext("Client-side map block cache");
+	gettext("Keep map blocks received from a server in a cache on disk.\nWhen reconnecting, the server only sends blocks that changed in the meantime.");
 	gettext("Serverlist URL");
 	gettext("URL to the server list displayed in the Multiplayer Tab.");
 	gettext("Enable split login/register");
@@ -801,6 +803,8 @@ fake_function() {
 	gettext("Level of logging to be written to debug.txt:\n-    <nothing> (no logging)\n-    none (messages with no level)\n-    error\n-    warning\n-    action\n-    info\n-    verbose\n-    trace");
 	gettext("Debug log file size threshold");
 	gettext("If the file size of debug.txt exceeds the number of megabytes specified in\nthis setting when it is opened, the file is moved to debug.txt.1,\ndeleting an older debug.txt.1 if it exists.\ndebug.txt is only moved if this setting is positive.");
+	gettext("Asynchronous logging");
+	gettext("Write log messages from a background thread.\nThreads then only format messages into their own buffers, so logging\nat high levels does not stall them on file or console output.\nIf a buffer overflows, info and more verbose messages are dropped;\nerrors, warnings and actions are always written.");
 	gettext("Chat log level");
 	gettext("Minimal level of logging to be written to chat.");
 	gettext("Deprecated Lua API handling");
@@ -835,6 +839,12 @@ fake_function() {
 	gettext("Engine Profiler");
 	gettext("Engine profiling data print interval");
 	gettext("Print the engine's profiling data in regular intervals (in seconds).\n0 = disable. Useful for developers.");
+	gettext("Record client trace");
+	gettext("Record a timeline of all threads while in game and write it to a file\nin the user directory when leaving the game.\nThe file uses the Chrome trace event format and can be viewed with\ne.g. ui.perfetto.dev. Servers use the /trace chat command instead.");
+	gettext("Lua accounting");
+	gettext("Measure the time and Lua memory of globalsteps, ABMs, LBMs, entity\nsteps and node timers per mod and callback.\nThe results are shown by the /lua_usage chat command and exported\nas metrics. Adds a small overhead to every callback.");
+	gettext("Lua time budget per mod");
+	gettext("Log mods that spend more than this many milliseconds of Lua time in a\nsingle server step (needs lua_accounting). 0 = disable.");
 	gettext("Advanced");
 	gettext("IPv6");
 	gettext("Enable IPv6 support (for both client and server).\nRequired for IPv6 connections to work at all.");
@@ -965,6 +975,8 @@ fake_function() {
 	gettext("Interval of saving important changes in the world, stated in seconds.");
 	gettext("Unload unused server data");
 	gettext("How long the server will wait before unloading unused mapblocks, stated in seconds.\nHigher value is smoother, but will use more RAM.");
+	gettext("Compact uniform mapblocks");
+	gettext("Mapblocks that consist of a single node (e.g. only air or stone) share\ntheir node data in memory, instead of using 16 KiB each.");
 	gettext("Maximum objects per block");
 	gettext("Maximum number of statically stored objects in a block.");
 	gettext("Active block management interval");
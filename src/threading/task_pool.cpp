@@ -0,0 +1,206 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "task_pool.h"
+#include "threading/thread.h"
+#include "porting.h"
+#include "profiler.h"
+#include "util/trace.h"
+#include <algorithm>
+
+// Pool and queue of the worker the current thread belongs to, if any
+static thread_local const TaskPool *current_pool = nullptr;
+static thread_local size_t current_queue = 0;
+
+class TaskPool::WorkerThread : public Thread
+{
+public:
+	WorkerThread(TaskPool *pool, size_t index, const std::string &name) :
+		Thread(name), m_pool(pool), m_index(index)
+	{}
+
+protected:
+	void *run() override
+	{
+		current_pool = m_pool;
+		current_queue = m_index;
+		m_pool->workerLoop(m_index);
+		return nullptr;
+	}
+
+private:
+	TaskPool *m_pool;
+	size_t m_index;
+};
+
+TaskPool::TaskPool(unsigned int num_threads, const std::string &name)
+{
+	num_threads = std::max(num_threads, 1U);
+	for (unsigned int i = 0; i < num_threads; i++)
+		m_queues.emplace_back(std::make_unique<WorkerQueue>());
+	for (unsigned int i = 0; i < num_threads; i++) {
+		m_threads.emplace_back(std::make_unique<WorkerThread>(this, i,
+				name + std::to_string(i)));
+		m_threads.back()->start();
+	}
+}
+
+TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	// Queued tasks are still run before the workers exit
+	for (auto &thread : m_threads)
+		thread->wait();
+}
+
+TaskPool &TaskPool::get()
+{
+	// Leave one processor to the thread that hands out the work
+	static TaskPool pool(std::max(Thread::getNumberOfProcessors(), 2U) - 1, "TaskPool");
+	return pool;
+}
+
+void TaskPool::post(Task task, TaskPriority prio, const char *name)
+{
+	size_t queue_index = current_pool == this ? current_queue :
+			m_next_queue++ % m_queues.size();
+	push(queue_index, QueuedTask{std::move(task), name}, prio);
+}
+
+void TaskPool::push(size_t queue_index, QueuedTask &&task, TaskPriority prio)
+{
+	// Counted before it can be taken, so that the count never drops below
+	// the number of tasks workers have taken
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending++;
+	}
+	{
+		WorkerQueue &queue = *m_queues[queue_index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks[static_cast<size_t>(prio)].push_back(std::move(task));
+	}
+	m_cv.notify_one();
+}
+
+bool TaskPool::pop(size_t queue_index, QueuedTask &task)
+{
+	const size_t num_queues = m_queues.size();
+	for (size_t prio = 0; prio < NUM_PRIORITIES; prio++) {
+		// Own queue first (oldest task), then the others (newest task)
+		for (size_t i = 0; i < num_queues; i++) {
+			WorkerQueue &queue = *m_queues[(queue_index + i) % num_queues];
+			std::unique_lock<std::mutex> lock(queue.mutex);
+			auto &tasks = queue.tasks[prio];
+			if (tasks.empty())
+				continue;
+			if (i == 0) {
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			} else {
+				task = std::move(tasks.back());
+				tasks.pop_back();
+			}
+			lock.unlock();
+
+			std::lock_guard<std::mutex> pending_lock(m_mutex);
+			m_pending--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void TaskPool::runTask(QueuedTask &task)
+{
+	if (!task.name) {
+		task.func();
+		return;
+	}
+
+	u64 t0 = porting::getTimeUs();
+	{
+		TraceScope trace(task.name);
+		task.func();
+	}
+	u64 time_us = porting::getTimeUs() - t0;
+
+	g_profiler->avg(std::string(task.name) + " [ms]", time_us / 1000.0f);
+	auto hook = std::atomic_load(&m_profile_hook);
+	if (hook)
+		(*hook)(task.name, time_us);
+}
+
+void TaskPool::workerLoop(size_t index)
+{
+	QueuedTask task;
+	for (;;) {
+		if (pop(index, task)) {
+			runTask(task);
+			task = QueuedTask();
+			continue;
+		}
+
+		// A task that is counted but not queued yet only delays this until
+		// the next pop() finds it
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [this] { return m_stop || m_pending > 0; });
+		if (m_stop && m_pending == 0)
+			return;
+	}
+}
+
+void TaskPool::parallelFor(size_t begin, size_t end,
+		const std::function<void(size_t)> &func, size_t grain,
+		TaskPriority prio, const char *name)
+{
+	if (begin >= end)
+		return;
+	grain = std::max<size_t>(grain, 1);
+	const size_t num_chunks = (end - begin + grain - 1) / grain;
+
+	struct State
+	{
+		std::atomic<size_t> next_chunk{0};
+		std::atomic<size_t> chunks_done{0};
+		std::mutex mutex;
+		std::condition_variable cv;
+	};
+	auto state = std::make_shared<State>();
+
+	// Helpers that start after all chunks were taken do not touch 'func',
+	// so it is fine that they may outlive this call.
+	auto work = [state, &func, begin, end, grain, num_chunks] {
+		size_t chunk, done = 0;
+		while ((chunk = state->next_chunk++) < num_chunks) {
+			const size_t chunk_begin = begin + chunk * grain;
+			const size_t chunk_end = std::min(chunk_begin + grain, end);
+			for (size_t i = chunk_begin; i < chunk_end; i++)
+				func(i);
+			done++;
+		}
+		if (done > 0 && state->chunks_done.fetch_add(done) + done == num_chunks) {
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->cv.notify_all();
+		}
+	};
+
+	const size_t num_helpers = std::min<size_t>(num_chunks - 1, m_threads.size());
+	for (size_t i = 0; i < num_helpers; i++)
+		post(work, prio, name);
+
+	work();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->cv.wait(lock, [&] { return state->chunks_done == num_chunks; });
+}
+
+void TaskPool::setProfileHook(ProfileHook hook)
+{
+	std::atomic_store(&m_profile_hook, hook ?
+			std::make_shared<ProfileHook>(std::move(hook)) : nullptr);
+}
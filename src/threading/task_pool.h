@@ -0,0 +1,120 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+enum class TaskPriority : u8 {
+	High,
+	Normal,
+	Low,
+};
+
+/*
+	Work-stealing pool of worker threads for short-lived tasks.
+
+	Every worker owns a queue per priority. Tasks posted from a worker go to
+	its own queue, other tasks are spread over all queues. Idle workers take
+	work from the other queues, always preferring higher priority tasks.
+
+	Tasks must not block on other tasks of the same pool (e.g. wait on the
+	future of a queued task), parallelFor() is the exception as the calling
+	thread does the remaining work itself.
+*/
+class TaskPool
+{
+public:
+	using Task = std::function<void()>;
+	// Called after every named task with its name and run time
+	using ProfileHook = std::function<void(const char *name, u64 time_us)>;
+
+	TaskPool(unsigned int num_threads, const std::string &name = "TaskPool");
+	~TaskPool();
+
+	DISABLE_CLASS_COPY(TaskPool)
+
+	// Process-wide pool sized from the number of processors
+	static TaskPool &get();
+
+	unsigned int getThreadCount() const { return m_threads.size(); }
+
+	/*
+		Queues a task without any means to wait for it. The task must not throw.
+		If a 'name' (which must outlive the task) is given, the run time of the
+		task is recorded in g_profiler and passed to the profile hook.
+	*/
+	void post(Task task, TaskPriority prio = TaskPriority::Normal,
+			const char *name = nullptr);
+
+	// Queues a task and returns a future for its result (or exception)
+	template <typename F>
+	auto submit(F &&func, TaskPriority prio = TaskPriority::Normal,
+			const char *name = nullptr) -> std::future<std::invoke_result_t<F>>
+	{
+		using R = std::invoke_result_t<F>;
+		auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+		std::future<R> ret = task->get_future();
+		post([task] { (*task)(); }, prio, name);
+		return ret;
+	}
+
+	/*
+		Calls func(i) for every i in [begin, end) and returns when all calls
+		are done. The range is handed out in chunks of 'grain' elements and the
+		calling thread takes part in the work, so this can be used from inside
+		a task too. func must not throw.
+	*/
+	void parallelFor(size_t begin, size_t end,
+			const std::function<void(size_t)> &func, size_t grain = 1,
+			TaskPriority prio = TaskPriority::High, const char *name = nullptr);
+
+	void setProfileHook(ProfileHook hook);
+
+private:
+	class WorkerThread;
+
+	struct QueuedTask
+	{
+		Task func;
+		const char *name = nullptr;
+	};
+
+	static constexpr size_t NUM_PRIORITIES = 3;
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<QueuedTask> tasks[NUM_PRIORITIES];
+	};
+
+	void push(size_t queue_index, QueuedTask &&task, TaskPriority prio);
+	// Takes a task from the worker's own queue or steals one from the others
+	bool pop(size_t queue_index, QueuedTask &task);
+	void runTask(QueuedTask &task);
+	void workerLoop(size_t index);
+
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+	std::vector<std::unique_ptr<WorkerThread>> m_threads;
+	std::atomic<size_t> m_next_queue{0};
+
+	// Number of queued tasks, including ones that are about to be queued.
+	// Protected by m_mutex, so that workers going to sleep do not miss a task.
+	size_t m_pending = 0;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+
+	std::shared_ptr<ProfileHook> m_profile_hook;
+};
@@ -89,6 +89,7 @@ class Thread {
 	bool isCurrentThread() const { return std::this_thread::get_id() == getThreadId(); }
 
 	bool isRunning() const { return m_running; }
+	const std::string &getName() const { return m_name; }
 	bool stopRequested() const { return m_request_stop; }
 
 	std::thread::id getThreadId() const { return m_thread_obj->get_id(); }
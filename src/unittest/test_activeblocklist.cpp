@@ -0,0 +1,248 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "serverenvironment.h"
+#include "noise.h"
+
+class TestActiveBlockList : public TestBase
+{
+public:
+	TestActiveBlockList() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestActiveBlockList"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSingle();
+	void testRemove();
+	void testForceloaded();
+	void testViewCone();
+	void testRandomized();
+};
+
+static TestActiveBlockList g_test_instance;
+
+void TestActiveBlockList::runTests(IGameDef *gamedef)
+{
+	TEST(testSingle);
+	TEST(testRemove);
+	TEST(testForceloaded);
+	TEST(testViewCone);
+	TEST(testRandomized);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static ActiveBlockViewer make_viewer(u16 id, v3s16 blockpos)
+{
+	ActiveBlockViewer viewer;
+	viewer.id = id;
+	viewer.blockpos = blockpos;
+	viewer.object_range = 0;
+	viewer.eye_pos = v3f::from(blockpos * MAP_BLOCKSIZE) * BS;
+	viewer.camera_dir = v3f(0, 0, 1);
+	viewer.fov = 1.5f;
+	return viewer;
+}
+
+struct Changes {
+	std::vector<v3s16> removed, added, extra_added;
+
+	void update(ActiveBlockList &list, const std::vector<ActiveBlockViewer> &viewers,
+			s16 block_range, s16 object_range)
+	{
+		removed.clear();
+		added.clear();
+		extra_added.clear();
+		list.update(viewers, block_range, object_range, removed, added, extra_added);
+	}
+};
+
+void TestActiveBlockList::testSingle()
+{
+	ActiveBlockList list;
+	Changes changes;
+
+	std::vector<ActiveBlockViewer> viewers{make_viewer(1, v3s16(0, 0, 0))};
+	changes.update(list, viewers, 1, 0);
+	// The distance is rounded down, so this is a cube
+	UASSERTEQ(size_t, list.size(), 27);
+	UASSERTEQ(size_t, changes.added.size(), 27);
+	UASSERT(list.contains(v3s16(1, 1, 1)));
+	UASSERT(!list.contains(v3s16(0, 0, 2)));
+
+	// Nothing changes without moving
+	changes.update(list, viewers, 1, 0);
+	UASSERT(changes.added.empty() && changes.removed.empty());
+
+	// Moving by one block exchanges a layer
+	viewers[0].blockpos.X++;
+	changes.update(list, viewers, 1, 0);
+	UASSERTEQ(size_t, changes.added.size(), 9);
+	UASSERTEQ(size_t, changes.removed.size(), 9);
+	UASSERT(list.contains(v3s16(2, 0, 0)));
+	UASSERT(!list.contains(v3s16(-1, 0, 0)));
+
+	// Leaving removes everything
+	viewers.clear();
+	changes.update(list, viewers, 1, 0);
+	UASSERTEQ(size_t, changes.removed.size(), 27);
+	UASSERTEQ(size_t, list.size(), 0);
+	UASSERTEQ(size_t, list.m_abm_list.size(), 0);
+}
+
+void TestActiveBlockList::testRemove()
+{
+	ActiveBlockList list;
+	Changes changes;
+
+	std::vector<ActiveBlockViewer> viewers{make_viewer(1, v3s16(0, 0, 0))};
+	changes.update(list, viewers, 1, 0);
+	list.remove(v3s16(0, 0, 0));
+	UASSERT(!list.contains(v3s16(0, 0, 0)));
+	UASSERTEQ(size_t, list.m_abm_list.count(v3s16(0, 0, 0)), 0);
+
+	// Retried by the next update
+	changes.update(list, viewers, 1, 0);
+	UASSERTEQ(size_t, changes.added.size(), 1);
+	UASSERT(changes.added[0] == v3s16(0, 0, 0));
+	UASSERT(list.contains(v3s16(0, 0, 0)));
+	UASSERTEQ(size_t, list.m_abm_list.count(v3s16(0, 0, 0)), 1);
+}
+
+void TestActiveBlockList::testForceloaded()
+{
+	ActiveBlockList list;
+	Changes changes;
+	const std::vector<ActiveBlockViewer> no_viewers;
+
+	list.m_forceloaded_list.insert(v3s16(10, 0, 0));
+	changes.update(list, no_viewers, 1, 0);
+	UASSERTEQ(size_t, changes.added.size(), 1);
+	UASSERT(list.contains(v3s16(10, 0, 0)));
+
+	// Shared with a player
+	std::vector<ActiveBlockViewer> viewers{make_viewer(1, v3s16(10, 0, 0))};
+	changes.update(list, viewers, 1, 0);
+	UASSERTEQ(size_t, changes.added.size(), 26);
+	list.m_forceloaded_list.clear();
+	changes.update(list, viewers, 1, 0);
+	UASSERT(changes.removed.empty());
+	changes.update(list, no_viewers, 1, 0);
+	UASSERTEQ(size_t, changes.removed.size(), 27);
+}
+
+void TestActiveBlockList::testViewCone()
+{
+	ActiveBlockList list;
+	Changes changes;
+
+	std::vector<ActiveBlockViewer> viewers{make_viewer(1, v3s16(0, 0, 0))};
+	viewers[0].object_range = 4;
+	changes.update(list, viewers, 1, 4);
+	UASSERT(!changes.extra_added.empty());
+
+	// Looking around a little or moving within the block keeps the cone
+	viewers[0].camera_dir.rotateXZBy(2);
+	viewers[0].eye_pos.X += BS;
+	viewers[0].fov += 0.01f;
+	changes.update(list, viewers, 1, 4);
+	UASSERT(changes.removed.empty() && changes.extra_added.empty());
+
+	// Turning around does not
+	viewers[0].camera_dir.rotateXZBy(180);
+	changes.update(list, viewers, 1, 4);
+	UASSERT(!changes.removed.empty() && !changes.extra_added.empty());
+}
+
+// Computes the lists from scratch
+static void reference_lists(const std::vector<ActiveBlockViewer> &viewers,
+	const std::set<v3s16> &forceloaded, s16 block_range, s16 object_range,
+	std::set<v3s16> &abm_list, std::set<v3s16> &list)
+{
+	abm_list = forceloaded;
+	for (const ActiveBlockViewer &viewer : viewers) {
+		v3s16 p;
+		const s16 r = block_range;
+		for (p.X = -r; p.X <= r; p.X++)
+		for (p.Y = -r; p.Y <= r; p.Y++)
+		for (p.Z = -r; p.Z <= r; p.Z++) {
+			if (p.getDistanceFrom(v3s16()) <= r)
+				abm_list.insert(viewer.blockpos + p);
+		}
+	}
+
+	list = abm_list;
+	for (const ActiveBlockViewer &viewer : viewers) {
+		const s16 r = std::min(object_range, viewer.object_range);
+		if (r <= block_range)
+			continue;
+		v3s16 p;
+		const v3s16 &p0 = viewer.blockpos;
+		for (p.X = p0.X - r; p.X <= p0.X + r; p.X++)
+		for (p.Y = p0.Y - r; p.Y <= p0.Y + r; p.Y++)
+		for (p.Z = p0.Z - r; p.Z <= p0.Z + r; p.Z++) {
+			if (isBlockInSight(p, viewer.eye_pos, viewer.camera_dir, viewer.fov,
+					r * BS * MAP_BLOCKSIZE))
+				list.insert(p);
+		}
+	}
+}
+
+void TestActiveBlockList::testRandomized()
+{
+	ActiveBlockList list;
+	Changes changes;
+	PcgRandom pr(1234);
+	const s16 block_range = 2, object_range = 4;
+
+	std::vector<ActiveBlockViewer> viewers;
+	std::set<v3s16> expected_list, expected_abm_list;
+	for (int step = 0; step < 50; step++) {
+		// Players join, leave, walk and look around
+		if (viewers.size() < 8 && pr.range(0, 2) == 0) {
+			viewers.push_back(make_viewer(step, v3s16(pr.range(-6, 6), 0, pr.range(-6, 6))));
+			viewers.back().object_range = pr.range(0, 6);
+		}
+		if (!viewers.empty() && pr.range(0, 4) == 0)
+			viewers.erase(viewers.begin() + pr.range(0, viewers.size() - 1));
+		for (ActiveBlockViewer &viewer : viewers) {
+			if (pr.range(0, 2) == 0)
+				viewer.blockpos.X += pr.range(-1, 1);
+			if (pr.range(0, 2) == 0) {
+				// Smaller turns do not update the view cone
+				viewer.camera_dir.rotateXZBy(pr.range(1, 23) * 15);
+				viewer.eye_pos = v3f::from(viewer.blockpos * MAP_BLOCKSIZE) * BS;
+			}
+		}
+		if (pr.range(0, 3) == 0)
+			list.m_forceloaded_list.insert(v3s16(pr.range(-3, 3), 5, 0));
+		else if (pr.range(0, 3) == 0)
+			list.m_forceloaded_list.clear();
+
+		const std::set<v3s16> old_list(list.m_list.begin(), list.m_list.end());
+		changes.update(list, viewers, block_range, object_range);
+
+		reference_lists(viewers, list.m_forceloaded_list, block_range, object_range,
+			expected_abm_list, expected_list);
+		const std::set<v3s16> new_list(list.m_list.begin(), list.m_list.end());
+		const std::set<v3s16> new_abm_list(list.m_abm_list.begin(), list.m_abm_list.end());
+		UASSERT(new_list == expected_list);
+		UASSERT(new_abm_list == expected_abm_list);
+
+		// The changes lead from the old to the new list
+		std::set<v3s16> replayed = old_list;
+		for (v3s16 p : changes.removed)
+			UASSERTEQ(size_t, replayed.erase(p), 1);
+		for (v3s16 p : changes.added) {
+			UASSERT(replayed.insert(p).second);
+			UASSERT(expected_abm_list.count(p));
+		}
+		for (v3s16 p : changes.extra_added) {
+			UASSERT(replayed.insert(p).second);
+			UASSERT(!expected_abm_list.count(p));
+		}
+		UASSERT(replayed == expected_list);
+	}
+}
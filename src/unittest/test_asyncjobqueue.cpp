@@ -0,0 +1,151 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "script/cpp_api/s_async.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+class TestAsyncJobQueue : public TestBase
+{
+public:
+	TestAsyncJobQueue() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestAsyncJobQueue"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testOrder();
+	void testStealing();
+	void testWakeUp();
+	void testThreads();
+};
+
+static TestAsyncJobQueue g_test_instance;
+
+void TestAsyncJobQueue::runTests(IGameDef *gamedef)
+{
+	TEST(testOrder);
+	TEST(testStealing);
+	TEST(testWakeUp);
+	TEST(testThreads);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::vector<LuaJobInfo> make_jobs(u32 first, size_t count, u64 time = 0)
+{
+	std::vector<LuaJobInfo> jobs(count);
+	for (size_t i = 0; i < count; i++) {
+		jobs[i].id = first + i;
+		jobs[i].time_queued = time;
+	}
+	return jobs;
+}
+
+void TestAsyncJobQueue::testOrder()
+{
+	AsyncJobQueue queue;
+	queue.setShardCount(1);
+
+	queue.push(make_jobs(0, 3));
+	queue.push(make_jobs(3, 2));
+	UASSERTEQ(size_t, queue.size(), 5);
+
+	LuaJobInfo job;
+	for (u32 i = 0; i < 5; i++) {
+		UASSERT(queue.pop(0, &job));
+		UASSERTEQ(u32, job.id, i);
+	}
+	UASSERTEQ(size_t, queue.size(), 0);
+}
+
+void TestAsyncJobQueue::testStealing()
+{
+	AsyncJobQueue queue;
+	queue.setShardCount(4);
+	queue.setActiveShards(2);
+
+	// Spread over the two active shards
+	queue.push(make_jobs(0, 4, 100));
+	UASSERTEQ(u64, queue.getOldestAge(150), 50);
+
+	// A worker of an inactive shard steals everything
+	LuaJobInfo job;
+	std::vector<u32> ids;
+	for (int i = 0; i < 4; i++) {
+		UASSERT(queue.pop(3, &job));
+		ids.push_back(job.id);
+	}
+	std::sort(ids.begin(), ids.end());
+	UASSERT(ids == std::vector<u32>({0, 1, 2, 3}));
+	UASSERTEQ(u64, queue.getOldestAge(150), 0);
+}
+
+void TestAsyncJobQueue::testWakeUp()
+{
+	AsyncJobQueue queue;
+	queue.setShardCount(2);
+
+	queue.wakeUp(1);
+	LuaJobInfo job;
+	UASSERT(!queue.pop(0, &job));
+
+	queue.push(make_jobs(0, 2));
+	queue.clear();
+	UASSERTEQ(size_t, queue.size(), 0);
+	// The posts of the cleared jobs only cause empty wakeups
+	UASSERT(!queue.pop(1, &job));
+	UASSERT(!queue.pop(1, &job));
+}
+
+void TestAsyncJobQueue::testThreads()
+{
+	constexpr int WORKERS = 4;
+	constexpr u32 JOBS = 20000;
+
+	AsyncJobQueue queue;
+	queue.setShardCount(WORKERS);
+	queue.setActiveShards(WORKERS);
+
+	std::vector<std::vector<u32>> taken(WORKERS);
+	std::atomic<bool> stop{false};
+	std::vector<std::thread> workers;
+	for (int w = 0; w < WORKERS; w++) {
+		workers.emplace_back([&, w] {
+			LuaJobInfo job;
+			while (!stop) {
+				if (queue.pop(w, &job))
+					taken[w].push_back(job.id);
+			}
+		});
+	}
+
+	// Single jobs and batches of different sizes
+	u32 id = 0;
+	while (id < JOBS) {
+		const size_t count = std::min<u32>(JOBS - id, id % 7 == 0 ? 1 : 1 + id % 97);
+		queue.push(make_jobs(id, count));
+		id += count;
+	}
+	// Stop the workers once they took everything
+	while (queue.size() > 0)
+		std::this_thread::yield();
+	stop = true;
+	queue.wakeUp(WORKERS);
+	for (auto &worker : workers)
+		worker.join();
+
+	// Every job was taken exactly once
+	std::vector<bool> seen(JOBS);
+	size_t total = 0;
+	for (const auto &ids : taken) {
+		for (u32 i : ids) {
+			UASSERT(!seen[i]);
+			seen[i] = true;
+		}
+		total += ids.size();
+	}
+	UASSERTEQ(size_t, total, JOBS);
+}
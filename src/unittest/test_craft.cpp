@@ -19,6 +19,7 @@ class TestCraft : public TestBase
 			const std::vector<std::string> &groups, IGameDef *gamedef);
 
 	void testShapeless(IGameDef *gamedef);
+	void testRecipeIndex(IGameDef *gamedef);
 };
 
 static TestCraft g_test_instance;
@@ -26,6 +27,7 @@ static TestCraft g_test_instance;
 void TestCraft::runTests(IGameDef *gamedef)
 {
 	TEST(testShapeless, gamedef);
+	TEST(testRecipeIndex, gamedef);
 }
 
 std::string TestCraft::getDumpedCraftResult(CraftInput input, IGameDef *gamedef)
@@ -258,3 +260,62 @@ void TestCraft::testShapeless(IGameDef *gamedef)
 			}), gamedef),
 			"(item=\"crafttest:i4\", time=0)");
 }
+
+void TestCraft::testRecipeIndex(IGameDef *gamedef)
+{
+	IWritableItemDefManager *idef = (IWritableItemDefManager *)gamedef->getItemDefManager();
+	IWritableCraftDefManager *cdef = (IWritableCraftDefManager *)gamedef->getCraftDefManager();
+
+	auto craft = [&](unsigned int width, const std::vector<std::string> &itemstrings) {
+		std::vector<ItemStack> items;
+		for (const auto &itemstring : itemstrings) {
+			items.emplace_back();
+			items.back().deSerialize(itemstring, idef);
+		}
+		return getDumpedCraftResult(CraftInput(CRAFT_METHOD_NORMAL, width, items),
+				gamedef);
+	};
+
+	cdef->clear();
+
+	registerItemWithGroups("crafttest:x", {}, gamedef);
+	registerItemWithGroups("crafttest:y", {}, gamedef);
+	registerItemWithGroups("crafttest:soft", {"crafttest_wood"}, gamedef);
+	registerItemWithGroups("crafttest:hard", {"crafttest_wood", "crafttest_hard"}, gamedef);
+
+	cdef->registerCraft(new CraftDefinitionShapeless("crafttest:x",
+			{"crafttest:y", "group:crafttest_wood"}, CraftReplacements{}), gamedef);
+	// Only groups
+	cdef->registerCraft(new CraftDefinitionShapeless("crafttest:y",
+			{"group:crafttest_wood", "group:crafttest_wood,crafttest_hard"},
+			CraftReplacements{}), gamedef);
+	cdef->registerCraft(new CraftDefinitionShaped("crafttest:soft", 1,
+			{"crafttest:y", "crafttest:y"}, CraftReplacements{}), gamedef);
+	cdef->registerCraft(new CraftDefinitionShaped("crafttest:hard 2", 1,
+			{"group:crafttest_hard"}, CraftReplacements{}), gamedef);
+	// Overrides the first recipe
+	cdef->registerCraft(new CraftDefinitionShapeless("crafttest:x 2",
+			{"crafttest:y", "group:crafttest_wood"}, CraftReplacements{}), gamedef);
+
+	cdef->initHashes(gamedef);
+
+	// Twice, the second one comes from the result cache
+	for (int i = 0; i < 2; i++) {
+		UASSERTEQ(std::string, craft(2, {"crafttest:y", "crafttest:soft"}),
+				"(item=\"crafttest:x 2\", time=0)");
+		UASSERTEQ(std::string, craft(2, {"crafttest:hard", "crafttest:y"}),
+				"(item=\"crafttest:x 2\", time=0)");
+		UASSERTEQ(std::string, craft(2, {"crafttest:soft", "crafttest:hard"}),
+				"(item=\"crafttest:y\", time=0)");
+		UASSERTEQ(std::string, craft(2, {"crafttest:hard", "crafttest:soft 5"}),
+				"(item=\"crafttest:y\", time=0)");
+		UASSERTEQ(std::string, craft(2, {"crafttest:soft", "crafttest:soft"}),
+				"(item=\"\", time=0)");
+		UASSERTEQ(std::string, craft(3, {"", "crafttest:hard"}),
+				"(item=\"crafttest:hard 2\", time=0)");
+		UASSERTEQ(std::string, craft(1, {"crafttest:y", "crafttest:y"}),
+				"(item=\"crafttest:soft\", time=0)");
+		UASSERTEQ(std::string, craft(2, {"crafttest:y", "crafttest:y"}),
+				"(item=\"\", time=0)");
+	}
+}
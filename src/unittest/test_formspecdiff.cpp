@@ -0,0 +1,145 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "exceptions.h"
+#include "util/formspec_diff.h"
+#include <sstream>
+
+class TestFormspecDiff : public TestBase
+{
+public:
+	TestFormspecDiff() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFormspecDiff"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSplit();
+	void testChangedElements();
+	void testAddedElements();
+	void testSerialize();
+	void testMismatch();
+};
+
+static TestFormspecDiff g_test_instance;
+
+void TestFormspecDiff::runTests(IGameDef *gamedef)
+{
+	TEST(testSplit);
+	TEST(testChangedElements);
+	TEST(testAddedElements);
+	TEST(testSerialize);
+	TEST(testMismatch);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const std::string FORM_A =
+	"formspec_version[8]size[10,8]"
+	"label[0.5,0.5;Fuel: 10\\]]"
+	"list[context;src;1,1;1,1;]"
+	"image[3,1;1,1;progress.png^[lowpart:20:arrow.png]"
+	"list[current_player;main;0.5,3;8,4;]";
+
+static std::string check_apply(const std::string &from, const std::string &to)
+{
+	FormspecDiff diff = FormspecDiff::make(from, to);
+	std::string result;
+	UASSERT(diff.apply(from, &result));
+	UASSERTEQ(std::string, result, to);
+	return result;
+}
+
+void TestFormspecDiff::testSplit()
+{
+	auto elements = formspec_split_elements(FORM_A);
+	UASSERTEQ(size_t, elements.size(), 6);
+	UASSERTEQ(std::string, elements[2], "label[0.5,0.5;Fuel: 10\\]]");
+
+	std::string joined;
+	for (const auto &element : elements)
+		joined += element;
+	UASSERTEQ(std::string, joined, FORM_A);
+
+	// Trailing text without a closing bracket
+	elements = formspec_split_elements("size[1,1]label[x");
+	UASSERTEQ(size_t, elements.size(), 2);
+	UASSERTEQ(std::string, elements[1], "label[x");
+
+	UASSERT(formspec_split_elements("").empty());
+}
+
+void TestFormspecDiff::testChangedElements()
+{
+	std::string to = FORM_A;
+	to.replace(to.find("Fuel: 10"), 8, "Fuel: 9");
+	to.replace(to.find("lowpart:20"), 10, "lowpart:30");
+
+	FormspecDiff diff = FormspecDiff::make(FORM_A, to);
+	// The unchanged list between them is not sent
+	UASSERTEQ(size_t, diff.hunks.size(), 2);
+	UASSERTEQ(u32, diff.hunks[0].start, 2);
+	UASSERTEQ(u32, diff.hunks[1].start, 4);
+	check_apply(FORM_A, to);
+
+	// Nothing changed
+	diff = FormspecDiff::make(FORM_A, FORM_A);
+	UASSERT(diff.hunks.empty());
+	check_apply(FORM_A, FORM_A);
+}
+
+void TestFormspecDiff::testAddedElements()
+{
+	std::string to = FORM_A;
+	to.insert(to.find("list[current_player"), "button[1,2;2,1;go;Go]");
+	FormspecDiff diff = FormspecDiff::make(FORM_A, to);
+	UASSERTEQ(size_t, diff.hunks.size(), 1);
+	UASSERTEQ(u32, diff.hunks[0].start, 5);
+	UASSERTEQ(u32, diff.hunks[0].remove, 0);
+	check_apply(FORM_A, to);
+
+	// and removed again
+	check_apply(to, FORM_A);
+	check_apply(FORM_A, "");
+	check_apply("", FORM_A);
+}
+
+void TestFormspecDiff::testSerialize()
+{
+	std::string to = FORM_A;
+	to.replace(to.find("Fuel: 10"), 8, "Fuel: 9");
+	FormspecDiff diff = FormspecDiff::make(FORM_A, to);
+
+	std::ostringstream os(std::ios_base::binary);
+	diff.serialize(os);
+	UASSERT(os.str().size() < to.size());
+
+	std::istringstream is(os.str(), std::ios_base::binary);
+	FormspecDiff diff2;
+	diff2.deSerialize(is);
+	std::string result;
+	UASSERT(diff2.apply(FORM_A, &result));
+	UASSERTEQ(std::string, result, to);
+
+	// Truncated data
+	std::istringstream is2(os.str().substr(0, 24), std::ios_base::binary);
+	EXCEPTION_CHECK(SerializationError, diff2.deSerialize(is2));
+}
+
+void TestFormspecDiff::testMismatch()
+{
+	std::string to = FORM_A;
+	to.replace(to.find("Fuel: 10"), 8, "Fuel: 9");
+	FormspecDiff diff = FormspecDiff::make(FORM_A, to);
+
+	// Applied to another formspec than the one it was made from
+	std::string result = "unchanged";
+	UASSERT(!diff.apply(to, &result));
+	UASSERTEQ(std::string, result, "unchanged");
+
+	// Hunk out of range
+	diff.hunks[0].start = 100;
+	UASSERT(!diff.apply(FORM_A, &result));
+	UASSERTEQ(std::string, result, "unchanged");
+}
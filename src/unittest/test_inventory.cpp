@@ -4,6 +4,7 @@
 
 #include "test.h"
 
+#include <memory>
 #include <sstream>
 
 #include "gamedef.h"
@@ -17,10 +18,12 @@ class TestInventory : public TestBase {
 	void runTests(IGameDef *gamedef);
 
 	void testSerializeDeserialize(IItemDefManager *idef);
+	void testItemName();
 
 	static const char *serialized_inventory_in;
 	static const char *serialized_inventory_out;
 	static const char *serialized_inventory_inc;
+	static const char *serialized_inventory_inc_slots;
 };
 
 static TestInventory g_test_instance;
@@ -28,6 +31,7 @@ static TestInventory g_test_instance;
 void TestInventory::runTests(IGameDef *gamedef)
 {
 	TEST(testSerializeDeserialize, gamedef->getItemDefManager());
+	TEST(testItemName);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -57,12 +61,86 @@ void TestInventory::testSerializeDeserialize(IItemDefManager *idef)
 	inv.serialize(inv_os, true);
 	UASSERTEQ(std::string, inv_os.str(), serialized_inventory_inc);
 
+	// Copy of the state a client would have now
+	Inventory inv_client(idef);
+	inv_client = inv;
+
 	ItemStack leftover = inv.getList("main")->takeItem(7, 99 - 12);
 	ItemStack wanted = ItemStack("default:dirt", 99 - 12, 0, idef);
 	UASSERT(leftover == wanted);
 	leftover = inv.getList("main")->getItem(7);
 	wanted.count = 12;
 	UASSERT(leftover == wanted);
+
+	// Only the changed slot is sent
+	inv.getList("main")->deleteItem(2);
+	inv_os.str("");
+	inv_os.clear();
+	inv.serialize(inv_os, true);
+	UASSERTEQ(std::string, inv_os.str(), serialized_inventory_inc_slots);
+
+	std::istringstream inc_is(inv_os.str(), std::ios::binary);
+	inv_client.deSerialize(inc_is);
+	UASSERT(inv_client == inv);
+}
+
+void TestInventory::testItemName()
+{
+	// Unknown names are not interned
+	ItemName plain("test:never_registered");
+	UASSERT(!plain.isInterned());
+	UASSERT(plain == ItemName(std::string("test:never_registered")));
+	UASSERT(plain != ItemName("test:other"));
+	UASSERT(plain == "test:never_registered");
+
+	ItemName dirt = ItemName::intern("default:dirt");
+	UASSERT(dirt.isInterned());
+	UASSERT(ItemName("default:dirt").isInterned());
+	UASSERTEQ(u32, dirt.getId(), ItemName("default:dirt").getId());
+	UASSERT(dirt != ItemName("default:stone"));
+	UASSERTEQ(std::string, dirt.str(), "default:dirt");
+	UASSERT(ItemName().empty());
+	UASSERT(ItemName("") == ItemName());
+	UASSERTEQ(u32, ItemName().getId(), 0);
+
+	// A plain name made before the name was interned still matches it
+	ItemName early("test:interned_late");
+	ItemName late = ItemName::intern("test:interned_late");
+	UASSERT(!early.isInterned());
+	UASSERT(early == late);
+	UASSERTEQ(size_t, std::hash<ItemName>()(early), std::hash<ItemName>()(late));
+
+	std::unique_ptr<IWritableItemDefManager> idef(createItemDefManager());
+	ItemDefinition def;
+	def.type = ITEM_CRAFT;
+	def.name = "test:item";
+	idef->registerItem(def);
+	idef->registerAlias("test:old", "test:item");
+
+	UASSERT(idef->isKnown(ItemName("test:item")));
+	UASSERT(idef->isKnown(ItemName("test:old")));
+	UASSERT(!idef->isKnown(ItemName("test:missing")));
+	UASSERT(idef->getAlias(ItemName("test:old")) == "test:item");
+	UASSERTEQ(std::string, idef->get(ItemName("test:old")).name, "test:item");
+	UASSERTEQ(std::string, idef->get(ItemName("test:missing")).name, "unknown");
+	UASSERTEQ(std::string, idef->get(ItemName()).name, "");
+	UASSERT(ItemStack("test:old", 1, 0, idef.get()).name == "test:item");
+	UASSERT(idef->getItemName("test:item").isInterned());
+	UASSERT(!idef->getItemName("test:missing").isInterned());
+
+	// Created before the registration
+	ItemName before("test:new");
+	def.name = "test:new";
+	idef->registerItem(def);
+	UASSERT(idef->isKnown(before));
+	UASSERT(idef->getAlias(before).isInterned());
+
+	idef->unregisterItem("test:item");
+	UASSERT(!idef->isKnown(ItemName("test:item")));
+	UASSERT(!idef->isKnown(ItemName("test:old")));
+	idef->clear();
+	UASSERT(idef->getAlias(ItemName("test:old")) == "test:old");
+	UASSERT(idef->isKnown(ItemName("air")));
 }
 
 const char *TestInventory::serialized_inventory_in =
@@ -109,3 +187,20 @@ const char *TestInventory::serialized_inventory_inc =
 	"KeepList main\n"
 	"KeepList abc\n"
 	"EndInventory\n";
+
+const char *TestInventory::serialized_inventory_inc_slots =
+	"List main 10\n"
+	"Width 5\n"
+	"Keep\n"
+	"Keep\n"
+	"Empty\n"
+	"Keep\n"
+	"Keep\n"
+	"Keep\n"
+	"Keep\n"
+	"Item default:dirt 12\n"
+	"Keep\n"
+	"Keep\n"
+	"EndInventoryList\n"
+	"KeepList abc\n"
+	"EndInventory\n";
@@ -2,6 +2,9 @@
 
 #include "test.h"
 #include "log_internal.h"
+#include "util/string.h"
+
+#include <thread>
 
 using std::ostream;
 
@@ -15,6 +18,9 @@ class TestLogging : public TestBase
 
 	void testNullChecks();
 	void testBitCheck();
+	void testAsync();
+	void testAsyncOverflow();
+	void testAsyncActions();
 };
 
 static TestLogging g_test_instance;
@@ -23,6 +29,9 @@ void TestLogging::runTests(IGameDef *gamedef)
 {
 	TEST(testNullChecks);
 	TEST(testBitCheck);
+	TEST(testAsync);
+	TEST(testAsyncOverflow);
+	TEST(testAsyncActions);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -88,3 +97,99 @@ void TestLogging::testBitCheck()
 	UASSERTEQ(std::string, logs[1].text, "Fail is (ostream:failbit)");
 	UASSERTEQ(std::string, logs[2].text, "Bad is (ostream:badbit)");
 }
+
+void TestLogging::testAsync()
+{
+	Logger logger;
+	CaptureLogOutput capture(logger);
+	logger.setAsync(true);
+
+	const int per_thread = 200;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&logger, t] () {
+			logger.registerThread("Log" + std::to_string(t));
+			for (int i = 0; i < per_thread; i++)
+				logger.log(LL_ACTION, std::to_string(t) + " " + std::to_string(i));
+			logger.deregisterThread();
+		});
+	}
+	for (auto &thread : threads)
+		thread.join();
+	logger.logRaw(LL_NONE, "raw");
+	logger.flush();
+
+	auto logs = capture.take();
+	UASSERTEQ(size_t, logs.size(), 4 * per_thread + 1);
+	// Messages of each thread stay in order
+	int next[4] = {};
+	for (size_t i = 0; i + 1 < logs.size(); i++) {
+		const LogEntry &e = logs[i];
+		UASSERTEQ(LogLevel, e.level, LL_ACTION);
+		int t = e.text[0] - '0';
+		UASSERT(t >= 0 && t < 4);
+		UASSERTEQ(std::string, e.thread_name, "Log" + std::to_string(t));
+		UASSERTEQ(std::string, e.text, std::to_string(t) + " " + std::to_string(next[t]));
+		UASSERT(e.combined.find("ACTION[" + e.thread_name + "]: " + e.text) != std::string::npos);
+		next[t]++;
+	}
+	UASSERTEQ(std::string, logs.back().text, "raw");
+
+	// Disabling asynchronous mode writes out everything and logs directly
+	logger.log(LL_ERROR, "pending");
+	logger.setAsync(false);
+	UASSERTEQ(size_t, capture.take().size(), 1);
+	logger.log(LL_ERROR, "direct");
+	UASSERTEQ(size_t, capture.take().size(), 1);
+}
+
+void TestLogging::testAsyncOverflow()
+{
+	Logger logger;
+	CaptureLogOutput capture(logger);
+	logger.setAsync(true);
+
+	// Much more than fits into a ring buffer
+	const u32 count = 5000;
+	for (u32 i = 0; i < count; i++)
+		logger.log(LL_INFO, "info");
+	for (u32 i = 0; i < count; i++)
+		logger.log(LL_WARNING, "warning");
+	logger.setAsync(false);
+
+	u32 infos = 0, warnings = 0;
+	bool reported = false;
+	for (auto &e : capture.take()) {
+		if (e.text == "info")
+			infos++;
+		else if (e.text == "warning")
+			warnings++;
+		else if (str_starts_with(e.text, "Logger: dropped"))
+			reported = true;
+	}
+	// Warnings are never dropped, info messages may be
+	UASSERTEQ(u32, warnings, count);
+	UASSERTEQ(u64, infos + logger.getDroppedCount(), count);
+	UASSERT(reported == (logger.getDroppedCount() > 0));
+}
+
+void TestLogging::testAsyncActions()
+{
+	Logger logger;
+	CaptureLogOutput capture(logger);
+	logger.setAsync(true);
+
+	// Action messages are the audit log, they are never dropped either
+	const u32 count = 20000;
+	for (u32 i = 0; i < count; i++)
+		logger.log(LL_ACTION, std::to_string(i));
+	logger.setAsync(false);
+
+	u32 next = 0;
+	for (auto &e : capture.take()) {
+		UASSERTEQ(std::string, e.text, std::to_string(next));
+		next++;
+	}
+	UASSERTEQ(u32, next, count);
+	UASSERTEQ(u64, logger.getDroppedCount(), 0);
+}
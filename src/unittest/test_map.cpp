@@ -23,6 +23,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <unordered_map>
 #include "mapblock.h"
 #include "dummymap.h"
+#include "gamedef.h"
+#include "nodedef.h"
+#include "noise.h"
 
 class TestMap : public TestBase
 {
@@ -36,6 +39,10 @@ class TestMap : public TestBase
 	void testForEachNodeInArea(IGameDef *gamedef);
 	void testForEachNodeInAreaBlank(IGameDef *gamedef);
 	void testForEachNodeInAreaEmpty(IGameDef *gamedef);
+	void testForEachNodeInAreaWithContent(IGameDef *gamedef);
+	void testPointableSummary(IGameDef *gamedef);
+	void testTimerUpdate(IGameDef *gamedef);
+	void testBlockIndex();
 };
 
 static TestMap g_test_instance;
@@ -46,6 +53,10 @@ void TestMap::runTests(IGameDef *gamedef)
 	TEST(testForEachNodeInArea, gamedef);
 	TEST(testForEachNodeInAreaBlank, gamedef);
 	TEST(testForEachNodeInAreaEmpty, gamedef);
+	TEST(testForEachNodeInAreaWithContent, gamedef);
+	TEST(testPointableSummary, gamedef);
+	TEST(testTimerUpdate, gamedef);
+	TEST(testBlockIndex);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -169,3 +180,147 @@ void TestMap::testForEachNodeInAreaEmpty(IGameDef *gamedef)
 		return true;
 	});
 }
+
+void TestMap::testForEachNodeInAreaWithContent(IGameDef *gamedef)
+{
+	DummyMap map(gamedef, v3s16(-2, -2, -2), v3s16(1, 1, 1));
+	map.fill(v3s16(-2, -2, -2), v3s16(1, -1, 1), MapNode(t_CONTENT_STONE));
+	map.fill(v3s16(-2, 0, -2), v3s16(1, 1, 1), MapNode(CONTENT_AIR));
+
+	map.setNode(v3s16(3, 5, -7), MapNode(t_CONTENT_TORCH));
+	map.setNode(v3s16(-20, -3, 9), MapNode(t_CONTENT_TORCH));
+	map.setNode(v3s16(4, -30, 4), MapNode(t_CONTENT_WATER));
+
+	MapBlock *air_block = map.getBlockNoCreateNoEx(v3s16(1, 1, 1));
+	UASSERT(air_block->mayContain(MapBlock::getContentBit(CONTENT_AIR)));
+	UASSERT(!air_block->mayContain(MapBlock::getContentBit(t_CONTENT_TORCH)));
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(0, 0, -1))->
+			mayContain(MapBlock::getContentBit(t_CONTENT_TORCH)));
+
+	// Reaches out of the map, where there are no blocks
+	const v3s16 minp(-25, -31, -12), maxp(12, 20, 40);
+	const std::vector<std::vector<content_t>> filters = {
+		{t_CONTENT_TORCH},
+		{t_CONTENT_WATER, t_CONTENT_TORCH},
+		{CONTENT_IGNORE},
+		{t_CONTENT_LAVA},
+	};
+	for (auto &filter : filters) {
+		// Must be the same as the generic iteration
+		std::vector<std::pair<v3s16, content_t>> expected, actual;
+		map.forEachNodeInArea(minp, maxp, [&](v3s16 p, MapNode n) -> bool {
+			if (CONTAINS(filter, n.getContent()))
+				expected.emplace_back(p, n.getContent());
+			return true;
+		});
+		map.forEachNodeInAreaWithContent(minp, maxp, filter, [&](v3s16 p, MapNode n) -> bool {
+			actual.emplace_back(p, n.getContent());
+			return true;
+		});
+		UASSERT(actual == expected);
+	}
+
+	// Stops early
+	int visited = 0;
+	map.forEachNodeInAreaWithContent(minp, maxp, {CONTENT_IGNORE}, [&](v3s16 p, MapNode n) -> bool {
+		return ++visited < 3;
+	});
+	UASSERTEQ(int, visited, 3);
+}
+
+void TestMap::testPointableSummary(IGameDef *gamedef)
+{
+	DummyMap map(gamedef, {0, 0, 0}, {0, 0, 0});
+	map.fill({0, 0, 0}, {0, 0, 0}, MapNode(CONTENT_AIR));
+	MapBlock *block = map.getBlockNoCreateNoEx(v3s16(0, 0, 0));
+	UASSERT(!block->mayBePointed(false));
+	UASSERT(!block->mayBePointed(true));
+
+	// Liquids only count if they are pointable
+	ContentFeatures water = gamedef->ndef()->get(t_CONTENT_WATER);
+	map.setNode(v3s16(1, 2, 3), MapNode(t_CONTENT_WATER));
+	UASSERT(block->mayBePointed(true));
+	UASSERTEQ(bool, block->mayBePointed(false),
+			water.pointable != PointabilityType::POINTABLE_NOT);
+
+	map.setNode(v3s16(4, 5, 6), MapNode(t_CONTENT_STONE));
+	UASSERT(block->mayBePointed(false));
+
+	// Bulk writes expire the summary
+	map.fill({0, 0, 0}, {0, 0, 0}, MapNode(CONTENT_AIR));
+	UASSERT(!block->mayBePointed(true));
+}
+
+void TestMap::testTimerUpdate(IGameDef *gamedef)
+{
+	DummyMap map(gamedef, {0, 0, 0}, {3, 0, 0});
+	UASSERTEQ(size_t, map.getBlockCount(), 4);
+	std::vector<v3s16> unloaded;
+	auto get_block = [&] (s16 x) { return map.getBlockNoCreateNoEx(v3s16(x, 0, 0)); };
+
+	map.timerUpdate(1.0f, 5.0f, -1, &unloaded);
+	UASSERT(unloaded.empty());
+	UASSERT(get_block(0)->getUsageTimer() == 1.0f);
+
+	// Only the unused blocks time out
+	get_block(2)->resetUsageTimer();
+	get_block(0)->resetUsageTimer();
+	map.timerUpdate(5.0f, 5.5f, -1, &unloaded);
+	UASSERTEQ(size_t, unloaded.size(), 2);
+	UASSERT(unloaded[0] == v3s16(1, 0, 0) || unloaded[1] == v3s16(1, 0, 0));
+	UASSERT(!get_block(1) && !get_block(3));
+	UASSERT(!map.getSectorNoGenerate(v2s16(1, 0)));
+	UASSERTEQ(size_t, map.getBlockCount(), 2);
+
+	// The least recently used block goes first, unless it is in use
+	unloaded.clear();
+	get_block(2)->refGrab();
+	map.timerUpdate(0.0f, 100.0f, 1, &unloaded);
+	UASSERT(unloaded.empty());
+	get_block(2)->refDrop();
+	map.timerUpdate(0.0f, 100.0f, 1, &unloaded);
+	UASSERTEQ(size_t, unloaded.size(), 1);
+	UASSERT(unloaded[0] == v3s16(2, 0, 0));
+
+	map.unloadUnreferencedBlocks();
+	UASSERTEQ(size_t, map.getBlockCount(), 0);
+	UASSERT(!map.getSectorNoGenerate(v2s16(0, 0)));
+}
+
+void TestMap::testBlockIndex()
+{
+	// The index never dereferences the blocks
+	std::vector<char> storage(1000);
+	auto fake_block = [&] (size_t i) { return reinterpret_cast<MapBlock *>(&storage[i]); };
+
+	MapBlockIndex index;
+	UASSERT(!index.find(v3s16(0, 0, 0)));
+	UASSERT(!index.erase(v3s16(0, 0, 0)));
+
+	// Compare to a std::map in a small area, so that clusters form
+	std::map<v3s16, MapBlock *> expected;
+	PcgRandom pr(7);
+	for (int i = 0; i < 5000; i++) {
+		v3s16 p(pr.range(-8, 8), pr.range(-2, 2), pr.range(-8, 8));
+		if (expected.count(p)) {
+			UASSERT(index.erase(p));
+			expected.erase(p);
+		} else {
+			MapBlock *block = fake_block(pr.range(0, storage.size() - 1));
+			index.insert(p, block);
+			expected[p] = block;
+		}
+		UASSERTEQ(size_t, index.size(), expected.size());
+	}
+	v3s16 p;
+	for (p.Z = -9; p.Z <= 9; p.Z++)
+	for (p.Y = -3; p.Y <= 3; p.Y++)
+	for (p.X = -9; p.X <= 9; p.X++) {
+		auto it = expected.find(p);
+		UASSERT(index.find(p) == (it != expected.end() ? it->second : nullptr));
+	}
+
+	index.clear();
+	UASSERTEQ(size_t, index.size(), 0);
+	UASSERT(!index.find(expected.begin()->first));
+}
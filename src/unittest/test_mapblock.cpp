@@ -33,6 +33,10 @@ class TestMapBlock : public TestBase
 
 	// Tests loading a non-standard MapBlock
 	void testLoadNonStd(IGameDef *gamedef);
+
+	void testUniform(IGameDef *gamedef);
+
+	void testSerializeUncompressed(IGameDef *gamedef);
 };
 
 static TestMapBlock g_test_instance;
@@ -45,6 +49,8 @@ void TestMapBlock::runTests(IGameDef *gamedef)
 	TEST(testLoad29, gamedef);
 	TEST(testLoad20, gamedef);
 	TEST(testLoadNonStd, gamedef);
+	TEST(testUniform, gamedef);
+	TEST(testSerializeUncompressed, gamedef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -70,7 +76,7 @@ void TestMapBlock::testSaveLoad(IGameDef *gamedef, const u8 version)
 		PcgRandom r(seed);
 		for (size_t i = 0; i < MapBlock::nodecount; ++i) {
 			u32 rval = r.next();
-			block.getData()[i] =
+			block.getDataMutable()[i] =
 				MapNode(rval % max, (rval >> 16) & 0xff, (rval >> 24) & 0xff);
 		}
 
@@ -105,7 +111,7 @@ void TestMapBlock::testSave29(IGameDef *gamedef)
 		// Prepare test block
 		MapBlock block({}, gamedef);
 		for (size_t i = 0; i < MapBlock::nodecount; ++i)
-			block.getData()[i] = MapNode(CONTENT_AIR);
+			block.getDataMutable()[i] = MapNode(CONTENT_AIR);
 		block.setNode({0, 0, 0}, MapNode(t_CONTENT_STONE));
 
 		block.serialize(ss, 29, true, -1);
@@ -356,3 +362,75 @@ void TestMapBlock::testLoadNonStd(IGameDef *gamedef)
 	for (s16 i = 0; i < 16; i++)
 		UASSERTEQ(int, block.getNodeNoEx({i, 1, 0}).param2, data_lo[i]);
 }
+
+void TestMapBlock::testUniform(IGameDef *gamedef)
+{
+	MapBlock block({}, gamedef), other({}, gamedef);
+	UASSERT(block.isUniform());
+	UASSERTEQ(content_t, block.getNodeNoCheck(1, 2, 3).getContent(), CONTENT_IGNORE);
+
+	// Uniform blocks of the same node share memory
+	block.fillData(MapNode(CONTENT_AIR));
+	other.fillData(MapNode(CONTENT_AIR));
+	UASSERT(block.isUniform());
+	UASSERT(block.getData() == other.getData());
+
+	// Setting the same node changes nothing
+	block.setNodeNoCheck(1, 2, 3, MapNode(CONTENT_AIR));
+	UASSERT(block.isUniform());
+
+	// The first change makes a copy
+	block.setNodeNoCheck(1, 2, 3, MapNode(t_CONTENT_STONE));
+	UASSERT(!block.isUniform());
+	UASSERTEQ(content_t, block.getNodeNoCheck(1, 2, 3).getContent(), t_CONTENT_STONE);
+	UASSERTEQ(content_t, block.getNodeNoCheck(3, 2, 1).getContent(), CONTENT_AIR);
+	UASSERTEQ(content_t, other.getNodeNoCheck(1, 2, 3).getContent(), CONTENT_AIR);
+	UASSERT(!block.compactData());
+
+	block.setNodeNoCheck(1, 2, 3, MapNode(CONTENT_AIR));
+	UASSERT(block.compactData());
+	UASSERT(block.getData() == other.getData());
+
+	// Loading compacts
+	std::stringstream ss;
+	block.fillData(MapNode(t_CONTENT_WATER, 0, 7));
+	block.serialize(ss, SER_FMT_VER_HIGHEST_WRITE, true, -1);
+	MapBlock loaded({}, gamedef);
+	loaded.getDataMutable()[0] = MapNode(CONTENT_AIR);
+	UASSERT(!loaded.isUniform());
+	loaded.deSerialize(ss, SER_FMT_VER_HIGHEST_WRITE, true);
+	UASSERT(loaded.isUniform());
+	UASSERT(loaded.getNodeNoCheck(15, 15, 15) == MapNode(t_CONTENT_WATER, 0, 7));
+
+	// Blocks received over the network keep their array, mesh threads
+	// may be reading it
+	MapBlock received({}, gamedef);
+	received.getDataMutable();
+	const MapNode *array = received.getData();
+	std::stringstream ss2;
+	block.serialize(ss2, SER_FMT_VER_HIGHEST_WRITE, false, -1);
+	received.deSerialize(ss2, SER_FMT_VER_HIGHEST_WRITE, false);
+	UASSERT(!received.isUniform());
+	UASSERT(received.getData() == array);
+	UASSERT(received.getNodeNoCheck(15, 15, 15) == MapNode(t_CONTENT_WATER, 0, 7));
+}
+
+void TestMapBlock::testSerializeUncompressed(IGameDef *gamedef)
+{
+	MapBlock block({}, gamedef);
+	block.fillData(MapNode(CONTENT_AIR));
+	block.setNode({1, 2, 3}, MapNode(t_CONTENT_STONE));
+	NodeMetadata *meta = new NodeMetadata(gamedef->idef());
+	meta->setString("infotext", "test");
+	block.m_node_metadata.set({1, 2, 3}, meta);
+
+	// Compressing later gives the same result
+	for (bool disk : {false, true}) {
+		std::ostringstream expected(std::ios_base::binary);
+		block.serialize(expected, SER_FMT_VER_HIGHEST_WRITE, disk, -1);
+		std::ostringstream raw(std::ios_base::binary), actual(std::ios_base::binary);
+		block.serializeUncompressed(raw, SER_FMT_VER_HIGHEST_WRITE, disk);
+		compress(raw.str(), actual, SER_FMT_VER_HIGHEST_WRITE, -1);
+		UASSERT(actual.str() == expected.str());
+	}
+}
@@ -11,6 +11,7 @@
 #include <optional>
 #include "database/database-dummy.h"
 #include "database/database-sqlite3.h"
+#include "filesys.h"
 #if USE_LEVELDB
 #include "database/database-leveldb.h"
 #endif
@@ -73,6 +74,7 @@ class TestMapDatabase : public TestBase
 	void testList(int expect);
 	void testRemove();
 	void testPositionEncoding();
+	void testBlockCache();
 
 private:
 	MapDatabaseProvider *provider = nullptr;
@@ -92,6 +94,7 @@ void TestMapDatabase::runTests(IGameDef *gamedef)
 	sanity_check(!test_data.empty());
 
 	TEST(testPositionEncoding);
+	TEST(testBlockCache);
 
 	rawstream << "-------- Dummy" << std::endl;
 
@@ -224,3 +227,38 @@ void TestMapDatabase::testPositionEncoding()
 	UASSERT(db->getIntegerAsBlock(-0x800800800) == v3s16(-2048, -2048, -2048))
 	UASSERT(db->getIntegerAsBlock(-0x314e3807b) == v3s16(-123, 456, -789))
 }
+
+void TestMapDatabase::testBlockCache()
+{
+	const std::string dir = getTestTempDirectory() + DIR_DELIM "block_cache";
+	fs::CreateAllDirs(dir);
+	// The hash uses all 64 bits
+	const u64 hash = 0xfedcba9876543210ULL;
+	{
+		BlockCacheDatabaseSQLite3 db(dir);
+		db.beginSave();
+		UASSERT(db.saveBlock({1, 2, 3}, hash, test_data));
+		UASSERT(db.saveBlock({-4, 5, -6}, 1, "wrong"));
+		UASSERT(db.saveBlock({-4, 5, -6}, 2, "stuff"));
+		db.endSave();
+	}
+
+	// The hashes are there without loading the blocks
+	BlockCacheDatabaseSQLite3 db(dir);
+	std::unordered_map<v3s16, u64> hashes;
+	db.listHashes(hashes);
+	UASSERTEQ(size_t, hashes.size(), 2);
+	UASSERTEQ(u64, hashes[v3s16(1, 2, 3)], hash);
+	UASSERTEQ(u64, hashes[v3s16(-4, 5, -6)], 2);
+
+	std::string dest;
+	db.loadBlock({1, 2, 3}, &dest);
+	UASSERT(dest == test_data);
+	UASSERT(db.deleteBlock({1, 2, 3}));
+	db.loadBlock({1, 2, 3}, &dest);
+	UASSERT(dest.empty());
+
+	hashes.clear();
+	db.listHashes(hashes);
+	UASSERTEQ(size_t, hashes.size(), 1);
+}
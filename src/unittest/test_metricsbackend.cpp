@@ -0,0 +1,60 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "util/metricsbackend.h"
+
+class TestMetricsBackend : public TestBase
+{
+public:
+	TestMetricsBackend() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMetricsBackend"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testHistogram();
+	void testLookup();
+};
+
+static TestMetricsBackend g_test_instance;
+
+void TestMetricsBackend::runTests(IGameDef *gamedef)
+{
+	TEST(testHistogram);
+	TEST(testLookup);
+}
+
+void TestMetricsBackend::testHistogram()
+{
+	MetricsBackend mb;
+	auto h = mb.addHistogram("test_histogram", "", {10, 20, 50});
+	UASSERTEQ(double, h->getQuantile(0.5), 0);
+
+	// 1..100, a quarter of the values in each bucket
+	for (int i = 1; i <= 100; i++)
+		h->observe(i <= 25 ? 5 : i <= 50 ? 15 : i <= 75 ? 30 : 100);
+	UASSERTEQ(u64, h->getCount(), 100);
+	UASSERTEQ(double, h->getSum(), 25 * (5 + 15 + 30 + 100));
+
+	UASSERT(h->getQuantile(0.1) >= 0 && h->getQuantile(0.1) <= 10);
+	UASSERTEQ(double, h->getQuantile(0.5), 20);
+	UASSERT(h->getQuantile(0.6) > 20 && h->getQuantile(0.6) <= 50);
+	// The unbounded bucket ends at the largest value
+	UASSERTEQ(double, h->getQuantile(1.0), 100);
+}
+
+void TestMetricsBackend::testLookup()
+{
+	MetricsBackend mb;
+	auto c = mb.addCounter("test_counter", "");
+	auto g1 = mb.addGauge("test_gauge", "", {{"kind", "a"}});
+	auto g2 = mb.addGauge("test_gauge", "", {{"kind", "b"}});
+
+	UASSERT(mb.getCounter("test_counter") == c);
+	UASSERT(mb.getGauge("test_gauge", {{"kind", "a"}}) == g1);
+	UASSERT(mb.getGauge("test_gauge", {{"kind", "b"}}) == g2);
+	UASSERT(!mb.getGauge("test_gauge"));
+	UASSERT(!mb.getGauge("test_counter"));
+	UASSERT(!mb.getHistogram("missing"));
+}
@@ -13,6 +13,7 @@
 #include <cstdlib>
 #include "database/database-dummy.h"
 #include "database/database-files.h"
+#include "database/database-journal.h"
 #include "database/database-sqlite3.h"
 #if USE_POSTGRESQL
 #include "database/database-postgresql.h"
@@ -102,6 +103,33 @@ class SQLite3Provider : public ModStorageDatabaseProvider
 	ModStorageDatabase *m_db = nullptr;
 };
 
+class JournalProvider : public ModStorageDatabaseProvider
+{
+public:
+	JournalProvider(const std::string &dir): m_dir(dir) {}
+
+	~JournalProvider()
+	{
+		if (m_db)
+			m_db->endSave();
+		delete m_db;
+	}
+
+	ModStorageDatabase *getModStorageDatabase() override
+	{
+		if (m_db)
+			m_db->endSave();
+		delete m_db;
+		m_db = new ModStorageDatabaseJournal(m_dir);
+		m_db->beginSave();
+		return m_db;
+	}
+
+private:
+	std::string m_dir;
+	ModStorageDatabase *m_db = nullptr;
+};
+
 #if USE_POSTGRESQL
 void clearPostgreSQLDatabase(const std::string &connect_string)
 {
@@ -160,6 +188,9 @@ class TestModStorageDatabase : public TestBase
 	void testListMods();
 	void testRemove();
 
+	void testJournalRecovery(const std::string &dir);
+	void testJournalCompaction(const std::string &dir);
+
 private:
 	ModStorageDatabaseProvider *mod_storage_provider;
 };
@@ -231,6 +262,30 @@ void TestModStorageDatabase::runTests(IGameDef *gamedef)
 
 	delete mod_storage_provider;
 
+	rawstream << "-------- Journal database (same object)" << std::endl;
+
+	mod_storage_db = new ModStorageDatabaseJournal(test_dir);
+	mod_storage_provider = new FixedProvider(mod_storage_db);
+
+	runTestsForCurrentDB();
+
+	delete mod_storage_db;
+	delete mod_storage_provider;
+
+	// reset database
+	fs::DeleteSingleFileOrEmptyDirectory(test_dir + DIR_DELIM + "mod_storage.journal");
+
+	rawstream << "-------- Journal database (new objects)" << std::endl;
+
+	mod_storage_provider = new JournalProvider(test_dir);
+
+	runTestsForCurrentDB();
+
+	delete mod_storage_provider;
+
+	TEST(testJournalRecovery, test_dir);
+	TEST(testJournalCompaction, test_dir);
+
 #if USE_POSTGRESQL
 	const char *env_postgresql_connect_string = getenv("MINETEST_POSTGRESQL_CONNECT_STRING");
 	if (env_postgresql_connect_string) {
@@ -348,3 +403,89 @@ void TestModStorageDatabase::testRemove()
 	UASSERT(!mod_storage_db->removeModEntries("mod1"));
 	UASSERT(mod_storage_db->removeModEntries("mod2"));
 }
+
+void TestModStorageDatabase::testJournalRecovery(const std::string &dir)
+{
+	const std::string path = dir + DIR_DELIM + "mod_storage.journal";
+	fs::DeleteSingleFileOrEmptyDirectory(path);
+	{
+		ModStorageDatabaseJournal db(dir);
+		UASSERT(db.setModEntry("mod1", "key1", "value1"));
+		UASSERT(db.setModEntry("mod1", "key2", "value2"));
+		db.endSave();
+		UASSERT(db.removeModEntry("mod1", "key2"));
+	}
+
+	// Simulate a crash in the middle of writing a record
+	std::string data;
+	UASSERT(fs::ReadFile(path, data));
+	const size_t good_size = data.size();
+	{
+		ModStorageDatabaseJournal db(dir);
+		UASSERT(db.setModEntry("mod1", "key3", "value3"));
+	}
+	std::string torn;
+	UASSERT(fs::ReadFile(path, torn));
+	UASSERT(torn.size() > good_size + 4);
+	UASSERT(fs::safeWriteToFile(path, torn.substr(0, torn.size() - 4)));
+
+	{
+		ModStorageDatabaseJournal db(dir);
+		StringMap entries;
+		db.getModEntries("mod1", &entries);
+		UASSERTEQ(size_t, entries.size(), 1);
+		UASSERTEQ(std::string, entries["key1"], "value1");
+		// The torn record was cut off
+		UASSERTEQ(u64, db.getFileSize(), good_size);
+
+		// and new records are readable again
+		UASSERT(db.setModEntry("mod1", "key4", "value4"));
+	}
+	{
+		ModStorageDatabaseJournal db(dir);
+		UASSERT(db.hasModEntry("mod1", "key4"));
+	}
+
+	// Not a journal
+	UASSERT(fs::safeWriteToFile(path, "{\"key1\":\"value1\"}"));
+	EXCEPTION_CHECK(DatabaseException, ModStorageDatabaseJournal db(dir));
+	fs::DeleteSingleFileOrEmptyDirectory(path);
+}
+
+void TestModStorageDatabase::testJournalCompaction(const std::string &dir)
+{
+	const std::string path = dir + DIR_DELIM + "mod_storage.journal";
+	fs::DeleteSingleFileOrEmptyDirectory(path);
+	const std::string big(ModStorageDatabaseJournal::COMPACT_MIN_SIZE / 4, 'x');
+	std::string last_big;
+	{
+		ModStorageDatabaseJournal db(dir);
+		UASSERT(db.setModEntry("mod1", "small", "value"));
+		// Overwrite the same entry until the log is mostly garbage
+		for (int i = 0; !db.isCompacting(); i++) {
+			UASSERT(i < 10);
+			last_big = big + std::to_string(i);
+			UASSERT(db.setModEntry("mod1", "big", last_big));
+			db.endSave();
+		}
+		const u64 size_before = db.getFileSize();
+
+		// Changes made while compacting must not get lost
+		UASSERT(db.setModEntry("mod2", "key1", "value1"));
+		db.endSave();
+		UASSERT(db.removeModEntry("mod1", "small"));
+		db.finishCompaction();
+		UASSERT(!db.isCompacting());
+		UASSERT(db.getFileSize() < size_before / 2);
+		db.endSave();
+	}
+	UASSERT(!fs::PathExists(path + ".new"));
+
+	ModStorageDatabaseJournal db(dir);
+	std::string value;
+	UASSERT(db.getModEntry("mod1", "big", &value));
+	UASSERTEQ(std::string, value, last_big);
+	UASSERT(!db.hasModEntry("mod1", "small"));
+	UASSERT(db.getModEntry("mod2", "key1", &value));
+	UASSERTEQ(std::string, value, "value1");
+}
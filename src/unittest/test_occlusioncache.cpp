@@ -0,0 +1,71 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "client/occlusioncache.h"
+#include "dummymap.h"
+#include "mapblock.h"
+
+class TestOcclusionCache : public TestBase
+{
+public:
+	TestOcclusionCache() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestOcclusionCache"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testInvalidate(IGameDef *gamedef);
+};
+
+static TestOcclusionCache g_test_instance;
+
+void TestOcclusionCache::runTests(IGameDef *gamedef)
+{
+	TEST(testInvalidate, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestOcclusionCache::testInvalidate(IGameDef *gamedef)
+{
+	// A wall of stone between the camera and the blocks at X = 3
+	DummyMap map(gamedef, v3s16(-1, -1, -1), v3s16(3, 1, 1));
+	map.fill(v3s16(-1, -1, -1), v3s16(3, 1, 1), MapNode(CONTENT_AIR));
+	map.fill(v3s16(1, -1, -1), v3s16(1, 1, 1), MapNode(t_CONTENT_STONE));
+	MapBlock *behind = map.getBlockNoCreateNoEx(v3s16(3, 0, 0));
+	MapBlock *open = map.getBlockNoCreateNoEx(v3s16(-1, 0, 0));
+
+	OcclusionCache cache(&map);
+	cache.setCamera(v3s16(8, 8, 8), MeshGrid{1});
+	UASSERT(cache.isMeshOccluded(behind));
+	UASSERT(!cache.isMeshOccluded(open));
+	UASSERTEQ(size_t, cache.size(), 2);
+
+	// Checking many meshes at once gives the same results
+	cache.clear();
+	cache.checkMeshes({behind, open});
+	UASSERTEQ(size_t, cache.size(), 2);
+	UASSERT(cache.isMeshOccluded(behind));
+	UASSERT(!cache.isMeshOccluded(open));
+
+	// Turning around in the same node keeps the results
+	cache.setCamera(v3s16(8, 8, 8), MeshGrid{1});
+	UASSERTEQ(size_t, cache.size(), 2);
+
+	// A change far from one of the meshes keeps its result
+	cache.invalidate({v3s16(3, 1, 0)});
+	UASSERTEQ(size_t, cache.size(), 1);
+	UASSERT(!cache.isMeshOccluded(open));
+	UASSERT(cache.isMeshOccluded(behind));
+
+	// Opening the wall is noticed once the changed block is reported
+	map.fill(v3s16(1, 0, 0), v3s16(1, 0, 0), MapNode(CONTENT_AIR));
+	UASSERT(cache.isMeshOccluded(behind));
+	cache.invalidate({v3s16(1, 0, 0)});
+	UASSERT(!cache.isMeshOccluded(behind));
+
+	// Moving the camera forgets everything
+	cache.setCamera(v3s16(9, 8, 8), MeshGrid{1});
+	UASSERTEQ(size_t, cache.size(), 0);
+}
@@ -0,0 +1,116 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "dummymap.h"
+#include "gamedef.h"
+#include "pathfinder.h"
+#include <algorithm>
+
+class TestPathfinder : public TestBase {
+public:
+	TestPathfinder() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestPathfinder"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testCachedPath(IGameDef *gamedef);
+	void testQueuedPaths(IGameDef *gamedef);
+};
+
+static TestPathfinder g_test_instance;
+
+void TestPathfinder::runTests(IGameDef *gamedef)
+{
+	TEST(testCachedPath, gamedef);
+	TEST(testQueuedPaths, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Flat floor at y = 0 with a wall at x = 0 that has a gap at z = 5
+static void make_terrain(DummyMap &map)
+{
+	map.fill({-1, -1, -1}, {0, 0, 0}, MapNode(CONTENT_AIR));
+	for (s16 z = -16; z < 16; z++)
+	for (s16 x = -16; x < 16; x++)
+		map.setNode(v3s16(x, 0, z), MapNode(t_CONTENT_STONE));
+	for (s16 z = -16; z < 16; z++) {
+		if (z == 5)
+			continue;
+		map.setNode(v3s16(0, 1, z), MapNode(t_CONTENT_STONE));
+		map.setNode(v3s16(0, 2, z), MapNode(t_CONTENT_STONE));
+	}
+}
+
+void TestPathfinder::testCachedPath(IGameDef *gamedef)
+{
+	DummyMap map(gamedef, {-1, -1, -1}, {0, 0, 0});
+	make_terrain(map);
+	PathfinderService service(&map, gamedef->ndef());
+
+	PathQuery query;
+	query.source = v3s16(-5, 1, 0);
+	query.destination = v3s16(5, 1, 0);
+	query.searchdistance = 8;
+	query.max_jump = 1;
+	query.max_drop = 1;
+	query.algo = PA_PLAIN;
+
+	std::vector<v3s16> expected = get_path(&map, gamedef->ndef(), query.source,
+		query.destination, query.searchdistance, query.max_jump,
+		query.max_drop, query.algo);
+	UASSERT(!expected.empty());
+	UASSERT(std::find(expected.begin(), expected.end(), v3s16(0, 1, 5)) != expected.end());
+
+	UASSERT(service.findPath(query) == expected);
+	UASSERT(service.getCache().size() > 0);
+	// Cached blocks are used the second time
+	UASSERT(service.findPath(query) == expected);
+
+	// Closing the gap drops the cached block
+	map.addNodeWithEvent(v3s16(0, 1, 5), MapNode(t_CONTENT_STONE));
+	map.addNodeWithEvent(v3s16(0, 2, 5), MapNode(t_CONTENT_STONE));
+	UASSERT(service.findPath(query).empty());
+
+	// Opening another one is seen too
+	map.removeNodeWithEvent(v3s16(0, 1, -3));
+	map.removeNodeWithEvent(v3s16(0, 2, -3));
+	std::vector<v3s16> path = service.findPath(query);
+	UASSERT(!path.empty());
+	UASSERT(std::find(path.begin(), path.end(), v3s16(0, 1, -3)) != path.end());
+}
+
+void TestPathfinder::testQueuedPaths(IGameDef *gamedef)
+{
+	DummyMap map(gamedef, {-1, -1, -1}, {0, 0, 0});
+	make_terrain(map);
+	PathfinderService service(&map, gamedef->ndef());
+
+	std::vector<PathQuery> queries;
+	for (s16 z = -8; z <= 8; z += 4) {
+		PathQuery query;
+		query.source = v3s16(-6, 1, z);
+		query.destination = v3s16(6, 1, -z);
+		query.searchdistance = 10;
+		query.max_jump = 1;
+		query.max_drop = 1;
+		queries.push_back(query);
+	}
+
+	std::vector<std::vector<v3s16>> paths(queries.size());
+	for (size_t i = 0; i < queries.size(); i++) {
+		service.queuePath(queries[i], [&paths, i] (std::vector<v3s16> &&path) {
+			paths[i] = std::move(path);
+		});
+	}
+	UASSERTEQ(size_t, service.getPendingCount(), queries.size());
+	service.finish();
+	UASSERTEQ(size_t, service.getPendingCount(), 0);
+
+	for (size_t i = 0; i < queries.size(); i++) {
+		UASSERT(!paths[i].empty());
+		UASSERT(paths[i] == service.findPath(queries[i]));
+	}
+}
@@ -0,0 +1,214 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "script/cpp_api/s_accounting.h"
+#include <chrono>
+#include <thread>
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+class TestScriptAccounting : public TestBase
+{
+public:
+	TestScriptAccounting() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestScriptAccounting"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSlices();
+	void testNested();
+	void testNestedCallback();
+	void testMemory();
+	void testMetrics();
+	void testBudget();
+};
+
+static TestScriptAccounting g_test_instance;
+
+void TestScriptAccounting::runTests(IGameDef *gamedef)
+{
+	TEST(testSlices);
+	TEST(testNested);
+	TEST(testNestedCallback);
+	TEST(testMemory);
+	TEST(testMetrics);
+	TEST(testBudget);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void wait_ms(u32 ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void TestScriptAccounting::testSlices()
+{
+	lua_State *L = luaL_newstate();
+	ScriptAccounting acc(L, nullptr);
+
+	// Outside of a scope
+	acc.setMod("ignored");
+
+	acc.beginScope(ScriptCallbackType::Globalstep, "");
+	acc.setMod("a");
+	wait_ms(2);
+	acc.setMod("b");
+	acc.setMod("b");
+	acc.endScope();
+
+	auto stats = acc.getStats();
+	UASSERTEQ(size_t, stats.size(), 2);
+	UASSERTEQ(std::string, stats[0].mod, "a");
+	UASSERTEQ(std::string, stats[1].mod, "b");
+	UASSERT(stats[0].type == ScriptCallbackType::Globalstep);
+	UASSERTEQ(u64, stats[0].calls, 1);
+	UASSERTEQ(u64, stats[1].calls, 1);
+	UASSERT(stats[0].time_us >= 2000);
+	UASSERT(stats[0].max_time_us == stats[0].time_us);
+
+	acc.clear();
+	UASSERT(acc.getStats().empty());
+	lua_close(L);
+}
+
+void TestScriptAccounting::testNested()
+{
+	lua_State *L = luaL_newstate();
+	ScriptAccounting acc(L, nullptr);
+
+	for (int i = 0; i < 3; i++) {
+		acc.beginScope(ScriptCallbackType::ABM, "test abm");
+		acc.setMod("a");
+		acc.beginScope(ScriptCallbackType::EntityStep, "test entity");
+		acc.endScope();
+		acc.endScope();
+	}
+
+	auto stats = acc.getStats();
+	UASSERTEQ(size_t, stats.size(), 1);
+	UASSERT(stats[0].type == ScriptCallbackType::ABM);
+	UASSERTEQ(std::string, stats[0].name, "test abm");
+	UASSERTEQ(u64, stats[0].calls, 3);
+	lua_close(L);
+}
+
+void TestScriptAccounting::testNestedCallback()
+{
+	lua_State *L = luaL_newstate();
+	ScriptAccounting acc(L, nullptr);
+
+	// An ABM of mod a calls core.set_node(), which runs an on_construct of b
+	acc.beginNested();
+	acc.beginScope(ScriptCallbackType::ABM, "test abm");
+	acc.setMod("a");
+	acc.beginNested();
+	acc.setMod("b");
+	wait_ms(2);
+	acc.endNested();
+	wait_ms(3);
+	acc.endScope();
+	acc.endNested();
+
+	auto stats = acc.getStats();
+	UASSERTEQ(size_t, stats.size(), 2);
+	// The rest of the ABM is charged to a again
+	UASSERTEQ(std::string, stats[0].mod, "a");
+	UASSERT(stats[0].time_us >= 3000);
+	UASSERTEQ(u64, stats[0].calls, 1);
+	UASSERTEQ(std::string, stats[1].mod, "b");
+	UASSERT(stats[1].time_us >= 2000 && stats[1].time_us < stats[0].time_us);
+	UASSERTEQ(u64, stats[1].calls, 1);
+
+	// A nested callback of the same mod does not split the slice
+	acc.clear();
+	acc.beginScope(ScriptCallbackType::ABM, "test abm");
+	acc.setMod("a");
+	acc.beginNested();
+	acc.setMod("a");
+	acc.endNested();
+	acc.endScope();
+	stats = acc.getStats();
+	UASSERTEQ(size_t, stats.size(), 1);
+	UASSERTEQ(u64, stats[0].calls, 1);
+	lua_close(L);
+}
+
+void TestScriptAccounting::testMemory()
+{
+	lua_State *L = luaL_newstate();
+	lua_gc(L, LUA_GCSTOP, 0);
+	ScriptAccounting acc(L, nullptr);
+
+	acc.beginScope(ScriptCallbackType::NodeTimer, "test node");
+	acc.setMod("a");
+	lua_createtable(L, 10000, 0);
+	acc.endScope();
+	lua_pop(L, 1);
+
+	auto stats = acc.getStats();
+	UASSERTEQ(size_t, stats.size(), 1);
+	UASSERT(stats[0].memory >= 10000 * sizeof(double));
+	lua_close(L);
+}
+
+void TestScriptAccounting::testMetrics()
+{
+	lua_State *L = luaL_newstate();
+	MetricsBackend mb;
+	ScriptAccounting acc(L, &mb);
+
+	acc.beginScope(ScriptCallbackType::LBM, "a:one");
+	acc.setMod("a");
+	acc.endScope();
+	acc.beginScope(ScriptCallbackType::LBM, "a:two");
+	acc.setMod("a");
+	acc.endScope();
+
+	// Both LBMs share the series of the mod
+	UASSERTEQ(size_t, acc.getStats().size(), 2);
+	auto calls = mb.getCounter("minetest_lua_callback_calls",
+		{{"type", "lbm"}, {"mod", "a"}});
+	UASSERT(calls);
+	UASSERTEQ(double, calls->get(), 2);
+	UASSERT(mb.getCounter("minetest_lua_callback_time",
+		{{"type", "lbm"}, {"mod", "a"}}));
+	lua_close(L);
+}
+
+void TestScriptAccounting::testBudget()
+{
+	lua_State *L = luaL_newstate();
+	MetricsBackend mb;
+	ScriptAccounting acc(L, &mb);
+	acc.setBudget(1000);
+
+	// The calls of a step add up
+	for (int i = 0; i < 2; i++) {
+		acc.beginScope(ScriptCallbackType::EntityStep, "test entity");
+		acc.setMod("slow");
+		wait_ms(1);
+		acc.endScope();
+	}
+	acc.beginScope(ScriptCallbackType::EntityStep, "test entity");
+	acc.setMod("fast");
+	acc.endScope();
+	acc.endStep();
+
+	auto slow = mb.getCounter("minetest_lua_budget_exceeded", {{"mod", "slow"}});
+	UASSERT(slow);
+	UASSERTEQ(double, slow->get(), 1);
+	UASSERT(!mb.getCounter("minetest_lua_budget_exceeded", {{"mod", "fast"}}));
+
+	// The next step starts from zero
+	acc.beginScope(ScriptCallbackType::EntityStep, "test entity");
+	acc.setMod("slow");
+	acc.endScope();
+	acc.endStep();
+	UASSERTEQ(double, slow->get(), 1);
+	lua_close(L);
+}
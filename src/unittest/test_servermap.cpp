@@ -0,0 +1,93 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "mock_server.h"
+#include "database/database-sqlite3.h"
+#include "emerge.h"
+#include "mapblock.h"
+#include "servermap.h"
+#include "serialization.h"
+#include <sstream>
+
+class TestServerMap : public TestBase
+{
+public:
+	TestServerMap() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestServerMap"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSaveSnapshot(IGameDef *gamedef);
+};
+
+static TestServerMap g_test_instance;
+
+void TestServerMap::runTests(IGameDef *gamedef)
+{
+	TEST(testSaveSnapshot, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static MapNode load_node(IGameDef *gamedef, MapDatabase *db, v3s16 blockpos, v3s16 p)
+{
+	std::string data;
+	db->loadBlock(blockpos, &data);
+	UASSERT(!data.empty());
+
+	MapBlock block(blockpos, gamedef);
+	std::istringstream is(data, std::ios_base::binary);
+	ServerMap::deSerializeBlock(&block, is);
+	return block.getNodeNoCheck(p);
+}
+
+void TestServerMap::testSaveSnapshot(IGameDef *gamedef)
+{
+	MockServer server(getTestTempDirectory());
+	MetricsBackend mb;
+	EmergeManager emerge(&server, &mb);
+	ServerMap map(server.getWorldPath(), gamedef, &emerge, &mb);
+
+	const v3s16 blockpos(1, -2, 3);
+	MapBlock *block = map.emergeBlock(blockpos);
+	UASSERT(block);
+	block->fillData(MapNode(CONTENT_AIR));
+	block->setNode(v3s16(1, 2, 3), MapNode(t_CONTENT_STONE));
+	UASSERT(block->getModified() == MOD_STATE_WRITE_NEEDED);
+
+	MapSaveSnapshot snapshot;
+	map.snapshotModified(MOD_STATE_WRITE_NEEDED, snapshot);
+	UASSERTEQ(size_t, snapshot.blocks.size(), 1);
+	UASSERT(snapshot.blocks[0].block == block);
+	UASSERT(block->getModified() == MOD_STATE_CLEAN);
+	UASSERTEQ(int, block->refGet(), 1);
+
+	// Changed while being written
+	block->setNode(v3s16(4, 5, 6), MapNode(t_CONTENT_STONE));
+
+	map.writeSnapshot(snapshot);
+	map.releaseSnapshot(snapshot);
+	UASSERTEQ(int, block->refGet(), 0);
+	UASSERT(snapshot.blocks.empty());
+
+	// The data at the time of the snapshot was written
+	MapDatabaseSQLite3 db(server.getWorldPath());
+	UASSERTEQ(content_t, load_node(gamedef, &db, blockpos, v3s16(1, 2, 3)).getContent(),
+			t_CONTENT_STONE);
+	UASSERTEQ(content_t, load_node(gamedef, &db, blockpos, v3s16(4, 5, 6)).getContent(),
+			CONTENT_AIR);
+
+	// and the later change is saved next time
+	UASSERT(block->getModified() == MOD_STATE_WRITE_NEEDED);
+	map.snapshotModified(MOD_STATE_WRITE_NEEDED, snapshot);
+	map.writeSnapshot(snapshot);
+	map.releaseSnapshot(snapshot);
+	UASSERTEQ(content_t, load_node(gamedef, &db, blockpos, v3s16(4, 5, 6)).getContent(),
+			t_CONTENT_STONE);
+
+	// Nothing left to save
+	map.snapshotModified(MOD_STATE_WRITE_NEEDED, snapshot);
+	UASSERT(snapshot.blocks.empty());
+}
@@ -0,0 +1,216 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "database/database-sqlite3.h"
+#include "filesys.h"
+#include "network/connection.h"
+#include "network/networkpacket.h"
+#include "serialization.h"
+#include "server.h"
+#include "server/session_recorder.h"
+#include "util/auth.h"
+#include "util/serialize.h"
+#include "util/srp.h"
+#include "util/string.h"
+#include <unordered_map>
+
+class TestSessionRecorder : public TestBase
+{
+public:
+	TestSessionRecorder() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestSessionRecorder"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testReplayLogin();
+};
+
+static TestSessionRecorder g_test_instance;
+
+void TestSessionRecorder::runTests(IGameDef *gamedef)
+{
+	TEST(testReplayLogin);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Makes a packet as it is received from the network, ready for reading
+void set_received(NetworkPacket *pkt, u16 command, const std::string &data,
+	session_t peer_id)
+{
+	std::string raw(2, '\0');
+	writeU16((u8 *)&raw[0], command);
+	raw += data;
+	pkt->clear();
+	pkt->putRawPacket((const u8 *)raw.data(), raw.size(), peer_id);
+}
+
+void receive(Server &server, const NetworkPacket &pkt)
+{
+	NetworkPacket received;
+	set_received(&received, pkt.getCommand(),
+		std::string(pkt.getString(0), pkt.getSize()), pkt.getPeerId());
+	server.processPacket(&received);
+}
+
+class TestPeer : public con::IPeer
+{
+public:
+	TestPeer(session_t id) : IPeer(id), m_address(127, 0, 0, 1, 30000) {}
+
+	const Address &getAddress() const override { return m_address; }
+
+private:
+	Address m_address;
+};
+
+// Keeps the packets sent by the server, so that the test can answer them
+class TestConnection : public con::IConnection
+{
+public:
+	void Serve(Address bind_addr) override {}
+	void Connect(Address address) override {}
+	bool Connected() override { return false; }
+	void Disconnect() override {}
+	void DisconnectPeer(session_t peer_id) override {}
+
+	bool ReceiveTimeoutMs(NetworkPacket *pkt, u32 timeout_ms) override { return false; }
+
+	void Send(session_t peer_id, u8 channelnum, NetworkPacket *pkt, bool reliable) override
+	{
+		sent[pkt->getCommand()] = std::string(pkt->getString(0), pkt->getSize());
+	}
+
+	session_t GetPeerID() const override { return PEER_ID_SERVER; }
+	Address GetPeerAddress(session_t peer_id) override { return Address(127, 0, 0, 1, 30000); }
+	float getPeerStat(session_t peer_id, con::rtt_stat_type type) override { return 0.0f; }
+	float getLocalStat(con::rate_stat_type type) override { return 0.0f; }
+
+	// Returns the last packet with the command, for reading
+	bool take(u16 command, NetworkPacket *pkt)
+	{
+		auto it = sent.find(command);
+		if (it == sent.end())
+			return false;
+		set_received(pkt, command, it->second, PEER_ID_SERVER);
+		sent.erase(it);
+		return true;
+	}
+
+	std::unordered_map<u16, std::string> sent;
+};
+
+}
+
+void TestSessionRecorder::testReplayLogin()
+{
+	const std::string dir = getTestTempDirectory();
+	const std::string game_path = dir + DIR_DELIM "game";
+	const std::string world_path = dir + DIR_DELIM "world";
+	const std::string record_path = dir + DIR_DELIM "recording";
+	const std::string replay_world_path = dir + DIR_DELIM "replay_world";
+	const std::string name = "Alice", password = "secret";
+	const session_t peer_id = 2;
+
+	// An empty game and a world with an existing account
+	UASSERT(fs::CreateAllDirs(game_path + DIR_DELIM "mods"));
+	UASSERT(fs::safeWriteToFile(game_path + DIR_DELIM "game.conf", "title = Test\n"));
+	const SubgameSpec gamespec("test", game_path, game_path + DIR_DELIM "mods");
+	UASSERT(fs::CreateAllDirs(world_path));
+	UASSERT(fs::safeWriteToFile(world_path + DIR_DELIM "world.mt",
+		"gameid = test\nbackend = sqlite3\nplayer_backend = sqlite3\n"
+		"auth_backend = sqlite3\n"));
+	{
+		AuthDatabaseSQLite3 auth_db(world_path);
+		AuthEntry entry;
+		entry.id = 0;
+		entry.name = name;
+		entry.password = get_encoded_srp_verifier(name, password);
+		entry.privileges = {"interact"};
+		entry.last_login = 0;
+		UASSERT(auth_db.createAuth(entry));
+	}
+
+	// Log in while recording
+	{
+		auto con = std::make_shared<TestConnection>();
+		Server server(world_path, gamespec, false, Address(), true,
+			nullptr, nullptr, con);
+		server.setSessionRecorder(std::make_unique<SessionRecorder>(
+			record_path, world_path, gamespec.id));
+		server.startOffline();
+
+		TestPeer peer(peer_id);
+		server.peerAdded(&peer);
+
+		NetworkPacket init(TOSERVER_INIT, 0, peer_id);
+		init << SER_FMT_VER_HIGHEST_READ << (u16) 0;
+		init << CLIENT_PROTOCOL_VERSION_MIN << LATEST_PROTOCOL_VERSION;
+		init << name;
+		receive(server, init);
+
+		NetworkPacket pkt;
+		UASSERT(con->take(TOCLIENT_HELLO, &pkt));
+		u8 ser_ver;
+		u16 unused_compression_mode, proto_ver;
+		u32 auth_mechs;
+		pkt >> ser_ver >> unused_compression_mode >> proto_ver >> auth_mechs;
+		UASSERT(auth_mechs & AUTH_MECHANISM_SRP);
+
+		const std::string name_lower = lowercase(name);
+		SRPUser *usr = srp_user_new(SRP_SHA256, SRP_NG_2048,
+			name.c_str(), name_lower.c_str(),
+			(const unsigned char *) password.c_str(), password.size(),
+			NULL, NULL);
+		char *bytes_A = 0;
+		size_t len_A = 0;
+		UASSERT(srp_user_start_authentication(usr, NULL, NULL, 0,
+			(unsigned char **) &bytes_A, &len_A) == SRP_OK);
+		NetworkPacket srp_a(TOSERVER_SRP_BYTES_A, 0, peer_id);
+		srp_a << std::string(bytes_A, len_A) << (u8) 1;
+		receive(server, srp_a);
+
+		UASSERT(con->take(TOCLIENT_SRP_BYTES_S_B, &pkt));
+		std::string s, B;
+		pkt >> s >> B;
+		char *bytes_M = 0;
+		size_t len_M = 0;
+		srp_user_process_challenge(usr, (const unsigned char *) s.c_str(), s.size(),
+			(const unsigned char *) B.c_str(), B.size(),
+			(unsigned char **) &bytes_M, &len_M);
+		UASSERT(bytes_M);
+		NetworkPacket srp_m(TOSERVER_SRP_BYTES_M, 0, peer_id);
+		srp_m << std::string(bytes_M, len_M);
+		receive(server, srp_m);
+		srp_user_delete(usr);
+
+		UASSERT(con->take(TOCLIENT_AUTH_ACCEPT, &pkt));
+		ClientInfo info;
+		UASSERT(server.getClientInfo(peer_id, info));
+		UASSERTEQ(int, info.state, CS_AwaitingInit2);
+	}
+
+	// The replay logs in as well, although the server's SRP values differ
+	SessionReplay replay(record_path);
+	UASSERTEQ(std::string, replay.getGameId(), gamespec.id);
+	UASSERT(fs::CopyDir(SessionReplay::getWorldPath(record_path), replay_world_path));
+	{
+		Server server(replay_world_path, gamespec, false, Address(), true,
+			nullptr, nullptr, replay.createConnection());
+		server.setRandomSeed(replay.getSeed());
+		server.startOffline();
+
+		SessionReplayStats stats;
+		UASSERT(replay.run(&server, &stats));
+		UASSERTEQ(u32, stats.peers, 1);
+		UASSERTEQ(u32, stats.packets, 3);
+
+		ClientInfo info;
+		UASSERT(server.getClientInfo(peer_id, info));
+		UASSERTEQ(int, info.state, CS_AwaitingInit2);
+	}
+}
@@ -6,7 +6,9 @@
 
 #include <atomic>
 #include <iostream>
+#include <stdexcept>
 #include "threading/semaphore.h"
+#include "threading/task_pool.h"
 #include "threading/thread.h"
 
 
@@ -19,6 +21,8 @@ class TestThreading : public TestBase {
 	void testStartStopWait();
 	void testAtomicSemaphoreThread();
 	void testTLS();
+	void testTaskPool();
+	void testTaskPoolParallelFor();
 };
 
 static TestThreading g_test_instance;
@@ -28,6 +32,8 @@ void TestThreading::runTests(IGameDef *gamedef)
 	TEST(testStartStopWait);
 	TEST(testAtomicSemaphoreThread);
 	TEST(testTLS);
+	TEST(testTaskPool);
+	TEST(testTaskPoolParallelFor);
 }
 
 class SimpleTestThread : public Thread {
@@ -227,3 +233,71 @@ void TestThreading::testTLS()
 		}
 	}
 }
+
+
+void TestThreading::testTaskPool()
+{
+	std::atomic<u32> named_runs{0};
+	{
+		TaskPool pool(3, "TestPool");
+		UASSERTEQ(unsigned int, pool.getThreadCount(), 3);
+
+		pool.setProfileHook([&] (const char *name, u64 time_us) {
+			if (std::string(name) == "test")
+				named_runs++;
+		});
+
+		std::atomic<u32> counter{0};
+		std::vector<std::future<u32>> results;
+		for (u32 i = 0; i < 100; i++) {
+			results.push_back(pool.submit([&counter, i] {
+				counter++;
+				return i * 2;
+			}, static_cast<TaskPriority>(i % 3), "test"));
+		}
+		for (u32 i = 0; i < 100; i++)
+			UASSERTEQ(u32, results[i].get(), i * 2);
+		UASSERTEQ(u32, counter.load(), 100);
+
+		// Exceptions end up in the future
+		auto failing = pool.submit([] () -> int {
+			throw std::runtime_error("expected");
+		});
+		EXCEPTION_CHECK(std::runtime_error, failing.get());
+
+		// Tasks posted from a task run too
+		Semaphore done;
+		pool.post([&] {
+			pool.post([&] { done.post(); }, TaskPriority::Low);
+		});
+		UASSERT(done.wait(10000));
+	}
+	// The hook is called after the task (and thus the future) finished
+	UASSERTEQ(u32, named_runs.load(), 100);
+}
+
+void TestThreading::testTaskPoolParallelFor()
+{
+	TaskPool pool(4, "TestPool");
+
+	std::vector<u32> values(10000, 0);
+	pool.parallelFor(0, values.size(), [&] (size_t i) {
+		values[i] += i;
+	}, 64);
+	for (size_t i = 0; i < values.size(); i++)
+		UASSERTEQ(u32, values[i], i);
+
+	// Empty range
+	pool.parallelFor(5, 5, [&] (size_t i) {
+		UASSERT(false);
+	});
+
+	// Nested use from within the pool must not deadlock
+	std::atomic<u32> sum{0};
+	pool.parallelFor(0, 16, [&] (size_t i) {
+		pool.parallelFor(0, 16, [&] (size_t j) {
+			sum += i * 16 + j;
+		});
+	});
+	UASSERTEQ(u32, sum.load(), 256 * 255 / 2);
+}
@@ -0,0 +1,150 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+#include "profiler.h"
+#include "util/trace.h"
+
+#include <sstream>
+#include <thread>
+
+class TestTrace : public TestBase
+{
+public:
+	TestTrace() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestTrace"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testNotRecording();
+	void testScopes();
+	void testThreads();
+	void testSessions();
+	void testJson();
+};
+
+static TestTrace g_test_instance;
+
+void TestTrace::runTests(IGameDef *gamedef)
+{
+	TEST(testNotRecording);
+	TEST(testScopes);
+	TEST(testThreads);
+	TEST(testSessions);
+	TEST(testJson);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Events of the calling thread, which is the first one with the given event
+static const TraceData::Thread *find_thread(const TraceData &data, const std::string &name)
+{
+	for (const auto &thread : data.threads) {
+		for (const auto &event : thread.events) {
+			if (name == event.name || name == event.dynamic_name)
+				return &thread;
+		}
+	}
+	return nullptr;
+}
+
+void TestTrace::testNotRecording()
+{
+	UASSERT(!g_tracer->isRecording());
+	UASSERT(!g_tracer->stop());
+	UASSERT(!g_tracer->begin("unrecorded"));
+	{
+		TraceScope scope("unrecorded");
+	}
+
+	UASSERT(g_tracer->start());
+	UASSERT(!g_tracer->start());
+	auto data = g_tracer->stop();
+	UASSERT(data);
+	UASSERT(!find_thread(*data, "unrecorded"));
+}
+
+void TestTrace::testScopes()
+{
+	UASSERT(g_tracer->start());
+	{
+		TraceScope outer("test outer");
+		{
+			ScopeProfiler sp(nullptr, "test inner");
+			g_tracer->counter("test counter", 42);
+		}
+		TimeTaker timer("test timer");
+	}
+	auto data = g_tracer->stop();
+	UASSERT(data);
+
+	const TraceData::Thread *thread = find_thread(*data, "test outer");
+	UASSERT(thread);
+	const auto &events = thread->events;
+	UASSERTEQ(size_t, events.size(), 6);
+	UASSERTEQ(char, events[0].phase, TraceEvent::BEGIN);
+	UASSERTEQ(char, events[1].phase, TraceEvent::BEGIN);
+	UASSERTEQ(std::string, events[1].dynamic_name, "test inner");
+	UASSERTEQ(char, events[2].phase, TraceEvent::COUNTER);
+	UASSERTEQ(double, events[2].value, 42);
+	UASSERTEQ(char, events[3].phase, TraceEvent::END);
+	UASSERTEQ(char, events[4].phase, TraceEvent::COMPLETE);
+	UASSERTEQ(std::string, events[4].dynamic_name, "test timer");
+	UASSERTEQ(char, events[5].phase, TraceEvent::END);
+	UASSERT(events[0].time_us <= events[5].time_us);
+}
+
+void TestTrace::testThreads()
+{
+	UASSERT(g_tracer->start());
+	{
+		TraceScope scope("test main");
+	}
+	std::thread([] {
+		TraceScope scope("test other");
+	}).join();
+	auto data = g_tracer->stop();
+	UASSERT(data);
+
+	const TraceData::Thread *main = find_thread(*data, "test main");
+	const TraceData::Thread *other = find_thread(*data, "test other");
+	UASSERT(main && other);
+	UASSERT(main->id != other->id);
+	UASSERTEQ(size_t, other->events.size(), 2);
+}
+
+void TestTrace::testSessions()
+{
+	// A scope that outlives its recording must not end in the next one
+	UASSERT(g_tracer->start());
+	auto scope = std::make_unique<TraceScope>("test first");
+	g_tracer->stop();
+	UASSERT(g_tracer->start());
+	scope.reset();
+	{
+		TraceScope scope2("test second");
+	}
+	auto data = g_tracer->stop();
+	UASSERT(data);
+
+	const TraceData::Thread *thread = find_thread(*data, "test second");
+	UASSERT(thread);
+	UASSERTEQ(size_t, thread->events.size(), 2);
+}
+
+void TestTrace::testJson()
+{
+	UASSERT(g_tracer->start());
+	{
+		TraceScope scope("test \"quoted\"");
+	}
+	auto data = g_tracer->stop();
+	UASSERT(data);
+
+	std::ostringstream os;
+	data->writeJson(os);
+	const std::string json = os.str();
+	UASSERT(json.find("\"traceEvents\":[") != std::string::npos);
+	UASSERT(json.find("\"name\":\"test \\\"quoted\\\"\"") != std::string::npos);
+	UASSERT(json.find("\"ph\":\"M\",\"name\":\"thread_name\"") != std::string::npos);
+}
@@ -0,0 +1,144 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "formspec_diff.h"
+#include "util/numeric.h"
+#include "util/serialize.h"
+#include <algorithm>
+
+#define FORMSPEC_HASH_SEED 0x6673
+
+std::vector<std::string> formspec_split_elements(std::string_view formspec)
+{
+	std::vector<std::string> elements;
+	size_t begin = 0;
+	for (size_t i = 0; i < formspec.size(); i++) {
+		if (formspec[i] == '\\') {
+			i++; // skip the escaped character
+		} else if (formspec[i] == ']') {
+			elements.emplace_back(formspec.substr(begin, i + 1 - begin));
+			begin = i + 1;
+		}
+	}
+	// Whatever follows the last element
+	if (begin < formspec.size())
+		elements.emplace_back(formspec.substr(begin));
+	return elements;
+}
+
+u64 formspec_hash(std::string_view formspec)
+{
+	return murmur_hash_64_ua(formspec.data(), formspec.size(), FORMSPEC_HASH_SEED);
+}
+
+FormspecDiff FormspecDiff::make(std::string_view from, std::string_view to)
+{
+	FormspecDiff diff;
+	diff.base_hash = formspec_hash(from);
+	diff.result_hash = formspec_hash(to);
+
+	const auto a = formspec_split_elements(from);
+	auto b = formspec_split_elements(to);
+
+	// Common prefix and suffix
+	size_t prefix = 0;
+	while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix])
+		prefix++;
+	size_t suffix = 0;
+	while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+			a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+		suffix++;
+
+	const size_t a_end = a.size() - suffix;
+	const size_t b_end = b.size() - suffix;
+	if (a_end - prefix != b_end - prefix) {
+		// Elements were added or removed, replace the whole middle part
+		Hunk hunk;
+		hunk.start = prefix;
+		hunk.remove = a_end - prefix;
+		hunk.insert.assign(std::make_move_iterator(b.begin() + prefix),
+				std::make_move_iterator(b.begin() + b_end));
+		diff.hunks.push_back(std::move(hunk));
+		return diff;
+	}
+
+	/*
+		Same number of elements, which is what refreshing a form usually
+		looks like. Only replace the runs of changed elements so that
+		unchanged elements in between are not sent.
+	*/
+	for (size_t i = prefix; i < a_end; i++) {
+		if (a[i] == b[i])
+			continue;
+		if (diff.hunks.empty() ||
+				diff.hunks.back().start + diff.hunks.back().remove != i) {
+			diff.hunks.emplace_back();
+			diff.hunks.back().start = i;
+		}
+		Hunk &hunk = diff.hunks.back();
+		hunk.remove++;
+		hunk.insert.push_back(std::move(b[i]));
+	}
+	return diff;
+}
+
+bool FormspecDiff::apply(std::string_view from, std::string *to) const
+{
+	if (formspec_hash(from) != base_hash)
+		return false;
+
+	const auto elements = formspec_split_elements(from);
+	std::string result;
+	result.reserve(from.size());
+	size_t pos = 0;
+	for (const Hunk &hunk : hunks) {
+		if (hunk.start < pos || hunk.start > elements.size() ||
+				hunk.remove > elements.size() - hunk.start)
+			return false;
+		for (; pos < hunk.start; pos++)
+			result.append(elements[pos]);
+		for (const std::string &element : hunk.insert)
+			result.append(element);
+		pos += hunk.remove;
+	}
+	for (; pos < elements.size(); pos++)
+		result.append(elements[pos]);
+
+	if (formspec_hash(result) != result_hash)
+		return false;
+	*to = std::move(result);
+	return true;
+}
+
+void FormspecDiff::serialize(std::ostream &os) const
+{
+	writeU64(os, base_hash);
+	writeU64(os, result_hash);
+	writeU32(os, hunks.size());
+	for (const Hunk &hunk : hunks) {
+		writeU32(os, hunk.start);
+		writeU32(os, hunk.remove);
+		writeU32(os, hunk.insert.size());
+		for (const std::string &element : hunk.insert)
+			os << serializeString32(element);
+	}
+}
+
+void FormspecDiff::deSerialize(std::istream &is)
+{
+	base_hash = readU64(is);
+	result_hash = readU64(is);
+	const u32 hunk_count = readU32(is);
+	hunks.clear();
+	for (u32 i = 0; i < hunk_count; i++) {
+		Hunk hunk;
+		hunk.start = readU32(is);
+		hunk.remove = readU32(is);
+		const u32 count = readU32(is);
+		if (!is.good())
+			throw SerializationError("FormspecDiff: truncated");
+		for (u32 j = 0; j < count; j++)
+			hunk.insert.push_back(deSerializeString32(is));
+		hunks.push_back(std::move(hunk));
+	}
+}
@@ -0,0 +1,52 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Splits a formspec into its elements. The elements keep their closing ']'
+	and escape sequences, so concatenating them gives back the formspec.
+*/
+std::vector<std::string> formspec_split_elements(std::string_view formspec);
+
+// Hash of a full formspec, used to check that a diff applies
+u64 formspec_hash(std::string_view formspec);
+
+/*
+	Element-level difference between two formspecs, sent to clients in
+	TOCLIENT_FORMSPEC_DIFF instead of the full formspec.
+*/
+struct FormspecDiff
+{
+	// Replaces `remove` elements of the old formspec at `start`
+	struct Hunk
+	{
+		u32 start = 0;
+		u32 remove = 0;
+		std::vector<std::string> insert;
+	};
+
+	u64 base_hash = 0;
+	u64 result_hash = 0;
+	// Sorted by start, not overlapping
+	std::vector<Hunk> hunks;
+
+	static FormspecDiff make(std::string_view from, std::string_view to);
+
+	/**
+	 * Applies the diff to the formspec it was made from.
+	 * @return false if `from` is not the base of this diff or the diff is
+	 *  invalid. `to` is unchanged in that case.
+	 */
+	bool apply(std::string_view from, std::string *to) const;
+
+	void serialize(std::ostream &os) const;
+	// @throws SerializationError
+	void deSerialize(std::istream &is);
+};
@@ -4,11 +4,14 @@
 
 #include "metricsbackend.h"
 #include "util/thread.h"
+#include <algorithm>
+#include <cassert>
 #if USE_PROMETHEUS
 #include <prometheus/exposer.h>
 #include <prometheus/registry.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
+#include <prometheus/histogram.h>
 #include "log.h"
 #include "settings.h"
 #endif
@@ -71,16 +74,138 @@ class SimpleMetricGauge : public MetricGauge
 	double m_gauge;
 };
 
+class SimpleMetricHistogram : public MetricHistogram
+{
+public:
+	SimpleMetricHistogram(const std::vector<double> &buckets) :
+		MetricHistogram(), m_bounds(buckets), m_counts(buckets.size() + 1, 0)
+	{
+		assert(std::is_sorted(m_bounds.begin(), m_bounds.end()));
+	}
+
+	virtual ~SimpleMetricHistogram() {}
+
+	void observe(double value) override
+	{
+		size_t i = std::lower_bound(m_bounds.begin(), m_bounds.end(), value)
+			- m_bounds.begin();
+		MutexAutoLock lock(m_mutex);
+		m_counts[i]++;
+		m_count++;
+		m_sum += value;
+		m_max = m_count == 1 ? value : std::max(m_max, value);
+	}
+	u64 getCount() const override
+	{
+		MutexAutoLock lock(m_mutex);
+		return m_count;
+	}
+	double getSum() const override
+	{
+		MutexAutoLock lock(m_mutex);
+		return m_sum;
+	}
+	double getQuantile(double q) const override
+	{
+		MutexAutoLock lock(m_mutex);
+		if (m_count == 0)
+			return 0.0;
+		// Interpolate linearly inside the bucket containing the rank.
+		// The unbounded bucket ends at the largest value seen.
+		double rank = std::clamp(q, 0.0, 1.0) * m_count;
+		u64 below = 0;
+		for (size_t i = 0; i < m_counts.size(); i++) {
+			if (m_counts[i] == 0 || below + m_counts[i] < rank) {
+				below += m_counts[i];
+				continue;
+			}
+			double lower = i > 0 ? m_bounds[i - 1] : std::min(0.0, m_bounds[0]);
+			double upper = i < m_bounds.size() ? std::min(m_bounds[i], m_max) : m_max;
+			lower = std::min(lower, upper);
+			return lower + (upper - lower) * (rank - below) / m_counts[i];
+		}
+		return m_max;
+	}
+
+private:
+	const std::vector<double> m_bounds;
+	mutable std::mutex m_mutex;
+	std::vector<u64> m_counts;
+	u64 m_count = 0;
+	double m_sum = 0.0;
+	double m_max = 0.0;
+};
+
 MetricCounterPtr MetricsBackend::addCounter(
 		const std::string &name, const std::string &help_str, Labels labels)
 {
-	return std::make_shared<SimpleMetricCounter>();
+	return remember(name, labels, std::make_shared<SimpleMetricCounter>());
 }
 
 MetricGaugePtr MetricsBackend::addGauge(
 		const std::string &name, const std::string &help_str, Labels labels)
 {
-	return std::make_shared<SimpleMetricGauge>();
+	return remember(name, labels, std::make_shared<SimpleMetricGauge>());
+}
+
+MetricHistogramPtr MetricsBackend::addHistogram(
+		const std::string &name, const std::string &help_str,
+		const std::vector<double> &buckets, Labels labels)
+{
+	return remember(name, labels, std::make_shared<SimpleMetricHistogram>(buckets));
+}
+
+std::string MetricsBackend::makeKey(const std::string &name, Labels labels)
+{
+	std::string key = name;
+	for (auto &label : labels)
+		key.append(1, '\0').append(label.first).append(1, '=').append(label.second);
+	return key;
+}
+
+MetricCounterPtr MetricsBackend::remember(const std::string &name, Labels labels,
+		MetricCounterPtr metric)
+{
+	MutexAutoLock lock(m_lookup_mutex);
+	m_counters[makeKey(name, labels)] = metric;
+	return metric;
+}
+
+MetricGaugePtr MetricsBackend::remember(const std::string &name, Labels labels,
+		MetricGaugePtr metric)
+{
+	MutexAutoLock lock(m_lookup_mutex);
+	m_gauges[makeKey(name, labels)] = metric;
+	return metric;
+}
+
+MetricHistogramPtr MetricsBackend::remember(const std::string &name, Labels labels,
+		MetricHistogramPtr metric)
+{
+	MutexAutoLock lock(m_lookup_mutex);
+	m_histograms[makeKey(name, labels)] = metric;
+	return metric;
+}
+
+MetricCounterPtr MetricsBackend::getCounter(const std::string &name, Labels labels) const
+{
+	MutexAutoLock lock(m_lookup_mutex);
+	auto it = m_counters.find(makeKey(name, labels));
+	return it != m_counters.end() ? it->second : nullptr;
+}
+
+MetricGaugePtr MetricsBackend::getGauge(const std::string &name, Labels labels) const
+{
+	MutexAutoLock lock(m_lookup_mutex);
+	auto it = m_gauges.find(makeKey(name, labels));
+	return it != m_gauges.end() ? it->second : nullptr;
+}
+
+MetricHistogramPtr MetricsBackend::getHistogram(const std::string &name, Labels labels) const
+{
+	MutexAutoLock lock(m_lookup_mutex);
+	auto it = m_histograms.find(makeKey(name, labels));
+	return it != m_histograms.end() ? it->second : nullptr;
 }
 
 /* Prometheus backend */
@@ -143,6 +268,37 @@ class PrometheusMetricGauge : public MetricGauge
 	prometheus::Gauge &m_gauge;
 };
 
+class PrometheusMetricHistogram : public SimpleMetricHistogram
+{
+public:
+	PrometheusMetricHistogram() = delete;
+
+	PrometheusMetricHistogram(const std::string &name, const std::string &help_str,
+			const std::vector<double> &buckets, MetricsBackend::Labels labels,
+			std::shared_ptr<prometheus::Registry> registry) :
+			SimpleMetricHistogram(buckets),
+			m_family(prometheus::BuildHistogram()
+							.Name(name)
+							.Help(help_str)
+							.Register(*registry)),
+			m_histogram(m_family.Add(labels, buckets))
+	{
+	}
+
+	virtual ~PrometheusMetricHistogram() {}
+
+	// The quantiles are computed from the local copy of the buckets
+	virtual void observe(double value)
+	{
+		SimpleMetricHistogram::observe(value);
+		m_histogram.Observe(value);
+	}
+
+private:
+	prometheus::Family<prometheus::Histogram> &m_family;
+	prometheus::Histogram &m_histogram;
+};
+
 class PrometheusMetricsBackend : public MetricsBackend
 {
 public:
@@ -161,6 +317,9 @@ class PrometheusMetricsBackend : public MetricsBackend
 	MetricGaugePtr addGauge(
 			const std::string &name, const std::string &help_str,
 			Labels labels = {}) override;
+	MetricHistogramPtr addHistogram(
+			const std::string &name, const std::string &help_str,
+			const std::vector<double> &buckets, Labels labels = {}) override;
 
 private:
 	std::unique_ptr<prometheus::Exposer> m_exposer;
@@ -170,13 +329,23 @@ class PrometheusMetricsBackend : public MetricsBackend
 MetricCounterPtr PrometheusMetricsBackend::addCounter(
 		const std::string &name, const std::string &help_str, Labels labels)
 {
-	return std::make_shared<PrometheusMetricCounter>(name, help_str, labels, m_registry);
+	return remember(name, labels,
+		std::make_shared<PrometheusMetricCounter>(name, help_str, labels, m_registry));
 }
 
 MetricGaugePtr PrometheusMetricsBackend::addGauge(
 		const std::string &name, const std::string &help_str, Labels labels)
 {
-	return std::make_shared<PrometheusMetricGauge>(name, help_str, labels, m_registry);
+	return remember(name, labels,
+		std::make_shared<PrometheusMetricGauge>(name, help_str, labels, m_registry));
+}
+
+MetricHistogramPtr PrometheusMetricsBackend::addHistogram(
+		const std::string &name, const std::string &help_str,
+		const std::vector<double> &buckets, Labels labels)
+{
+	return remember(name, labels, std::make_shared<PrometheusMetricHistogram>(
+		name, help_str, buckets, labels, m_registry));
 }
 
 MetricsBackend *createPrometheusMetricsBackend()
@@ -3,10 +3,14 @@
 // Copyright (C) 2013-2020 Minetest core developers team
 
 #pragma once
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 #include "config.h"
+#include "irrlichttypes.h"
 
 class MetricCounter
 {
@@ -35,6 +39,21 @@ class MetricGauge
 
 typedef std::shared_ptr<MetricGauge> MetricGaugePtr;
 
+class MetricHistogram
+{
+public:
+	MetricHistogram() = default;
+	virtual ~MetricHistogram() {}
+
+	virtual void observe(double value) = 0;
+	virtual u64 getCount() const = 0;
+	virtual double getSum() const = 0;
+	// Estimates the q-quantile (0 <= q <= 1) from the bucket counts
+	virtual double getQuantile(double q) const = 0;
+};
+
+typedef std::shared_ptr<MetricHistogram> MetricHistogramPtr;
+
 class MetricsBackend
 {
 public:
@@ -50,6 +69,33 @@ class MetricsBackend
 	virtual MetricGaugePtr addGauge(
 			const std::string &name, const std::string &help_str,
 			Labels labels = {});
+	// buckets: ascending upper bounds, an unbounded bucket is added implicitly
+	virtual MetricHistogramPtr addHistogram(
+			const std::string &name, const std::string &help_str,
+			const std::vector<double> &buckets, Labels labels = {});
+
+	// Look up metrics added before, e.g. to report them in benchmarks.
+	// Return nullptr if there is no such metric.
+	MetricCounterPtr getCounter(const std::string &name, Labels labels = {}) const;
+	MetricGaugePtr getGauge(const std::string &name, Labels labels = {}) const;
+	MetricHistogramPtr getHistogram(const std::string &name, Labels labels = {}) const;
+
+protected:
+	// Make a new metric available for lookup, returns it
+	MetricCounterPtr remember(const std::string &name, Labels labels,
+			MetricCounterPtr metric);
+	MetricGaugePtr remember(const std::string &name, Labels labels,
+			MetricGaugePtr metric);
+	MetricHistogramPtr remember(const std::string &name, Labels labels,
+			MetricHistogramPtr metric);
+
+private:
+	static std::string makeKey(const std::string &name, Labels labels);
+
+	mutable std::mutex m_lookup_mutex;
+	std::map<std::string, MetricCounterPtr> m_counters;
+	std::map<std::string, MetricGaugePtr> m_gauges;
+	std::map<std::string, MetricHistogramPtr> m_histograms;
 };
 
 #if USE_PROMETHEUS
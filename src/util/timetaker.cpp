@@ -6,17 +6,26 @@
 
 #include "porting.h"
 #include "log.h"
+#include "util/trace.h"
 #include <ostream>
 
 void TimeTaker::start()
 {
 	m_time1 = porting::getTime(m_precision);
+	if (g_tracer->isRecording()) {
+		m_trace_session = g_tracer->getSession();
+		m_trace_start_us = porting::getTimeUs();
+	}
 }
 
 u64 TimeTaker::stop(bool quiet)
 {
 	if (m_running) {
 		u64 dtime = porting::getTime(m_precision) - m_time1;
+		if (m_trace_session != 0 && g_tracer->getSession() == m_trace_session) {
+			g_tracer->complete(m_name, m_trace_start_us,
+				porting::getTimeUs() - m_trace_start_us);
+		}
 		if (m_result != nullptr) {
 			(*m_result) += dtime;
 		} else {
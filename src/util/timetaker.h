@@ -34,10 +34,9 @@ class TimeTaker
 	TimeTaker(const std::string &name, u64 *result = nullptr,
 		TimePrecision prec = PRECISION_MILLI)
 	{
-		if (result)
-			m_result = result;
-		else
-			m_name = name;
+		// The name is also used for tracing
+		m_name = name;
+		m_result = result;
 		m_precision = prec;
 		start();
 	}
@@ -59,4 +58,7 @@ class TimeTaker
 	u64 m_time1;
 	bool m_running = true;
 	TimePrecision m_precision;
+	// See TraceScope
+	u32 m_trace_session = 0;
+	u64 m_trace_start_us;
 };
@@ -0,0 +1,242 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "trace.h"
+#include "gettime.h"
+#include "log.h"
+#include "porting.h"
+#include "threading/thread.h"
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
+static TraceRecorder main_tracer;
+TraceRecorder *g_tracer = &main_tracer;
+
+// Static initialization runs on the main thread
+static const std::thread::id main_thread_id = std::this_thread::get_id();
+
+struct TraceRecorder::ThreadBuffer {
+	// Only contended while the recorder collects the events
+	std::mutex mutex;
+	std::vector<TraceEvent> events;
+	std::string name;
+	u32 id;
+};
+
+// ThreadBuffer is private, hence the void
+static thread_local std::shared_ptr<void> current_buffer;
+
+TraceRecorder::ThreadBuffer *TraceRecorder::getThreadBuffer()
+{
+	// There is only g_tracer, so the buffer always belongs to it
+	if (current_buffer)
+		return static_cast<ThreadBuffer *>(current_buffer.get());
+
+	auto buffer = std::make_shared<ThreadBuffer>();
+	if (Thread *thread = Thread::getCurrentThread())
+		buffer->name = thread->getName();
+	else if (std::this_thread::get_id() == main_thread_id)
+		buffer->name = "Main";
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		buffer->id = m_next_thread_id++;
+		m_buffers.push_back(buffer);
+	}
+	if (buffer->name.empty())
+		buffer->name = "Thread " + std::to_string(buffer->id);
+	current_buffer = buffer;
+	return buffer.get();
+}
+
+bool TraceRecorder::start()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (isRecording())
+		return false;
+	m_start_us = porting::getTimeUs();
+	m_dropped = 0;
+	// Session 0 means "not recorded" for TraceScope
+	u32 session = m_session.load() + 1;
+	m_session = session != 0 ? session : 1;
+	m_recording = true;
+	return true;
+}
+
+std::unique_ptr<TraceData> TraceRecorder::stop()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!isRecording())
+		return nullptr;
+	m_recording = false;
+
+	auto data = std::make_unique<TraceData>();
+	data->start_us = m_start_us;
+	for (auto &buffer : m_buffers) {
+		std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+		if (buffer->events.empty())
+			continue;
+		data->threads.push_back({buffer->name, buffer->id, {}});
+		std::swap(data->threads.back().events, buffer->events);
+	}
+	data->dropped = m_dropped;
+
+	// Forget the buffers of threads that exited
+	m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+		[] (const std::shared_ptr<ThreadBuffer> &buffer) {
+			return buffer.use_count() == 1;
+		}), m_buffers.end());
+	return data;
+}
+
+TraceEvent *TraceRecorder::addEvent(TraceEvent::Phase phase)
+{
+	ThreadBuffer *buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> lock(buffer->mutex);
+	// Check again, stop() may have collected the events in the meantime
+	if (!isRecording())
+		return nullptr;
+	// End events are always kept so that no scope stays open
+	if (phase != TraceEvent::END && buffer->events.size() >= MAX_EVENTS_PER_THREAD) {
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	TraceEvent &event = buffer->events.emplace_back();
+	event.name = "";
+	event.time_us = porting::getTimeUs();
+	event.duration_us = 0;
+	event.phase = phase;
+	return &event;
+}
+
+bool TraceRecorder::begin(const char *name)
+{
+	if (!isRecording())
+		return false;
+	TraceEvent *event = addEvent(TraceEvent::BEGIN);
+	if (!event)
+		return false;
+	event->name = name;
+	return true;
+}
+
+bool TraceRecorder::begin(const std::string &name)
+{
+	if (!isRecording())
+		return false;
+	TraceEvent *event = addEvent(TraceEvent::BEGIN);
+	if (!event)
+		return false;
+	event->dynamic_name = name;
+	return true;
+}
+
+void TraceRecorder::end()
+{
+	if (isRecording())
+		addEvent(TraceEvent::END);
+}
+
+void TraceRecorder::complete(const std::string &name, u64 start_us, u64 duration_us)
+{
+	if (!isRecording())
+		return;
+	TraceEvent *event = addEvent(TraceEvent::COMPLETE);
+	if (!event)
+		return;
+	event->dynamic_name = name;
+	event->time_us = start_us;
+	event->duration_us = duration_us;
+}
+
+void TraceRecorder::counter(const char *name, double value)
+{
+	if (!isRecording())
+		return;
+	TraceEvent *event = addEvent(TraceEvent::COUNTER);
+	if (!event)
+		return;
+	event->name = name;
+	event->value = value;
+}
+
+/*
+	TraceData
+*/
+
+static void write_json_string(std::ostream &os, const char *str)
+{
+	static const char hex[] = "0123456789abcdef";
+	os << '"';
+	for (; *str; str++) {
+		const char c = *str;
+		if (c == '"' || c == '\\')
+			os << '\\' << c;
+		else if ((unsigned char)c < 0x20)
+			os << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+		else
+			os << c;
+	}
+	os << '"';
+}
+
+void TraceData::writeJson(std::ostream &os) const
+{
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	auto separator = [&] () {
+		if (!first)
+			os << ",\n";
+		first = false;
+	};
+
+	for (const Thread &thread : threads) {
+		separator();
+		os << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+			<< thread.id << ",\"args\":{\"name\":";
+		write_json_string(os, thread.name.c_str());
+		os << "}}";
+
+		for (const TraceEvent &event : thread.events) {
+			separator();
+			// Events started before the recording are clamped to its start
+			const u64 time = std::max(event.time_us, start_us) - start_us;
+			os << "{\"ph\":\"" << (char)event.phase << "\",\"pid\":1,\"tid\":"
+				<< thread.id << ",\"ts\":" << time;
+			if (event.phase != TraceEvent::END) {
+				os << ",\"name\":";
+				write_json_string(os, event.name[0] ? event.name :
+						event.dynamic_name.c_str());
+			}
+			if (event.phase == TraceEvent::COMPLETE)
+				os << ",\"dur\":" << event.duration_us;
+			else if (event.phase == TraceEvent::COUNTER)
+				os << ",\"args\":{\"value\":" << event.value << "}";
+			os << "}";
+		}
+	}
+	os << "\n],\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+}
+
+bool TraceData::writeFile(const std::string &path) const
+{
+	std::ofstream os(path, std::ios::binary);
+	if (os.good())
+		writeJson(os);
+	os.close();
+	if (os.fail()) {
+		errorstream << "Failed to write trace to " << path << std::endl;
+		return false;
+	}
+	actionstream << "Wrote trace to " << path << std::endl;
+	return true;
+}
+
+std::string TraceData::getDefaultFileName()
+{
+	const struct tm tm = mt_localtime();
+	char buf[32];
+	strftime(buf, sizeof(buf), "trace_%Y%m%d-%H%M%S.json", &tm);
+	return buf;
+}
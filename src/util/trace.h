@@ -0,0 +1,138 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+	Trace event recorder
+
+	While recording, timeline events of all threads are collected and can
+	be written in the Chrome trace event format (JSON), which can be opened
+	with chrome://tracing or https://ui.perfetto.dev.
+
+	Every thread appends to its own buffer, so threads never wait for each
+	other. When not recording, an event costs one atomic load.
+	ScopeProfiler, TimeTaker and ZoneScoped (see tracy_wrapper.h) feed
+	the recorder.
+*/
+
+struct TraceEvent {
+	enum Phase : char {
+		BEGIN = 'B',
+		END = 'E',
+		COMPLETE = 'X',
+		COUNTER = 'C',
+	};
+
+	// Either a static string or empty, then 'dynamic_name' is used
+	const char *name;
+	std::string dynamic_name;
+	u64 time_us;
+	// Duration for COMPLETE, value for COUNTER
+	union {
+		u64 duration_us;
+		double value;
+	};
+	Phase phase;
+};
+
+// The events of one recording
+struct TraceData {
+	struct Thread {
+		std::string name;
+		u32 id;
+		std::vector<TraceEvent> events;
+	};
+
+	u64 start_us = 0;
+	u64 dropped = 0;
+	std::vector<Thread> threads;
+
+	void writeJson(std::ostream &os) const;
+	// Logs errors, returns false on failure
+	bool writeFile(const std::string &path) const;
+
+	// e.g. "trace_20240131-235959.json"
+	static std::string getDefaultFileName();
+};
+
+// Use g_tracer, the thread buffers are shared by the whole process
+class TraceRecorder
+{
+public:
+	TraceRecorder() = default;
+	DISABLE_CLASS_COPY(TraceRecorder)
+
+	// Returns false if already recording
+	bool start();
+	// Stops recording and returns the events, nullptr if not recording
+	std::unique_ptr<TraceData> stop();
+
+	bool isRecording() const { return m_recording.load(std::memory_order_relaxed); }
+	// Changes with every start(), to match begin and end of a scope
+	u32 getSession() const { return m_session.load(std::memory_order_relaxed); }
+
+	/*
+		Adds an event for the calling thread if recording. Names passed as
+		const char * must be static strings. Begin and end events must be
+		nested per thread, end() has to be called exactly once for every
+		begin() that returned true and in the same session.
+	*/
+	bool begin(const char *name);
+	bool begin(const std::string &name);
+	void end();
+	void complete(const std::string &name, u64 start_us, u64 duration_us);
+	void counter(const char *name, double value);
+
+	// Per-thread limit of recorded events, the rest is dropped
+	static constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+private:
+	struct ThreadBuffer;
+
+	ThreadBuffer *getThreadBuffer();
+	// Returns nullptr if the event has to be dropped
+	TraceEvent *addEvent(TraceEvent::Phase phase);
+
+	std::atomic<bool> m_recording{false};
+	std::atomic<u32> m_session{0};
+	std::atomic<u64> m_dropped{0};
+	u64 m_start_us = 0;
+
+	std::mutex m_mutex;
+	std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+	u32 m_next_thread_id = 1;
+};
+
+extern TraceRecorder *g_tracer;
+
+// Records the lifetime of the object as a begin/end pair
+class TraceScope
+{
+public:
+	TraceScope(const char *name)
+	{
+		if (g_tracer->isRecording() && g_tracer->begin(name))
+			m_session = g_tracer->getSession();
+	}
+
+	~TraceScope()
+	{
+		if (m_session != 0 && g_tracer->getSession() == m_session)
+			g_tracer->end();
+	}
+
+	DISABLE_CLASS_COPY(TraceScope)
+
+private:
+	u32 m_session = 0;
+};
@@ -6,6 +6,9 @@
  * Wrapper for <tracy/Tracy.hpp>, so that we can use Tracy's macros without
  * having it as mandatory dependency.
  *
+ * ZoneScoped and ZoneScopedN additionally feed the built-in trace recorder
+ * (see util/trace.h), with or without Tracy.
+ *
  * For annotations that you don't intend to upstream, you can also include
  * <tracy/Tracy.hpp> directly (which also works in irr/).
  */
@@ -14,6 +17,7 @@
 
 #include "config.h"
 #include "util/basic_macros.h"
+#include "util/trace.h"
 
 #if BUILD_WITH_TRACY
 
@@ -129,6 +133,24 @@
 
 #endif
 
+#if defined(__GNUC__)
+#define TRACE_FUNCTION __PRETTY_FUNCTION__
+#else
+#define TRACE_FUNCTION __FUNCTION__
+#endif
+
+#undef ZoneScoped
+#undef ZoneScopedN
+#if BUILD_WITH_TRACY
+#define ZoneScoped ZoneNamed(___tracy_scoped_zone, true); \
+	TraceScope ___trace_scope(TRACE_FUNCTION)
+#define ZoneScopedN(x) ZoneNamedN(___tracy_scoped_zone, x, true); \
+	TraceScope ___trace_scope(x)
+#else
+#define ZoneScoped TraceScope ___trace_scope(TRACE_FUNCTION)
+#define ZoneScopedN(x) TraceScope ___trace_scope(x)
+#endif
+
 
 // Helper for making sure frames end in all possible control flow path
 class FrameMarker